@@ -0,0 +1,303 @@
+/*
+ * ============================================================================
+ * DecoderBench.c - ELSGW API Frame Decoder Benchmark
+ * ============================================================================
+ * 機能:
+ *   - 全メッセージ種別と未知の種別を混ぜたデータグラム群を生成し、
+ *     elsgw_decode() の1フレームあたりの処理時間を計測する
+ *   - ハンドラ未登録 (集計のみ) と、全種別にフィールドを読むハンドラを
+ *     登録した場合の両方を計測する
+ *   - 計測前に、種別ごとの件数とハンドラが読んだ値が生成内容と
+ *     一致することを確認する
+ *
+ * 使い方:
+ *   ./DecoderBench [-n 反復回数] [-f 1データグラムのフレーム数]
+ *
+ * ビルド:
+ *   gcc -O2 -Wall -o DecoderBench DecoderBench.c elsgw_decoder.c
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "elsgw_decoder.h"
+
+/* ============================================================================
+ * 動作設定
+ * ============================================================================ */
+#define ITERATIONS_DEFAULT  2000    /* 既定の反復回数 (データグラム群の周回数) */
+#define FRAMES_DEFAULT      4       /* 既定の1データグラムのフレーム数 */
+#define DATAGRAM_COUNT      256     /* 生成するデータグラム数 */
+#define UNKNOWN_TYPE        0x7f    /* 未知の種別として使う番号 */
+
+/* 生成するフレームの種別の並び (未知の種別を含む) */
+static const uint8_t FRAME_TYPES[] = {
+    ELSGW_MSG_HEARTBEAT, ELSGW_MSG_DEVICE_STATUS, ELSGW_MSG_MEASUREMENT,
+    ELSGW_MSG_EVENT, ELSGW_MSG_COMMAND_ACK, ELSGW_MSG_DEVICE_STATUS,
+    ELSGW_MSG_MEASUREMENT, UNKNOWN_TYPE,
+};
+#define FRAME_TYPE_COUNT    (sizeof(FRAME_TYPES) / sizeof(FRAME_TYPES[0]))
+
+/* ハンドラが読んだ値の合計 (最適化で読み出しが消えないよう検証に使う) */
+static uint64_t g_checksum;
+
+/* ============================================================================
+ * 関数: now_ns
+ * 機能: 単調増加時刻をナノ秒で取得
+ * ============================================================================ */
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* ============================================================================
+ * 関数: put16 / put32 / put64
+ * 機能: ビッグエンディアンで書き込む
+ * ============================================================================ */
+static void put16(unsigned char *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+}
+
+static void put32(unsigned char *p, uint32_t v) {
+    put16(p, v >> 16);
+    put16(p + 2, v & 0xffff);
+}
+
+static void put64(unsigned char *p, uint64_t v) {
+    put32(p, v >> 32);
+    put32(p + 4, v & 0xffffffff);
+}
+
+/* ============================================================================
+ * 関数: build_frame
+ * 機能: 種別に応じた本体を持つフレームを1個書き込み、期待値を加算する
+ * 戻り値: フレーム長
+ * ============================================================================ */
+static size_t build_frame(unsigned char *p, uint8_t type, uint32_t seq,
+                          uint64_t *expect) {
+    unsigned char *body = p + ELSGW_HEADER_SIZE;
+    size_t body_len;
+    uint16_t count;
+
+    switch (type) {
+    case ELSGW_MSG_HEARTBEAT:
+        put32(body, seq);
+        body_len = 4;
+        *expect += seq;
+        break;
+    case ELSGW_MSG_DEVICE_STATUS:
+        put16(body, seq & 0xffff);
+        body[2] = seq & 0x7;
+        body[3] = 0;
+        put32(body + 4, seq * 3);
+        memcpy(body + 8, "status text", 11);
+        body_len = 8 + 11;
+        *expect += (seq & 0xffff) + (seq & 0x7) + (uint32_t)(seq * 3);
+        break;
+    case ELSGW_MSG_MEASUREMENT:
+        count = 1 + seq % 8;
+        put16(body, 1);
+        put16(body + 2, count);
+        for (uint16_t i = 0; i < count; i++) {
+            put32(body + 4 + i * 4, seq + i);
+            *expect += seq + i;
+        }
+        body_len = 4 + count * 4;
+        break;
+    case ELSGW_MSG_EVENT:
+        put16(body, seq & 0xffff);
+        body[2] = 1;
+        body[3] = 0;
+        put64(body + 4, (uint64_t)seq * 1000);
+        body_len = 12;
+        *expect += (seq & 0xffff) + (uint64_t)seq * 1000;
+        break;
+    case ELSGW_MSG_COMMAND_ACK:
+        put32(body, seq);
+        put16(body + 4, 0);
+        put16(body + 6, 0);
+        body_len = 8;
+        *expect += seq;
+        break;
+    default:
+        memset(body, 0xee, 16);
+        body_len = 16;
+        break;
+    }
+
+    p[0] = ELSGW_VERSION;
+    p[1] = type;
+    put16(p + 2, (uint16_t)(ELSGW_HEADER_SIZE + body_len));
+    put32(p + 4, seq);
+    return ELSGW_HEADER_SIZE + body_len;
+}
+
+/* ============================================================================
+ * ハンドラ (本体のフィールドを読んで合計する)
+ * ============================================================================ */
+static void on_heartbeat(const elsgw_msg_t *m, void *ctx) {
+    (void)ctx;
+    g_checksum += elsgw_heartbeat_uptime(m);
+}
+
+static void on_device_status(const elsgw_msg_t *m, void *ctx) {
+    (void)ctx;
+    g_checksum += elsgw_status_device_id(m) + elsgw_status_code(m) +
+                  (uint32_t)elsgw_status_value(m);
+}
+
+static void on_measurement(const elsgw_msg_t *m, void *ctx) {
+    uint16_t count = elsgw_measurement_count(m);
+    (void)ctx;
+    for (uint16_t i = 0; i < count; i++) {
+        g_checksum += (uint32_t)elsgw_measurement_value(m, i);
+    }
+}
+
+static void on_event(const elsgw_msg_t *m, void *ctx) {
+    (void)ctx;
+    g_checksum += elsgw_event_code(m) + elsgw_event_time_ns(m);
+}
+
+static void on_command_ack(const elsgw_msg_t *m, void *ctx) {
+    (void)ctx;
+    g_checksum += elsgw_ack_command_id(m) + elsgw_ack_result(m);
+}
+
+/* ============================================================================
+ * 関数: run
+ * 機能: 全データグラムを iterations 周解析し、経過時間を返す
+ * ============================================================================ */
+static long long run(elsgw_decoder_t *d, const rx_packet_t *pkts, int iterations) {
+    long long start = now_ns();
+
+    for (int it = 0; it < iterations; it++) {
+        for (int i = 0; i < DATAGRAM_COUNT; i++) {
+            elsgw_decode(d, &pkts[i]);
+        }
+    }
+    return now_ns() - start;
+}
+
+/* ============================================================================
+ * 関数: main
+ * ============================================================================ */
+int main(int argc, char *argv[]) {
+    static elsgw_decoder_t decoder;
+    static rx_packet_t pkts[DATAGRAM_COUNT];
+    static struct sockaddr_in sender;
+    unsigned char *buffer;
+    uint64_t expect = 0;
+    unsigned long expect_unknown = 0;
+    unsigned long total_frames;
+    int iterations = ITERATIONS_DEFAULT;
+    int frames = FRAMES_DEFAULT;
+    size_t off, len;
+    uint32_t seq = 1;
+    long long plain_ns, handler_ns;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:f:")) != -1) {
+        switch (c) {
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 'f':
+            frames = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n iterations] [-f frames_per_datagram]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (iterations <= 0 || frames <= 0 || frames > 32) {
+        fprintf(stderr, "[ERROR] Invalid iteration or frame count\n");
+        return 1;
+    }
+
+    /* データグラム群の生成 (BUFFER_SIZE を超えない範囲でフレームを詰める) */
+    buffer = malloc((size_t)DATAGRAM_COUNT * BUFFER_SIZE);
+    if (buffer == NULL) {
+        perror("[ERROR] malloc failed");
+        return 1;
+    }
+    total_frames = 0;
+    for (int i = 0; i < DATAGRAM_COUNT; i++) {
+        unsigned char *dg = buffer + (size_t)i * BUFFER_SIZE;
+        off = 0;
+        for (int f = 0; f < frames; f++, seq++) {
+            uint8_t type = FRAME_TYPES[seq % FRAME_TYPE_COUNT];
+            if (off + ELSGW_HEADER_SIZE + 64 > BUFFER_SIZE) {
+                break;
+            }
+            len = build_frame(dg + off, type, seq, &expect);
+            off += len;
+            total_frames++;
+            if (type == UNKNOWN_TYPE) {
+                expect_unknown++;
+            }
+        }
+        pkts[i].data = dg;
+        pkts[i].len = off;
+        pkts[i].sender = &sender;
+    }
+
+    /* 検証 (全ハンドラ登録、1周) */
+    elsgw_decoder_init(&decoder);
+    elsgw_decoder_register(&decoder, ELSGW_MSG_HEARTBEAT, on_heartbeat, NULL);
+    elsgw_decoder_register(&decoder, ELSGW_MSG_DEVICE_STATUS, on_device_status, NULL);
+    elsgw_decoder_register(&decoder, ELSGW_MSG_MEASUREMENT, on_measurement, NULL);
+    elsgw_decoder_register(&decoder, ELSGW_MSG_EVENT, on_event, NULL);
+    elsgw_decoder_register(&decoder, ELSGW_MSG_COMMAND_ACK, on_command_ack, NULL);
+    run(&decoder, pkts, 1);
+    if (g_checksum != expect || decoder.unknown != expect_unknown ||
+        decoder.frames + decoder.unknown != total_frames || decoder.malformed != 0) {
+        fprintf(stderr, "[ERROR] Decode mismatch: checksum %llu/%llu, "
+                "frames %lu+%lu/%lu, malformed %lu\n",
+                (unsigned long long)g_checksum, (unsigned long long)expect,
+                decoder.frames, decoder.unknown, total_frames, decoder.malformed);
+        return 1;
+    }
+
+    printf("============================================================\n");
+    printf("  ELSGW Decoder Benchmark (%d iterations, %d datagrams, "
+           "%lu frames/iteration)\n", iterations, DATAGRAM_COUNT, total_frames);
+    printf("============================================================\n");
+
+    /* 計測: ハンドラなし (検証・集計のみ) */
+    elsgw_decoder_init(&decoder);
+    plain_ns = run(&decoder, pkts, iterations);
+
+    /* 計測: 全種別にハンドラを登録 */
+    elsgw_decoder_init(&decoder);
+    elsgw_decoder_register(&decoder, ELSGW_MSG_HEARTBEAT, on_heartbeat, NULL);
+    elsgw_decoder_register(&decoder, ELSGW_MSG_DEVICE_STATUS, on_device_status, NULL);
+    elsgw_decoder_register(&decoder, ELSGW_MSG_MEASUREMENT, on_measurement, NULL);
+    elsgw_decoder_register(&decoder, ELSGW_MSG_EVENT, on_event, NULL);
+    elsgw_decoder_register(&decoder, ELSGW_MSG_COMMAND_ACK, on_command_ack, NULL);
+    handler_ns = run(&decoder, pkts, iterations);
+
+    total_frames *= (unsigned long)iterations;
+    printf("%-16s %12s %14s %12s\n", "mode", "ns/message", "ns/datagram", "Mmsg/s");
+    printf("%-16s %12.1f %14.1f %12.2f\n", "count only",
+           (double)plain_ns / total_frames,
+           (double)plain_ns / ((double)DATAGRAM_COUNT * iterations),
+           total_frames / (plain_ns / 1e3));
+    printf("%-16s %12.1f %14.1f %12.2f\n", "with handlers",
+           (double)handler_ns / total_frames,
+           (double)handler_ns / ((double)DATAGRAM_COUNT * iterations),
+           total_frames / (handler_ns / 1e3));
+    printf("[INFO] unknown skipped: %lu, checksum: %llu\n",
+           decoder.unknown, (unsigned long long)g_checksum);
+
+    free(buffer);
+    return 0;
+}
@@ -1,68 +1,543 @@
+/*
+ * ============================================================================
+ * ElsgwReceiver.c - ABOS1 ELSGW Multicast Receiver Program
+ * ============================================================================
+ * 機能:
+ *   - ELSGWからのマルチキャストUDPパケットを受信 (239.64.0.3:52000)
+ *   - recvmmsg() によるバッチ受信 (1回のシステムコールで最大N個)
+ *   - SO_TIMESTAMPNS によるカーネル受信時刻の取得
+ *   - 受信スレッドと処理スレッドの2段構成 (SPSCリングで受け渡し)
+ *   - パケット表示は非同期ログ (NetworkTest/Guest/async_log.h) で行う。
+ *     処理スレッドはデータと引数をリングへ写すのみで、16進ダンプの整形と
+ *     出力はログスレッドがまとめて行う (-l: バイナリ形式でファイルへ出力し、
+ *     LogDecode で後から表示する)
+ *   - 受信バックエンドの選択
+ *       UDPソケット (既定) : recvmmsg() でリングのスロットへ受信
+ *       AF_PACKET (-p)     : TPACKET_V3 mmapリングをカーネル内BPFで絞り込み、
+ *                            ブロック内のパケットをコピーせず処理スレッドへ渡す
+ *       複数グループ (-c)  : 購読設定ファイルの複数グループ/ポートを、CPUごとの
+ *                            受信スレッド (epoll + SO_REUSEPORT) で分担して受信
+ *   - 受信パケットを pcap 形式でファイルへ保存 (-w, ElsgwReplay で再送可能)
+ *   - 受信統計 (送信元別カウンタ、カーネルドロップ、シーケンス欠番、
+ *     到着間隔・処理遅延ヒストグラム) を JSON で定期出力 (-j)
+ *   - ELSGW API フレームを受信バッファ上で解析し、種別ごとのハンドラへ渡す
+ *   - TCP 購読者への中継 (-r): マルチキャストの届かない 192.168.200.x 側の
+ *     ノードが 192.168.200.1 へ TCP で接続すると、受信したデータグラムを
+ *     長さヘッダ付きで中継する (elsgw_relay.h)。購読者ごとのリングに溜め、
+ *     中継スレッドが writev() でまとめて送る。遅い購読者は切断し、
+ *     受信・処理は止めない
+ *   - 共有メモリへの公開 (-m): 受信したデータグラムをメタデータと共に
+ *     /dev/shm/elsgw_feed.<名前> のリングへ1回だけ書き込み、同じホストの
+ *     任意の数のプロセスがコピーなしで読み出す (elsgw_shm.h, seqlock)。
+ *     読み出し側の例は ElsgwShmReader
+ *   - A/B 調停 (-A): 同じフィードを eth0 (192.168.100.1) と eth1
+ *     (192.168.200.1) の両方で受信し、メッセージごとに先着の1個のみを
+ *     処理する (elsgw_arb.h)。重複は宛先 (グループ:ポート) ごとのシーケンス
+ *     番号 (-S -1 の場合は内容のハッシュ) で判定し、系統ごとの勝率と
+ *     ギャップ補完数を表示する
+ *   - 段階ごとの計測 (-T): カーネル受信 -> リング投入 (受信スレッド)、
+ *     カーネル受信 -> 処理開始・パケット処理 (処理スレッド) の所要時間を
+ *     共有メモリ (NetworkTest/Guest/stage_probe.h) へ記録し、実行中に
+ *     StageStat で表示する (リング投入は UDPソケットの単一グループ受信のみ)
+ *
+ * スレッド構成:
+ *   [受信スレッド] CPU0: リングのスロットへ直接受信するのみ
+ *   [処理スレッド] CPU1: リングから取り出して表示・解析
+ *   [中継スレッド]     : TCP 購読者の受け入れと送信 (-r 指定時のみ, 固定しない)
+ *   共有メモリへの公開 (-m) は処理スレッドが行う (読み出し側を待たない)
+ *   処理が追いつかずリングが満杯の場合、受信スレッドはソケットを読み捨てて
+ *   ドロップ数を計上する (カーネルのソケットバッファ溢れにはしない)
+ *   複数グループモードでは受信スレッドが CPU0..N-1 に1個ずつ固定され、
+ *   それぞれ専用のリングへ受信する。処理スレッドは全リングを順に読む。
+ *
+ * 使い方:
+ *   ./ElsgwReceiver [-b バッチ数] [-p] [-i インターフェース]
+ *                   [-w 保存先接頭辞] [-z セグメントMB] [-q]
+ *                   [-j 統計出力先] [-t 周期ms] [-S シーケンス位置]
+ *                   [-c 購読設定ファイル] [-n 受信スレッド数] [-R] [-T]
+ *                   [-l ログファイル] [-r 中継ポート] [-k リングKB]
+ *                   [-m 共有メモリ名] [-A]
+ *     -b  1回のrecvmmsg()で受信する最大パケット数 (1-64, 既定: 32)
+ *     -p  AF_PACKET (TPACKET_V3) バックエンドで受信する (要 CAP_NET_RAW)
+ *     -i  AF_PACKET で受信するインターフェース (既定: eth0)
+ *     -w  受信パケットを <接頭辞>_NNNN.pcap へ保存する
+ *     -z  保存ファイルのセグメントサイズ (MB, 既定: 64)
+ *     -q  パケット表示を行わない (保存のみ等、高レートでの計測用)
+ *     -j  統計スナップショットの出力先ファイル ("-" = 標準エラー出力)
+ *     -t  統計スナップショットの周期 (ミリ秒, 既定: 1000)
+ *     -S  シーケンス番号 (32bit, ビッグエンディアン) のフレーム内位置
+ *         (既定: 4, -1 で欠番検出を行わない)
+ *     -c  複数グループモードで受信する (書式は epoll_rx.h, 例: ElsgwSubscriptions.conf)
+ *     -n  複数グループモードの受信スレッド数 (既定: オンラインCPU数, 最大8)
+ *     -R  ユニキャスト購読を受信CPUと同じ番号のスレッドへ振り分ける (BPF)
+ *     -T  段階ごとの所要時間を共有メモリに記録する (StageStat で表示)
+ *     -l  パケット表示をバイナリ形式でファイルに出力する (LogDecode で表示)
+ *     -r  TCP 購読者への中継を行い、192.168.200.1 のこのポートで待ち受ける
+ *         (例: 52100)
+ *     -k  購読者ごとの中継リングのサイズ (KB, 2のべき乗, 既定: 1024)
+ *     -m  受信したデータグラムを /dev/shm/elsgw_feed.<名前> へ公開する
+ *     -A  eth0 と eth1 の両方でグループへ参加し、A/B 調停を行う
+ *         (-c と併用する場合は、購読設定ファイルに両方のインターフェースを書く。
+ *          -p とは併用できない)
+ *
+ * ビルド:
+ *   gcc -O2 -Wall -pthread -o ElsgwReceiver ElsgwReceiver.c hex_dump.c \
+ *       tpacket_rx.c pcap_writer.c elsgw_stats.c epoll_rx.c elsgw_decoder.c \
+ *       elsgw_relay.c elsgw_shm.c elsgw_arb.c
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 
+#include "elsgw_receiver.h"
+#include "tpacket_rx.h"
+#include "pcap_writer.h"
+#include "elsgw_stats.h"
+#include "epoll_rx.h"
+#include "elsgw_decoder.h"
+#include "elsgw_relay.h"
+#include "elsgw_shm.h"
+#include "elsgw_arb.h"
+#include "hex_dump.h"
+#include "../NetworkTest/Guest/stage_probe.h"
+#include "../NetworkTest/Guest/async_log.h"
+
 /* ============================================================================
-[<35;55;3M * ネットワーク設定 (ABOS1上で、ELSGWからのマルチキャストUDP通信を待ち受け)
+ * 表示設定
  * ============================================================================ */
-#define ABOS1_IP            "192.168.100.1"     /* ABOS1のeth0 IP */
-#define MULTICAST_GROUP     "239.64.0.3"        /* ELSGWのマルチキャストグループ */
-#define LISTEN_PORT         52000               /* ELSGWの連携ポート */
+#define DUMP_FOOTER         "[RECV] ========================================\n\n"
+
+
+/* 終了要求フラグ (SIGINT/SIGTERM で 0 になる) */
+volatile sig_atomic_t g_running = 1;
+
+/* 処理スレッドの動作設定 (処理スレッド起動前に main で設定) */
+static int g_dump_enabled = 1;          /* パケット表示の有無 */
+static pcap_writer_t g_capture;         /* pcap 保存 */
+static int g_capture_enabled = 0;       /* pcap 保存の有無 */
+static elsgw_relay_t g_relay;           /* TCP 購読者への中継 (-r) */
+static int g_relay_enabled = 0;         /* 中継の有無 */
+static elsgw_shm_writer_t g_feed;       /* 共有メモリへの公開 (-m) */
+static int g_feed_enabled = 0;          /* 共有メモリへの公開の有無 */
+static elsgw_arb_t g_arb;               /* A/B 調停 (-A) */
+static int g_arb_enabled = 0;           /* A/B 調停の有無 */
+static elsgw_stats_t g_stats;           /* 受信統計 */
+static elsgw_decoder_t g_decoder;       /* ELSGW API フレーム解析 */
+static stage_shm_t *g_stages = NULL;    /* 段階ごとの計測の共有メモリ (-T) */
+
+/* 段階ごとの計測 (-T) の段階・カウンタ番号 (stage_names / counter_names の順) */
+enum {
+    STAGE_RING,                         /* カーネル受信 -> リング投入 */
+    STAGE_QUEUE,                        /* カーネル受信 -> 処理開始 */
+    STAGE_PROCESS,                      /* パケット処理 (表示・保存・解析) */
+};
+enum {
+    COUNTER_PACKETS,
+    COUNTER_RING_DROPS,
+};
+
+static const char *const stage_names[] = { "kernel->ring", "kernel->process", "process" };
+static const char *const counter_names[] = { "packets", "ring_drops" };
 
 /* ============================================================================
- * 動作設定
+ * 関数: timespec_ns
+ * 機能: 時刻をナノ秒に変換する (受信時刻は CLOCK_REALTIME)
  * ============================================================================ */
-#define BUFFER_SIZE         1024    /* バッファサイズ */
-#define TRUE                1
+static inline long long timespec_ns(const struct timespec *ts) {
+    return (long long)ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
 
 /* ============================================================================
- * 関数: print_hex_dump
- * 機能: バイナリデータを16進数でダンプ表示
+ * 関数: parse_control
+ * 機能: 補助データから以下を取り出す
+ *   SCM_TIMESTAMPNS : カーネル受信時刻 (なければ呼び出し時の時刻で代用)
+ *   SO_RXQ_OVFL     : ソケットバッファ溢れによる累計ドロップ数
+ *                     (ドロップ発生後のみ付加されるため、なければ変更しない)
+ *   IP_PKTINFO      : 宛先アドレスと受信インターフェース (なければ変更しない)
  * ============================================================================ */
-void print_hex_dump(const unsigned char *data, size_t len) {
-    size_t i;
-    printf("[HEX] ");
-    for (i = 0; i < len; i++) {
-        printf("%02x ", data[i]);
-        if ((i + 1) % 16 == 0) {
-            printf("\n[HEX] ");
+void parse_control(struct msghdr *msg, rx_slot_t *slot, uint32_t *drops) {
+    struct cmsghdr *cmsg;
+    struct in_pktinfo info;
+    int have_ts = 0;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            memcpy(&slot->rx_time, CMSG_DATA(cmsg), sizeof(slot->rx_time));
+            have_ts = 1;
+        } else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+            memcpy(drops, CMSG_DATA(cmsg), sizeof(*drops));
+        } else if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO) {
+            memcpy(&info, CMSG_DATA(cmsg), sizeof(info));
+            slot->dest.sin_addr = info.ipi_addr;
+            slot->ifindex = info.ipi_ifindex;
         }
     }
-    if (len % 16 != 0) {
-        printf("\n");
+    if (!have_ts) {
+        clock_gettime(CLOCK_REALTIME, &slot->rx_time);
     }
 }
 
 /* ============================================================================
- * 関数: main
- * 機能: マルチキャストUDP受信サーバーを起動
+ * 関数: process_packet
+ * 機能: 受信パケット1個分の表示と処理
+ * 引数:
+ *   pkt          - 受信パケット情報
+ *   packet_count - 通算パケット番号
  * ============================================================================ */
-int main(int argc, char *argv[]) {
-    int sock_fd = -1;
-    struct sockaddr_in local_addr, sender_addr;
-    struct ip_mreq mreq;
-    socklen_t sender_addr_len;
-    unsigned char buffer[BUFFER_SIZE];
-    ssize_t recv_len;
-    char sender_ip[INET_ADDRSTRLEN];
+void process_packet(const rx_packet_t *pkt, unsigned long packet_count) {
+    const unsigned char *src = (const unsigned char *)&pkt->sender->sin_addr;
+    const unsigned char *dst = (const unsigned char *)&pkt->dest->sin_addr;
+
+    /* pcap 保存 (mmap セグメントへの追記のみでシステムコールなし) */
+    if (g_capture_enabled) {
+        if (pcap_writer_write(&g_capture, &pkt->rx_time, pkt->sender, pkt->dest,
+                              pkt->data, pkt->len) < 0) {
+            fprintf(stderr, "[ERROR] Capture stopped\n");
+            g_capture_enabled = 0;
+        }
+    }
+
+    /* TCP 購読者への中継 (購読者ごとのリングへの書き込みのみ) */
+    if (g_relay_enabled) {
+        elsgw_relay_publish(&g_relay, pkt->data, pkt->len);
+    }
+
+    /* 共有メモリへの公開 (リングのスロットへの書き込みのみ) */
+    if (g_feed_enabled) {
+        elsgw_shm_publish(&g_feed, pkt->data, pkt->len, pkt->sender, pkt->dest,
+                          &pkt->rx_time);
+    }
+
+    /* フレーム解析と登録済みハンドラの呼び出し (register_handlers 参照) */
+    elsgw_decode(&g_decoder, pkt);
+
+    if (!g_dump_enabled) {
+        return;
+    }
+
+    /* 受信データ表示 (ヘッダ、16進ダンプ、ASCII表示)。処理スレッドは
+     * データと引数をログのリングへ写すのみで、整形と出力はログスレッドが行う */
+    ALOG_DUMP(ALOG_LEVEL_INFO, pkt->data, pkt->len,
+              "\n[RECV] ======================================== [#%lu]\n"
+              "[RECV] From: %u.%u.%u.%u:%d\n"
+              "[RECV] To:   %u.%u.%u.%u:%d\n"
+              "[RECV] Size: %zu bytes\n"
+              "[RECV] Time: %ld.%09ld\n",
+              packet_count, src[0], src[1], src[2], src[3], ntohs(pkt->sender->sin_port),
+              dst[0], dst[1], dst[2], dst[3], ntohs(pkt->dest->sin_port), pkt->len,
+              (long)pkt->rx_time.tv_sec, pkt->rx_time.tv_nsec);
+    ALOG_INFO(DUMP_FOOTER);
+}
+
+/* ============================================================================
+ * 関数: register_handlers
+ * 機能: ELSGW API メッセージ種別ごとのハンドラを登録する
+ *   ハンドラはヘッダ解析・長さ検証済みの elsgw_msg_t を受け取り、本体は
+ *   elsgw_decoder.h のアクセサで読む。処理スレッドで呼ばれるため、
+ *   時間のかかる処理は別スレッドへ渡すこと。
+ * ============================================================================ */
+void register_handlers(elsgw_decoder_t *decoder) {
+    (void)decoder;
+
+    /* ★ ここに受信メッセージの処理を登録 ★ */
+    /* 例: elsgw_decoder_register(decoder, ELSGW_MSG_DEVICE_STATUS,
+     *                            on_device_status, &device_table); */
+}
+
+/* ============================================================================
+ * 関数: handle_signal
+ * 機能: 終了シグナルを受けて受信・処理ループを停止させる
+ * ============================================================================ */
+void handle_signal(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+/* ============================================================================
+ * 関数: pin_thread
+ * 機能: スレッドを指定CPUに固定する (CPUが存在しない場合は固定しない)
+ * ============================================================================ */
+void pin_thread(pthread_t thread, int cpu, const char *name) {
+    cpu_set_t set;
+    int err;
+
+    if (cpu >= sysconf(_SC_NPROCESSORS_ONLN)) {
+        printf("[WARN] CPU%d not available, %s thread not pinned\n", cpu, name);
+        return;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    err = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (err != 0) {
+        fprintf(stderr, "[WARN] Failed to pin %s thread to CPU%d: %s\n",
+                name, cpu, strerror(err));
+        return;
+    }
+    printf("[INFO] %s thread pinned to CPU%d\n", name, cpu);
+}
+
+/* ============================================================================
+ * 関数: init_msgs
+ * 機能: msghdr を各スロットのバッファへ向ける
+ * ============================================================================ */
+void init_msgs(rx_slot_t *slots, struct mmsghdr *msgs, int count) {
+    memset(msgs, 0, sizeof(*msgs) * count);
+    for (int i = 0; i < count; i++) {
+        slots[i].iov.iov_base = slots[i].data;
+        slots[i].iov.iov_len = sizeof(slots[i].data);
+        msgs[i].msg_hdr.msg_iov = &slots[i].iov;
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+/* ============================================================================
+ * 関数: receive_batch
+ * 機能: 指定スロットへ recvmmsg() で一括受信し、長さ・受信時刻・宛先を記録する
+ *       ソケットのドロップ累計が増えていれば rx->kernel_drops へ加算する
+ * 引数:
+ *   sock  - 受信ソケット
+ *   flags - recvmmsg() のフラグ (MSG_WAITFORONE / MSG_DONTWAIT)
+ * 戻り値: 受信数 (エラー時は -1)
+ * ============================================================================ */
+int receive_batch(receiver_t *rx, rx_socket_t *sock, int flags,
+                  rx_slot_t *slots, struct mmsghdr *msgs, int count) {
+    int recv_count;
+    uint32_t drops = sock->kernel_drops;
+
+    /* 前回の受信で書き換えられた長さを戻す */
+    for (int i = 0; i < count; i++) {
+        msgs[i].msg_hdr.msg_name = &slots[i].sender;
+        msgs[i].msg_hdr.msg_namelen = sizeof(slots[i].sender);
+        msgs[i].msg_hdr.msg_control = slots[i].control;
+        msgs[i].msg_hdr.msg_controllen = sizeof(slots[i].control);
+    }
+
+    /* マルチキャストパケット受信（MSG_WAITFORONE: 最初の1個までブロッキング、
+     * 以降はキューにある分だけまとめて取得） */
+    recv_count = recvmmsg(sock->fd, msgs, count, flags, NULL);
+    if (recv_count < 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < recv_count; i++) {
+        slots[i].payload = slots[i].data;
+        slots[i].len = msgs[i].msg_len;
+        slots[i].dest.sin_family = AF_INET;
+        slots[i].dest.sin_port = sock->port;
+        slots[i].ifindex = 0;
+        parse_control(&msgs[i].msg_hdr, &slots[i], &drops);
+    }
+    if (drops != sock->kernel_drops) {
+        atomic_fetch_add_explicit(&rx->kernel_drops, drops - sock->kernel_drops,
+                                  memory_order_relaxed);
+        sock->kernel_drops = drops;
+    }
+    return recv_count;
+}
+
+/* ============================================================================
+ * 関数: receive_loop
+ * 機能: 受信スレッド本体。リングの空きスロットへ直接受信して公開する
+ *       リング満杯時は読み捨て用スロットへ受信し、ドロップ数を計上する
+ * ============================================================================ */
+void receive_loop(receiver_t *rx) {
+    stage_slot_t *probe = stage_thread(g_stages, "receive");
+    struct timespec now;
+    uint32_t start;
+    uint32_t avail;
+    int recv_count;
+
+    while (g_running) {
+        avail = spsc_ring_reserve(&rx->ring, rx->batch_size, &start);
+
+        if (avail > 0) {
+            recv_count = receive_batch(rx, &rx->sock, MSG_WAITFORONE,
+                                       &rx->slots[start], &rx->msgs[start], avail);
+        } else {
+            recv_count = receive_batch(rx, &rx->sock, MSG_WAITFORONE,
+                                       rx->drop_slots, rx->drop_msgs, rx->batch_size);
+        }
+
+        if (recv_count < 0) {
+            if (errno != EINTR) {
+                perror("[ERROR] recvmmsg failed");
+            }
+            continue;
+        }
+
+        atomic_fetch_add_explicit(&rx->rx_packets, recv_count,
+                                  memory_order_relaxed);
+        if (avail > 0) {
+            if (probe != NULL) {
+                clock_gettime(CLOCK_REALTIME, &now);
+                for (int i = 0; i < recv_count; i++) {
+                    stage_record(probe, STAGE_RING, timespec_ns(&now) -
+                                 timespec_ns(&rx->slots[start + i].rx_time));
+                }
+            }
+            spsc_ring_publish(&rx->ring, recv_count);
+        } else {
+            atomic_fetch_add_explicit(&rx->ring_drops, recv_count,
+                                      memory_order_relaxed);
+            stage_add(probe, COUNTER_RING_DROPS, recv_count);
+        }
+    }
+}
+
+/* ============================================================================
+ * 関数: wait_for_packets
+ * 機能: 全リングが空の間、待機する
+ *       リング1個なら spsc_ring_wait()、複数なら共有ドアベルで待つ
+ * ============================================================================ */
+void wait_for_packets(receiver_set_t *set) {
+    uint32_t start;
+    uint32_t seq;
+
+    if (set->doorbell == NULL) {
+        spsc_ring_wait(&set->rx[0].ring, WAIT_TIMEOUT_MS);
+        return;
+    }
+
+    /* 待機を宣言した後に全リングを再確認し、取りこぼしを防ぐ */
+    seq = spsc_doorbell_prepare(set->doorbell);
+    for (int r = 0; r < set->count; r++) {
+        if (spsc_ring_peek(&set->rx[r].ring, &start) > 0) {
+            spsc_doorbell_cancel(set->doorbell);
+            return;
+        }
+    }
+    spsc_doorbell_wait(set->doorbell, seq, WAIT_TIMEOUT_MS);
+}
+
+/* ============================================================================
+ * 関数: worker_main
+ * 機能: 処理スレッド本体。全リングからパケットを順に取り出して処理する
+ * ============================================================================ */
+void *worker_main(void *arg) {
+    receiver_set_t *set = (receiver_set_t *)arg;
+    receiver_t *rx;
+    rx_packet_t pkt;
+    rx_slot_t *slot;
+    struct timespec now, done;
+    uint32_t start;
+    uint32_t count;
+    uint32_t total;
+    unsigned long packet_count = 0;
+    unsigned long reported_drops = 0;
+    unsigned long drops;
+    stage_slot_t *probe = stage_thread(g_stages, "worker");
+
+    while (g_running) {
+        total = 0;
+        for (int r = 0; r < set->count; r++) {
+            rx = &set->rx[r];
+            count = spsc_ring_peek(&rx->ring, &start);
+            if (count == 0) {
+                continue;
+            }
+
+            for (uint32_t i = 0; i < count; i++) {
+                slot = &rx->slots[(start + i) & rx->ring.mask];
+                pkt.data = slot->payload;
+                pkt.len = slot->len;
+                pkt.sender = &slot->sender;
+                pkt.dest = &slot->dest;
+                pkt.rx_time = slot->rx_time;
+                pkt.ifindex = slot->ifindex;
+
+                /* A/B 調停 (もう一方の系統で処理済みのメッセージは捨てる) */
+                if (g_arb_enabled && !elsgw_arb_accept(&g_arb, &pkt)) {
+                    continue;
+                }
+
+                /* パケットカウント */
+                packet_count++;
+
+                /* 統計記録 (処理開始時刻を受信→処理遅延とする) */
+                clock_gettime(CLOCK_REALTIME, &now);
+                stats_record(&g_stats, &pkt, &now);
+
+                process_packet(&pkt, packet_count);
+                if (probe != NULL) {
+                    clock_gettime(CLOCK_REALTIME, &done);
+                    stage_record(probe, STAGE_QUEUE,
+                                 timespec_ns(&now) - timespec_ns(&pkt.rx_time));
+                    stage_record(probe, STAGE_PROCESS,
+                                 timespec_ns(&done) - timespec_ns(&now));
+                }
+            }
+            spsc_ring_release(&rx->ring, count);
+            atomic_fetch_add_explicit(&rx->processed, count, memory_order_relaxed);
+            total += count;
+        }
+        stage_set(probe, COUNTER_PACKETS, packet_count);
+
+        if (total == 0) {
+            wait_for_packets(set);
+        }
+        stats_poll(&g_stats, set->rx, set->count, 0);
+
+        /* リング満杯によるドロップが増えていれば報告 */
+        drops = 0;
+        for (int r = 0; r < set->count; r++) {
+            drops += atomic_load_explicit(&set->rx[r].ring_drops, memory_order_relaxed);
+        }
+        if (drops != reported_drops) {
+            fprintf(stderr, "[WARN] Receive ring full: %lu packets dropped "
+                    "(total %lu)\n", drops - reported_drops, drops);
+            reported_drops = drops;
+        }
+    }
+
+    /* 終了時の最終スナップショット */
+    stats_poll(&g_stats, set->rx, set->count, 1);
+    return NULL;
+}
+
+/* ============================================================================
+ * 関数: print_usage
+ * 機能: コマンドラインの使い方を表示
+ * ============================================================================ */
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-b batch(1-%d)] [-p] [-i ifname]"
+            " [-w prefix] [-z segment_mb] [-q]\n"
+            "       [-j stats_file] [-t interval_ms] [-S seq_offset]\n"
+            "       [-c subscriptions] [-n rx_workers] [-R] [-T] [-l log_file]\n"
+            "       [-r relay_port] [-k relay_ring_kb] [-m feed_name] [-A]\n",
+            prog, BATCH_MAX);
+}
+
+/* ============================================================================
+ * 関数: open_multicast_socket
+ * 機能: マルチキャスト受信用UDPソケットを作成し、グループへ参加する
+ * 引数:
+ *   mreq  - 参加したグループ情報の格納先 (legs 個, 終了時の離脱に使用)
+ *   addrs - 参加する受信インターフェースIP (legs 個)
+ *   legs  - 1 = eth0 のみ, ARB_LEGS = A/B 調停 (同じソケットで両方に参加)
+ * 戻り値: ソケット (失敗時は -1)
+ * ============================================================================ */
+int open_multicast_socket(struct ip_mreq *mreq, const char *const *addrs, int legs) {
+    int sock_fd;
+    struct sockaddr_in local_addr;
     int opt = 1;
-    int packet_count = 0;
 
-    printf("============================================================\n");
-    printf("  ELSGW Receiver (Multicast UDP Mode) - ABOS1\n");
-    printf("  Multicast Group: %s:%d\n", MULTICAST_GROUP, LISTEN_PORT);
-    printf("  Local Interface: %s\n", ABOS1_IP);
-    printf("============================================================\n");
-    
     /* UDP ソケット作成 */
     sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sock_fd < 0) {
         perror("[ERROR] Failed to create UDP socket");
-        return 1;
+        return -1;
     }
     
     /* ポート再利用設定（複数プロセスが同じポートで受信可能にする） */
@@ -70,7 +545,25 @@ int main(int argc, char *argv[]) {
                    &opt, sizeof(opt)) < 0) {
         perror("[ERROR] Failed to set SO_REUSEADDR");
         close(sock_fd);
-        return 1;
+        return -1;
+    }
+
+    /* カーネル受信時刻 (ナノ秒) を補助データで受け取る */
+    if (setsockopt(sock_fd, SOL_SOCKET, SO_TIMESTAMPNS,
+                   &opt, sizeof(opt)) < 0) {
+        perror("[WARN] Failed to set SO_TIMESTAMPNS");
+    }
+
+    /* ソケットバッファ溢れによるドロップ数を補助データで受け取る */
+    if (setsockopt(sock_fd, SOL_SOCKET, SO_RXQ_OVFL,
+                   &opt, sizeof(opt)) < 0) {
+        perror("[WARN] Failed to set SO_RXQ_OVFL");
+    }
+
+    /* 宛先アドレスを補助データで受け取る (表示・pcap 保存用) */
+    if (setsockopt(sock_fd, IPPROTO_IP, IP_PKTINFO,
+                   &opt, sizeof(opt)) < 0) {
+        perror("[WARN] Failed to set IP_PKTINFO");
     }
     
     /* ローカルアドレス設定（全インターフェースで受信） */
@@ -84,81 +577,427 @@ int main(int argc, char *argv[]) {
              sizeof(local_addr)) < 0) {
         perror("[ERROR] Failed to bind UDP socket");
         close(sock_fd);
-        return 1;
+        return -1;
     }
     
     printf("[INFO] UDP socket bound to 0.0.0.0:%d\n", LISTEN_PORT);
     
-    /* マルチキャストグループに参加 */
-    memset(&mreq, 0, sizeof(mreq));
-    mreq.imr_multiaddr.s_addr = inet_addr(MULTICAST_GROUP);  /* グループアドレス */
-    mreq.imr_interface.s_addr = inet_addr(ABOS1_IP);         /* 受信インターフェース */
-    
-    if (setsockopt(sock_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, 
-                   &mreq, sizeof(mreq)) < 0) {
-        perror("[ERROR] Failed to join multicast group");
-        close(sock_fd);
-        return 1;
+    /* マルチキャストグループに参加 (A/B 調停では両方のインターフェースで) */
+    for (int i = 0; i < legs; i++) {
+        memset(&mreq[i], 0, sizeof(mreq[i]));
+        mreq[i].imr_multiaddr.s_addr = inet_addr(MULTICAST_GROUP);  /* グループアドレス */
+        mreq[i].imr_interface.s_addr = inet_addr(addrs[i]);         /* 受信インターフェース */
+
+        if (setsockopt(sock_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+                       &mreq[i], sizeof(mreq[i])) < 0) {
+            perror("[ERROR] Failed to join multicast group");
+            close(sock_fd);
+            return -1;
+        }
     }
     
     printf("[INFO] Joined multicast group: %s\n", MULTICAST_GROUP);
-    printf("[INFO] Using interface: %s\n", ABOS1_IP);
+    for (int i = 0; i < legs; i++) {
+        printf("[INFO] Using interface: %s\n", addrs[i]);
+    }
+    return sock_fd;
+}
+
+/* ============================================================================
+ * 関数: receiver_alloc / receiver_free
+ * 機能: 受信リングとスロットを確保・解放する (受信ループ内では確保しない)
+ * ============================================================================ */
+int receiver_alloc(receiver_t *rx, int batch_size) {
+    rx->sock.fd = -1;
+    rx->batch_size = batch_size;
+    spsc_ring_init(&rx->ring, RING_SIZE);
+    rx->slots = calloc(RING_SIZE, sizeof(*rx->slots));
+    rx->msgs = calloc(RING_SIZE, sizeof(*rx->msgs));
+    rx->drop_slots = calloc(BATCH_MAX, sizeof(*rx->drop_slots));
+    rx->drop_msgs = calloc(BATCH_MAX, sizeof(*rx->drop_msgs));
+    if (rx->slots == NULL || rx->msgs == NULL ||
+        rx->drop_slots == NULL || rx->drop_msgs == NULL) {
+        fprintf(stderr, "[ERROR] Failed to allocate receive ring\n");
+        return -1;
+    }
+    init_msgs(rx->slots, rx->msgs, RING_SIZE);
+    init_msgs(rx->drop_slots, rx->drop_msgs, BATCH_MAX);
+    return 0;
+}
+
+void receiver_free(receiver_t *rx) {
+    free(rx->slots);
+    free(rx->msgs);
+    free(rx->drop_slots);
+    free(rx->drop_msgs);
+}
+
+/* ============================================================================
+ * 関数: main
+ * 機能: マルチキャストUDP受信サーバーを起動
+ * ============================================================================ */
+int main(int argc, char *argv[]) {
+    struct ip_mreq mreq[ARB_LEGS];
+    static const char *const leg_addrs[ARB_LEGS] = { ABOS1_IP, ABOS1_IP_B };
+    int legs = 1;
+    static receiver_t rx[MAX_RX_WORKERS];
+    static receiver_set_t rx_set;
+    static tpacket_rx_t tp;
+    static epoll_rx_t ep;
+    const char *ifname = CAPTURE_IFNAME;
+    const char *capture_prefix = NULL;
+    const char *subs_path = NULL;
+    size_t segment_size = PCAP_SEGMENT_SIZE_DEFAULT;
+    const char *stats_path = NULL;
+    int stats_fd = -1;
+    int stats_interval_ms = STATS_INTERVAL_MS;
+    int seq_offset = STATS_SEQ_OFFSET;
+    int use_packet = 0;
+    int rx_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int steer_cpu = 0;
+    int probes = 0;
+    const char *log_path = NULL;
+    int relay_port = 0;
+    size_t relay_ring = RELAY_RING_DEFAULT;
+    const char *feed_name = NULL;
+    int backend_open = 0;
+    unsigned long total_rx = 0, total_processed = 0;
+    unsigned long total_ring_drops = 0, total_kernel_drops = 0;
+    struct sigaction sa;
+    sigset_t block_set, orig_set;
+    pthread_t worker;
+    int batch_size = BATCH_DEFAULT;
+    int ret = 1;
+    int c;
+
+    /* コマンドライン引数の解析 */
+    while ((c = getopt(argc, argv, "b:pi:w:z:qj:t:S:c:n:RTl:r:k:m:Ah")) != -1) {
+        switch (c) {
+        case 'b':
+            batch_size = atoi(optarg);
+            if (batch_size < 1 || batch_size > BATCH_MAX) {
+                fprintf(stderr, "[ERROR] Invalid batch size: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'p':
+            use_packet = 1;
+            break;
+        case 'i':
+            ifname = optarg;
+            break;
+        case 'w':
+            capture_prefix = optarg;
+            break;
+        case 'z':
+            segment_size = strtoul(optarg, NULL, 10) * 1024 * 1024;
+            break;
+        case 'q':
+            g_dump_enabled = 0;
+            break;
+        case 'j':
+            stats_path = optarg;
+            break;
+        case 't':
+            stats_interval_ms = atoi(optarg);
+            if (stats_interval_ms <= 0) {
+                fprintf(stderr, "[ERROR] Invalid stats interval: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'S':
+            seq_offset = atoi(optarg);
+            if (seq_offset < 0) {
+                seq_offset = STATS_SEQ_DISABLED;
+            }
+            break;
+        case 'c':
+            subs_path = optarg;
+            break;
+        case 'n':
+            rx_workers = atoi(optarg);
+            if (rx_workers < 1 || rx_workers > MAX_RX_WORKERS) {
+                fprintf(stderr, "[ERROR] Invalid worker count: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'R':
+            steer_cpu = 1;
+            break;
+        case 'T':
+            probes = 1;
+            break;
+        case 'l':
+            log_path = optarg;
+            break;
+        case 'r':
+            relay_port = atoi(optarg);
+            if (relay_port <= 0 || relay_port > 65535) {
+                fprintf(stderr, "[ERROR] Invalid relay port: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'k':
+            relay_ring = strtoul(optarg, NULL, 10) * 1024;
+            break;
+        case 'm':
+            feed_name = optarg;
+            break;
+        case 'A':
+            legs = ARB_LEGS;
+            break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (use_packet && subs_path != NULL) {
+        fprintf(stderr, "[ERROR] -p and -c cannot be used together\n");
+        return 1;
+    }
+    if (use_packet && legs > 1) {
+        fprintf(stderr, "[ERROR] -p and -A cannot be used together\n");
+        return 1;
+    }
+    if (rx_workers > MAX_RX_WORKERS) {
+        rx_workers = MAX_RX_WORKERS;
+    }
+    if (subs_path == NULL) {
+        rx_workers = 1;
+    }
+
+    printf("============================================================\n");
+    if (subs_path != NULL) {
+        printf("  ELSGW Receiver (Multi-group epoll Mode) - ABOS1\n");
+        printf("  Subscriptions: %s\n", subs_path);
+        printf("  Receive Workers: %d\n", rx_workers);
+        printf("  Batch Size: %d\n", batch_size);
+    } else {
+        printf("  ELSGW Receiver (%s Mode) - ABOS1\n",
+               use_packet ? "AF_PACKET TPACKET_V3" : "Multicast UDP");
+        printf("  Multicast Group: %s:%d\n", MULTICAST_GROUP, LISTEN_PORT);
+        if (use_packet) {
+            printf("  Capture Interface: %s\n", ifname);
+        } else {
+            printf("  Local Interface: %s\n", ABOS1_IP);
+            printf("  Batch Size: %d\n", batch_size);
+        }
+    }
+    if (legs > 1) {
+        printf("  A/B Arbitration: %s (A) + %s (B)\n", ABOS1_IP, ABOS1_IP_B);
+    }
+    printf("============================================================\n");
+
+    /* 受信リングとスロットの確保 */
+    for (int i = 0; i < rx_workers; i++) {
+        if (receiver_alloc(&rx[i], batch_size) < 0) {
+            goto cleanup;
+        }
+    }
+    rx_set.rx = rx;
+    rx_set.count = rx_workers;
+    rx_set.doorbell = NULL;
+
+    /* 受信バックエンドの準備 */
+    if (subs_path != NULL) {
+        if (epoll_rx_load(&ep, subs_path) < 0 ||
+            epoll_rx_open(&ep, rx, rx_workers, steer_cpu) < 0) {
+            goto cleanup;
+        }
+        rx_set.doorbell = &ep.doorbell;
+        backend_open = 1;
+    } else if (use_packet) {
+        if (tpacket_rx_open(&tp, ifname) < 0) {
+            goto cleanup;
+        }
+        backend_open = 1;
+    } else {
+        rx[0].sock.fd = open_multicast_socket(mreq, leg_addrs, legs);
+        if (rx[0].sock.fd < 0) {
+            goto cleanup;
+        }
+        rx[0].sock.port = htons(LISTEN_PORT);
+        backend_open = 1;
+    }
+
+    /* pcap 保存の準備 */
+    if (capture_prefix != NULL) {
+        if (pcap_writer_open(&g_capture, capture_prefix, segment_size) < 0) {
+            goto cleanup;
+        }
+        g_capture_enabled = 1;
+    }
+
+    /* TCP 購読者への中継の準備 */
+    if (relay_port > 0) {
+        if (elsgw_relay_open(&g_relay, relay_port, relay_ring) < 0) {
+            elsgw_relay_close(&g_relay);
+            goto cleanup;
+        }
+        g_relay_enabled = 1;
+    }
+
+    /* 共有メモリへの公開の準備 */
+    if (feed_name != NULL) {
+        if (elsgw_shm_create(&g_feed, feed_name) < 0) {
+            goto cleanup;
+        }
+        g_feed_enabled = 1;
+        printf("[INFO] Publishing datagrams to %s (%d slots)\n",
+               g_feed.path, ELSGW_SHM_SLOTS);
+    }
+
+    /* 統計スナップショットの出力先 */
+    if (stats_path != NULL) {
+        if (strcmp(stats_path, "-") == 0) {
+            stats_fd = STDERR_FILENO;
+        } else {
+            stats_fd = open(stats_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (stats_fd < 0) {
+                perror("[ERROR] Failed to open stats file");
+                goto cleanup;
+            }
+        }
+        printf("[INFO] Stats snapshot every %d ms to %s\n",
+               stats_interval_ms, stats_path);
+    }
+    stats_init(&g_stats, seq_offset, stats_fd, stats_interval_ms);
+    if (probes) {
+        g_stages = stage_shm_create("ElsgwReceiver", stage_names,
+                                    sizeof(stage_names) / sizeof(stage_names[0]),
+                                    counter_names,
+                                    sizeof(counter_names) / sizeof(counter_names[0]));
+    }
+    elsgw_decoder_init(&g_decoder);
+    register_handlers(&g_decoder);
+    if (legs > 1) {
+        if (elsgw_arb_init(&g_arb, seq_offset, leg_addrs) < 0) {
+            elsgw_arb_free(&g_arb);
+            goto cleanup;
+        }
+        g_arb_enabled = 1;
+    }
+
     printf("\n[INFO] Ready to receive ELSGW API packets\n");
     printf("============================================================\n\n");
-    
-    /* パケット受信ループ */
-    while (TRUE) {
-        sender_addr_len = sizeof(sender_addr);
-        
-        /* マルチキャストパケット受信（ブロッキング） */
-        recv_len = recvfrom(sock_fd, buffer, sizeof(buffer), 0,
-                            (struct sockaddr *)&sender_addr, 
-                            &sender_addr_len);
-        
-        if (recv_len < 0) {
-            if (errno != EINTR) {
-                perror("[ERROR] recvfrom failed");
-            }
-            continue;
+
+    /* 終了シグナルの設定 (recvmmsg() を EINTR で抜けるよう SA_RESTART なし) */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    /* 処理スレッド・受信スレッドの起動 (シグナルは main で受けるため遮断して生成) */
+    sigemptyset(&block_set);
+    sigaddset(&block_set, SIGINT);
+    sigaddset(&block_set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block_set, &orig_set);
+    alog_start("ElsgwReceiver", log_path);
+    if (g_relay_enabled && elsgw_relay_start(&g_relay) < 0) {
+        goto cleanup;
+    }
+    if (pthread_create(&worker, NULL, worker_main, &rx_set) != 0) {
+        fprintf(stderr, "[ERROR] Failed to start worker thread\n");
+        goto cleanup;
+    }
+
+    if (subs_path != NULL) {
+        /* 受信は epoll_rx の各スレッドが行い、main は終了シグナルを待つのみ
+         * (処理スレッドは固定せず、受信スレッドの空きCPUで動かす) */
+        if (epoll_rx_start(&ep) < 0) {
+            g_running = 0;
         }
-        
-        /* 送信元 IP 取得 */
-        inet_ntop(AF_INET, &sender_addr.sin_addr, sender_ip, INET_ADDRSTRLEN);
-        
-        /* パケットカウント */
-        packet_count++;
-        
-        /* 受信データ表示 */
-        printf("\n[RECV] ======================================== [#%d]\n", 
-               packet_count);
-        printf("[RECV] From: %s:%d\n", sender_ip, ntohs(sender_addr.sin_port));
-        printf("[RECV] Size: %zd bytes\n", recv_len);
-        
-        /* 16進数ダンプ */
-        print_hex_dump(buffer, recv_len);
-        
-        /* ASCII 表示（表示可能文字のみ） */
-        printf("[ASCII] ");
-        for (ssize_t i = 0; i < recv_len; i++) {
-            if (buffer[i] >= 32 && buffer[i] <= 126) {
-                printf("%c", buffer[i]);
-            } else {
-                printf(".");
+        fflush(stdout);
+        while (g_running) {
+            sigsuspend(&orig_set);
+        }
+        pthread_sigmask(SIG_SETMASK, &orig_set, NULL);
+        epoll_rx_join(&ep);
+    } else {
+        pthread_sigmask(SIG_SETMASK, &orig_set, NULL);
+        pin_thread(pthread_self(), RX_CPU, "Receive");
+        pin_thread(worker, WORKER_CPU, "Worker");
+
+        fflush(stdout);
+
+        /* パケット受信ループ */
+        if (use_packet) {
+            tpacket_rx_loop(&rx[0], &tp);
+        } else {
+            receive_loop(&rx[0]);
+        }
+    }
+
+    pthread_join(worker, NULL);
+    elsgw_relay_join(&g_relay);
+    alog_stop();
+    if (use_packet) {
+        tpacket_rx_update_stats(&rx[0], &tp);
+    }
+    for (int i = 0; i < rx_workers; i++) {
+        total_rx += atomic_load(&rx[i].rx_packets);
+        total_processed += atomic_load(&rx[i].processed);
+        total_ring_drops += atomic_load(&rx[i].ring_drops);
+        total_kernel_drops += atomic_load(&rx[i].kernel_drops);
+        if (rx_workers > 1) {
+            printf("[INFO] Worker %d: Received: %lu, Ring drops: %lu, Kernel drops: %lu\n",
+                   i, atomic_load(&rx[i].rx_packets), atomic_load(&rx[i].ring_drops),
+                   atomic_load(&rx[i].kernel_drops));
+        }
+    }
+    printf("\n[INFO] Received: %lu, Processed: %lu, Ring drops: %lu, "
+           "Kernel drops: %lu\n",
+           total_rx, total_processed, total_ring_drops, total_kernel_drops);
+    elsgw_decoder_print(&g_decoder);
+    if (g_relay_enabled) {
+        elsgw_relay_print(&g_relay);
+    }
+    if (g_feed_enabled) {
+        elsgw_shm_print(&g_feed);
+    }
+    if (g_arb_enabled) {
+        elsgw_arb_print(&g_arb);
+    }
+    ret = 0;
+
+    /* クリーンアップ */
+cleanup:
+    alog_stop();
+    if (g_relay_enabled) {
+        g_running = 0;                  /* 起動失敗時も中継スレッドを止める */
+        elsgw_relay_join(&g_relay);
+        elsgw_relay_close(&g_relay);
+    }
+    if (g_feed_enabled) {
+        elsgw_shm_close(&g_feed);
+    }
+    if (g_arb_enabled) {
+        elsgw_arb_free(&g_arb);
+    }
+    if (g_capture_enabled) {
+        pcap_writer_close(&g_capture);
+    }
+    if (!backend_open) {
+        /* 受信バックエンド未準備 */
+    } else if (subs_path != NULL) {
+        epoll_rx_close(&ep);
+    } else if (use_packet) {
+        tpacket_rx_close(&tp);
+    } else {
+        for (int i = 0; i < legs; i++) {
+            if (setsockopt(rx[0].sock.fd, IPPROTO_IP, IP_DROP_MEMBERSHIP,
+                           &mreq[i], sizeof(mreq[i])) < 0) {
+                perror("[WARN] Failed to leave multicast group");
             }
         }
-        printf("\n");
-        
-        printf("[RECV] ========================================\n\n");
-        
-        /* ★ ここに受信パケットの解析・処理を追加 ★ */
-        /* 例: プロトコル解析、コマンド実行、ログ記録など */
+        close(rx[0].sock.fd);
     }
-    
-    /* クリーンアップ（到達しない） */
-    if (setsockopt(sock_fd, IPPROTO_IP, IP_DROP_MEMBERSHIP, 
-                   &mreq, sizeof(mreq)) < 0) {
-        perror("[WARN] Failed to leave multicast group");
+    if (stats_fd >= 0 && stats_fd != STDERR_FILENO) {
+        close(stats_fd);
     }
-    close(sock_fd);
-    return 0;
+    for (int i = 0; i < rx_workers; i++) {
+        receiver_free(&rx[i]);
+    }
+    stage_shm_destroy(g_stages);
+    return ret;
 }
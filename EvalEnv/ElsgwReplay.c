@@ -0,0 +1,400 @@
+/*
+ * ============================================================================
+ * ElsgwReplay.c - ELSGW Capture Replay Program
+ * ============================================================================
+ * 機能:
+ *   - ElsgwReceiver -w で保存した pcap (または tcpdump の pcap) を読み込み、
+ *     UDPペイロードを ELSGW のマルチキャストグループへ再送する
+ *   - 再送タイミング: 保存時の間隔どおり / 速度倍率指定 / 最大速度
+ *   - 送信時刻に達したパケットは sendmmsg() でまとめて送信する
+ *
+ * 通信経路:
+ *   Host (192.168.100.100) -> 239.64.0.3:52000 -> ABOS1 (ElsgwReceiver)
+ *
+ * 使い方:
+ *   ./ElsgwReplay [-s 倍率 | -m] [-i 送信IF] [-d 宛先:ポート] [-l 回数]
+ *                 ファイル...
+ *     -s  再送速度の倍率 (2.0 = 2倍速, 既定: 1.0)
+ *     -m  間隔を無視して最大速度で送信する
+ *     -i  マルチキャスト送信インターフェースのIP (既定: 192.168.100.100)
+ *     -d  宛先 (既定: 239.64.0.3:52000)
+ *     -l  全ファイルを繰り返す回数 (既定: 1)
+ *   ファイルはセグメント順に指定する (例: capture_*.pcap)
+ *
+ * ビルド:
+ *   gcc -O2 -Wall -o ElsgwReplay ElsgwReplay.c
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+
+#include "pcap_writer.h"
+
+/* ============================================================================
+ * ネットワーク設定
+ * ============================================================================ */
+#define HOST_IP             "192.168.100.100"   /* Host の br100 IP */
+#define MULTICAST_GROUP     "239.64.0.3"        /* ELSGWのマルチキャストグループ */
+#define LISTEN_PORT         52000               /* ELSGWの連携ポート */
+
+/* ============================================================================
+ * 動作設定
+ * ============================================================================ */
+#define SEND_BATCH          64      /* sendmmsg() 1回の最大送信数 */
+#define ETH_HEADER_LEN      14
+#define ETH_TYPE_IP         0x0800
+
+/* ============================================================================
+ * 再送状態
+ * ============================================================================ */
+typedef struct {
+    int                sock_fd;         /* 送信ソケット */
+    struct sockaddr_in dest;            /* 宛先 */
+    double             speed;           /* 速度倍率 (0 = 最大速度) */
+    int                have_base;       /* 基準時刻設定済み */
+    long long          base_capture_ns; /* 最初のパケットの保存時刻 */
+    long long          base_wall_ns;    /* 最初のパケットの送信時刻 */
+    struct mmsghdr     msgs[SEND_BATCH];
+    struct iovec       iovs[SEND_BATCH];
+    int                pending;         /* 送信待ちの数 */
+    unsigned long      sent;            /* 送信数 */
+    unsigned long      bytes;           /* 送信バイト数 */
+    unsigned long      skipped;         /* UDP以外等で送信しなかった数 */
+    long long          max_late_ns;     /* 予定時刻からの最大遅れ */
+} replay_t;
+
+/* ============================================================================
+ * 関数: now_ns
+ * 機能: 単調増加時刻をナノ秒で取得
+ * ============================================================================ */
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* ============================================================================
+ * 関数: sleep_until
+ * 機能: 指定した単調増加時刻まで待機する
+ * ============================================================================ */
+static void sleep_until(long long target_ns) {
+    struct timespec ts;
+
+    ts.tv_sec = target_ns / 1000000000LL;
+    ts.tv_nsec = target_ns % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+/* ============================================================================
+ * 関数: flush_batch
+ * 機能: 送信待ちのパケットを sendmmsg() でまとめて送信する
+ * ============================================================================ */
+static void flush_batch(replay_t *rp) {
+    int done = 0;
+    int ret;
+
+    while (done < rp->pending) {
+        ret = sendmmsg(rp->sock_fd, rp->msgs + done, rp->pending - done, 0);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("[ERROR] sendmmsg failed");
+            break;
+        }
+        for (int i = done; i < done + ret; i++) {
+            rp->bytes += rp->iovs[i].iov_len;
+        }
+        rp->sent += ret;
+        done += ret;
+    }
+    rp->pending = 0;
+}
+
+/* ============================================================================
+ * 関数: extract_udp_payload
+ * 機能: pcap レコードから UDP ペイロードを取り出す
+ * 戻り値: 1 = 取り出し成功, 0 = UDP/IPv4 以外
+ * ============================================================================ */
+static int extract_udp_payload(uint32_t linktype, const unsigned char *frame,
+                               size_t len, const unsigned char **payload,
+                               size_t *payload_len) {
+    const struct iphdr *ip;
+    const struct udphdr *udp;
+    size_t ihl;
+
+    if (linktype == LINKTYPE_ETHERNET) {
+        if (len < ETH_HEADER_LEN ||
+            ((frame[12] << 8) | frame[13]) != ETH_TYPE_IP) {
+            return 0;
+        }
+        frame += ETH_HEADER_LEN;
+        len -= ETH_HEADER_LEN;
+    } else if (linktype != LINKTYPE_IPV4 && linktype != LINKTYPE_RAW) {
+        return 0;
+    }
+
+    if (len < sizeof(*ip)) {
+        return 0;
+    }
+    ip = (const struct iphdr *)frame;
+    ihl = ip->ihl * 4;
+    if (ip->version != 4 || ip->protocol != IPPROTO_UDP ||
+        len < ihl + sizeof(*udp)) {
+        return 0;
+    }
+    udp = (const struct udphdr *)(frame + ihl);
+    *payload = frame + ihl + sizeof(*udp);
+    *payload_len = ntohs(udp->len) - sizeof(*udp);
+    if (*payload_len > len - ihl - sizeof(*udp)) {
+        *payload_len = len - ihl - sizeof(*udp);
+    }
+    return 1;
+}
+
+/* ============================================================================
+ * 関数: replay_file
+ * 機能: pcap ファイル1個分を再送する
+ * 戻り値: 0 = 成功, -1 = ファイル異常
+ * ============================================================================ */
+static int replay_file(replay_t *rp, const char *path) {
+    const pcap_file_header_t *fh;
+    const pcap_record_header_t *rec;
+    const unsigned char *map, *p, *end, *payload;
+    size_t payload_len;
+    long long frac_ns, capture_ns, target_ns, now;
+    struct stat st;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "[ERROR] Failed to open %s: %s\n", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(*fh)) {
+        fprintf(stderr, "[ERROR] Not a pcap file: %s\n", path);
+        close(fd);
+        return -1;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("[ERROR] Failed to mmap capture file");
+        return -1;
+    }
+    madvise((void *)map, st.st_size, MADV_SEQUENTIAL);
+
+    fh = (const pcap_file_header_t *)map;
+    if (fh->magic == PCAP_MAGIC_NSEC) {
+        frac_ns = 1;
+    } else if (fh->magic == PCAP_MAGIC_USEC) {
+        frac_ns = 1000;
+    } else {
+        fprintf(stderr, "[ERROR] Unsupported pcap magic in %s: 0x%08x\n",
+                path, fh->magic);
+        munmap((void *)map, st.st_size);
+        return -1;
+    }
+
+    printf("[INFO] Replaying %s (linktype %u)\n", path, fh->linktype);
+
+    p = map + sizeof(*fh);
+    end = map + st.st_size;
+    while (p + sizeof(*rec) <= end) {
+        rec = (const pcap_record_header_t *)p;
+        p += sizeof(*rec);
+        if (p + rec->incl_len > end) {
+            fprintf(stderr, "[WARN] Truncated record at end of %s\n", path);
+            break;
+        }
+
+        if (!extract_udp_payload(fh->linktype, p, rec->incl_len,
+                                 &payload, &payload_len)) {
+            rp->skipped++;
+            p += rec->incl_len;
+            continue;
+        }
+
+        /* 送信予定時刻 = 開始時刻 + (保存時刻の差分 / 倍率) */
+        capture_ns = (long long)rec->ts_sec * 1000000000LL +
+                     (long long)rec->ts_frac * frac_ns;
+        if (!rp->have_base) {
+            rp->base_capture_ns = capture_ns;
+            rp->base_wall_ns = now_ns();
+            rp->have_base = 1;
+        }
+        if (rp->speed > 0) {
+            target_ns = rp->base_wall_ns +
+                        (long long)((capture_ns - rp->base_capture_ns) / rp->speed);
+            now = now_ns();
+            if (target_ns > now) {
+                /* 予定時刻前: 溜まった分を送ってから待機 */
+                flush_batch(rp);
+                sleep_until(target_ns);
+                now = now_ns();
+            }
+            if (now - target_ns > rp->max_late_ns) {
+                rp->max_late_ns = now - target_ns;
+            }
+        }
+
+        rp->iovs[rp->pending].iov_base = (void *)payload;
+        rp->iovs[rp->pending].iov_len = payload_len;
+        rp->pending++;
+        if (rp->pending == SEND_BATCH) {
+            flush_batch(rp);
+        }
+        p += rec->incl_len;
+    }
+
+    /* mmap 解除前に参照中のペイロードを送り切る */
+    flush_batch(rp);
+    munmap((void *)map, st.st_size);
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: print_usage
+ * 機能: コマンドラインの使い方を表示
+ * ============================================================================ */
+static void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-s speed | -m] [-i if_ip] [-d addr:port]"
+            " [-l loops] file...\n", prog);
+}
+
+/* ============================================================================
+ * 関数: main
+ * 機能: 指定された pcap ファイルを順に再送する
+ * ============================================================================ */
+int main(int argc, char *argv[]) {
+    static replay_t rp;
+    const char *if_ip = HOST_IP;
+    char dest_str[64] = MULTICAST_GROUP;
+    int dest_port = LISTEN_PORT;
+    struct in_addr if_addr;
+    unsigned char ttl = 1;
+    unsigned char loop = 1;
+    int loops = 1;
+    long long start, elapsed;
+    char *colon;
+    int c;
+
+    rp.speed = 1.0;
+
+    while ((c = getopt(argc, argv, "s:mi:d:l:h")) != -1) {
+        switch (c) {
+        case 's':
+            rp.speed = atof(optarg);
+            if (rp.speed <= 0) {
+                fprintf(stderr, "[ERROR] Invalid speed: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'm':
+            rp.speed = 0;
+            break;
+        case 'i':
+            if_ip = optarg;
+            break;
+        case 'd':
+            snprintf(dest_str, sizeof(dest_str), "%s", optarg);
+            colon = strchr(dest_str, ':');
+            if (colon != NULL) {
+                *colon = '\0';
+                dest_port = atoi(colon + 1);
+            }
+            break;
+        case 'l':
+            loops = atoi(optarg);
+            break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc || loops < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    printf("============================================================\n");
+    printf("  ELSGW Replay\n");
+    printf("  Destination: %s:%d via %s\n", dest_str, dest_port, if_ip);
+    if (rp.speed > 0) {
+        printf("  Timing: original x%.2f\n", rp.speed);
+    } else {
+        printf("  Timing: maximum speed\n");
+    }
+    printf("============================================================\n");
+
+    memset(&rp.dest, 0, sizeof(rp.dest));
+    rp.dest.sin_family = AF_INET;
+    rp.dest.sin_port = htons(dest_port);
+    if (inet_pton(AF_INET, dest_str, &rp.dest.sin_addr) <= 0 ||
+        inet_pton(AF_INET, if_ip, &if_addr) <= 0) {
+        fprintf(stderr, "[ERROR] Invalid address\n");
+        return 1;
+    }
+
+    rp.sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (rp.sock_fd < 0) {
+        perror("[ERROR] Failed to create UDP socket");
+        return 1;
+    }
+    if (setsockopt(rp.sock_fd, IPPROTO_IP, IP_MULTICAST_IF,
+                   &if_addr, sizeof(if_addr)) < 0) {
+        perror("[WARN] Failed to set IP_MULTICAST_IF");
+    }
+    setsockopt(rp.sock_fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(rp.sock_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+    /* 送信用 msghdr の初期化 (宛先は全パケット共通) */
+    for (int i = 0; i < SEND_BATCH; i++) {
+        rp.msgs[i].msg_hdr.msg_name = &rp.dest;
+        rp.msgs[i].msg_hdr.msg_namelen = sizeof(rp.dest);
+        rp.msgs[i].msg_hdr.msg_iov = &rp.iovs[i];
+        rp.msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    start = now_ns();
+    for (int l = 0; l < loops; l++) {
+        for (int i = optind; i < argc; i++) {
+            if (replay_file(&rp, argv[i]) < 0) {
+                close(rp.sock_fd);
+                return 1;
+            }
+        }
+        /* 繰り返し時は次の周回を新たな基準時刻で開始する */
+        rp.have_base = 0;
+    }
+    elapsed = now_ns() - start;
+
+    printf("[INFO] Sent %lu packets, %lu bytes in %.3f s (%.0f pps, %.2f Mbps)\n",
+           rp.sent, rp.bytes, elapsed / 1e9,
+           elapsed > 0 ? rp.sent / (elapsed / 1e9) : 0.0,
+           elapsed > 0 ? rp.bytes * 8 / (elapsed / 1e3) : 0.0);
+    if (rp.skipped > 0) {
+        printf("[INFO] Skipped %lu non-UDP records\n", rp.skipped);
+    }
+    if (rp.speed > 0) {
+        printf("[INFO] Max schedule lateness: %.1f us\n", rp.max_late_ns / 1e3);
+    }
+
+    close(rp.sock_fd);
+    return 0;
+}
@@ -0,0 +1,226 @@
+/*
+ * ============================================================================
+ * ElsgwShmReader.c - ELSGW Shared-Memory Feed Reader
+ * ============================================================================
+ * 機能:
+ *   - ElsgwReceiver -m が公開した共有メモリのリング (elsgw_shm.h) を読み、
+ *     データグラムをコピーせずに参照する読み出し側の例
+ *   - 何個でも同時に起動できる (書き込み側は読み出し側を待たない)
+ *   - 受け渡し遅延 (公開 -> 読み出し) とカーネル受信からの遅延
+ *     (カーネル受信 -> 読み出し) を記録し、周期ごとと終了時に表示する
+ *   - 周回遅れ・読んでいる間の上書きを欠損として数える
+ *   - 待ち方の選択
+ *       futex (既定)   : ELSGW_SHM_SPIN 回スピンしてから futex で待つ
+ *       ビジーポーリング (-b) : スピンし続ける (CPUを1個使い切る, 最小遅延)
+ *
+ * 使い方:
+ *   ./ElsgwShmReader [-v] [-b] [-a] [-t 周期秒] 共有メモリ名
+ *     -v  データグラムごとに送信元・長さ・先頭フレームの種別と番号を表示する
+ *     -b  futex で待たずにビジーポーリングする
+ *     -a  リングに残っている最も古いデータグラムから読む
+ *         (既定: 起動後に公開されたデータグラムのみ)
+ *     -t  統計の表示周期 (秒, 既定: 1, 0 = 終了時のみ)
+ *   共有メモリ名は ElsgwReceiver -m の指定と同じ (/dev/shm/elsgw_feed.<名前>)
+ *   書き込み側が終了するか、SIGINT/SIGTERM で終了する
+ *
+ * ビルド:
+ *   gcc -O2 -Wall -o ElsgwShmReader ElsgwShmReader.c
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#include "elsgw_shm.h"
+#include "../NetworkTest/Guest/latency_hist.h"
+
+/* ============================================================================
+ * 動作設定
+ * ============================================================================ */
+#define WAIT_TIMEOUT_MS     200     /* futex で待つ最大時間 (終了確認のため) */
+
+/* 終了要求フラグ (SIGINT/SIGTERM で 0 になる) */
+static volatile sig_atomic_t g_running = 1;
+
+/* ============================================================================
+ * 関数: handle_signal
+ * 機能: 終了シグナルを受けてループを止める
+ * ============================================================================ */
+static void handle_signal(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+/* ============================================================================
+ * 関数: now_ns
+ * 機能: 現在時刻をナノ秒で取得する (公開時刻と同じ CLOCK_REALTIME)
+ * ============================================================================ */
+static int64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* ============================================================================
+ * 関数: print_interval
+ * 機能: 周期ごとの統計を1行で表示する (遅延はマイクロ秒)
+ * ============================================================================ */
+static void print_interval(unsigned long packets, unsigned long lost, const lat_hist_t *h) {
+    if (h->count == 0) {
+        printf("[STATS] %lu datagrams, %lu lost\n", packets, lost);
+        return;
+    }
+    printf("[STATS] %lu datagrams, %lu lost, handoff (us): p50 %.3f, p99 %.3f, max %.3f\n",
+           packets, lost, lat_hist_percentile(h, 50) / 1e3,
+           lat_hist_percentile(h, 99) / 1e3, h->max / 1e3);
+}
+
+/* ============================================================================
+ * 関数: print_slot
+ * 機能: データグラム1個の概要を表示する (-v)
+ * ============================================================================ */
+static void print_slot(const elsgw_shm_slot_t *s, uint64_t number) {
+    const unsigned char *src = (const unsigned char *)&s->src_addr;
+
+    printf("[RECV] #%lu From: %u.%u.%u.%u:%d Size: %u bytes",
+           (unsigned long)number, src[0], src[1], src[2], src[3], ntohs(s->src_port),
+           s->orig_len);
+    if (s->msg_valid) {
+        printf(" Type: 0x%02x Seq: %u", s->msg_type, s->msg_seq);
+    }
+    printf(" Time: %ld.%09ld\n", (long)(s->rx_time_ns / 1000000000LL),
+           (long)(s->rx_time_ns % 1000000000LL));
+}
+
+/* ============================================================================
+ * 関数: print_usage
+ * 機能: コマンドラインの使い方を表示
+ * ============================================================================ */
+static void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-v] [-b] [-a] [-t interval_sec] feed_name\n", prog);
+}
+
+/* ============================================================================
+ * 関数: main
+ * ============================================================================ */
+int main(int argc, char *argv[]) {
+    elsgw_shm_reader_t r;
+    const elsgw_shm_slot_t *s;
+    elsgw_shm_slot_t meta;
+    lat_hist_t handoff, handoff_total, kernel_total;
+    struct sigaction sa;
+    int verbose = 0, busy = 0, oldest = 0;
+    int interval_sec = 1;
+    unsigned long packets = 0, total = 0, lost_reported = 0;
+    int64_t next_report, t;
+    uint64_t number;
+    int c;
+
+    while ((c = getopt(argc, argv, "vbat:h")) != -1) {
+        switch (c) {
+        case 'v':
+            verbose = 1;
+            break;
+        case 'b':
+            busy = 1;
+            break;
+        case 'a':
+            oldest = 1;
+            break;
+        case 't':
+            interval_sec = atoi(optarg);
+            if (interval_sec < 0) {
+                fprintf(stderr, "[ERROR] Invalid interval: %s\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (elsgw_shm_reader_open(&r, argv[optind], oldest) < 0) {
+        return 1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    printf("============================================================\n");
+    printf("  ELSGW Shared-Memory Feed Reader\n");
+    printf("  Feed: %s (writer pid %d, %u slots)\n", argv[optind], r.hdr->pid,
+           r.hdr->slot_count);
+    printf("  Wait: %s\n", busy ? "busy poll" : "spin + futex");
+    printf("============================================================\n");
+    fflush(stdout);
+
+    lat_hist_init(&handoff);
+    lat_hist_init(&handoff_total);
+    lat_hist_init(&kernel_total);
+    next_report = now_ns() + (int64_t)interval_sec * 1000000000LL;
+
+    while (g_running) {
+        s = elsgw_shm_next(&r);
+        if (s == NULL) {
+            if (elsgw_shm_closed(&r)) {
+                printf("[INFO] Writer closed the feed\n");
+                break;
+            }
+            if (!busy) {
+                elsgw_shm_wait(&r, WAIT_TIMEOUT_MS);
+            }
+        } else {
+            /* メタデータのみ手元へ写し、データは直接参照する。
+             * elsgw_shm_done() で上書きされていないことを確認してから使う */
+            memcpy(&meta, s, offsetof(elsgw_shm_slot_t, data));
+            number = r.next;
+            t = now_ns();
+            if (elsgw_shm_done(&r, s) == 0) {
+                packets++;
+                if (t > meta.pub_time_ns) {
+                    lat_hist_record(&handoff, t - meta.pub_time_ns);
+                }
+                if (t > meta.rx_time_ns) {
+                    lat_hist_record(&kernel_total, t - meta.rx_time_ns);
+                }
+                if (verbose) {
+                    print_slot(&meta, number);
+                }
+            }
+        }
+
+        if (interval_sec > 0 && (s == NULL || (packets & 1023) == 0) &&
+            (t = now_ns()) >= next_report) {
+            print_interval(packets, r.lost - lost_reported, &handoff);
+            fflush(stdout);
+            lat_hist_merge(&handoff_total, &handoff);
+            lat_hist_init(&handoff);
+            total += packets;
+            packets = 0;
+            lost_reported = r.lost;
+            next_report = t + (int64_t)interval_sec * 1000000000LL;
+        }
+    }
+
+    lat_hist_merge(&handoff_total, &handoff);
+    total += packets;
+    printf("\n[INFO] Read: %lu datagrams, Lost: %lu\n", total, r.lost);
+    lat_hist_print(&handoff_total, "Handoff (publish -> read)");
+    lat_hist_print(&kernel_total, "Kernel receive -> read");
+    elsgw_shm_reader_close(&r);
+    return 0;
+}
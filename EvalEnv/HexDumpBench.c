@@ -0,0 +1,211 @@
+/*
+ * ============================================================================
+ * HexDumpBench.c - Hex Dump Formatter Benchmark
+ * ============================================================================
+ * 機能:
+ *   - 従来の print_hex_dump() + ASCII表示 (1バイトごとの printf) と
+ *     hex_dump_format() + write() 1回の処理時間を比較する
+ *   - 計測前に両者の出力内容が一致することを確認する
+ *     (16の倍数でない長さも確認し、16バイトに満たない行末の処理を検証する)
+ *   - 出力先は /dev/null。従来方式の stdio は ElsgwReceiver のコンソール
+ *     出力 (ttyAMA0) と同じ行バッファリングとする (-f で完全バッファ)
+ *
+ * 使い方:
+ *   ./HexDumpBench [-n 反復回数] [-f]
+ *
+ * ビルド:
+ *   gcc -O2 -Wall -o HexDumpBench HexDumpBench.c hex_dump.c
+ *   既定のビルドでベクトル化されるのは aarch64 (NEON) のみで、x86 では
+ *   テーブル参照版を計測する。x86 で SSSE3 版を計測する場合は -mssse3 を追加
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include "hex_dump.h"
+
+/* ============================================================================
+ * 動作設定
+ * ============================================================================ */
+#define ITERATIONS_DEFAULT  20000   /* 既定の反復回数 */
+#define MAX_PACKET_SIZE     1500    /* 最大パケットサイズ (Ethernet MTU) */
+
+static const size_t PACKET_SIZES[] = { 64, 128, 256, 512, 1024 };
+
+/* 出力の一致を確認する長さ (行末が16バイトに満たない長さを含む) */
+static const size_t VERIFY_SIZES[] = {
+    1, 15, 16, 17, 33, 64, 100, 1000, 1024, 1472, 1473, 1500
+};
+
+/* ============================================================================
+ * 関数: legacy_dump
+ * 機能: 従来の ElsgwReceiver と同じ print_hex_dump() + ASCII表示
+ * ============================================================================ */
+void legacy_dump(FILE *fp, const unsigned char *data, size_t len) {
+    size_t i;
+    fprintf(fp, "[HEX] ");
+    for (i = 0; i < len; i++) {
+        fprintf(fp, "%02x ", data[i]);
+        if ((i + 1) % 16 == 0) {
+            fprintf(fp, "\n[HEX] ");
+        }
+    }
+    if (len % 16 != 0) {
+        fprintf(fp, "\n");
+    }
+
+    fprintf(fp, "[ASCII] ");
+    for (i = 0; i < len; i++) {
+        if (data[i] >= 32 && data[i] <= 126) {
+            fprintf(fp, "%c", data[i]);
+        } else {
+            fprintf(fp, ".");
+        }
+    }
+    fprintf(fp, "\n");
+}
+
+/* ============================================================================
+ * 関数: now_ns
+ * 機能: 単調増加時刻をナノ秒で取得
+ * ============================================================================ */
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* ============================================================================
+ * 関数: verify_output
+ * 機能: 従来方式と新方式の出力が一致することを確認する
+ *   従来方式は長さが16の倍数のとき末尾に改行なしの "[HEX] " を出力するため、
+ *   その部分のみ取り除いて比較する
+ * 戻り値: 1 = 一致, 0 = 不一致
+ * ============================================================================ */
+int verify_output(const unsigned char *data, size_t len) {
+    static char formatted[HEX_DUMP_MAX_SIZE(MAX_PACKET_SIZE)];
+    char *legacy = NULL;
+    size_t legacy_len = 0;
+    size_t formatted_len;
+    char *dangling;
+    FILE *fp;
+    int match;
+
+    fp = open_memstream(&legacy, &legacy_len);
+    if (fp == NULL) {
+        return 0;
+    }
+    legacy_dump(fp, data, len);
+    fclose(fp);
+
+    dangling = strstr(legacy, "[HEX] [ASCII] ");
+    if (dangling != NULL) {
+        memmove(dangling, dangling + 6, strlen(dangling + 6) + 1);
+        legacy_len -= 6;
+    }
+
+    formatted_len = hex_dump_format(formatted, data, len);
+    match = (formatted_len == legacy_len &&
+             memcmp(formatted, legacy, legacy_len) == 0);
+    free(legacy);
+    return match;
+}
+
+/* ============================================================================
+ * 関数: main
+ * 機能: パケットサイズごとに従来方式と新方式の処理時間を計測する
+ * ============================================================================ */
+int main(int argc, char *argv[]) {
+    static unsigned char data[MAX_PACKET_SIZE];
+    static char out[HEX_DUMP_MAX_SIZE(MAX_PACKET_SIZE)];
+    int iterations = ITERATIONS_DEFAULT;
+    int buffer_mode = _IOLBF;
+    int null_fd;
+    FILE *null_fp;
+    long long start, legacy_ns, formatted_ns;
+    size_t len, out_len = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:f")) != -1) {
+        switch (c) {
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 'f':
+            buffer_mode = _IOFBF;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n iterations] [-f]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (iterations <= 0) {
+        fprintf(stderr, "[ERROR] Invalid iteration count\n");
+        return 1;
+    }
+
+    /* 全バイト値を含むテストデータ */
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (unsigned char)(i * 37 + 11);
+    }
+
+    null_fd = open("/dev/null", O_WRONLY);
+    null_fp = fopen("/dev/null", "w");
+    if (null_fd < 0 || null_fp == NULL) {
+        perror("[ERROR] Failed to open /dev/null");
+        return 1;
+    }
+    setvbuf(null_fp, NULL, buffer_mode, BUFSIZ);
+
+    for (size_t s = 0; s < sizeof(VERIFY_SIZES) / sizeof(VERIFY_SIZES[0]); s++) {
+        if (!verify_output(data, VERIFY_SIZES[s])) {
+            fprintf(stderr, "[ERROR] Output mismatch at %zu bytes\n",
+                    VERIFY_SIZES[s]);
+            return 1;
+        }
+    }
+
+    printf("============================================================\n");
+    printf("  Hex Dump Benchmark (%d iterations, %s stdio)\n", iterations,
+           buffer_mode == _IOLBF ? "line-buffered" : "fully-buffered");
+    printf("============================================================\n");
+    printf("%8s %14s %14s %9s %12s\n",
+           "size", "legacy ns/pkt", "format ns/pkt", "speedup", "format MB/s");
+
+    for (size_t s = 0; s < sizeof(PACKET_SIZES) / sizeof(PACKET_SIZES[0]); s++) {
+        len = PACKET_SIZES[s];
+
+        start = now_ns();
+        for (int i = 0; i < iterations; i++) {
+            legacy_dump(null_fp, data, len);
+        }
+        fflush(null_fp);
+        legacy_ns = now_ns() - start;
+
+        start = now_ns();
+        for (int i = 0; i < iterations; i++) {
+            out_len = hex_dump_format(out, data, len);
+            if (write(null_fd, out, out_len) < 0) {
+                perror("[ERROR] write failed");
+                return 1;
+            }
+        }
+        formatted_ns = now_ns() - start;
+
+        printf("%8zu %14.1f %14.1f %8.1fx %12.1f\n", len,
+               (double)legacy_ns / iterations,
+               (double)formatted_ns / iterations,
+               (double)legacy_ns / formatted_ns,
+               (double)len * iterations / (formatted_ns / 1e9) / 1e6);
+    }
+
+    fclose(null_fp);
+    close(null_fd);
+    return 0;
+}
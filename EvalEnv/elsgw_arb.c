@@ -0,0 +1,266 @@
+/*
+ * ============================================================================
+ * elsgw_arb.c - ELSGW A/B Feed Arbitration
+ * ============================================================================
+ * 判定の手順 (パケットごと, システムコール・メモリ確保なし):
+ *   1. 受信インターフェースから系統を求める
+ *   2. 宛先 (グループ:ポート) とキー (番号またはハッシュ) から判定表の組
+ *      (ARB_WAYS 個) を引く
+ *   3. 組の中で同じ宛先・キーが ARB_WINDOW_MS 以内に通っていれば重複として捨て、
+ *      先着との受信時刻の差を後着の系統の遅れとして記録する
+ *   4. そうでなければ組の空き (なければ最も古い要素) を置き換えて通す。
+ *      置き換えられた要素が1系統からしか届いていなければ、その系統の
+ *      ギャップ補完として数える
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ifaddrs.h>
+#include <arpa/inet.h>
+
+#include "elsgw_arb.h"
+#include "elsgw_decoder.h"
+
+#define ARB_WINDOW_NS       ((int64_t)ARB_WINDOW_MS * 1000000LL)
+#define ARB_OTHER_BIT       (1 << ARB_LEGS)     /* どちらの系統でもない受信 */
+#define ARB_SETS            (ARB_SLOTS / ARB_WAYS)
+
+static const char *const leg_names[ARB_LEGS] = { "A", "B" };
+
+/* ============================================================================
+ * 関数: find_ifindex
+ * 機能: IPアドレスを持つインターフェースの番号と名前を求める
+ * 戻り値: インターフェース番号 (0 = 見つからない)
+ * ============================================================================ */
+static int find_ifindex(struct in_addr addr, char *name) {
+    struct ifaddrs *list, *ifa;
+    int ifindex = 0;
+
+    if (getifaddrs(&list) < 0) {
+        perror("[ERROR] getifaddrs failed");
+        return 0;
+    }
+    for (ifa = list; ifa != NULL; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr != NULL && ifa->ifa_addr->sa_family == AF_INET &&
+            ((struct sockaddr_in *)ifa->ifa_addr)->sin_addr.s_addr == addr.s_addr) {
+            ifindex = if_nametoindex(ifa->ifa_name);
+            snprintf(name, IF_NAMESIZE, "%s", ifa->ifa_name);
+            break;
+        }
+    }
+    freeifaddrs(list);
+    return ifindex;
+}
+
+/* ============================================================================
+ * 関数: fnv1a64
+ * 機能: データグラム全体のハッシュ (FNV-1a 64bit) を求める
+ * ============================================================================ */
+static uint64_t fnv1a64(const unsigned char *p, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/* ============================================================================
+ * 関数: dest_hash
+ * 機能: 宛先 (グループ:ポート) を判定表の位置のずらし幅にする
+ *   (番号は宛先ごとに連続するため、番号の下位ビットはそのまま位置に使う)
+ * ============================================================================ */
+static uint32_t dest_hash(const struct sockaddr_in *dest) {
+    uint64_t v = ((uint64_t)dest->sin_addr.s_addr << 16) | dest->sin_port;
+
+    return (uint32_t)((v * 0x9e3779b97f4a7c15ULL) >> 32);
+}
+
+/* ============================================================================
+ * 関数: retire
+ * 機能: 判定表の要素を手放す。1系統からしか届かなかったメッセージを、
+ *       その系統のギャップ補完として数える
+ * ============================================================================ */
+static void retire(elsgw_arb_t *a, arb_entry_t *e) {
+    for (int i = 0; i < ARB_LEGS; i++) {
+        if (e->legs == (1 << i)) {
+            a->legs[i].fills++;
+        }
+    }
+    e->used = 0;
+}
+
+/* ============================================================================
+ * 関数: elsgw_arb_init
+ * 機能: 判定表を確保し、各系統のインターフェース番号を求める
+ * ============================================================================ */
+int elsgw_arb_init(elsgw_arb_t *a, int seq_offset, const char *const addrs[ARB_LEGS]) {
+    memset(a, 0, sizeof(*a));
+    a->seq_offset = seq_offset;
+    for (int i = 0; i < ARB_LEGS; i++) {
+        arb_leg_t *leg = &a->legs[i];
+
+        if (inet_pton(AF_INET, addrs[i], &leg->addr) <= 0) {
+            fprintf(stderr, "[ERROR] Invalid leg %s address: %s\n", leg_names[i], addrs[i]);
+            return -1;
+        }
+        leg->ifindex = find_ifindex(leg->addr, leg->ifname);
+        if (leg->ifindex == 0) {
+            fprintf(stderr, "[ERROR] No interface has leg %s address %s\n",
+                    leg_names[i], addrs[i]);
+            return -1;
+        }
+    }
+    if (a->legs[0].ifindex == a->legs[1].ifindex) {
+        fprintf(stderr, "[WARN] Legs A and B are both on %s; "
+                "all packets are counted as leg A\n", a->legs[0].ifname);
+    }
+
+    a->table = calloc(ARB_SLOTS, sizeof(*a->table));
+    if (a->table == NULL) {
+        fprintf(stderr, "[ERROR] Failed to allocate arbitration table\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: elsgw_arb_accept
+ * 機能: パケットがメッセージの最初の1個か判定し、集計する
+ * ============================================================================ */
+int elsgw_arb_accept(elsgw_arb_t *a, const rx_packet_t *pkt) {
+    int64_t rx_ns = (int64_t)pkt->rx_time.tv_sec * 1000000000LL + pkt->rx_time.tv_nsec;
+    int64_t behind;
+    arb_entry_t *set, *e = NULL;
+    uint64_t key;
+    uint32_t index, group;
+    uint16_t port;
+    int bit = ARB_OTHER_BIT;
+    int leg = -1;
+
+    for (int i = 0; i < ARB_LEGS; i++) {
+        if (pkt->ifindex == a->legs[i].ifindex) {
+            leg = i;
+            bit = 1 << i;
+            a->legs[i].received++;
+            break;
+        }
+    }
+    if (leg < 0) {
+        a->other++;
+    }
+
+    if (a->seq_offset != ARB_SEQ_DISABLED && pkt->len >= (size_t)a->seq_offset + 4) {
+        key = elsgw_be32(pkt->data + a->seq_offset);
+        index = (uint32_t)key;
+    } else {
+        key = fnv1a64(pkt->data, pkt->len);
+        index = (uint32_t)(key ^ (key >> 32));
+        a->hashed++;
+    }
+    group = pkt->dest->sin_addr.s_addr;
+    port = pkt->dest->sin_port;
+    index = (index + dest_hash(pkt->dest)) & (ARB_SETS - 1);
+
+    /* 先着が ARB_WINDOW_MS 以内に通っていれば重複 (前後どちらの差も許す)。
+     * 重複でなければ、空き (なければ最も古い要素) を置き換える */
+    set = &a->table[(size_t)index * ARB_WAYS];
+    for (int w = 0; w < ARB_WAYS; w++) {
+        arb_entry_t *cand = &set[w];
+
+        if (!cand->used) {
+            if (e == NULL || e->used) {
+                e = cand;
+            }
+            continue;
+        }
+        behind = rx_ns - cand->first_ns;
+        if (cand->key == key && cand->group == group && cand->port == port &&
+            behind <= ARB_WINDOW_NS && behind >= -ARB_WINDOW_NS) {
+            cand->legs |= bit;
+            if (leg >= 0) {
+                a->legs[leg].duplicates++;
+                if (behind > 0) {
+                    a->legs[leg].behind_count++;
+                    a->legs[leg].behind_sum_ns += behind;
+                    if (behind > a->legs[leg].behind_max_ns) {
+                        a->legs[leg].behind_max_ns = behind;
+                    }
+                }
+            }
+            return 0;
+        }
+        if (e == NULL || (e->used && cand->first_ns < e->first_ns)) {
+            e = cand;
+        }
+    }
+
+    if (e->used) {
+        retire(a, e);
+    }
+    e->key = key;
+    e->first_ns = rx_ns;
+    e->group = group;
+    e->port = port;
+    e->legs = bit;
+    e->used = 1;
+    if (leg >= 0) {
+        a->legs[leg].wins++;
+    }
+    a->accepted++;
+    return 1;
+}
+
+/* ============================================================================
+ * 関数: elsgw_arb_print
+ * 機能: 判定表に残ったメッセージを集計に反映し、系統ごとの集計を表示する
+ * ============================================================================ */
+void elsgw_arb_print(elsgw_arb_t *a) {
+    unsigned long dropped = 0;
+
+    for (int i = 0; i < ARB_SLOTS; i++) {
+        if (a->table[i].used) {
+            retire(a, &a->table[i]);
+        }
+    }
+    for (int i = 0; i < ARB_LEGS; i++) {
+        dropped += a->legs[i].duplicates;
+    }
+
+    if (a->seq_offset != ARB_SEQ_DISABLED) {
+        printf("[INFO] A/B arbitration (seq at offset %d): %lu delivered, "
+               "%lu duplicates dropped\n", a->seq_offset, a->accepted, dropped);
+    } else {
+        printf("[INFO] A/B arbitration (content hash): %lu delivered, "
+               "%lu duplicates dropped\n", a->accepted, dropped);
+    }
+    for (int i = 0; i < ARB_LEGS; i++) {
+        const arb_leg_t *leg = &a->legs[i];
+
+        printf("[INFO]   Leg %s %s (%s): received %lu, wins %lu (%.1f%%), "
+               "gap fills %lu, behind avg %.1f us (max %.1f us)\n",
+               leg_names[i], leg->ifname, inet_ntoa(leg->addr), leg->received, leg->wins,
+               a->accepted > 0 ? 100.0 * leg->wins / a->accepted : 0.0, leg->fills,
+               leg->behind_count > 0 ? leg->behind_sum_ns / leg->behind_count / 1e3 : 0.0,
+               leg->behind_max_ns / 1e3);
+    }
+    if (a->seq_offset != ARB_SEQ_DISABLED && a->hashed > 0) {
+        printf("[INFO]   %lu datagrams too short for the seq, compared by hash\n", a->hashed);
+    }
+    if (a->other > 0) {
+        printf("[INFO]   %lu datagrams from other interfaces\n", a->other);
+    }
+}
+
+/* ============================================================================
+ * 関数: elsgw_arb_free
+ * 機能: 判定表を解放する
+ * ============================================================================ */
+void elsgw_arb_free(elsgw_arb_t *a) {
+    free(a->table);
+    a->table = NULL;
+}
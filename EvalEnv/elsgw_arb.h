@@ -0,0 +1,106 @@
+/*
+ * ============================================================================
+ * elsgw_arb.h - ELSGW A/B Feed Arbitration
+ * ============================================================================
+ * 機能:
+ *   - 同じ ELSGW フィードを2系統 (A: eth0, B: eth1) で受信し、各メッセージの
+ *     最初に処理した1個のみを通し、もう一方の系統の重複を捨てる
+ *     (片方の系統が止まっても、待たずにもう一方で受信を続ける)
+ *   - 系統は受信インターフェース (IP_PKTINFO / AF_PACKET の ifindex) で区別する
+ *   - 重複の判定キー (宛先 (グループ:ポート) と以下の組。-c で複数のグループを
+ *     受信する場合も、同じ宛先の2系統のみを調停する)
+ *       シーケンス番号 (既定) : データグラム内の32bit番号 (-S の位置)
+ *       内容のハッシュ (-S -1) : データグラム全体の FNV-1a 64bit
+ *   - 判定範囲 (スライディングウィンドウ): キーで引く ARB_SLOTS 個の表
+ *     (ARB_WAYS 個ずつの組で、組が埋まっていれば最も古い要素を置き換える)。
+ *     最初の1個から ARB_WINDOW_MS 以内に届いた同じキーのみ重複とする
+ *     (送信側の再起動で番号が戻った場合に、新しいメッセージを捨てない)
+ *   - 系統ごとに、先着数 (勝率)、捨てた重複数、もう一方が届けなかった
+ *     メッセージを補った数 (ギャップ補完)、負けた場合の遅れを集計する
+ *
+ * 呼び出しは処理スレッドからのみ (ロックなし)
+ * ============================================================================
+ */
+
+#ifndef ELSGW_ARB_H
+#define ELSGW_ARB_H
+
+#include <stdint.h>
+#include <net/if.h>
+
+#include "elsgw_receiver.h"
+
+/* ============================================================================
+ * 調停設定
+ * ============================================================================ */
+#define ARB_LEGS            2                   /* 系統数 (A, B) */
+#define ARB_SLOTS           65536               /* 判定表の大きさ (2のべき乗) */
+#define ARB_WAYS            4                   /* 同じ位置に置ける要素数 (ハッシュの衝突対策) */
+#define ARB_WINDOW_MS       100                 /* 同じキーを重複とみなす時間 */
+#define ARB_SEQ_DISABLED    (-1)                /* 番号を使わずハッシュで判定 */
+
+/* ============================================================================
+ * 判定表の要素 (キーごと)
+ * ============================================================================ */
+typedef struct {
+    uint64_t key;                       /* 番号またはハッシュ */
+    int64_t  first_ns;                  /* 最初の1個のカーネル受信時刻 */
+    uint32_t group;                     /* 宛先グループ (ネットワークバイト順) */
+    uint16_t port;                      /* 宛先ポート (ネットワークバイト順) */
+    uint8_t  legs;                      /* 届いた系統のビット (1 << 系統番号) */
+    uint8_t  used;                      /* 1 = 使用中 */
+} arb_entry_t;
+
+/* ============================================================================
+ * 系統ごとの集計
+ * ============================================================================ */
+typedef struct {
+    struct in_addr addr;                /* 受信インターフェースIP */
+    int            ifindex;             /* 受信インターフェース番号 */
+    char           ifname[IF_NAMESIZE];
+    unsigned long  received;            /* この系統で受信した数 */
+    unsigned long  wins;                /* 先着して通した数 */
+    unsigned long  duplicates;          /* 後着して捨てた数 */
+    unsigned long  fills;               /* この系統のみが届けた数 (ギャップ補完) */
+    unsigned long  behind_count;        /* 先着より後に届いた重複の数 */
+    double         behind_sum_ns;       /* 後着時の遅れの合計 */
+    int64_t        behind_max_ns;       /* 後着時の遅れの最大 */
+} arb_leg_t;
+
+/* ============================================================================
+ * 調停の状態
+ * ============================================================================ */
+typedef struct {
+    int            seq_offset;          /* 番号の位置 (ARB_SEQ_DISABLED = ハッシュ) */
+    arb_entry_t   *table;               /* ARB_SLOTS 個 */
+    arb_leg_t      legs[ARB_LEGS];
+    unsigned long  accepted;            /* 通したメッセージ数 */
+    unsigned long  hashed;              /* 番号が読めずハッシュで判定した数 */
+    unsigned long  other;               /* どちらの系統でもないインターフェースから受信 */
+} elsgw_arb_t;
+
+/* ============================================================================
+ * 関数: elsgw_arb_init
+ * 機能: 判定表を確保し、各系統のインターフェース番号を求める
+ * 引数:
+ *   seq_offset - 番号 (32bit, ビッグエンディアン) の位置 (ARB_SEQ_DISABLED = ハッシュ)
+ *   addrs      - 系統 A, B の受信インターフェースIP
+ * 戻り値: 0 = 成功, -1 = 失敗
+ * ============================================================================ */
+int elsgw_arb_init(elsgw_arb_t *a, int seq_offset, const char *const addrs[ARB_LEGS]);
+
+/* ============================================================================
+ * 関数: elsgw_arb_accept
+ * 機能: パケットがメッセージの最初の1個か判定し、集計する
+ * 戻り値: 1 = 通す (最初の1個), 0 = 捨てる (もう一方の系統で受信済み)
+ * ============================================================================ */
+int elsgw_arb_accept(elsgw_arb_t *a, const rx_packet_t *pkt);
+
+/* ============================================================================
+ * 関数: elsgw_arb_print / elsgw_arb_free
+ * 機能: 系統ごとの集計を表示する / 判定表を解放する
+ * ============================================================================ */
+void elsgw_arb_print(elsgw_arb_t *a);
+void elsgw_arb_free(elsgw_arb_t *a);
+
+#endif /* ELSGW_ARB_H */
@@ -0,0 +1,140 @@
+/*
+ * ============================================================================
+ * elsgw_decoder.c - ELSGW API Frame Decoder
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "elsgw_decoder.h"
+
+/* ============================================================================
+ * メッセージ種別の定義 (ELSGW_MSG_TABLE から種別番号を添字として生成)
+ *   未定義の番号は name == NULL となる
+ * ============================================================================ */
+const elsgw_layout_t elsgw_layouts[ELSGW_MSG_TYPES] = {
+#define ELSGW_MSG_LAYOUT(name, id, min, max, count_off, elem) \
+    [id] = { #name, min, max, count_off, elem },
+    ELSGW_MSG_TABLE(ELSGW_MSG_LAYOUT)
+#undef ELSGW_MSG_LAYOUT
+};
+
+/* ============================================================================
+ * 関数: elsgw_decoder_init
+ * 機能: カウンタとハンドラ登録を初期化する
+ * ============================================================================ */
+void elsgw_decoder_init(elsgw_decoder_t *d) {
+    memset(d, 0, sizeof(*d));
+}
+
+/* ============================================================================
+ * 関数: elsgw_decoder_register
+ * 機能: 種別番号にハンドラを登録する (NULL で解除)
+ * ============================================================================ */
+int elsgw_decoder_register(elsgw_decoder_t *d, uint8_t type,
+                           elsgw_handler_t handler, void *ctx) {
+    if (elsgw_layouts[type].name == NULL) {
+        fprintf(stderr, "[ERROR] Unknown ELSGW message type: 0x%02x\n", type);
+        return -1;
+    }
+    d->handlers[type] = handler;
+    d->ctx[type] = ctx;
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: body_valid
+ * 機能: 本体長が種別の条件を満たすか検証する
+ * ============================================================================ */
+static inline int body_valid(const elsgw_layout_t *layout,
+                             const unsigned char *body, size_t body_len) {
+    if (body_len < layout->min_len) {
+        return 0;
+    }
+    if (layout->max_len != 0 && body_len > layout->max_len) {
+        return 0;
+    }
+    if (layout->elem_size != 0 &&
+        layout->min_len + (size_t)elsgw_be16(body + layout->count_off) *
+                          layout->elem_size > body_len) {
+        return 0;
+    }
+    return 1;
+}
+
+/* ============================================================================
+ * 関数: elsgw_decode
+ * 機能: データグラム内の全フレームを解析し、登録済みハンドラを呼び出す
+ *   フレーム長が不正な場合は以降のフレーム境界が分からないため打ち切る。
+ *   未知の種別・本体長不正・バージョン不一致はそのフレームのみ読み飛ばす。
+ * ============================================================================ */
+int elsgw_decode(elsgw_decoder_t *d, const rx_packet_t *pkt) {
+    const unsigned char *p = pkt->data;
+    const unsigned char *end = pkt->data + pkt->len;
+    const elsgw_layout_t *layout;
+    elsgw_handler_t handler;
+    elsgw_msg_t msg;
+    size_t length;
+    int decoded = 0;
+
+    d->datagrams++;
+    msg.pkt = pkt;
+
+    while ((size_t)(end - p) >= ELSGW_HEADER_SIZE) {
+        length = elsgw_be16(p + 2);
+        if (length < ELSGW_HEADER_SIZE || length > (size_t)(end - p)) {
+            d->malformed++;
+            return decoded;
+        }
+
+        layout = &elsgw_layouts[p[1]];
+        if (p[0] != ELSGW_VERSION) {
+            d->bad_version++;
+        } else if (layout->name == NULL) {
+            d->unknown++;
+        } else if (!body_valid(layout, p + ELSGW_HEADER_SIZE,
+                               length - ELSGW_HEADER_SIZE)) {
+            d->malformed++;
+        } else {
+            d->frames++;
+            d->type_count[p[1]]++;
+            decoded++;
+
+            handler = d->handlers[p[1]];
+            if (handler != NULL) {
+                msg.version = p[0];
+                msg.type = p[1];
+                msg.length = (uint16_t)length;
+                msg.seq = elsgw_be32(p + 4);
+                msg.body = p + ELSGW_HEADER_SIZE;
+                msg.body_len = length - ELSGW_HEADER_SIZE;
+                msg.layout = layout;
+                handler(&msg, d->ctx[p[1]]);
+            }
+        }
+        p += length;
+    }
+
+    /* ヘッダに満たない余りのバイト */
+    if (p != end) {
+        d->malformed++;
+    }
+    return decoded;
+}
+
+/* ============================================================================
+ * 関数: elsgw_decoder_print
+ * 機能: 解析結果の集計を表示する
+ * ============================================================================ */
+void elsgw_decoder_print(const elsgw_decoder_t *d) {
+    printf("[INFO] Decoder: %lu datagrams, %lu frames, unknown=%lu, "
+           "bad version=%lu, malformed=%lu\n",
+           d->datagrams, d->frames, d->unknown, d->bad_version, d->malformed);
+    for (int i = 0; i < ELSGW_MSG_TYPES; i++) {
+        if (d->type_count[i] != 0) {
+            printf("[INFO]   0x%02x %-14s %lu\n",
+                   i, elsgw_layouts[i].name, d->type_count[i]);
+        }
+    }
+}
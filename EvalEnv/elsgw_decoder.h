@@ -0,0 +1,201 @@
+/*
+ * ============================================================================
+ * elsgw_decoder.h - ELSGW API Frame Decoder
+ * ============================================================================
+ * 機能:
+ *   - 受信バッファ上の ELSGW API フレームをその場で解析する
+ *     (コピー・メモリ確保なし。1データグラムに複数フレームを格納可能)
+ *   - メッセージ種別ごとの本体長の条件をコンパイル時の表 (ELSGW_MSG_TABLE)
+ *     で定義し、種別番号を添字とする配列で参照する
+ *   - 種別番号ごとにハンドラを登録し、ヘッダ解析・長さ検証済みの
+ *     メッセージ (elsgw_msg_t) を渡す。本体のフィールドは下記のアクセサで
+ *     読み出す (長さ検証済みのため範囲チェック不要)
+ *   - 未知の種別・不正なフレームは数えて読み飛ばす
+ *
+ * フレーム形式 (ビッグエンディアン):
+ *   +0  u8   version   (ELSGW_VERSION)
+ *   +1  u8   msg_type
+ *   +2  u16  length    (ヘッダを含むフレーム長)
+ *   +4  u32  seq
+ *   +8  本体 (length - 8 バイト)
+ *
+ * 注意: ELSGW API 仕様書の値が確定するまで、各メッセージの番号と本体の
+ *       レイアウトは暫定値。変更は ELSGW_MSG_TABLE とアクセサのみで行う。
+ * ============================================================================
+ */
+
+#ifndef ELSGW_DECODER_H
+#define ELSGW_DECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "elsgw_receiver.h"
+
+/* ============================================================================
+ * フレームヘッダ
+ * ============================================================================ */
+#define ELSGW_VERSION           1
+#define ELSGW_HEADER_SIZE       8
+#define ELSGW_MSG_TYPES         256     /* msg_type は8bit */
+
+/* ============================================================================
+ * メッセージ種別の表
+ *   X(名前, 番号, 本体の最小長, 本体の最大長 (0 = 上限なし),
+ *     要素数の位置, 要素サイズ (可変長配列がない場合は 0, 0))
+ *   可変長配列を持つ種別は、最小長 + 要素数 x 要素サイズ <= 本体長 を検証する
+ * ============================================================================ */
+#define ELSGW_MSG_TABLE(X)                                  \
+    X(HEARTBEAT,     0x01,  4,  4, 0, 0)                    \
+    X(DEVICE_STATUS, 0x10,  8,  0, 0, 0)                    \
+    X(MEASUREMENT,   0x20,  4,  0, 2, 4)                    \
+    X(EVENT,         0x30, 12,  0, 0, 0)                    \
+    X(COMMAND_ACK,   0x40,  8,  8, 0, 0)
+
+enum {
+#define ELSGW_MSG_ENUM(name, id, min, max, count_off, elem) ELSGW_MSG_##name = id,
+    ELSGW_MSG_TABLE(ELSGW_MSG_ENUM)
+#undef ELSGW_MSG_ENUM
+};
+
+/* ============================================================================
+ * メッセージ種別の定義 (表から生成)
+ * ============================================================================ */
+typedef struct {
+    const char *name;                   /* NULL = 未定義の種別 */
+    uint16_t    min_len;                /* 本体の最小長 */
+    uint16_t    max_len;                /* 本体の最大長 (0 = 上限なし) */
+    uint16_t    count_off;              /* 要素数 (u16) の位置 */
+    uint16_t    elem_size;              /* 要素サイズ (0 = 可変長配列なし) */
+} elsgw_layout_t;
+
+extern const elsgw_layout_t elsgw_layouts[ELSGW_MSG_TYPES];
+
+/* ============================================================================
+ * 解析済みメッセージ (受信バッファを直接指す)
+ * ============================================================================ */
+typedef struct {
+    uint8_t              version;
+    uint8_t              type;
+    uint16_t             length;        /* フレーム長 (ヘッダ含む) */
+    uint32_t             seq;
+    const unsigned char *body;          /* 本体の先頭 */
+    size_t               body_len;      /* 本体長 (min_len 以上が保証される) */
+    const elsgw_layout_t *layout;
+    const rx_packet_t    *pkt;          /* 受信パケット (送信元・受信時刻) */
+} elsgw_msg_t;
+
+/* ハンドラ (ctx は登録時の値) */
+typedef void (*elsgw_handler_t)(const elsgw_msg_t *msg, void *ctx);
+
+/* ============================================================================
+ * デコーダ (処理スレッドのみが使用する)
+ * ============================================================================ */
+typedef struct {
+    elsgw_handler_t handlers[ELSGW_MSG_TYPES];
+    void           *ctx[ELSGW_MSG_TYPES];
+    unsigned long   type_count[ELSGW_MSG_TYPES];    /* 種別ごとの受信数 */
+    unsigned long   datagrams;          /* 解析したデータグラム数 */
+    unsigned long   frames;             /* 正常なフレーム数 */
+    unsigned long   unknown;            /* 未知の種別 */
+    unsigned long   bad_version;        /* バージョン不一致 */
+    unsigned long   malformed;          /* 長さ不正 (フレーム/本体) */
+} elsgw_decoder_t;
+
+/* ============================================================================
+ * ビッグエンディアン読み出し
+ * ============================================================================ */
+static inline uint16_t elsgw_be16(const unsigned char *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t elsgw_be32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint64_t elsgw_be64(const unsigned char *p) {
+    return ((uint64_t)elsgw_be32(p) << 32) | elsgw_be32(p + 4);
+}
+
+/* ============================================================================
+ * 本体のアクセサ (暫定レイアウト)
+ * ============================================================================ */
+/* HEARTBEAT: +0 u32 uptime_s */
+static inline uint32_t elsgw_heartbeat_uptime(const elsgw_msg_t *m) {
+    return elsgw_be32(m->body);
+}
+
+/* DEVICE_STATUS: +0 u16 device_id, +2 u8 status, +3 u8 flags, +4 i32 value,
+ *                +8 以降は任意のテキスト */
+static inline uint16_t elsgw_status_device_id(const elsgw_msg_t *m) {
+    return elsgw_be16(m->body);
+}
+static inline uint8_t elsgw_status_code(const elsgw_msg_t *m) {
+    return m->body[2];
+}
+static inline uint8_t elsgw_status_flags(const elsgw_msg_t *m) {
+    return m->body[3];
+}
+static inline int32_t elsgw_status_value(const elsgw_msg_t *m) {
+    return (int32_t)elsgw_be32(m->body + 4);
+}
+
+/* MEASUREMENT: +0 u16 channel, +2 u16 count, +4 i32 values[count] */
+static inline uint16_t elsgw_measurement_channel(const elsgw_msg_t *m) {
+    return elsgw_be16(m->body);
+}
+static inline uint16_t elsgw_measurement_count(const elsgw_msg_t *m) {
+    return elsgw_be16(m->body + 2);
+}
+static inline int32_t elsgw_measurement_value(const elsgw_msg_t *m, uint16_t i) {
+    return (int32_t)elsgw_be32(m->body + 4 + (size_t)i * 4);
+}
+
+/* EVENT: +0 u16 event_code, +2 u8 severity, +3 u8 reserved, +4 u64 time_ns */
+static inline uint16_t elsgw_event_code(const elsgw_msg_t *m) {
+    return elsgw_be16(m->body);
+}
+static inline uint8_t elsgw_event_severity(const elsgw_msg_t *m) {
+    return m->body[2];
+}
+static inline uint64_t elsgw_event_time_ns(const elsgw_msg_t *m) {
+    return elsgw_be64(m->body + 4);
+}
+
+/* COMMAND_ACK: +0 u32 command_id, +4 u16 result, +6 u16 reserved */
+static inline uint32_t elsgw_ack_command_id(const elsgw_msg_t *m) {
+    return elsgw_be32(m->body);
+}
+static inline uint16_t elsgw_ack_result(const elsgw_msg_t *m) {
+    return elsgw_be16(m->body + 4);
+}
+
+/* ============================================================================
+ * 関数: elsgw_decoder_init
+ * 機能: カウンタとハンドラ登録を初期化する
+ * ============================================================================ */
+void elsgw_decoder_init(elsgw_decoder_t *d);
+
+/* ============================================================================
+ * 関数: elsgw_decoder_register
+ * 機能: 種別番号にハンドラを登録する (NULL で解除)
+ * 戻り値: 0 = 成功, -1 = 表にない種別
+ * ============================================================================ */
+int elsgw_decoder_register(elsgw_decoder_t *d, uint8_t type,
+                           elsgw_handler_t handler, void *ctx);
+
+/* ============================================================================
+ * 関数: elsgw_decode
+ * 機能: データグラム内の全フレームを解析し、登録済みハンドラを呼び出す
+ * 戻り値: 正常に解析したフレーム数
+ * ============================================================================ */
+int elsgw_decode(elsgw_decoder_t *d, const rx_packet_t *pkt);
+
+/* ============================================================================
+ * 関数: elsgw_decoder_print
+ * 機能: 解析結果の集計を表示する
+ * ============================================================================ */
+void elsgw_decoder_print(const elsgw_decoder_t *d);
+
+#endif /* ELSGW_DECODER_H */
@@ -0,0 +1,131 @@
+/*
+ * ============================================================================
+ * elsgw_receiver.h - ELSGW Receiver Common Definitions
+ * ============================================================================
+ * ElsgwReceiver の受信バックエンド (UDPソケット / AF_PACKET / epoll 複数グループ)
+ * と処理スレッドが共有する設定値・型の定義
+ * ============================================================================
+ */
+
+#ifndef ELSGW_RECEIVER_H
+#define ELSGW_RECEIVER_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "spsc_ring.h"
+
+/* ============================================================================
+ * ネットワーク設定 (ABOS1上で、ELSGWからのマルチキャストUDP通信を待ち受け)
+ * ============================================================================ */
+#define ABOS1_IP            "192.168.100.1"     /* ABOS1のeth0 IP */
+#define ABOS1_IP_B          "192.168.200.1"     /* ABOS1のeth1 IP (A/B 調停の B 系統) */
+#define MULTICAST_GROUP     "239.64.0.3"        /* ELSGWのマルチキャストグループ */
+#define LISTEN_PORT         52000               /* ELSGWの連携ポート */
+#define CAPTURE_IFNAME      "eth0"              /* AF_PACKET受信時の既定インターフェース */
+
+/* ============================================================================
+ * 動作設定
+ * ============================================================================ */
+#define BUFFER_SIZE         1024    /* バッファサイズ */
+#define BATCH_DEFAULT       32      /* 既定のバッチ受信数 */
+#define BATCH_MAX           64      /* バッチ受信数の上限 */
+#define RING_SIZE           4096    /* 受信リングのスロット数 (2のべき乗) */
+#define RX_CPU              0       /* 受信スレッドを固定するCPU */
+#define WORKER_CPU          1       /* 処理スレッドを固定するCPU */
+#define WAIT_TIMEOUT_MS     200     /* 処理スレッドの最大待機時間 (ミリ秒) */
+#define MAX_RX_WORKERS      8       /* epoll 受信スレッドの最大数 */
+#define TRUE                1
+
+/* ============================================================================
+ * 受信スロット
+ *   recvmmsg() に渡すメッセージ領域兼リングの要素。起動時に RING_SIZE 個を
+ *   確保し、受信ループ内ではメモリ確保もデータのコピーも行わない。
+ *   AF_PACKET受信時は data を使わず、payload が mmap リング内を直接指す。
+ * ============================================================================ */
+typedef struct {
+    unsigned char      data[BUFFER_SIZE];   /* 受信データ */
+    struct sockaddr_in sender;              /* 送信元アドレス */
+    struct sockaddr_in dest;                /* 宛先 (グループ:ポート) */
+    struct iovec       iov;                 /* data を指す iovec */
+    char               control[CMSG_SPACE(sizeof(struct timespec)) +
+                               CMSG_SPACE(sizeof(uint32_t)) +
+                               CMSG_SPACE(sizeof(struct in_pktinfo))];
+                                            /* 補助データ (受信時刻, ドロップ数, 宛先) */
+    const unsigned char *payload;           /* UDPペイロードの先頭 */
+    size_t             len;                 /* 受信データ長 */
+    struct timespec    rx_time;             /* カーネル受信時刻 */
+    int                ifindex;             /* 受信インターフェース番号 (0 = 不明) */
+} rx_slot_t;
+
+/* ============================================================================
+ * 受信パケット情報
+ * ============================================================================ */
+typedef struct {
+    const unsigned char      *data;         /* 受信データ */
+    size_t                    len;          /* データ長 */
+    const struct sockaddr_in *sender;       /* 送信元アドレス */
+    const struct sockaddr_in *dest;         /* 宛先 (グループ:ポート) */
+    struct timespec           rx_time;      /* カーネル受信時刻 (CLOCK_REALTIME) */
+    int                       ifindex;      /* 受信インターフェース番号 (0 = 不明) */
+} rx_packet_t;
+
+/* ============================================================================
+ * 受信ソケット
+ * ============================================================================ */
+typedef struct {
+    int              fd;
+    in_port_t        port;                  /* bind したポート (ネットワークバイト順) */
+    uint32_t         kernel_drops;          /* SO_RXQ_OVFL の最終値 (累計) */
+} rx_socket_t;
+
+/* ============================================================================
+ * 受信コンテキスト
+ *   受信スレッドと処理スレッドが共有する状態。カウンタは書き込み側スレッドが
+ *   1つに限られるため、ロックを用いず atomic で参照する。
+ * ============================================================================ */
+typedef struct {
+    rx_socket_t      sock;                  /* マルチキャスト受信ソケット (UDPモード) */
+    int              batch_size;            /* 1回の受信数上限 */
+    spsc_ring_t      ring;                  /* 受信→処理リング */
+    rx_slot_t       *slots;                 /* リングのスロット (RING_SIZE個) */
+    struct mmsghdr  *msgs;                  /* スロットに対応する msghdr */
+    rx_slot_t       *drop_slots;            /* リング満杯時の読み捨て用 */
+    struct mmsghdr  *drop_msgs;
+    _Atomic unsigned long rx_packets;       /* 受信数 (受信スレッドが更新) */
+    _Atomic unsigned long ring_drops;       /* リング満杯による破棄数 */
+    _Atomic unsigned long kernel_drops;     /* カーネル (ソケット/AF_PACKET) での破棄数 */
+    _Atomic unsigned long processed;        /* 処理数 (処理スレッドが更新) */
+} receiver_t;
+
+/* ============================================================================
+ * 処理スレッドが読む受信コンテキストの集合
+ *   UDP/AF_PACKET では1個、epoll バックエンドでは受信スレッドごとに1個。
+ *   複数の場合、処理スレッドは doorbell で待機する。
+ * ============================================================================ */
+typedef struct {
+    receiver_t      *rx;
+    int              count;
+    spsc_doorbell_t *doorbell;              /* count が1の場合は NULL */
+} receiver_set_t;
+
+/* 終了要求フラグ (SIGINT/SIGTERM で 0 になる) */
+extern volatile sig_atomic_t g_running;
+
+/* ============================================================================
+ * 受信バックエンド共通の関数 (ElsgwReceiver.c)
+ * ============================================================================ */
+/* msghdr を各スロットのバッファへ向ける */
+void init_msgs(rx_slot_t *slots, struct mmsghdr *msgs, int count);
+
+/* 指定スロットへ recvmmsg() で一括受信する (flags: MSG_WAITFORONE 等)
+ * 戻り値: 受信数 (エラー時は -1) */
+int receive_batch(receiver_t *rx, rx_socket_t *sock, int flags,
+                  rx_slot_t *slots, struct mmsghdr *msgs, int count);
+
+#endif /* ELSGW_RECEIVER_H */
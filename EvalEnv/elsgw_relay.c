@@ -0,0 +1,555 @@
+/*
+ * ============================================================================
+ * elsgw_relay.c - ELSGW Multicast-to-TCP Fan-out Relay
+ * ============================================================================
+ * 中継スレッドのループ:
+ *   1. 各購読者について、リング満杯なら切断し、溜まった分を writev() で送る
+ *      (送信中に処理スレッドが書き足した分は次の周回でまとめて送る)
+ *   2. 未送信がなければ待機を宣言して epoll_wait() で待つ。処理スレッドは
+ *      待機中の場合のみ eventfd へ書き込む (高レート時はシステムコールなし)
+ *   3. 受け入れ・ソケットの書き込み可能・購読者の切断を処理し、
+ *      送信が RELAY_STALL_MS 以上進まない購読者を切断する
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "elsgw_receiver.h"
+#include "elsgw_relay.h"
+
+#define RELAY_MAX_EVENTS    (RELAY_MAX_SUBSCRIBERS + 2)
+#define RELAY_LISTEN_KEY    UINT32_MAX          /* epoll のキー (購読者は枠番号) */
+#define RELAY_EVENT_KEY     (UINT32_MAX - 1)
+
+/* ============================================================================
+ * 関数: now_ms
+ * 機能: 単調増加時刻をミリ秒で取得する
+ * ============================================================================ */
+static long long now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* ============================================================================
+ * 関数: elsgw_relay_open
+ * 機能: 購読者の待ち受けソケットと epoll を準備する
+ * ============================================================================ */
+int elsgw_relay_open(elsgw_relay_t *r, int port, size_t ring_size) {
+    struct sockaddr_in addr;
+    struct epoll_event ev;
+    int opt = 1;
+
+    memset(r, 0, sizeof(*r));
+    r->listen_fd = r->epfd = r->event_fd = -1;
+    for (int i = 0; i < RELAY_MAX_SUBSCRIBERS; i++) {
+        r->subs[i].fd = -1;
+    }
+    if (ring_size < RELAY_HEADER_LEN + RELAY_DATAGRAM_MAX ||
+        (ring_size & (ring_size - 1)) != 0) {
+        fprintf(stderr, "[ERROR] Relay ring size must be a power of two >= %d bytes\n",
+                RELAY_HEADER_LEN + RELAY_DATAGRAM_MAX);
+        return -1;
+    }
+    r->ring_size = ring_size;
+    r->mask = ring_size - 1;
+
+    r->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (r->listen_fd < 0) {
+        perror("[ERROR] Failed to create relay socket");
+        return -1;
+    }
+    setsockopt(r->listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, RELAY_IP, &addr.sin_addr) != 1 ||
+        bind(r->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(r->listen_fd, RELAY_MAX_SUBSCRIBERS) < 0) {
+        perror("[ERROR] Failed to listen for relay subscribers");
+        return -1;
+    }
+
+    r->epfd = epoll_create1(EPOLL_CLOEXEC);
+    r->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (r->epfd < 0 || r->event_fd < 0) {
+        perror("[ERROR] Failed to create relay epoll/eventfd");
+        return -1;
+    }
+    ev.events = EPOLLIN;
+    ev.data.u32 = RELAY_LISTEN_KEY;
+    epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->listen_fd, &ev);
+    ev.data.u32 = RELAY_EVENT_KEY;
+    epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->event_fd, &ev);
+
+    printf("[INFO] Relay listening on %s:%d (ring %zu KB per subscriber)\n",
+           RELAY_IP, port, ring_size / 1024);
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: ring_copy
+ * 機能: リングの位置 pos から len バイトを書き込む (末尾で折り返す)
+ * ============================================================================ */
+static void ring_copy(const elsgw_relay_t *r, relay_sub_t *s, uint64_t pos,
+                      const void *src, size_t len) {
+    size_t off = (size_t)pos & r->mask;
+    size_t first = r->ring_size - off;
+
+    if (first >= len) {
+        memcpy(s->data + off, src, len);
+    } else {
+        memcpy(s->data + off, src, first);
+        memcpy(s->data, (const unsigned char *)src + first, len - first);
+    }
+}
+
+/* ============================================================================
+ * 関数: elsgw_relay_publish
+ * 機能: データグラム1個を全購読者のリングへ書き込む (処理スレッドから呼ぶ)
+ *   epoch を奇数にしている間のみ購読者の枠へ触れる。中継スレッドは枠を
+ *   RETIRING にした後、epoch が偶数になるのを待ってから枠を回収する。
+ * ============================================================================ */
+void elsgw_relay_publish(elsgw_relay_t *r, const unsigned char *data, size_t len) {
+    unsigned char hdr[RELAY_HEADER_LEN];
+    size_t need = RELAY_HEADER_LEN + len;
+    int limit = atomic_load_explicit(&r->sub_limit, memory_order_acquire);
+    int notify = 0;
+
+    if (len > RELAY_DATAGRAM_MAX || limit == 0) {
+        return;
+    }
+    hdr[0] = (unsigned char)(len >> 8);
+    hdr[1] = (unsigned char)len;
+
+    atomic_fetch_add_explicit(&r->epoch, 1, memory_order_seq_cst);
+    for (int i = 0; i < limit; i++) {
+        relay_sub_t *s = &r->subs[i];
+        uint64_t head;
+
+        if (atomic_load_explicit(&s->state, memory_order_seq_cst) != RELAY_ACTIVE ||
+            atomic_load_explicit(&s->overflow, memory_order_relaxed)) {
+            continue;
+        }
+        head = atomic_load_explicit(&s->head, memory_order_relaxed);
+        if (r->ring_size - (head - s->cached_tail) < need) {
+            s->cached_tail = atomic_load_explicit(&s->tail, memory_order_acquire);
+            if (r->ring_size - (head - s->cached_tail) < need) {
+                /* 遅い購読者: 以降は書き込まず、中継スレッドが切断する */
+                atomic_store_explicit(&s->overflow, 1, memory_order_relaxed);
+                notify = 1;
+                continue;
+            }
+        }
+        ring_copy(r, s, head, hdr, RELAY_HEADER_LEN);
+        ring_copy(r, s, head + RELAY_HEADER_LEN, data, len);
+        atomic_store_explicit(&s->head, head + need, memory_order_release);
+        atomic_store_explicit(&s->datagrams, s->datagrams + 1, memory_order_relaxed);
+        notify = 1;
+    }
+    atomic_fetch_add_explicit(&r->epoch, 1, memory_order_seq_cst);
+    atomic_store_explicit(&r->published, r->published + 1, memory_order_relaxed);
+
+    /* 中継スレッドが待機中の場合のみ起こす (head の公開と waiting の確認の順序を保証) */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (notify && atomic_load_explicit(&r->waiting, memory_order_seq_cst)) {
+        uint64_t one = 1;
+
+        atomic_store_explicit(&r->waiting, 0, memory_order_relaxed);
+        if (write(r->event_fd, &one, sizeof(one)) < 0) {
+            /* カウンタが満杯でも起床はする */
+        }
+    }
+}
+
+/* ============================================================================
+ * 関数: watch_output
+ * 機能: 購読者ソケットの書き込み可能の監視を切り替える
+ * ============================================================================ */
+static void watch_output(elsgw_relay_t *r, int index, int on) {
+    relay_sub_t *s = &r->subs[index];
+    struct epoll_event ev;
+
+    ev.events = EPOLLIN | EPOLLRDHUP | (on ? EPOLLOUT : 0);
+    ev.data.u32 = (uint32_t)index;
+    epoll_ctl(r->epfd, EPOLL_CTL_MOD, s->fd, &ev);
+    s->blocked = on;
+}
+
+/* ============================================================================
+ * 関数: retire_subscriber
+ * 機能: 購読者を切断して枠を空きに戻す
+ *   枠を RETIRING にした時点で publish 中でなければ、以降の publish は
+ *   この枠に書き込まない。publish 中 (epoch が奇数) なら終わるまで待つ。
+ * ============================================================================ */
+static void retire_subscriber(elsgw_relay_t *r, int index, const char *reason) {
+    relay_sub_t *s = &r->subs[index];
+    char ip[INET_ADDRSTRLEN];
+    uint32_t epoch;
+
+    atomic_store_explicit(&s->state, RELAY_RETIRING, memory_order_seq_cst);
+    epoch = atomic_load_explicit(&r->epoch, memory_order_seq_cst);
+    if (epoch & 1) {
+        while (atomic_load_explicit(&r->epoch, memory_order_acquire) == epoch) {
+            sched_yield();
+        }
+    }
+
+    inet_ntop(AF_INET, &s->addr.sin_addr, ip, sizeof(ip));
+    printf("[INFO] Relay subscriber %s:%d %s: %lu datagrams, %lu bytes in %lu writes, "
+           "%llu bytes unsent\n", ip, ntohs(s->addr.sin_port), reason,
+           atomic_load(&s->datagrams), s->bytes_sent, s->writes,
+           (unsigned long long)(atomic_load(&s->head) - atomic_load(&s->tail)));
+    close(s->fd);                       /* epoll からも外れる */
+    s->fd = -1;
+    atomic_store_explicit(&s->state, RELAY_FREE, memory_order_release);
+}
+
+/* ============================================================================
+ * 関数: accept_subscribers
+ * 機能: 接続してきた購読者を空いている枠へ割り当てる
+ * ============================================================================ */
+static void accept_subscribers(elsgw_relay_t *r) {
+    struct sockaddr_in addr;
+    socklen_t addr_len;
+    struct epoll_event ev;
+    char ip[INET_ADDRSTRLEN];
+    relay_sub_t *s;
+    int opt = 1;
+    int fd, index;
+
+    for (;;) {
+        addr_len = sizeof(addr);
+        fd = accept4(r->listen_fd, (struct sockaddr *)&addr, &addr_len,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("[WARN] Relay accept failed");
+            }
+            return;
+        }
+        inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+
+        for (index = 0; index < RELAY_MAX_SUBSCRIBERS; index++) {
+            if (atomic_load_explicit(&r->subs[index].state, memory_order_relaxed) == RELAY_FREE) {
+                break;
+            }
+        }
+        if (index == RELAY_MAX_SUBSCRIBERS) {
+            fprintf(stderr, "[WARN] Relay subscriber %s:%d rejected (max %d)\n",
+                    ip, ntohs(addr.sin_port), RELAY_MAX_SUBSCRIBERS);
+            r->rejected++;
+            close(fd);
+            continue;
+        }
+
+        s = &r->subs[index];
+
+        /* リングは初回のみ確保し、枠の再利用時はそのまま使う */
+        if (s->data == NULL) {
+            s->data = malloc(r->ring_size);
+            if (s->data == NULL) {
+                perror("[WARN] Failed to allocate relay ring");
+                close(fd);
+                continue;
+            }
+        }
+        /* 送信は中継スレッドでまとめて行うため Nagle は不要 */
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        s->fd = fd;
+        s->addr = addr;
+        s->blocked = 0;
+        s->stalled_since = 0;
+        s->bytes_sent = 0;
+        s->writes = 0;
+        s->cached_tail = 0;
+        atomic_store_explicit(&s->head, 0, memory_order_relaxed);
+        atomic_store_explicit(&s->tail, 0, memory_order_relaxed);
+        atomic_store_explicit(&s->overflow, 0, memory_order_relaxed);
+        atomic_store_explicit(&s->datagrams, 0, memory_order_relaxed);
+
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.u32 = (uint32_t)index;
+        epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev);
+
+        /* 枠の初期化を済ませてから処理スレッドへ公開する */
+        atomic_store_explicit(&s->state, RELAY_ACTIVE, memory_order_release);
+        if (index + 1 > atomic_load_explicit(&r->sub_limit, memory_order_relaxed)) {
+            atomic_store_explicit(&r->sub_limit, index + 1, memory_order_release);
+        }
+        r->accepted++;
+        printf("[INFO] Relay subscriber %s:%d connected\n", ip, ntohs(addr.sin_port));
+    }
+}
+
+/* ============================================================================
+ * 関数: send_pending
+ * 機能: リングに溜まった分を writev() 1回で送る
+ * 戻り値: 0 = 成功 (未送信が残る場合は書き込み可能を待つ), -1 = 切断された
+ * ============================================================================ */
+static int send_pending(elsgw_relay_t *r, int index, long long now) {
+    relay_sub_t *s = &r->subs[index];
+    uint64_t tail = atomic_load_explicit(&s->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&s->head, memory_order_acquire);
+    size_t pending = (size_t)(head - tail);
+    size_t off = (size_t)tail & r->mask;
+    size_t first = r->ring_size - off;
+    struct iovec iov[2];
+    int iov_count = 1;
+    ssize_t n;
+
+    if (pending == 0) {
+        return 0;
+    }
+    iov[0].iov_base = s->data + off;
+    iov[0].iov_len = pending < first ? pending : first;
+    if (pending > first) {
+        iov[1].iov_base = s->data;
+        iov[1].iov_len = pending - first;
+        iov_count = 2;
+    }
+
+    n = writev(s->fd, iov, iov_count);
+    if (n < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return -1;
+        }
+        n = 0;
+    }
+    atomic_store_explicit(&s->tail, tail + (uint64_t)n, memory_order_release);
+    s->bytes_sent += (unsigned long)n;
+    if (n > 0) {
+        s->writes++;
+    }
+
+    if ((size_t)n < pending) {
+        /* ソケットが満杯: 書き込み可能になるまで送らない */
+        if (!s->blocked) {
+            watch_output(r, index, 1);
+        }
+        if (n > 0 || s->stalled_since == 0) {
+            s->stalled_since = now;
+        }
+    } else {
+        s->stalled_since = 0;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: has_pending
+ * 機能: 送るべきデータ・切断すべき購読者があるか (待機前の再確認)
+ * ============================================================================ */
+static int has_pending(elsgw_relay_t *r) {
+    int limit = atomic_load_explicit(&r->sub_limit, memory_order_relaxed);
+
+    for (int i = 0; i < limit; i++) {
+        relay_sub_t *s = &r->subs[i];
+
+        if (atomic_load_explicit(&s->state, memory_order_relaxed) != RELAY_ACTIVE) {
+            continue;
+        }
+        if (atomic_load_explicit(&s->overflow, memory_order_seq_cst) ||
+            (!s->blocked && atomic_load_explicit(&s->head, memory_order_seq_cst) !=
+                            atomic_load_explicit(&s->tail, memory_order_relaxed))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: handle_subscriber_event
+ * 機能: 購読者ソケットのイベント (書き込み可能・受信・切断) を処理する
+ *   購読者からのデータは使わないため読み捨て、切断の検出のみに使う
+ * ============================================================================ */
+static void handle_subscriber_event(elsgw_relay_t *r, int index, uint32_t events) {
+    relay_sub_t *s = &r->subs[index];
+    char buf[256];
+    ssize_t n;
+
+    if (atomic_load_explicit(&s->state, memory_order_relaxed) != RELAY_ACTIVE) {
+        return;
+    }
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        do {
+            n = recv(s->fd, buf, sizeof(buf), 0);
+        } while (n > 0);
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            retire_subscriber(r, index, "disconnected");
+            r->closed++;
+            return;
+        }
+    }
+    if ((events & EPOLLOUT) && s->blocked) {
+        watch_output(r, index, 0);
+    }
+}
+
+/* ============================================================================
+ * 関数: relay_thread
+ * 機能: 中継スレッド本体 (ループの流れはファイル先頭を参照)
+ * ============================================================================ */
+static void *relay_thread(void *arg) {
+    elsgw_relay_t *r = (elsgw_relay_t *)arg;
+    struct epoll_event events[RELAY_MAX_EVENTS];
+    uint64_t value;
+    long long now;
+    int timeout, limit, n;
+
+    while (g_running) {
+        /* 遅い購読者の切断と、溜まった分の送信 */
+        now = now_ms();
+        limit = atomic_load_explicit(&r->sub_limit, memory_order_relaxed);
+        for (int i = 0; i < limit; i++) {
+            relay_sub_t *s = &r->subs[i];
+
+            if (atomic_load_explicit(&s->state, memory_order_relaxed) != RELAY_ACTIVE) {
+                continue;
+            }
+            if (atomic_load_explicit(&s->overflow, memory_order_relaxed)) {
+                retire_subscriber(r, i, "dropped (slow consumer, ring full)");
+                r->slow_drops++;
+            } else if (s->blocked) {
+                if (now - s->stalled_since >= RELAY_STALL_MS) {
+                    retire_subscriber(r, i, "dropped (slow consumer, send stalled)");
+                    r->slow_drops++;
+                }
+            } else if (send_pending(r, i, now) < 0) {
+                retire_subscriber(r, i, "disconnected");
+                r->closed++;
+            }
+        }
+
+        /* 待機を宣言した後に再確認し、取りこぼしを防ぐ */
+        atomic_store_explicit(&r->waiting, 1, memory_order_seq_cst);
+        timeout = has_pending(r) ? 0 : WAIT_TIMEOUT_MS;
+        if (timeout == 0) {
+            atomic_store_explicit(&r->waiting, 0, memory_order_relaxed);
+        }
+        n = epoll_wait(r->epfd, events, RELAY_MAX_EVENTS, timeout);
+        atomic_store_explicit(&r->waiting, 0, memory_order_relaxed);
+        if (n < 0) {
+            if (errno != EINTR) {
+                perror("[ERROR] Relay epoll_wait failed");
+            }
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            uint32_t key = events[i].data.u32;
+
+            if (key == RELAY_LISTEN_KEY) {
+                accept_subscribers(r);
+            } else if (key == RELAY_EVENT_KEY) {
+                if (read(r->event_fd, &value, sizeof(value)) < 0) {
+                    /* 起床のみが目的のため値は使わない */
+                }
+            } else {
+                handle_subscriber_event(r, (int)key, events[i].events);
+            }
+        }
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * 関数: elsgw_relay_start
+ * 機能: 中継スレッドを起動する
+ * ============================================================================ */
+int elsgw_relay_start(elsgw_relay_t *r) {
+    int err = pthread_create(&r->thread, NULL, relay_thread, r);
+
+    if (err != 0) {
+        fprintf(stderr, "[ERROR] Failed to start relay thread: %s\n", strerror(err));
+        return -1;
+    }
+    r->started = 1;
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: elsgw_relay_join
+ * 機能: 中継スレッドの終了を待つ
+ * ============================================================================ */
+void elsgw_relay_join(elsgw_relay_t *r) {
+    if (r->started) {
+        pthread_join(r->thread, NULL);
+        r->started = 0;
+    }
+}
+
+/* ============================================================================
+ * 関数: elsgw_relay_close
+ * 機能: 購読者と待ち受けを閉じてリングを解放する (処理スレッドの終了後に呼ぶ)
+ * ============================================================================ */
+void elsgw_relay_close(elsgw_relay_t *r) {
+    for (int i = 0; i < RELAY_MAX_SUBSCRIBERS; i++) {
+        relay_sub_t *s = &r->subs[i];
+
+        if (s->fd >= 0) {
+            close(s->fd);
+            s->fd = -1;
+        }
+        free(s->data);
+        s->data = NULL;
+        atomic_store(&s->state, RELAY_FREE);
+    }
+    atomic_store(&r->sub_limit, 0);
+    if (r->listen_fd >= 0) {
+        close(r->listen_fd);
+        r->listen_fd = -1;
+    }
+    if (r->event_fd >= 0) {
+        close(r->event_fd);
+        r->event_fd = -1;
+    }
+    if (r->epfd >= 0) {
+        close(r->epfd);
+        r->epfd = -1;
+    }
+}
+
+/* ============================================================================
+ * 関数: elsgw_relay_print
+ * 機能: 中継の集計を表示する
+ * ============================================================================ */
+void elsgw_relay_print(const elsgw_relay_t *r) {
+    unsigned long sent = 0, writes = 0;
+    int active = 0;
+
+    for (int i = 0; i < RELAY_MAX_SUBSCRIBERS; i++) {
+        const relay_sub_t *s = &r->subs[i];
+
+        if (atomic_load(&s->state) == RELAY_ACTIVE) {
+            active++;
+            sent += s->bytes_sent;
+            writes += s->writes;
+        }
+    }
+    printf("[INFO] Relay: %lu datagrams published, %lu subscribers accepted "
+           "(%d connected, %lu slow dropped, %lu disconnected, %lu rejected)\n",
+           atomic_load(&r->published), r->accepted, active, r->slow_drops,
+           r->closed, r->rejected);
+    if (writes > 0) {
+        printf("[INFO] Relay (connected): %lu bytes in %lu writes (%.1f bytes/write)\n",
+               sent, writes, (double)sent / writes);
+    }
+}
@@ -0,0 +1,139 @@
+/*
+ * ============================================================================
+ * elsgw_relay.h - ELSGW Multicast-to-TCP Fan-out Relay
+ * ============================================================================
+ * 機能:
+ *   - 受信した ELSGW データグラムを、TCP で接続してきた任意の数の購読者
+ *     (マルチキャストの届かない 192.168.200.x 側のノード) へ中継する
+ *   - 購読者ごとに固定サイズのリングを持ち、処理スレッドはデータグラムを
+ *     各リングへ写すのみ (システムコールなし、待たない)
+ *   - 中継スレッドがリングに溜まった分 (複数データグラム) を writev() 1回で
+ *     まとめて送る。リングの折り返しは iovec 2個で表し、コピーはしない
+ *   - 遅い購読者は待たずに切断する (フィードは止めない)
+ *       リング満杯     : 書き込めなかった時点で切断
+ *       送信の停滞     : ソケットが RELAY_STALL_MS 以上書き込めない場合に切断
+ *   - メモリ使用量は 購読者数 x リングサイズ で上限が決まる
+ *
+ * 送信形式 (TCP ストリーム, データグラムごと):
+ *   [長さ 2バイト (ビッグエンディアン)] [データグラム本体]
+ *   購読者は接続した時点以降のデータグラムを、受信順に区切りを保って受け取る
+ *
+ * スレッド:
+ *   elsgw_relay_publish() は1つのスレッド (処理スレッド) からのみ呼ぶ。
+ *   購読者の受け入れ・送信・切断は中継スレッドが行い、購読者の枠の
+ *   受け渡しは状態 (state) と publish 中を示す epoch で同期する。
+ * ============================================================================
+ */
+
+#ifndef ELSGW_RELAY_H
+#define ELSGW_RELAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <netinet/in.h>
+
+#include "spsc_ring.h"
+
+/* ============================================================================
+ * 中継設定 (ABOS1 の 192.168.200.x 側で購読者を待ち受け)
+ * ============================================================================ */
+#define RELAY_IP                "192.168.200.1"     /* 待ち受けアドレス */
+#define RELAY_PORT_DEFAULT      52100               /* 待ち受けポート */
+#define RELAY_MAX_SUBSCRIBERS   32                  /* 同時購読者数の上限 */
+#define RELAY_RING_DEFAULT      (1024 * 1024)       /* 購読者ごとのリング (バイト, 2のべき乗) */
+#define RELAY_STALL_MS          2000                /* 送信が進まない場合に切断するまで */
+#define RELAY_HEADER_LEN        2                   /* データグラムごとの長さヘッダ */
+#define RELAY_DATAGRAM_MAX      65535               /* 長さヘッダで表せる上限 */
+
+/* ============================================================================
+ * 購読者の枠の状態
+ *   FREE     : 中継スレッドが所有 (未使用)
+ *   ACTIVE   : 処理スレッドがリングへ書き込む
+ *   RETIRING : 中継スレッドが切断中 (処理スレッドは書き込まない)
+ * ============================================================================ */
+enum {
+    RELAY_FREE,
+    RELAY_ACTIVE,
+    RELAY_RETIRING,
+};
+
+/* ============================================================================
+ * 購読者
+ *   head: 処理スレッドが次に書き込む位置 (処理スレッドのみ更新)
+ *   tail: 中継スレッドが次に送る位置 (中継スレッドのみ更新)
+ *   位置は通算のバイト数 (リング内の位置は & (ring_size - 1))
+ * ============================================================================ */
+typedef struct {
+    _Alignas(SPSC_CACHE_LINE) _Atomic uint32_t state;
+    _Atomic uint32_t overflow;              /* 1 = リング満杯で書き込めなかった */
+    _Atomic unsigned long datagrams;        /* リングへ書き込んだデータグラム数 */
+    _Alignas(SPSC_CACHE_LINE) _Atomic uint64_t head;
+    uint64_t         cached_tail;           /* 処理スレッド側の tail キャッシュ */
+    _Alignas(SPSC_CACHE_LINE) _Atomic uint64_t tail;
+    unsigned char   *data;                  /* リング (ring_size バイト) */
+    int              fd;
+    struct sockaddr_in addr;                /* 購読者のアドレス */
+    int              blocked;               /* 1 = ソケットが満杯 (EPOLLOUT 待ち) */
+    long long        stalled_since;         /* 満杯になった時刻 (ms, 0 = 停滞なし) */
+    unsigned long    bytes_sent;
+    unsigned long    writes;                /* writev() の回数 */
+} relay_sub_t;
+
+/* ============================================================================
+ * 中継全体
+ * ============================================================================ */
+typedef struct {
+    int              listen_fd;
+    int              epfd;
+    int              event_fd;              /* 処理スレッドからの起床通知 */
+    size_t           ring_size;
+    size_t           mask;
+    relay_sub_t      subs[RELAY_MAX_SUBSCRIBERS];
+    _Atomic int      sub_limit;             /* 使用したことのある枠の数 (走査範囲) */
+    _Alignas(SPSC_CACHE_LINE) _Atomic uint32_t epoch;
+                                            /* publish 中は奇数 (処理スレッドが更新) */
+    _Atomic uint32_t waiting;               /* 中継スレッドが epoll_wait で待機中 */
+    _Atomic unsigned long published;        /* 中継対象のデータグラム数 */
+    unsigned long    accepted;              /* 受け入れた購読者数 */
+    unsigned long    rejected;              /* 枠不足で断った購読者数 */
+    unsigned long    slow_drops;            /* 遅い購読者として切断した数 */
+    unsigned long    closed;                /* 購読者側から切断された数 */
+    pthread_t        thread;
+    int              started;
+} elsgw_relay_t;
+
+/* ============================================================================
+ * 関数: elsgw_relay_open
+ * 機能: 購読者の待ち受けソケットと epoll を準備する
+ * 引数:
+ *   port      - 待ち受けポート (RELAY_IP 上)
+ *   ring_size - 購読者ごとのリングサイズ (バイト, 2のべき乗)
+ * 戻り値: 0 = 成功, -1 = 失敗
+ * ============================================================================ */
+int elsgw_relay_open(elsgw_relay_t *r, int port, size_t ring_size);
+
+/* ============================================================================
+ * 関数: elsgw_relay_start
+ * 機能: 中継スレッドを起動する (終了シグナルは呼び出し側で遮断してから呼ぶこと)
+ * 戻り値: 0 = 成功, -1 = 失敗
+ * ============================================================================ */
+int elsgw_relay_start(elsgw_relay_t *r);
+
+/* ============================================================================
+ * 関数: elsgw_relay_publish
+ * 機能: データグラム1個を全購読者のリングへ書き込む (処理スレッドから呼ぶ)
+ *   リングが満杯の購読者には書き込まず、中継スレッドが切断する
+ * ============================================================================ */
+void elsgw_relay_publish(elsgw_relay_t *r, const unsigned char *data, size_t len);
+
+/* ============================================================================
+ * 関数: elsgw_relay_join / elsgw_relay_close / elsgw_relay_print
+ * 機能: 中継スレッドの終了を待つ / 購読者と待ち受けを閉じる / 集計を表示する
+ * ============================================================================ */
+void elsgw_relay_join(elsgw_relay_t *r);
+void elsgw_relay_close(elsgw_relay_t *r);
+void elsgw_relay_print(const elsgw_relay_t *r);
+
+#endif /* ELSGW_RELAY_H */
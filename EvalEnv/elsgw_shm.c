@@ -0,0 +1,159 @@
+/*
+ * ============================================================================
+ * elsgw_shm.c - ELSGW Shared-Memory Publication Ring (書き込み側)
+ * ============================================================================
+ * 公開の手順 (処理スレッドのみが呼ぶ, システムコールなし):
+ *   1. スロットの seq を 2n-1 (書き込み中) にする
+ *   2. メタデータとデータグラムを書き込む
+ *   3. seq を 2n にし、head を n に進める
+ *   4. 待機を宣言した読み出し側がいる場合のみ、宣言を取り消し、
+ *      wake を進めて全員を起床させる
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#include "elsgw_decoder.h"
+#include "elsgw_shm.h"
+
+/* ============================================================================
+ * 関数: shm_now_ns
+ * 機能: 現在時刻をナノ秒で取得する (受信時刻と比べるため CLOCK_REALTIME)
+ * ============================================================================ */
+static int64_t shm_now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* ============================================================================
+ * 関数: elsgw_shm_create
+ * 機能: 共有メモリを作成する (同じ名前の古いファイルは置き換える)
+ * ============================================================================ */
+int elsgw_shm_create(elsgw_shm_writer_t *w, const char *name) {
+    elsgw_shm_header_t *h;
+    int fd;
+
+    memset(w, 0, sizeof(*w));
+    if (elsgw_shm_path(w->path, sizeof(w->path), name) < 0) {
+        fprintf(stderr, "[ERROR] Invalid feed name: %s\n", name);
+        return -1;
+    }
+    w->map_size = sizeof(elsgw_shm_header_t) +
+                  (size_t)ELSGW_SHM_SLOTS * sizeof(elsgw_shm_slot_t);
+
+    unlink(w->path);                    /* 前回の実行で残ったファイル */
+    fd = open(w->path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0 || ftruncate(fd, w->map_size) < 0) {
+        perror("[ERROR] Failed to create shared-memory feed");
+        if (fd >= 0) {
+            close(fd);
+            unlink(w->path);
+        }
+        return -1;
+    }
+    h = mmap(NULL, w->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (h == MAP_FAILED) {
+        perror("[ERROR] Failed to map shared-memory feed");
+        unlink(w->path);
+        return -1;
+    }
+
+    /* ftruncate した領域は 0 で埋まっている (全スロット seq = 0, head = 0) */
+    w->hdr = h;
+    w->slots = (elsgw_shm_slot_t *)(h + 1);
+    w->mask = ELSGW_SHM_SLOTS - 1;
+    h->version = ELSGW_SHM_VERSION;
+    h->slot_count = ELSGW_SHM_SLOTS;
+    h->slot_size = sizeof(elsgw_shm_slot_t);
+    h->pid = getpid();
+    h->created_ns = shm_now_ns();
+    __atomic_store_n(&h->magic, ELSGW_SHM_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: elsgw_shm_publish
+ * 機能: データグラム1個を公開し、待機中の読み出し側がいれば起床させる
+ * ============================================================================ */
+void elsgw_shm_publish(elsgw_shm_writer_t *w, const unsigned char *data, size_t len,
+                       const struct sockaddr_in *sender, const struct sockaddr_in *dest,
+                       const struct timespec *rx_time) {
+    elsgw_shm_header_t *h = w->hdr;
+    uint64_t n = w->head + 1;
+    elsgw_shm_slot_t *s = &w->slots[n & w->mask];
+    size_t stored = len;
+
+    if (stored > ELSGW_SHM_DATA_MAX) {
+        stored = ELSGW_SHM_DATA_MAX;
+        w->truncated++;
+    }
+
+    atomic_store_explicit(&s->seq, 2 * n - 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    s->rx_time_ns = (int64_t)rx_time->tv_sec * 1000000000LL + rx_time->tv_nsec;
+    s->src_addr = sender->sin_addr.s_addr;
+    s->src_port = sender->sin_port;
+    s->dst_addr = dest->sin_addr.s_addr;
+    s->dst_port = dest->sin_port;
+    s->len = stored;
+    s->orig_len = len;
+    s->msg_valid = 0;
+    if (len >= ELSGW_HEADER_SIZE && data[0] == ELSGW_VERSION) {
+        s->msg_type = data[1];
+        s->msg_seq = elsgw_be32(data + 4);
+        s->msg_valid = 1;
+    }
+    memcpy(s->data, data, stored);
+    s->pub_time_ns = shm_now_ns();
+
+    atomic_store_explicit(&s->seq, 2 * n, memory_order_release);
+    atomic_store_explicit(&h->head, n, memory_order_seq_cst);
+    w->head = n;
+
+    /* 読み出し側は待機を宣言してから head を確認する (seq_cst で順序を保つ) */
+    if (atomic_load_explicit(&h->armed, memory_order_seq_cst) &&
+        atomic_exchange_explicit(&h->armed, 0, memory_order_seq_cst)) {
+        atomic_fetch_add_explicit(&h->wake, 1, memory_order_seq_cst);
+        syscall(SYS_futex, &h->wake, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+        w->wakeups++;
+    }
+}
+
+/* ============================================================================
+ * 関数: elsgw_shm_close
+ * 機能: 終了を通知して待機中の読み出し側を起こし、共有メモリを削除する
+ *   (読み出し側の割り当て済みの領域は閉じるまで有効)
+ * ============================================================================ */
+void elsgw_shm_close(elsgw_shm_writer_t *w) {
+    if (w->hdr == NULL) {
+        return;
+    }
+    atomic_store_explicit(&w->hdr->closed, 1, memory_order_seq_cst);
+    atomic_fetch_add_explicit(&w->hdr->wake, 1, memory_order_release);
+    syscall(SYS_futex, &w->hdr->wake, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    munmap(w->hdr, w->map_size);
+    unlink(w->path);
+    w->hdr = NULL;
+}
+
+/* ============================================================================
+ * 関数: elsgw_shm_print
+ * 機能: 共有メモリへの公開の集計を表示する
+ * ============================================================================ */
+void elsgw_shm_print(const elsgw_shm_writer_t *w) {
+    printf("[INFO] Shared memory: %lu datagrams published to %s "
+           "(%d slots, %lu reader wakeups, %lu truncated)\n",
+           (unsigned long)w->head, w->path, ELSGW_SHM_SLOTS, w->wakeups, w->truncated);
+}
@@ -0,0 +1,325 @@
+/*
+ * ============================================================================
+ * elsgw_shm.h - ELSGW Shared-Memory Publication Ring
+ * ============================================================================
+ * 機能:
+ *   - ElsgwReceiver (-m) が受信したデータグラムを、メタデータ (受信時刻・
+ *     送信元・宛先・先頭フレームの種別と番号) と共に共有メモリのリングへ
+ *     1回だけ書き込み、同じホストの任意の数のプロセスが読み出す
+ *     (各プロセスがマルチキャストに参加して個別に受信する必要がない)
+ *   - 書き込み側は1個 (処理スレッド)、読み出し側は複数。読み出し側は
+ *     書き込み側を待たせず、遅れて上書きされた分は欠損として数える
+ *   - スロットごとの seqlock: 番号 n のパケットを書き込む間は seq = 2n-1、
+ *     書き終えたら seq = 2n。読み出し側は読む前後で seq が 2n のままで
+ *     あることを確認する (途中で上書きされた場合は読んだ内容を捨てる)
+ *   - 読み出し側はリング内のデータを直接参照する (コピーなし)。
+ *     新しいパケットはスピン、または futex (プロセス間) で待つ。
+ *     書き込み側は待機を宣言した読み出し側がいる場合のみ起床させ、
+ *     宣言を取り消す (止まった・終了した読み出し側がいても、
+ *     パケットごとにシステムコールを呼ばない)
+ *
+ * 共有メモリ: /dev/shm/elsgw_feed.<名前> (ヘッダ + スロット x slot_count)
+ *   書き込み側の終了時に closed を立てて削除する。読み出し側は futex の
+ *   待機の宣言 (armed) を書き込むため、読み書き可能で開く
+ *
+ * 読み出し側の使い方 (ヘッダのみで使える):
+ *   elsgw_shm_reader_t r;
+ *   elsgw_shm_reader_open(&r, "feed", 0);
+ *   while (...) {
+ *       const elsgw_shm_slot_t *s = elsgw_shm_next(&r);
+ *       if (s == NULL) { elsgw_shm_wait(&r, 200); continue; }
+ *       ... s->data, s->len を参照 ...
+ *       if (elsgw_shm_done(&r, s) < 0) { 読んでいる間に上書きされた }
+ *   }
+ *   elsgw_shm_reader_close(&r);
+ * ============================================================================
+ */
+
+#ifndef ELSGW_SHM_H
+#define ELSGW_SHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+/* ============================================================================
+ * 共有メモリ設定
+ * ============================================================================ */
+#define ELSGW_SHM_DIR           "/dev/shm"
+#define ELSGW_SHM_PREFIX        "elsgw_feed."   /* ファイル名: 接頭辞<名前> */
+#define ELSGW_SHM_MAGIC         0x45534731      /* "ESG1" */
+#define ELSGW_SHM_VERSION       1
+#define ELSGW_SHM_SLOTS         4096            /* スロット数 (2のべき乗) */
+#define ELSGW_SHM_DATA_MAX      1472            /* 格納するデータグラムの最大長 */
+#define ELSGW_SHM_SPIN          2000            /* futex で待つ前のスピン回数 */
+#define ELSGW_SHM_CACHE_LINE    64
+
+/* ============================================================================
+ * スロット (パケット1個)
+ *   先頭フレームのヘッダ (elsgw_decoder.h のフレーム形式) を解析できた
+ *   場合のみ msg_type / msg_seq が有効 (msg_valid = 1)
+ * ============================================================================ */
+typedef struct {
+    _Alignas(ELSGW_SHM_CACHE_LINE) _Atomic uint64_t seq;
+                                            /* 2n-1 = 書き込み中, 2n = 番号 n を公開済み */
+    int64_t       rx_time_ns;               /* カーネル受信時刻 (CLOCK_REALTIME) */
+    int64_t       pub_time_ns;              /* 共有メモリへ公開した時刻 (同) */
+    uint32_t      src_addr, dst_addr;       /* 送信元・宛先 (ネットワークバイト順) */
+    uint16_t      src_port, dst_port;       /* 同 */
+    uint32_t      len;                      /* data に格納したバイト数 */
+    uint32_t      orig_len;                 /* データグラムの長さ (len より長い場合は切り詰め) */
+    uint32_t      msg_seq;                  /* 先頭フレームの seq */
+    uint8_t       msg_type;                 /* 先頭フレームの msg_type */
+    uint8_t       msg_valid;                /* 1 = msg_type / msg_seq が有効 */
+    unsigned char data[ELSGW_SHM_DATA_MAX];
+} elsgw_shm_slot_t;
+
+/* ============================================================================
+ * 共有メモリのヘッダ (スロットの配列が続く)
+ * ============================================================================ */
+typedef struct {
+    uint32_t         magic;
+    uint32_t         version;
+    uint32_t         slot_count;            /* スロット数 (2のべき乗) */
+    uint32_t         slot_size;             /* sizeof(elsgw_shm_slot_t) */
+    int32_t          pid;                   /* 書き込み側のプロセス */
+    int64_t          created_ns;            /* 作成時刻 (CLOCK_REALTIME) */
+    _Alignas(ELSGW_SHM_CACHE_LINE) _Atomic uint64_t head;
+                                            /* 公開済みの最新の番号 (1から, 0 = なし) */
+    _Alignas(ELSGW_SHM_CACHE_LINE) _Atomic uint32_t wake;
+                                            /* 起床ごとに増加 (futex 変数) */
+    _Atomic uint32_t armed;                 /* 1 = futex で待機する読み出し側がいる */
+    _Atomic uint32_t closed;                /* 1 = 書き込み側が終了した */
+} elsgw_shm_header_t;
+
+/* ============================================================================
+ * 書き込み側 (ElsgwReceiver の処理スレッドのみが使う, elsgw_shm.c)
+ * ============================================================================ */
+typedef struct {
+    elsgw_shm_header_t *hdr;
+    elsgw_shm_slot_t   *slots;
+    size_t              map_size;
+    uint32_t            mask;
+    uint64_t            head;               /* 最後に公開した番号 */
+    unsigned long       truncated;          /* 切り詰めたデータグラム数 */
+    unsigned long       wakeups;            /* futex で起床させた回数 */
+    char                path[128];
+} elsgw_shm_writer_t;
+
+/* ============================================================================
+ * 読み出し側
+ * ============================================================================ */
+typedef struct {
+    elsgw_shm_header_t *hdr;
+    elsgw_shm_slot_t   *slots;
+    size_t              map_size;
+    uint32_t            mask;
+    uint64_t            next;               /* 次に読む番号 */
+    unsigned long       lost;               /* 読む前・読んでいる間に上書きされた数 */
+} elsgw_shm_reader_t;
+
+/* ============================================================================
+ * 関数: elsgw_shm_path
+ * 機能: 名前から共有メモリのファイル名を作る
+ * 戻り値: 0 = 成功, -1 = 名前が不正 (空・'/' を含む・長すぎる)
+ * ============================================================================ */
+static inline int elsgw_shm_path(char *buf, size_t size, const char *name) {
+    if (name[0] == '\0' || strchr(name, '/') != NULL) {
+        return -1;
+    }
+    if ((size_t)snprintf(buf, size, "%s/%s%s", ELSGW_SHM_DIR, ELSGW_SHM_PREFIX, name) >= size) {
+        return -1;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 書き込み側の関数 (elsgw_shm.c)
+ * ============================================================================ */
+/* 共有メモリを作成する (同じ名前の古いファイルは置き換える)
+ * 戻り値: 0 = 成功, -1 = 失敗 */
+int elsgw_shm_create(elsgw_shm_writer_t *w, const char *name);
+
+/* データグラム1個を公開し、待機中の読み出し側がいれば起床させる */
+void elsgw_shm_publish(elsgw_shm_writer_t *w, const unsigned char *data, size_t len,
+                       const struct sockaddr_in *sender, const struct sockaddr_in *dest,
+                       const struct timespec *rx_time);
+
+/* 終了を通知して共有メモリを削除する / 集計を表示する */
+void elsgw_shm_close(elsgw_shm_writer_t *w);
+void elsgw_shm_print(const elsgw_shm_writer_t *w);
+
+/* ============================================================================
+ * 関数: elsgw_shm_reader_open
+ * 機能: 共有メモリを開く
+ * 引数:
+ *   name   - ElsgwReceiver -m で指定した名前
+ *   oldest - 1 = リングに残っている最も古いパケットから読む,
+ *            0 = これから公開されるパケットから読む
+ * 戻り値: 0 = 成功, -1 = 失敗 (存在しない・形式が違う)
+ * ============================================================================ */
+static inline int elsgw_shm_reader_open(elsgw_shm_reader_t *r, const char *name, int oldest) {
+    char path[128];
+    struct stat st;
+    uint64_t head;
+    int fd;
+
+    memset(r, 0, sizeof(*r));
+    if (elsgw_shm_path(path, sizeof(path), name) < 0) {
+        fprintf(stderr, "[ERROR] Invalid feed name: %s\n", name);
+        return -1;
+    }
+    fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(elsgw_shm_header_t)) {
+        fprintf(stderr, "[ERROR] %s: not an ELSGW feed\n", path);
+        close(fd);
+        return -1;
+    }
+    r->map_size = st.st_size;
+    r->hdr = mmap(NULL, r->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (r->hdr == MAP_FAILED) {
+        perror("[ERROR] mmap failed");
+        r->hdr = NULL;
+        return -1;
+    }
+    if (r->hdr->magic != ELSGW_SHM_MAGIC || r->hdr->version != ELSGW_SHM_VERSION ||
+        r->hdr->slot_size != sizeof(elsgw_shm_slot_t) || r->hdr->slot_count == 0 ||
+        (r->hdr->slot_count & (r->hdr->slot_count - 1)) != 0 ||
+        sizeof(elsgw_shm_header_t) + (size_t)r->hdr->slot_count * sizeof(elsgw_shm_slot_t) >
+        r->map_size) {
+        fprintf(stderr, "[ERROR] %s: not an ELSGW feed (or unsupported version)\n", path);
+        munmap(r->hdr, r->map_size);
+        r->hdr = NULL;
+        return -1;
+    }
+    r->slots = (elsgw_shm_slot_t *)(r->hdr + 1);
+    r->mask = r->hdr->slot_count - 1;
+
+    head = atomic_load_explicit(&r->hdr->head, memory_order_acquire);
+    r->next = head + 1;
+    if (oldest) {
+        r->next = head >= r->hdr->slot_count ? head - r->mask : 1;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: elsgw_shm_next
+ * 機能: 次のパケットのスロットを返す (コピーなし)
+ *   読み終えたら elsgw_shm_done() を呼ぶ。書き込み側に周回遅れにされて
+ *   いた場合は、リングに残っている範囲まで進めて欠損として数える
+ * 戻り値: スロット (NULL = まだ公開されていない)
+ * ============================================================================ */
+static inline const elsgw_shm_slot_t *elsgw_shm_next(elsgw_shm_reader_t *r) {
+    const elsgw_shm_slot_t *s;
+    uint64_t seq, head;
+
+    for (;;) {
+        s = &r->slots[r->next & r->mask];
+        seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if (seq == 2 * r->next) {
+            return s;
+        }
+        if (seq < 2 * r->next) {
+            return NULL;                /* まだ書かれていない・書き込み中 */
+        }
+
+        /* 周回遅れ: 最も古い分は次の書き込みで上書きされるため 1/8 先へ進める */
+        head = atomic_load_explicit(&r->hdr->head, memory_order_acquire);
+        seq = head - r->mask + (r->mask + 1) / 8;
+        if (seq > head + 1) {
+            seq = head + 1;
+        }
+        if (seq <= r->next) {
+            seq = r->next + 1;
+        }
+        r->lost += seq - r->next;
+        r->next = seq;
+    }
+}
+
+/* ============================================================================
+ * 関数: elsgw_shm_done
+ * 機能: elsgw_shm_next() で得たスロットを読み終えたことを通知し、次へ進む
+ * 戻り値: 0 = 読んだ内容は有効, -1 = 読んでいる間に上書きされた (内容を捨てる)
+ * ============================================================================ */
+static inline int elsgw_shm_done(elsgw_shm_reader_t *r, const elsgw_shm_slot_t *s) {
+    uint64_t expected = 2 * r->next;
+
+    atomic_thread_fence(memory_order_acquire);
+    r->next++;
+    if (atomic_load_explicit(&s->seq, memory_order_relaxed) != expected) {
+        r->lost++;
+        return -1;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: elsgw_shm_closed
+ * 機能: 書き込み側が終了し、読むパケットが残っていないか確認する
+ * ============================================================================ */
+static inline int elsgw_shm_closed(const elsgw_shm_reader_t *r) {
+    return atomic_load_explicit(&r->hdr->closed, memory_order_acquire) &&
+           atomic_load_explicit(&r->hdr->head, memory_order_acquire) < r->next;
+}
+
+/* ============================================================================
+ * 関数: elsgw_shm_wait
+ * 機能: 次のパケットが公開されるまで待つ (最大 timeout_ms)
+ *   ELSGW_SHM_SPIN 回スピンしてから、待機を宣言して futex で待つ
+ *   (宣言した後に再確認し、取りこぼしを防ぐ。書き込み側が wake を
+ *   進めた後に futex を呼んだ場合は待たずに戻る)
+ * ============================================================================ */
+static inline void elsgw_shm_wait(elsgw_shm_reader_t *r, int timeout_ms) {
+    elsgw_shm_header_t *h = r->hdr;
+    struct timespec ts;
+    uint32_t wake;
+
+    for (int i = 0; i < ELSGW_SHM_SPIN; i++) {
+        if (atomic_load_explicit(&h->head, memory_order_acquire) >= r->next) {
+            return;
+        }
+    }
+
+    wake = atomic_load_explicit(&h->wake, memory_order_acquire);
+    atomic_store_explicit(&h->armed, 1, memory_order_seq_cst);
+    if (atomic_load_explicit(&h->head, memory_order_seq_cst) < r->next &&
+        !atomic_load_explicit(&h->closed, memory_order_relaxed)) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+        syscall(SYS_futex, &h->wake, FUTEX_WAIT, wake, &ts, NULL, 0);
+    }
+}
+
+/* ============================================================================
+ * 関数: elsgw_shm_reader_close
+ * 機能: 共有メモリを閉じる
+ * ============================================================================ */
+static inline void elsgw_shm_reader_close(elsgw_shm_reader_t *r) {
+    if (r->hdr != NULL) {
+        munmap(r->hdr, r->map_size);
+        r->hdr = NULL;
+    }
+}
+
+#endif /* ELSGW_SHM_H */
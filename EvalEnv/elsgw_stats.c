@@ -0,0 +1,327 @@
+/*
+ * ============================================================================
+ * elsgw_stats.c - ELSGW Receive Statistics
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
+#include "elsgw_stats.h"
+
+#define SNAPSHOT_BUFFER_SIZE    16384
+
+/* ============================================================================
+ * 関数: now_mono_ns
+ * 機能: 単調増加時刻をナノ秒で取得
+ * ============================================================================ */
+static long long now_mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* ============================================================================
+ * 関数: timespec_diff_ns
+ * 機能: a - b をナノ秒で求める (負の場合は0)
+ * ============================================================================ */
+static uint64_t timespec_diff_ns(const struct timespec *a, const struct timespec *b) {
+    long long d = (long long)(a->tv_sec - b->tv_sec) * 1000000000LL +
+                  (a->tv_nsec - b->tv_nsec);
+    return d > 0 ? (uint64_t)d : 0;
+}
+
+/* ============================================================================
+ * 関数: hist_index / hist_value
+ * 機能: 値とバケット番号の相互変換
+ *   v < HIST_SUB_BUCKETS        : バケット = v (1ns刻み)
+ *   2^e <= v < 2^(e+1) (e >= SUB_BITS) :
+ *     バケット = (e - SUB_BITS + 1) * SUB_BUCKETS + 上位SUB_BITSビット(先頭1を除く)
+ * ============================================================================ */
+static inline int hist_index(uint64_t v) {
+    int e;
+
+    if (v < HIST_SUB_BUCKETS) {
+        return (int)v;
+    }
+    e = 63 - __builtin_clzll(v);
+    if (e >= HIST_MAX_BITS) {
+        return HIST_BUCKETS - 1;
+    }
+    return ((e - HIST_SUB_BITS + 1) << HIST_SUB_BITS) +
+           (int)((v >> (e - HIST_SUB_BITS)) - HIST_SUB_BUCKETS);
+}
+
+static inline uint64_t hist_value(int idx) {
+    int group = idx >> HIST_SUB_BITS;
+    uint64_t sub = idx & (HIST_SUB_BUCKETS - 1);
+
+    if (group == 0) {
+        return sub;
+    }
+    /* バケットの下限値 */
+    return (HIST_SUB_BUCKETS + sub) << (group - 1);
+}
+
+/* ============================================================================
+ * 関数: hist_record
+ * 機能: ヒストグラムへ値を記録する
+ * ============================================================================ */
+void hist_record(hdr_hist_t *h, uint64_t value) {
+    h->counts[hist_index(value)]++;
+    h->total++;
+    h->sum += value;
+    if (value > h->max) {
+        h->max = value;
+    }
+}
+
+/* ============================================================================
+ * 関数: hist_percentile
+ * 機能: パーセンタイル値 (0-100) を求める (該当バケットの下限値)
+ * ============================================================================ */
+uint64_t hist_percentile(const hdr_hist_t *h, double percentile) {
+    uint64_t rank, seen = 0;
+
+    if (h->total == 0) {
+        return 0;
+    }
+    rank = (uint64_t)(percentile / 100.0 * h->total + 0.5);
+    if (rank < 1) rank = 1;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            return hist_value(i) < h->max ? hist_value(i) : h->max;
+        }
+    }
+    return h->max;
+}
+
+/* ============================================================================
+ * 関数: stats_init
+ * 機能: 統計を初期化する
+ * ============================================================================ */
+void stats_init(elsgw_stats_t *st, int seq_offset, int snapshot_fd, int interval_ms) {
+    memset(st, 0, sizeof(*st));
+    st->seq_offset = seq_offset;
+    st->snapshot_fd = snapshot_fd;
+    st->interval_ns = (long long)interval_ms * 1000000LL;
+    st->last_snapshot_ns = now_mono_ns();
+    st->next_snapshot_ns = st->last_snapshot_ns + st->interval_ns;
+}
+
+/* ============================================================================
+ * 関数: find_sender
+ * 機能: 送信元の統計エントリを検索 (未登録なら追加) する
+ * 戻り値: エントリ (表が満杯の場合は NULL)
+ * ============================================================================ */
+static sender_stats_t *find_sender(elsgw_stats_t *st, const struct sockaddr_in *addr) {
+    uint32_t a = addr->sin_addr.s_addr;
+    uint16_t p = addr->sin_port;
+    unsigned int idx = (a * 2654435761u ^ p) % STATS_MAX_SENDERS;
+    sender_stats_t *s;
+
+    for (int i = 0; i < STATS_MAX_SENDERS; i++) {
+        s = &st->senders[(idx + i) % STATS_MAX_SENDERS];
+        if (!s->in_use) {
+            s->in_use = 1;
+            s->addr = a;
+            s->port = p;
+            return s;
+        }
+        if (s->addr == a && s->port == p) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * 関数: record_sequence
+ * 機能: シーケンス番号から欠番・逆転を判定する
+ * ============================================================================ */
+static void record_sequence(sender_stats_t *s, uint32_t seq) {
+    uint32_t expected = s->last_seq + 1;
+    int32_t diff = (int32_t)(seq - expected);
+
+    if (!s->seq_valid) {
+        s->seq_valid = 1;
+        s->last_seq = seq;
+        return;
+    }
+
+    if (diff == 0) {
+        s->last_seq = seq;
+    } else if (diff > 0) {
+        s->seq_gaps++;
+        s->seq_lost += (unsigned long)diff;
+        s->last_seq = seq;
+    } else if (diff < -STATS_SEQ_RESET_WINDOW) {
+        s->seq_resets++;
+        s->last_seq = seq;
+    } else {
+        /* 遅れて届いた番号は欠番数から戻す (古い番号の重複とは区別しない) */
+        s->seq_reorder++;
+        if (s->seq_lost > 0 && seq != s->last_seq) {
+            s->seq_lost--;
+        }
+    }
+}
+
+/* ============================================================================
+ * 関数: stats_record
+ * 機能: 処理したパケット1個を記録する
+ * ============================================================================ */
+void stats_record(elsgw_stats_t *st, const rx_packet_t *pkt,
+                  const struct timespec *now) {
+    sender_stats_t *s;
+    const unsigned char *p;
+
+    st->packets++;
+    st->bytes += pkt->len;
+
+    if (st->have_last_rx) {
+        hist_record(&st->inter_arrival, timespec_diff_ns(&pkt->rx_time, &st->last_rx));
+    }
+    st->last_rx = pkt->rx_time;
+    st->have_last_rx = 1;
+    hist_record(&st->latency, timespec_diff_ns(now, &pkt->rx_time));
+
+    s = find_sender(st, pkt->sender);
+    if (s == NULL) {
+        st->sender_overflow++;
+        return;
+    }
+    s->packets++;
+    s->bytes += pkt->len;
+
+    if (st->seq_offset >= 0 && pkt->len >= (size_t)st->seq_offset + 4) {
+        p = pkt->data + st->seq_offset;
+        record_sequence(s, ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                           ((uint32_t)p[2] << 8) | p[3]);
+    }
+}
+
+/* ============================================================================
+ * 関数: append
+ * 機能: スナップショットバッファへ書式付きで追記する (溢れた分は切り捨て)
+ * ============================================================================ */
+static void append(char *buf, size_t *off, const char *fmt, ...) {
+    va_list ap;
+    int n;
+
+    if (*off >= SNAPSHOT_BUFFER_SIZE) {
+        return;
+    }
+    va_start(ap, fmt);
+    n = vsnprintf(buf + *off, SNAPSHOT_BUFFER_SIZE - *off, fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        *off += (size_t)n;
+        if (*off > SNAPSHOT_BUFFER_SIZE) {
+            *off = SNAPSHOT_BUFFER_SIZE;
+        }
+    }
+}
+
+/* ============================================================================
+ * 関数: append_hist
+ * 機能: ヒストグラムの要約を JSON オブジェクトとして追記する
+ * ============================================================================ */
+static void append_hist(char *buf, size_t *off, const char *name, const hdr_hist_t *h) {
+    append(buf, off,
+           "\"%s\":{\"count\":%llu,\"mean\":%llu,\"p50\":%llu,\"p90\":%llu,"
+           "\"p99\":%llu,\"p999\":%llu,\"max\":%llu}",
+           name, (unsigned long long)h->total,
+           (unsigned long long)(h->total > 0 ? h->sum / h->total : 0),
+           (unsigned long long)hist_percentile(h, 50.0),
+           (unsigned long long)hist_percentile(h, 90.0),
+           (unsigned long long)hist_percentile(h, 99.0),
+           (unsigned long long)hist_percentile(h, 99.9),
+           (unsigned long long)h->max);
+}
+
+/* ============================================================================
+ * 関数: stats_poll
+ * 機能: 周期に達していればスナップショットを出力する
+ * ============================================================================ */
+void stats_poll(elsgw_stats_t *st, receiver_t *rx, int rx_count, int force) {
+    static char buf[SNAPSHOT_BUFFER_SIZE + 2];
+    long long now = now_mono_ns();
+    double interval_s;
+    struct timespec wall;
+    char ip[INET_ADDRSTRLEN];
+    struct in_addr addr;
+    const sender_stats_t *s;
+    size_t off = 0;
+    const char *sep = "";
+    unsigned long rx_packets = 0, ring_drops = 0, kernel_drops = 0;
+    ssize_t written;
+
+    if (st->snapshot_fd < 0 || (!force && now < st->next_snapshot_ns)) {
+        return;
+    }
+
+    for (int i = 0; i < rx_count; i++) {
+        rx_packets += atomic_load_explicit(&rx[i].rx_packets, memory_order_relaxed);
+        ring_drops += atomic_load_explicit(&rx[i].ring_drops, memory_order_relaxed);
+        kernel_drops += atomic_load_explicit(&rx[i].kernel_drops, memory_order_relaxed);
+    }
+    interval_s = (now - st->last_snapshot_ns) / 1e9;
+    clock_gettime(CLOCK_REALTIME, &wall);
+
+    append(buf, &off,
+           "{\"time\":%ld.%03ld,\"snapshot\":%lu,\"interval_s\":%.3f,"
+           "\"rx_packets\":%lu,\"processed\":%lu,\"bytes\":%lu,\"pps\":%.1f,"
+           "\"ring_drops\":%lu,\"kernel_drops\":%lu,\"sender_overflow\":%lu,",
+           (long)wall.tv_sec, wall.tv_nsec / 1000000, st->snapshot_no, interval_s,
+           rx_packets, st->packets, st->bytes,
+           interval_s > 0 ? (st->packets - st->last_packets) / interval_s : 0.0,
+           ring_drops, kernel_drops, st->sender_overflow);
+
+    append(buf, &off, "\"senders\":[");
+    for (int i = 0; i < STATS_MAX_SENDERS; i++) {
+        s = &st->senders[i];
+        if (!s->in_use) {
+            continue;
+        }
+        addr.s_addr = s->addr;
+        inet_ntop(AF_INET, &addr, ip, sizeof(ip));
+        append(buf, &off,
+               "%s{\"addr\":\"%s:%u\",\"packets\":%lu,\"bytes\":%lu,"
+               "\"seq_gaps\":%lu,\"seq_lost\":%lu,\"seq_reorder\":%lu,"
+               "\"seq_resets\":%lu}",
+               sep, ip, ntohs(s->port), s->packets, s->bytes,
+               s->seq_gaps, s->seq_lost, s->seq_reorder, s->seq_resets);
+        sep = ",";
+    }
+    append(buf, &off, "],");
+    append_hist(buf, &off, "inter_arrival_ns", &st->inter_arrival);
+    append(buf, &off, ",");
+    append_hist(buf, &off, "latency_ns", &st->latency);
+    append(buf, &off, "}");
+    buf[off++] = '\n';
+
+    for (size_t done = 0; done < off; ) {
+        written = write(st->snapshot_fd, buf + done, off - done);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        done += (size_t)written;
+    }
+
+    /* ヒストグラムは周期ごとの分布とする */
+    memset(&st->inter_arrival, 0, sizeof(st->inter_arrival));
+    memset(&st->latency, 0, sizeof(st->latency));
+    st->last_packets = st->packets;
+    st->last_snapshot_ns = now;
+    st->next_snapshot_ns = now + st->interval_ns;
+    st->snapshot_no++;
+}
@@ -0,0 +1,130 @@
+/*
+ * ============================================================================
+ * elsgw_stats.h - ELSGW Receive Statistics
+ * ============================================================================
+ * 機能:
+ *   - 送信元ごとのパケット数・バイト数
+ *   - 受信ソケットのカーネルドロップ数 (SO_RXQ_OVFL / PACKET_STATISTICS)
+ *   - シーケンス番号の欠番・逆転検出 (ELSGWフレーム内の位置を指定)
+ *   - 到着間隔と受信→処理遅延の対数線形ヒストグラム (HdrHistogram方式)
+ *   - 定期的なスナップショットを JSON (1行1オブジェクト) で出力
+ *
+ * 記録 (stats_record) は処理スレッドのみが呼び出し、表示やシステムコールを
+ * 行わない。出力はスナップショット周期ごとに write() 1回のみ。
+ * ============================================================================
+ */
+
+#ifndef ELSGW_STATS_H
+#define ELSGW_STATS_H
+
+#include <stdint.h>
+#include <time.h>
+#include <netinet/in.h>
+
+#include "elsgw_receiver.h"
+
+/* ============================================================================
+ * 動作設定
+ * ============================================================================ */
+#define STATS_MAX_SENDERS       64      /* 集計する送信元の最大数 */
+#define STATS_SEQ_OFFSET        4       /* シーケンス番号の位置 (ELSGWフレーム先頭から) */
+#define STATS_SEQ_DISABLED      (-1)    /* シーケンス番号なし */
+#define STATS_SEQ_RESET_WINDOW  65536   /* これ以上戻った場合は送信元の再起動とみなす */
+#define STATS_INTERVAL_MS       1000    /* 既定のスナップショット周期 */
+
+/* ============================================================================
+ * ヒストグラム
+ *   値 v (ナノ秒) を 2のべき乗ごとに HIST_SUB_BUCKETS 個へ等分して数える。
+ *   各バケットの相対誤差は 1/HIST_SUB_BUCKETS (約3%) 以下。
+ *   2^HIST_MAX_BITS ns (約18分) 以上は最上位バケットへ丸める。
+ * ============================================================================ */
+#define HIST_SUB_BITS       5
+#define HIST_SUB_BUCKETS    (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS       40
+#define HIST_BUCKETS        ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;                     /* 記録数 */
+    uint64_t sum;                       /* 合計値 (平均算出用) */
+    uint64_t max;                       /* 最大値 */
+} hdr_hist_t;
+
+/* ============================================================================
+ * 送信元ごとの統計
+ * ============================================================================ */
+typedef struct {
+    int            in_use;
+    uint32_t       addr;                /* 送信元IP (ネットワークバイト順) */
+    uint16_t       port;                /* 送信元ポート (ネットワークバイト順) */
+    unsigned long  packets;
+    unsigned long  bytes;
+    int            seq_valid;           /* last_seq が有効 */
+    uint32_t       last_seq;            /* 直前のシーケンス番号 */
+    unsigned long  seq_gaps;            /* 欠番の発生回数 */
+    unsigned long  seq_lost;            /* 欠番の合計数 */
+    unsigned long  seq_reorder;         /* 逆転・重複の数 */
+    unsigned long  seq_resets;          /* シーケンスの巻き戻り (再起動) */
+} sender_stats_t;
+
+/* ============================================================================
+ * 統計全体
+ * ============================================================================ */
+typedef struct {
+    sender_stats_t  senders[STATS_MAX_SENDERS];
+    unsigned long   sender_overflow;    /* 表に入らなかった送信元のパケット数 */
+    unsigned long   packets;
+    unsigned long   bytes;
+    int             seq_offset;         /* シーケンス番号の位置 (-1 = 無効) */
+    int             have_last_rx;
+    struct timespec last_rx;            /* 直前パケットのカーネル受信時刻 */
+    hdr_hist_t      inter_arrival;      /* 到着間隔 (スナップショットごとにリセット) */
+    hdr_hist_t      latency;            /* 受信→処理遅延 (同上) */
+
+    /* スナップショット出力 */
+    int             snapshot_fd;        /* 出力先 (-1 = 出力しない) */
+    long long       interval_ns;
+    long long       next_snapshot_ns;
+    long long       last_snapshot_ns;
+    unsigned long   last_packets;
+    unsigned long   snapshot_no;
+} elsgw_stats_t;
+
+/* ============================================================================
+ * 関数: hist_record / hist_percentile
+ * 機能: ヒストグラムへ値を記録する / パーセンタイル値 (0-100) を求める
+ * ============================================================================ */
+void hist_record(hdr_hist_t *h, uint64_t value);
+uint64_t hist_percentile(const hdr_hist_t *h, double percentile);
+
+/* ============================================================================
+ * 関数: stats_init
+ * 機能: 統計を初期化する
+ * 引数:
+ *   seq_offset  - シーケンス番号の位置 (STATS_SEQ_DISABLED で無効)
+ *   snapshot_fd - スナップショット出力先 (-1 で出力しない)
+ *   interval_ms - スナップショット周期
+ * ============================================================================ */
+void stats_init(elsgw_stats_t *st, int seq_offset, int snapshot_fd, int interval_ms);
+
+/* ============================================================================
+ * 関数: stats_record
+ * 機能: 処理したパケット1個を記録する
+ * 引数:
+ *   pkt - 受信パケット
+ *   now - 処理時刻 (CLOCK_REALTIME, カーネル受信時刻と同じ時計)
+ * ============================================================================ */
+void stats_record(elsgw_stats_t *st, const rx_packet_t *pkt,
+                  const struct timespec *now);
+
+/* ============================================================================
+ * 関数: stats_poll
+ * 機能: 周期に達していればスナップショットを出力する
+ * 引数:
+ *   rx       - 受信側のカウンタ (受信数、リング/カーネルドロップ数)
+ *   rx_count - rx の個数 (受信スレッドごとのカウンタを合算する)
+ *   force    - 1 の場合は周期に関わらず出力する (終了時)
+ * ============================================================================ */
+void stats_poll(elsgw_stats_t *st, receiver_t *rx, int rx_count, int force);
+
+#endif /* ELSGW_STATS_H */
@@ -0,0 +1,447 @@
+/*
+ * ============================================================================
+ * epoll_rx.c - Multi-group epoll Receive Engine
+ * ============================================================================
+ * ソケットの配置 (受信スレッド数 N, ポート数 P):
+ *   ソケットは P x N 個。ポートごとに受信スレッド番号順に bind するため、
+ *   各ポートの SO_REUSEPORT グループ内の番号 = 受信スレッド番号 となり、
+ *   CPU振り分けBPFの戻り値 (CPU番号) がそのまま受信スレッドを指す。
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <linux/filter.h>
+
+#include "epoll_rx.h"
+
+/* ============================================================================
+ * 関数: add_port
+ * 機能: ポート一覧へ追加する (登録済みならその番号を返す)
+ * 戻り値: ポート番号 (一覧の添字), -1 = 一覧が満杯
+ * ============================================================================ */
+static int add_port(epoll_rx_t *e, in_port_t port) {
+    for (int i = 0; i < e->port_count; i++) {
+        if (e->ports[i] == port) {
+            return i;
+        }
+    }
+    if (e->port_count >= EPOLL_RX_MAX_PORTS) {
+        return -1;
+    }
+    e->ports[e->port_count] = port;
+    return e->port_count++;
+}
+
+/* ============================================================================
+ * 関数: epoll_rx_load
+ * 機能: 購読設定ファイルを読み込む
+ * ============================================================================ */
+int epoll_rx_load(epoll_rx_t *e, const char *path) {
+    FILE *fp;
+    char line[256];
+    char group[64], ifaddr[64];
+    unsigned int port;
+    subscription_t *sub;
+    int line_no = 0;
+    int fields;
+
+    memset(e, 0, sizeof(*e));
+
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "[ERROR] Failed to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        line_no++;
+        line[strcspn(line, "#\r\n")] = '\0';
+
+        fields = sscanf(line, "%63s %u %63s", group, &port, ifaddr);
+        if (fields <= 0) {
+            continue;                   /* 空行・コメント */
+        }
+        if (fields == 2) {
+            snprintf(ifaddr, sizeof(ifaddr), "%s", ABOS1_IP);
+        }
+        if (fields < 2 || port == 0 || port > 65535) {
+            fprintf(stderr, "[ERROR] %s:%d: expected <group> <port> [<if_ip>]\n",
+                    path, line_no);
+            goto fail;
+        }
+        if (e->sub_count >= EPOLL_RX_MAX_SUBS) {
+            fprintf(stderr, "[ERROR] %s:%d: too many subscriptions (max %d)\n",
+                    path, line_no, EPOLL_RX_MAX_SUBS);
+            goto fail;
+        }
+
+        sub = &e->subs[e->sub_count];
+        if (inet_pton(AF_INET, group, &sub->group) != 1 ||
+            inet_pton(AF_INET, ifaddr, &sub->ifaddr) != 1) {
+            fprintf(stderr, "[ERROR] %s:%d: invalid address\n", path, line_no);
+            goto fail;
+        }
+        if (sub->group.s_addr != INADDR_ANY && !IN_MULTICAST(ntohl(sub->group.s_addr))) {
+            fprintf(stderr, "[ERROR] %s:%d: %s is not a multicast group "
+                    "(use 0.0.0.0 for unicast)\n", path, line_no, group);
+            goto fail;
+        }
+        sub->port = htons((uint16_t)port);
+        if (add_port(e, sub->port) < 0) {
+            fprintf(stderr, "[ERROR] %s:%d: too many ports (max %d)\n",
+                    path, line_no, EPOLL_RX_MAX_PORTS);
+            goto fail;
+        }
+        e->sub_count++;
+    }
+    fclose(fp);
+
+    if (e->sub_count == 0) {
+        fprintf(stderr, "[ERROR] No subscriptions in %s\n", path);
+        return -1;
+    }
+    return 0;
+
+fail:
+    fclose(fp);
+    return -1;
+}
+
+/* ============================================================================
+ * 関数: attach_cpu_steering
+ * 機能: SO_REUSEPORT グループに「受信CPU番号のソケットを選ぶ」BPFを設定する
+ *   ld  #cpu
+ *   ret a
+ *   (戻り値がソケット数以上の場合、カーネルは通常のハッシュ分散に戻る)
+ * ============================================================================ */
+static int attach_cpu_steering(int fd) {
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU),
+        BPF_STMT(BPF_RET | BPF_A, 0),
+    };
+    struct sock_fprog prog = {
+        .len = sizeof(code) / sizeof(code[0]),
+        .filter = code,
+    };
+
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+}
+
+/* ============================================================================
+ * 関数: open_socket
+ * 機能: 受信スレッド1個・ポート1個分のソケットを作成して bind する
+ * 戻り値: ソケット (失敗時は -1)
+ * ============================================================================ */
+static int open_socket(in_port_t port) {
+    struct sockaddr_in local_addr;
+    int fd;
+    int opt = 1;
+    int off = 0;
+
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        perror("[ERROR] Failed to create UDP socket");
+        return -1;
+    }
+
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("[ERROR] Failed to set SO_REUSEADDR/SO_REUSEPORT");
+        close(fd);
+        return -1;
+    }
+
+    /* 自ソケットで参加したグループのみ受信する (他スレッドの分は受けない) */
+    if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_ALL, &off, sizeof(off)) < 0) {
+        perror("[ERROR] Failed to clear IP_MULTICAST_ALL");
+        close(fd);
+        return -1;
+    }
+
+    /* 受信時刻・ドロップ数・宛先アドレスを補助データで受け取る */
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &opt, sizeof(opt)) < 0) {
+        perror("[WARN] Failed to set SO_TIMESTAMPNS");
+    }
+    if (setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof(opt)) < 0) {
+        perror("[WARN] Failed to set SO_RXQ_OVFL");
+    }
+    if (setsockopt(fd, IPPROTO_IP, IP_PKTINFO, &opt, sizeof(opt)) < 0) {
+        perror("[WARN] Failed to set IP_PKTINFO");
+    }
+
+    memset(&local_addr, 0, sizeof(local_addr));
+    local_addr.sin_family = AF_INET;
+    local_addr.sin_port = port;
+    local_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (struct sockaddr *)&local_addr, sizeof(local_addr)) < 0) {
+        perror("[ERROR] Failed to bind UDP socket");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* ============================================================================
+ * 関数: port_index
+ * 機能: ポートの一覧上の番号を返す
+ * ============================================================================ */
+static int port_index(const epoll_rx_t *e, in_port_t port) {
+    for (int i = 0; i < e->port_count; i++) {
+        if (e->ports[i] == port) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* ============================================================================
+ * 関数: epoll_rx_open
+ * 機能: 受信スレッドごとのソケットと epoll を準備し、グループへ参加する
+ * ============================================================================ */
+int epoll_rx_open(epoll_rx_t *e, receiver_t *rx, int worker_count, int steer_cpu) {
+    struct epoll_event ev;
+    struct ip_mreq mreq;
+    epoll_rx_worker_t *w;
+    subscription_t *sub;
+    char group[INET_ADDRSTRLEN], ifaddr[INET_ADDRSTRLEN];
+    int next_worker = 0;
+    int fd;
+
+    e->worker_count = worker_count;
+    for (int i = 0; i < worker_count; i++) {
+        w = &e->workers[i];
+        w->index = i;
+        w->rx = &rx[i];
+        w->doorbell = &e->doorbell;
+        w->epfd = -1;
+        for (int p = 0; p < EPOLL_RX_MAX_PORTS; p++) {
+            w->socks[p].fd = -1;
+        }
+    }
+
+    for (int i = 0; i < worker_count; i++) {
+        e->workers[i].epfd = epoll_create1(0);
+        if (e->workers[i].epfd < 0) {
+            perror("[ERROR] Failed to create epoll");
+            goto fail;
+        }
+    }
+
+    /* ポートごとに、受信スレッド番号順で SO_REUSEPORT グループへ追加 */
+    for (int p = 0; p < e->port_count; p++) {
+        for (int i = 0; i < worker_count; i++) {
+            w = &e->workers[i];
+            fd = open_socket(e->ports[p]);
+            if (fd < 0) {
+                goto fail;
+            }
+            w->socks[p].fd = fd;
+            w->socks[p].port = e->ports[p];
+
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.u32 = (uint32_t)p;
+            if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                perror("[ERROR] Failed to add socket to epoll");
+                goto fail;
+            }
+        }
+        if (steer_cpu && attach_cpu_steering(e->workers[0].socks[p].fd) < 0) {
+            perror("[WARN] Failed to attach SO_REUSEPORT CPU steering");
+        }
+        printf("[INFO] UDP port %d bound by %d worker(s)%s\n",
+               ntohs(e->ports[p]), worker_count,
+               steer_cpu ? " with CPU steering" : "");
+    }
+
+    /* マルチキャストグループを受信スレッドへ順に割り当てて参加 */
+    for (int s = 0; s < e->sub_count; s++) {
+        sub = &e->subs[s];
+        inet_ntop(AF_INET, &sub->group, group, sizeof(group));
+        inet_ntop(AF_INET, &sub->ifaddr, ifaddr, sizeof(ifaddr));
+
+        if (sub->group.s_addr == INADDR_ANY) {
+            sub->worker = -1;
+            printf("[INFO] Unicast port %d -> all workers\n", ntohs(sub->port));
+            continue;
+        }
+
+        sub->worker = next_worker;
+        next_worker = (next_worker + 1) % worker_count;
+        w = &e->workers[sub->worker];
+
+        memset(&mreq, 0, sizeof(mreq));
+        mreq.imr_multiaddr = sub->group;
+        mreq.imr_interface = sub->ifaddr;
+        if (setsockopt(w->socks[port_index(e, sub->port)].fd, IPPROTO_IP,
+                       IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+            fprintf(stderr, "[ERROR] Failed to join %s:%d on %s: %s\n",
+                    group, ntohs(sub->port), ifaddr, strerror(errno));
+            goto fail;
+        }
+        printf("[INFO] Joined %s:%d on %s -> worker %d\n",
+               group, ntohs(sub->port), ifaddr, sub->worker);
+    }
+    return 0;
+
+fail:
+    epoll_rx_close(e);
+    return -1;
+}
+
+/* ============================================================================
+ * 関数: receive_socket
+ * 機能: 1ソケットをキューが空になるまで (最大 EPOLL_RX_BATCH_ROUNDS 回)
+ *       受信リングへ読み込む
+ * ============================================================================ */
+static void receive_socket(epoll_rx_worker_t *w, rx_socket_t *sock) {
+    receiver_t *rx = w->rx;
+    uint32_t start;
+    uint32_t avail;
+    int want;
+    int recv_count;
+
+    for (int round = 0; round < EPOLL_RX_BATCH_ROUNDS; round++) {
+        avail = spsc_ring_reserve(&rx->ring, rx->batch_size, &start);
+
+        if (avail > 0) {
+            want = (int)avail;
+            recv_count = receive_batch(rx, sock, MSG_DONTWAIT, &rx->slots[start],
+                                       &rx->msgs[start], want);
+        } else {
+            want = rx->batch_size;
+            recv_count = receive_batch(rx, sock, MSG_DONTWAIT, rx->drop_slots,
+                                       rx->drop_msgs, want);
+        }
+
+        if (recv_count < 0) {
+            if (errno != EAGAIN && errno != EINTR) {
+                perror("[ERROR] recvmmsg failed");
+            }
+            return;
+        }
+
+        atomic_fetch_add_explicit(&rx->rx_packets, recv_count,
+                                  memory_order_relaxed);
+        if (avail > 0) {
+            spsc_ring_publish(&rx->ring, recv_count);
+            spsc_doorbell_notify(w->doorbell);
+        } else {
+            atomic_fetch_add_explicit(&rx->ring_drops, recv_count,
+                                      memory_order_relaxed);
+        }
+
+        /* 要求数に満たなければキューは空 (残りは epoll が再度通知する) */
+        if (recv_count < want) {
+            return;
+        }
+    }
+}
+
+/* ============================================================================
+ * 関数: worker_thread
+ * 機能: 受信スレッド本体。自分の epoll で待ち、通知のあったソケットを読む
+ * ============================================================================ */
+static void *worker_thread(void *arg) {
+    epoll_rx_worker_t *w = (epoll_rx_worker_t *)arg;
+    struct epoll_event events[EPOLL_RX_MAX_EVENTS];
+    int n;
+
+    while (g_running) {
+        n = epoll_wait(w->epfd, events, EPOLL_RX_MAX_EVENTS, WAIT_TIMEOUT_MS);
+        if (n < 0) {
+            if (errno != EINTR) {
+                perror("[ERROR] epoll_wait failed");
+            }
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            receive_socket(w, &w->socks[events[i].data.u32]);
+        }
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * 関数: epoll_rx_start
+ * 機能: 受信スレッドを起動し、CPU番号 = スレッド番号 で固定する
+ * ============================================================================ */
+int epoll_rx_start(epoll_rx_t *e) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_attr_t attr;
+    cpu_set_t set;
+    epoll_rx_worker_t *w;
+    int err;
+
+    for (int i = 0; i < e->worker_count; i++) {
+        w = &e->workers[i];
+        pthread_attr_init(&attr);
+        if (i < cpus) {
+            w->cpu = i;
+            CPU_ZERO(&set);
+            CPU_SET(i, &set);
+            pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        } else {
+            w->cpu = -1;
+        }
+
+        err = pthread_create(&w->thread, &attr, worker_thread, w);
+        pthread_attr_destroy(&attr);
+        if (err != 0) {
+            fprintf(stderr, "[ERROR] Failed to start receive worker %d: %s\n",
+                    i, strerror(err));
+            return -1;
+        }
+        w->started = 1;
+
+        if (w->cpu >= 0) {
+            printf("[INFO] Receive worker %d pinned to CPU%d\n", i, w->cpu);
+        } else {
+            printf("[WARN] CPU%d not available, Receive worker %d not pinned\n", i, i);
+        }
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: epoll_rx_join
+ * 機能: 受信スレッドの終了を待つ
+ * ============================================================================ */
+void epoll_rx_join(epoll_rx_t *e) {
+    for (int i = 0; i < e->worker_count; i++) {
+        if (e->workers[i].started) {
+            pthread_join(e->workers[i].thread, NULL);
+            e->workers[i].started = 0;
+        }
+    }
+}
+
+/* ============================================================================
+ * 関数: epoll_rx_close
+ * 機能: ソケットと epoll を閉じる (グループからの離脱はソケットの close で行われる)
+ * ============================================================================ */
+void epoll_rx_close(epoll_rx_t *e) {
+    epoll_rx_worker_t *w;
+
+    for (int i = 0; i < e->worker_count; i++) {
+        w = &e->workers[i];
+        for (int p = 0; p < EPOLL_RX_MAX_PORTS; p++) {
+            if (w->socks[p].fd >= 0) {
+                close(w->socks[p].fd);
+                w->socks[p].fd = -1;
+            }
+        }
+        if (w->epfd >= 0) {
+            close(w->epfd);
+            w->epfd = -1;
+        }
+    }
+}
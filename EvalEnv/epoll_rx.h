@@ -0,0 +1,115 @@
+/*
+ * ============================================================================
+ * epoll_rx.h - Multi-group epoll Receive Engine
+ * ============================================================================
+ * 機能:
+ *   - 購読設定ファイルに列挙した複数のグループ/ポート/インターフェースを受信
+ *   - 受信スレッドを CPU ごとに起動して固定し、各スレッドが自分の epoll で
+ *     自分のソケットを待ち受け、専用の受信リングへ recvmmsg() で受信する
+ *   - 全スレッドが同じポートへ SO_REUSEPORT で bind する
+ *
+ * グループの振り分け:
+ *   Linux はマルチキャストを同じポートの全ソケットへ複製して配送し、
+ *   SO_REUSEPORT による分散は行わない。そのため各ソケットに
+ *   IP_MULTICAST_ALL=0 を設定し、グループを受信スレッドへ順に割り当てて、
+ *   割り当て先のソケットだけがそのグループへ参加する。
+ *   ユニキャスト購読 (グループ 0.0.0.0) は SO_REUSEPORT グループで分散され、
+ *   -R 指定時はカーネル内BPF (SO_ATTACH_REUSEPORT_CBPF) で受信CPUと同じ
+ *   番号の受信スレッドへ振り分ける (ソフト割り込みと同じCPUで処理される)。
+ *
+ * 購読設定ファイル (1行1購読, # 以降はコメント):
+ *   <グループ> <ポート> [<受信インターフェースIP>]
+ *   例: 239.64.0.3  52000  192.168.100.1
+ * ============================================================================
+ */
+
+#ifndef EPOLL_RX_H
+#define EPOLL_RX_H
+
+#include <pthread.h>
+#include <netinet/in.h>
+
+#include "elsgw_receiver.h"
+
+/* ============================================================================
+ * 動作設定
+ * ============================================================================ */
+#define EPOLL_RX_MAX_SUBS       64      /* 購読の最大数 */
+#define EPOLL_RX_MAX_PORTS      16      /* 異なるポートの最大数 */
+#define EPOLL_RX_MAX_EVENTS     EPOLL_RX_MAX_PORTS
+#define EPOLL_RX_BATCH_ROUNDS   4       /* 1ソケットを続けて読む最大バッチ数 */
+
+/* ============================================================================
+ * 購読
+ * ============================================================================ */
+typedef struct {
+    struct in_addr group;               /* グループ (0.0.0.0 = ユニキャスト) */
+    in_port_t      port;                /* ポート (ネットワークバイト順) */
+    struct in_addr ifaddr;              /* 受信インターフェースIP */
+    int            worker;              /* 割り当て先の受信スレッド (-1 = 全て) */
+} subscription_t;
+
+/* ============================================================================
+ * 受信スレッド
+ * ============================================================================ */
+typedef struct {
+    int              index;
+    int              cpu;               /* 固定するCPU (-1 = 固定しない) */
+    int              epfd;
+    rx_socket_t      socks[EPOLL_RX_MAX_PORTS];
+                                        /* ポートごとのソケット (ports[] と同順) */
+    receiver_t      *rx;                /* このスレッド専用の受信リング */
+    spsc_doorbell_t *doorbell;          /* 処理スレッドの起床通知 */
+    pthread_t        thread;
+    int              started;
+} epoll_rx_worker_t;
+
+/* ============================================================================
+ * エンジン全体
+ * ============================================================================ */
+typedef struct {
+    subscription_t    subs[EPOLL_RX_MAX_SUBS];
+    int               sub_count;
+    in_port_t         ports[EPOLL_RX_MAX_PORTS];
+    int               port_count;
+    epoll_rx_worker_t workers[MAX_RX_WORKERS];
+    int               worker_count;
+    spsc_doorbell_t   doorbell;
+} epoll_rx_t;
+
+/* ============================================================================
+ * 関数: epoll_rx_load
+ * 機能: 購読設定ファイルを読み込む
+ * 引数:
+ *   path - 購読設定ファイル
+ * 戻り値: 0 = 成功, -1 = 失敗
+ * ============================================================================ */
+int epoll_rx_load(epoll_rx_t *e, const char *path);
+
+/* ============================================================================
+ * 関数: epoll_rx_open
+ * 機能: 受信スレッドごとのソケットと epoll を準備し、グループへ参加する
+ * 引数:
+ *   rx           - 受信コンテキストの配列 (worker_count 個, リング確保済み)
+ *   worker_count - 受信スレッド数 (1 - MAX_RX_WORKERS)
+ *   steer_cpu    - 1 の場合、ユニキャストを受信CPUで振り分けるBPFを設定
+ * 戻り値: 0 = 成功, -1 = 失敗
+ * ============================================================================ */
+int epoll_rx_open(epoll_rx_t *e, receiver_t *rx, int worker_count, int steer_cpu);
+
+/* ============================================================================
+ * 関数: epoll_rx_start
+ * 機能: 受信スレッドを起動し、CPU番号 = スレッド番号 で固定する
+ *       (終了シグナルは呼び出し側で遮断してから呼ぶこと)
+ * 戻り値: 0 = 成功, -1 = 失敗
+ * ============================================================================ */
+int epoll_rx_start(epoll_rx_t *e);
+
+/* ============================================================================
+ * 関数: epoll_rx_join / epoll_rx_close
+ * 機能: 受信スレッドの終了を待つ / ソケットと epoll を閉じる
+ * ============================================================================ */
+void epoll_rx_join(epoll_rx_t *e);
+void epoll_rx_close(epoll_rx_t *e);
+
+#endif /* EPOLL_RX_H */
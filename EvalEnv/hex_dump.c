@@ -0,0 +1,184 @@
+/*
+ * ============================================================================
+ * hex_dump.c - Packet Hex/ASCII Dump Formatter
+ * ============================================================================
+ * 16バイト (ダンプ1行分) ごとに以下の変換カーネルを使用する:
+ *   aarch64 (NEON) : vqtbl1q_u8 でニブル->16進文字変換、vst3q_u8 で
+ *                    "上位 下位 空白" を1命令で交互配置
+ *   x86 (SSSE3)    : pshufb でニブル->16進文字変換と空白挿入
+ *                    (-mssse3 でビルドした場合のみ。既定はテーブル参照)
+ *   その他         : バイト値->2文字のテーブル参照
+ * 16バイトに満たない行末はテーブル参照で処理する。
+ * ============================================================================
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+#include "hex_dump.h"
+
+#define HEX_PREFIX          "[HEX] "
+#define HEX_PREFIX_LEN      6
+#define ASCII_PREFIX        "[ASCII] "
+#define ASCII_PREFIX_LEN    8
+
+/* バイト値 n の16進表記は HEX_PAIRS[2n], HEX_PAIRS[2n+1] */
+static const char HEX_PAIRS[] =
+    "000102030405060708090a0b0c0d0e0f"
+    "101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f"
+    "303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f"
+    "505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f"
+    "707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f"
+    "909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf"
+    "b0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+    "d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+    "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+/* ============================================================================
+ * 関数: hex_scalar / ascii_scalar
+ * 機能: n バイトを "xx " 形式 / 表示可能文字 ('.'置換) へ変換する
+ * ============================================================================ */
+static inline char *hex_scalar(char *o, const unsigned char *p, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        o[0] = HEX_PAIRS[p[i] * 2];
+        o[1] = HEX_PAIRS[p[i] * 2 + 1];
+        o[2] = ' ';
+        o += 3;
+    }
+    return o;
+}
+
+static inline void ascii_scalar(char *o, const unsigned char *p, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        o[i] = (p[i] >= 32 && p[i] <= 126) ? (char)p[i] : '.';
+    }
+}
+
+#if defined(__ARM_NEON)
+/* ============================================================================
+ * 関数: hex16 / ascii16 (NEON)
+ * 機能: 16バイトを48文字の "xx " 列 / 16文字の表示文字列へ変換する
+ * ============================================================================ */
+static inline void hex16(char *o, const unsigned char *p) {
+    const uint8x16_t digits = vld1q_u8((const uint8_t *)"0123456789abcdef");
+    uint8x16_t v = vld1q_u8(p);
+    uint8x16x3_t t;
+
+    t.val[0] = vqtbl1q_u8(digits, vshrq_n_u8(v, 4));
+    t.val[1] = vqtbl1q_u8(digits, vandq_u8(v, vdupq_n_u8(0x0f)));
+    t.val[2] = vdupq_n_u8(' ');
+    vst3q_u8((uint8_t *)o, t);
+}
+
+static inline void ascii16(char *o, const unsigned char *p) {
+    uint8x16_t v = vld1q_u8(p);
+    uint8x16_t printable = vandq_u8(vcgeq_u8(v, vdupq_n_u8(32)),
+                                    vcleq_u8(v, vdupq_n_u8(126)));
+
+    vst1q_u8((uint8_t *)o, vbslq_u8(printable, v, vdupq_n_u8('.')));
+}
+
+#elif defined(__SSSE3__)
+/* ============================================================================
+ * 関数: hex16 / ascii16 (SSSE3)
+ *   上位/下位ニブルの文字を交互に並べた32バイト (A, B) から、
+ *   pshufb で3個の16バイト出力へ並べ替え、空白位置に ' ' を OR する
+ *   (シャッフル値 -128 の位置は0になる)
+ * ============================================================================ */
+#define Z (-128)
+static inline void hex16(char *o, const unsigned char *p) {
+    const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                                         '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    const __m128i m0a = _mm_setr_epi8(0, 1, Z, 2, 3, Z, 4, 5, Z, 6, 7, Z, 8, 9, Z, 10);
+    const __m128i m1a = _mm_setr_epi8(11, Z, 12, 13, Z, 14, 15, Z, Z, Z, Z, Z, Z, Z, Z, Z);
+    const __m128i m1b = _mm_setr_epi8(Z, Z, Z, Z, Z, Z, Z, Z, 0, 1, Z, 2, 3, Z, 4, 5);
+    const __m128i m2b = _mm_setr_epi8(Z, 6, 7, Z, 8, 9, Z, 10, 11, Z, 12, 13, Z, 14, 15, Z);
+    const __m128i sp0 = _mm_setr_epi8(0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0);
+    const __m128i sp1 = _mm_setr_epi8(0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0);
+    const __m128i sp2 = _mm_setr_epi8(' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ');
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+    __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(v, nibble));
+    __m128i a = _mm_unpacklo_epi8(hi, lo);
+    __m128i b = _mm_unpackhi_epi8(hi, lo);
+
+    _mm_storeu_si128((__m128i *)o,
+                     _mm_or_si128(_mm_shuffle_epi8(a, m0a), sp0));
+    _mm_storeu_si128((__m128i *)(o + 16),
+                     _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m1a),
+                                               _mm_shuffle_epi8(b, m1b)), sp1));
+    _mm_storeu_si128((__m128i *)(o + 32),
+                     _mm_or_si128(_mm_shuffle_epi8(b, m2b), sp2));
+}
+#undef Z
+
+static inline void ascii16(char *o, const unsigned char *p) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    /* 32..126 は符号付き比較でも正の範囲 (128以上は負となり除外される) */
+    __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(31)),
+                                      _mm_cmplt_epi8(v, _mm_set1_epi8(127)));
+
+    _mm_storeu_si128((__m128i *)o,
+                     _mm_or_si128(_mm_and_si128(printable, v),
+                                  _mm_andnot_si128(printable, _mm_set1_epi8('.'))));
+}
+
+#else
+static inline void hex16(char *o, const unsigned char *p) {
+    hex_scalar(o, p, 16);
+}
+
+static inline void ascii16(char *o, const unsigned char *p) {
+    ascii_scalar(o, p, 16);
+}
+#endif
+
+/* ============================================================================
+ * 関数: hex_dump_format
+ * 機能: data の16進ダンプとASCII表示を out へ書き込む
+ * ============================================================================ */
+size_t hex_dump_format(char *out, const unsigned char *data, size_t len) {
+    char *o = out;
+    size_t i;
+
+    /* 16進ダンプ (16バイト/行) */
+    for (i = 0; i + 16 <= len; i += 16) {
+        memcpy(o, HEX_PREFIX, HEX_PREFIX_LEN);
+        o += HEX_PREFIX_LEN;
+        hex16(o, data + i);
+        o += 48;
+        *o++ = '\n';
+    }
+    if (i < len) {
+        memcpy(o, HEX_PREFIX, HEX_PREFIX_LEN);
+        o += HEX_PREFIX_LEN;
+        o = hex_scalar(o, data + i, len - i);
+        *o++ = '\n';
+    }
+
+    /* ASCII 表示（表示可能文字のみ） */
+    memcpy(o, ASCII_PREFIX, ASCII_PREFIX_LEN);
+    o += ASCII_PREFIX_LEN;
+    for (i = 0; i + 16 <= len; i += 16) {
+        ascii16(o + i, data + i);
+    }
+    ascii_scalar(o + i, data + i, len - i);
+    o += len;
+    *o++ = '\n';
+
+    return (size_t)(o - out);
+}
@@ -0,0 +1,42 @@
+/*
+ * ============================================================================
+ * hex_dump.h - Packet Hex/ASCII Dump Formatter
+ * ============================================================================
+ * 機能:
+ *   - パケット全体の16進ダンプとASCII表示を1つの出力バッファへ生成する
+ *   - 1バイトごとの printf() を使わず、16バイト単位の変換カーネルで処理
+ *     (aarch64: NEON, x86: -mssse3 でビルドした場合のみ SSSE3, その他: テーブル参照)
+ *
+ * 出力形式 (16バイトごとに改行):
+ *   [HEX] 01 10 00 28 00 00 00 01 48 45 4c 4c 4f 20 45 4c
+ *   [HEX] 53 47 57
+ *   [ASCII] ...(....HELLO ELSGW
+ * ============================================================================
+ */
+
+#ifndef HEX_DUMP_H
+#define HEX_DUMP_H
+
+#include <stddef.h>
+
+/* ============================================================================
+ * マクロ: HEX_DUMP_MAX_SIZE
+ * 機能: len バイトのダンプに必要な出力バッファサイズ (上限値)
+ *   16進部: 1行あたり "[HEX] " (6) + 16 * "xx " (48) + 改行 (1)
+ *   ASCII部: "[ASCII] " (8) + len + 改行 (1)
+ * ============================================================================ */
+#define HEX_DUMP_MAX_SIZE(len) \
+    ((((len) + 15) / 16) * 55 + 8 + (len) + 1)
+
+/* ============================================================================
+ * 関数: hex_dump_format
+ * 機能: data の16進ダンプとASCII表示を out へ書き込む
+ * 引数:
+ *   out  - 出力先 (HEX_DUMP_MAX_SIZE(len) バイト以上)
+ *   data - ダンプ対象データ
+ *   len  - データ長
+ * 戻り値: 書き込んだバイト数 (終端NULは付加しない)
+ * ============================================================================ */
+size_t hex_dump_format(char *out, const unsigned char *data, size_t len);
+
+#endif /* HEX_DUMP_H */
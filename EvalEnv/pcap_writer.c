@@ -0,0 +1,194 @@
+/*
+ * ============================================================================
+ * pcap_writer.c - Segmented pcap Capture Writer
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+
+#include "pcap_writer.h"
+
+/* ============================================================================
+ * 関数: finish_segment
+ * 機能: セグメントの mmap を解除し、未使用部分を切り詰めて閉じる
+ * ============================================================================ */
+static void finish_segment(pcap_writer_t *w) {
+    if (w->map != NULL) {
+        munmap(w->map, w->segment_size);
+        w->map = NULL;
+    }
+    if (w->fd >= 0) {
+        if (ftruncate(w->fd, w->used) < 0) {
+            perror("[WARN] Failed to truncate capture segment");
+        }
+        close(w->fd);
+        w->fd = -1;
+    }
+}
+
+/* ============================================================================
+ * 関数: start_segment
+ * 機能: 次のセグメントファイルを作成・確保・mmap し、ファイルヘッダを書く
+ * ============================================================================ */
+static int start_segment(pcap_writer_t *w) {
+    char path[sizeof(w->prefix) + 16];
+    pcap_file_header_t hdr;
+    int err;
+
+    snprintf(path, sizeof(path), "%s_%04u.pcap", w->prefix, w->segment_no);
+
+    w->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (w->fd < 0) {
+        fprintf(stderr, "[ERROR] Failed to create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    /* 書き込み中にディスク不足で SIGBUS とならないよう実領域を確保する */
+    err = posix_fallocate(w->fd, 0, w->segment_size);
+    if (err != 0) {
+        fprintf(stderr, "[ERROR] Failed to allocate %s: %s\n", path, strerror(err));
+        close(w->fd);
+        w->fd = -1;
+        return -1;
+    }
+
+    w->map = mmap(NULL, w->segment_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                  w->fd, 0);
+    if (w->map == MAP_FAILED) {
+        perror("[ERROR] Failed to mmap capture segment");
+        w->map = NULL;
+        close(w->fd);
+        w->fd = -1;
+        return -1;
+    }
+    madvise(w->map, w->segment_size, MADV_SEQUENTIAL);
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = PCAP_MAGIC_NSEC;
+    hdr.version_major = PCAP_VERSION_MAJOR;
+    hdr.version_minor = PCAP_VERSION_MINOR;
+    hdr.snaplen = PCAP_SNAPLEN;
+    hdr.linktype = LINKTYPE_IPV4;
+    memcpy(w->map, &hdr, sizeof(hdr));
+    w->used = sizeof(hdr);
+
+    printf("[INFO] Capturing to %s\n", path);
+    fflush(stdout);
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: ip_checksum
+ * 機能: IPv4 ヘッダチェックサムを計算する
+ * ============================================================================ */
+static uint16_t ip_checksum(const void *data, size_t len) {
+    const uint16_t *p = data;
+    uint32_t sum = 0;
+
+    for (; len > 1; len -= 2) {
+        sum += *p++;
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return (uint16_t)~sum;
+}
+
+/* ============================================================================
+ * 関数: pcap_writer_open
+ * 機能: 最初のセグメントを作成して書き込みを開始する
+ * ============================================================================ */
+int pcap_writer_open(pcap_writer_t *w, const char *prefix, size_t segment_size) {
+    memset(w, 0, sizeof(*w));
+    w->fd = -1;
+    snprintf(w->prefix, sizeof(w->prefix), "%s", prefix);
+    w->segment_size = segment_size;
+
+    if (segment_size < sizeof(pcap_file_header_t) + sizeof(pcap_record_header_t) +
+                       PCAP_IP_UDP_HEADER_LEN + 65535) {
+        fprintf(stderr, "[ERROR] Capture segment size too small: %zu\n", segment_size);
+        return -1;
+    }
+    return start_segment(w);
+}
+
+/* ============================================================================
+ * 関数: pcap_writer_write
+ * 機能: パケット1個をセグメントへ追記する (満杯時は次のセグメントへ切替)
+ * ============================================================================ */
+int pcap_writer_write(pcap_writer_t *w, const struct timespec *ts,
+                      const struct sockaddr_in *sender,
+                      const struct sockaddr_in *dest,
+                      const unsigned char *data, size_t len) {
+    size_t record_len = sizeof(pcap_record_header_t) + PCAP_IP_UDP_HEADER_LEN + len;
+    pcap_record_header_t rec;
+    struct iphdr ip;
+    struct udphdr udp;
+    unsigned char *p;
+
+    if (w->map == NULL) {
+        return -1;
+    }
+
+    /* セグメント満杯なら次のセグメントへ */
+    if (w->used + record_len > w->segment_size) {
+        finish_segment(w);
+        w->segment_no++;
+        if (start_segment(w) < 0) {
+            return -1;
+        }
+    }
+
+    rec.ts_sec = (uint32_t)ts->tv_sec;
+    rec.ts_frac = (uint32_t)ts->tv_nsec;
+    rec.incl_len = (uint32_t)(PCAP_IP_UDP_HEADER_LEN + len);
+    rec.orig_len = rec.incl_len;
+
+    memset(&ip, 0, sizeof(ip));
+    ip.version = 4;
+    ip.ihl = 5;
+    ip.tot_len = htons((uint16_t)(PCAP_IP_UDP_HEADER_LEN + len));
+    ip.ttl = 1;
+    ip.protocol = IPPROTO_UDP;
+    ip.saddr = sender->sin_addr.s_addr;
+    ip.daddr = dest->sin_addr.s_addr;
+    ip.check = ip_checksum(&ip, sizeof(ip));
+
+    udp.source = sender->sin_port;
+    udp.dest = dest->sin_port;
+    udp.len = htons((uint16_t)(sizeof(udp) + len));
+    udp.check = 0;                      /* チェックサムなし (IPv4では任意) */
+
+    p = w->map + w->used;
+    memcpy(p, &rec, sizeof(rec));
+    p += sizeof(rec);
+    memcpy(p, &ip, sizeof(ip));
+    p += sizeof(ip);
+    memcpy(p, &udp, sizeof(udp));
+    p += sizeof(udp);
+    memcpy(p, data, len);
+
+    w->used += record_len;
+    w->packets++;
+    w->bytes += record_len;
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: pcap_writer_close
+ * 機能: 現在のセグメントを実サイズに切り詰めて閉じる
+ * ============================================================================ */
+void pcap_writer_close(pcap_writer_t *w) {
+    finish_segment(w);
+    printf("[INFO] Capture: %lu packets, %lu bytes in %u segment(s)\n",
+           w->packets, w->bytes, w->segment_no + 1);
+}
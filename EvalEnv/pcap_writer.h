@@ -0,0 +1,107 @@
+/*
+ * ============================================================================
+ * pcap_writer.h - Segmented pcap Capture Writer
+ * ============================================================================
+ * 機能:
+ *   - 受信パケットを pcap 形式 (ナノ秒精度, LINKTYPE_IPV4) のファイルへ保存
+ *   - ファイルは固定サイズのセグメント単位で事前確保して mmap し、
+ *     パケットごとのシステムコールは発行しない (セグメント切替時のみ)
+ *   - UDPペイロードの前に IPv4/UDP ヘッダを合成するため、
+ *     Wireshark/tcpdump でそのまま解析でき、ElsgwReplay で再送できる
+ *
+ * ファイル名: <prefix>_0000.pcap, <prefix>_0001.pcap, ...
+ * ============================================================================
+ */
+
+#ifndef PCAP_WRITER_H
+#define PCAP_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <netinet/in.h>
+
+/* ============================================================================
+ * pcap ファイル形式
+ * ============================================================================ */
+#define PCAP_MAGIC_USEC     0xa1b2c3d4  /* マイクロ秒精度 */
+#define PCAP_MAGIC_NSEC     0xa1b23c4d  /* ナノ秒精度 */
+#define PCAP_VERSION_MAJOR  2
+#define PCAP_VERSION_MINOR  4
+#define PCAP_SNAPLEN        65535
+#define LINKTYPE_ETHERNET   1
+#define LINKTYPE_RAW        101
+#define LINKTYPE_IPV4       228
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t  thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+} pcap_file_header_t;
+
+typedef struct {
+    uint32_t ts_sec;
+    uint32_t ts_frac;                   /* マイクロ秒またはナノ秒 */
+    uint32_t incl_len;
+    uint32_t orig_len;
+} pcap_record_header_t;
+
+/* 合成する IPv4 (20バイト) + UDP (8バイト) ヘッダ長 */
+#define PCAP_IP_UDP_HEADER_LEN  28
+
+/* ============================================================================
+ * 動作設定
+ * ============================================================================ */
+#define PCAP_SEGMENT_SIZE_DEFAULT   (64UL * 1024 * 1024)    /* 64MB */
+
+/* ============================================================================
+ * セグメント書き込み状態
+ * ============================================================================ */
+typedef struct {
+    char               prefix[256];     /* ファイル名の接頭辞 */
+    int                fd;              /* 現在のセグメントファイル */
+    unsigned char     *map;             /* セグメントの mmap 領域 */
+    size_t             segment_size;    /* セグメントサイズ */
+    size_t             used;            /* 書き込み済みバイト数 */
+    unsigned int       segment_no;      /* 現在のセグメント番号 */
+    unsigned long      packets;         /* 保存したパケット数 */
+    unsigned long      bytes;           /* 保存したバイト数 (ヘッダ含む) */
+} pcap_writer_t;
+
+/* ============================================================================
+ * 関数: pcap_writer_open
+ * 機能: 最初のセグメントを作成して書き込みを開始する
+ * 引数:
+ *   prefix       - ファイル名の接頭辞
+ *   segment_size - セグメントサイズ (バイト)
+ * 戻り値: 0 = 成功, -1 = 失敗
+ * ============================================================================ */
+int pcap_writer_open(pcap_writer_t *w, const char *prefix, size_t segment_size);
+
+/* ============================================================================
+ * 関数: pcap_writer_write
+ * 機能: パケット1個をセグメントへ追記する (満杯時は次のセグメントへ切替)
+ * 引数:
+ *   ts     - 受信時刻
+ *   sender - 送信元アドレス
+ *   dest   - 宛先アドレス (グループ:ポート)
+ *   data   - UDPペイロード
+ *   len    - ペイロード長
+ * 戻り値: 0 = 成功, -1 = 失敗
+ * ============================================================================ */
+int pcap_writer_write(pcap_writer_t *w, const struct timespec *ts,
+                      const struct sockaddr_in *sender,
+                      const struct sockaddr_in *dest,
+                      const unsigned char *data, size_t len);
+
+/* ============================================================================
+ * 関数: pcap_writer_close
+ * 機能: 現在のセグメントを実サイズに切り詰めて閉じる
+ * ============================================================================ */
+void pcap_writer_close(pcap_writer_t *w);
+
+#endif /* PCAP_WRITER_H */
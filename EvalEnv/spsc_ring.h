@@ -0,0 +1,226 @@
+/*
+ * ============================================================================
+ * spsc_ring.h - Lock-free Single-Producer/Single-Consumer Ring Index
+ * ============================================================================
+ * 機能:
+ *   - 受信スレッド (Producer) と処理スレッド (Consumer) 間のリングバッファ
+ *   - 本ヘッダはインデックス管理のみを行い、スロット実体は呼び出し側が
+ *     容量と同数の配列として確保する (スロット番号 = index & mask)
+ *   - Consumerが空で待機する場合のみ futex で起床させる
+ *     (Producer側は待機者がいない限りシステムコールを発行しない)
+ * ============================================================================
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#define SPSC_CACHE_LINE     64
+
+/* ============================================================================
+ * リング本体
+ *   head: Producerが次に書き込む位置 (Producerのみ更新)
+ *   tail: Consumerが次に読み出す位置 (Consumerのみ更新)
+ *   各インデックスは32bitで単調増加し、差分で使用量を求める
+ * ============================================================================ */
+typedef struct {
+    _Alignas(SPSC_CACHE_LINE) _Atomic uint32_t head;
+    uint32_t cached_tail;                   /* Producer側の tail キャッシュ */
+    _Alignas(SPSC_CACHE_LINE) _Atomic uint32_t tail;
+    uint32_t cached_head;                   /* Consumer側の head キャッシュ */
+    _Alignas(SPSC_CACHE_LINE) _Atomic uint32_t waiting;
+                                            /* Consumerが futex 待機中 */
+    uint32_t capacity;                      /* スロット数 (2のべき乗) */
+    uint32_t mask;                          /* capacity - 1 */
+} spsc_ring_t;
+
+/* ============================================================================
+ * 関数: spsc_ring_init
+ * 機能: リングを初期化する
+ * 引数:
+ *   capacity - スロット数 (2のべき乗であること)
+ * 戻り値: 0 = 成功, -1 = capacity が不正
+ * ============================================================================ */
+static inline int spsc_ring_init(spsc_ring_t *r, uint32_t capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return -1;
+    }
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->waiting, 0);
+    r->cached_tail = 0;
+    r->cached_head = 0;
+    r->capacity = capacity;
+    r->mask = capacity - 1;
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: spsc_ring_reserve (Producer)
+ * 機能: 書き込み可能な連続スロットを確保する
+ *   配列末尾で折り返さない範囲のみを返すため、返却された範囲は
+ *   recvmmsg() 等へそのまま渡せる
+ * 引数:
+ *   want  - 希望するスロット数
+ *   start - 先頭スロット番号の格納先
+ * 戻り値: 確保できたスロット数 (0 = リング満杯)
+ * ============================================================================ */
+static inline uint32_t spsc_ring_reserve(spsc_ring_t *r, uint32_t want,
+                                         uint32_t *start) {
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t free_slots = r->capacity - (head - r->cached_tail);
+    uint32_t to_end;
+
+    if (free_slots < want) {
+        r->cached_tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+        free_slots = r->capacity - (head - r->cached_tail);
+    }
+
+    *start = head & r->mask;
+    to_end = r->capacity - *start;
+    if (want > free_slots) want = free_slots;
+    if (want > to_end) want = to_end;
+    return want;
+}
+
+/* ============================================================================
+ * 関数: spsc_ring_publish (Producer)
+ * 機能: 書き込み済みスロットをConsumerへ公開し、待機中なら起床させる
+ * ============================================================================ */
+static inline void spsc_ring_publish(spsc_ring_t *r, uint32_t count) {
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+    atomic_store_explicit(&r->head, head + count, memory_order_seq_cst);
+    if (atomic_load_explicit(&r->waiting, memory_order_seq_cst)) {
+        atomic_store_explicit(&r->waiting, 0, memory_order_relaxed);
+        syscall(SYS_futex, &r->head, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+}
+
+/* ============================================================================
+ * 関数: spsc_ring_peek (Consumer)
+ * 機能: 読み出し可能なスロット数を取得する
+ * 引数:
+ *   start - 先頭インデックスの格納先 (スロット番号は (start + i) & mask)
+ * 戻り値: 読み出し可能なスロット数
+ * ============================================================================ */
+static inline uint32_t spsc_ring_peek(spsc_ring_t *r, uint32_t *start) {
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+    if (r->cached_head == tail) {
+        r->cached_head = atomic_load_explicit(&r->head, memory_order_acquire);
+    }
+    *start = tail;
+    return r->cached_head - tail;
+}
+
+/* ============================================================================
+ * 関数: spsc_ring_release (Consumer)
+ * 機能: 処理済みスロットをProducerへ返却する
+ * ============================================================================ */
+static inline void spsc_ring_release(spsc_ring_t *r, uint32_t count) {
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+    atomic_store_explicit(&r->tail, tail + count, memory_order_release);
+}
+
+/* ============================================================================
+ * 関数: spsc_ring_wait (Consumer)
+ * 機能: リングが空の間、futex で待機する
+ * 引数:
+ *   timeout_ms - 最大待機時間 (終了フラグ確認のため定期的に戻る)
+ * ============================================================================ */
+static inline void spsc_ring_wait(spsc_ring_t *r, int timeout_ms) {
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    struct timespec ts;
+
+    /* 短時間のスピンで到着を待つ (バースト中のシステムコールを避ける) */
+    for (int i = 0; i < 256; i++) {
+        if (atomic_load_explicit(&r->head, memory_order_acquire) != tail) {
+            return;
+        }
+    }
+
+    /* 待機を宣言した後に再確認し、取りこぼしを防ぐ */
+    atomic_store_explicit(&r->waiting, 1, memory_order_seq_cst);
+    if (atomic_load_explicit(&r->head, memory_order_seq_cst) != tail) {
+        atomic_store_explicit(&r->waiting, 0, memory_order_relaxed);
+        return;
+    }
+
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+    syscall(SYS_futex, &r->head, FUTEX_WAIT_PRIVATE, tail, &ts, NULL, 0);
+    atomic_store_explicit(&r->waiting, 0, memory_order_relaxed);
+}
+
+/* ============================================================================
+ * ドアベル (複数リングの Consumer 待機用)
+ *   1つの Consumer が複数のリングを読む場合に、リングごとの futex ではなく
+ *   共有のドアベルで待機する。Producer は公開後に spsc_doorbell_notify() を
+ *   呼ぶが、Consumer が待機を宣言していない限りシステムコールも共有変数への
+ *   書き込みも発生しない。
+ * ============================================================================ */
+typedef struct {
+    _Alignas(SPSC_CACHE_LINE) _Atomic uint32_t seq;
+                                            /* 起床ごとに増加 (futex 変数) */
+    _Atomic uint32_t waiting;               /* Consumerが待機を宣言中 */
+} spsc_doorbell_t;
+
+/* ============================================================================
+ * 関数: spsc_doorbell_notify (Producer)
+ * 機能: spsc_ring_publish() の後に呼び、待機中の Consumer を起床させる
+ *   公開 (head の書き込み) と waiting の読み出しの順序は seq_cst フェンスで
+ *   保証する。spsc_doorbell_prepare() 側のフェンスと対になり、どちらかが
+ *   必ず相手の書き込みを観測する (弱いメモリ順序の CPU でも起床を取りこぼさない)
+ * ============================================================================ */
+static inline void spsc_doorbell_notify(spsc_doorbell_t *db) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&db->waiting, memory_order_relaxed)) {
+        atomic_store_explicit(&db->waiting, 0, memory_order_relaxed);
+        atomic_fetch_add_explicit(&db->seq, 1, memory_order_seq_cst);
+        syscall(SYS_futex, &db->seq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+}
+
+/* ============================================================================
+ * 関数: spsc_doorbell_prepare (Consumer)
+ * 機能: 待機を宣言する。呼び出し後に全リングが空であることを再確認し、
+ *       空なら spsc_doorbell_wait()、空でなければ spsc_doorbell_cancel() を呼ぶ
+ *   waiting の書き込みと、その後のリングの再確認 (head の読み出し) の順序は
+ *   seq_cst フェンスで保証する (spsc_doorbell_notify() 側のフェンスと対)
+ * 戻り値: 現在の seq (spsc_doorbell_wait() へ渡す)
+ * ============================================================================ */
+static inline uint32_t spsc_doorbell_prepare(spsc_doorbell_t *db) {
+    uint32_t seq = atomic_load_explicit(&db->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&db->waiting, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    return seq;
+}
+
+static inline void spsc_doorbell_cancel(spsc_doorbell_t *db) {
+    atomic_store_explicit(&db->waiting, 0, memory_order_relaxed);
+}
+
+/* ============================================================================
+ * 関数: spsc_doorbell_wait (Consumer)
+ * 機能: 通知があるまで (最大 timeout_ms) futex で待機する
+ * ============================================================================ */
+static inline void spsc_doorbell_wait(spsc_doorbell_t *db, uint32_t seq,
+                                      int timeout_ms) {
+    struct timespec ts;
+
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+    syscall(SYS_futex, &db->seq, FUTEX_WAIT_PRIVATE, seq, &ts, NULL, 0);
+    atomic_store_explicit(&db->waiting, 0, memory_order_relaxed);
+}
+
+#endif /* SPSC_RING_H */
@@ -0,0 +1,375 @@
+/*
+ * ============================================================================
+ * tpacket_rx.c - AF_PACKET TPACKET_V3 Capture Backend
+ * ============================================================================
+ * ブロックの受け渡し:
+ *   1. カーネルがブロックを埋める (または TPACKET_RETIRE_MS 経過) と
+ *      block_status に TP_STATUS_USER が立つ
+ *   2. 受信スレッドがブロック内の各パケットの位置を受信リングへ公開し、
+ *      公開後のリング head を block_end に記録する
+ *   3. 処理スレッドのリング tail が block_end に達したら、そのブロックは
+ *      参照されないため TP_STATUS_KERNEL を書き込んでカーネルへ返却する
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+
+#include "tpacket_rx.h"
+
+#define POLL_TIMEOUT_MS     200     /* 受信待ちの最大時間 (終了フラグ確認用) */
+#define RELEASE_POLL_MS     1       /* 返却待ちブロックがある場合の待ち時間 */
+
+/* ============================================================================
+ * 関数: block_desc
+ * 機能: ブロック番号からブロック記述子を取得
+ * ============================================================================ */
+static inline struct tpacket_block_desc *block_desc(tpacket_rx_t *tp, uint32_t idx) {
+    return (struct tpacket_block_desc *)(tp->map + (size_t)idx * TPACKET_BLOCK_SIZE);
+}
+
+/* ============================================================================
+ * 関数: attach_filter
+ * 機能: ELSGW宛てUDP (非フラグメント) のみを通すBPFをソケットへ設定する
+ *   ldh [12]; jeq #ETH_P_IP          ; Ethernet Type
+ *   ldb [23]; jeq #IPPROTO_UDP       ; IP Protocol
+ *   ld  [30]; jeq #MULTICAST_GROUP   ; IP 宛先アドレス
+ *   ldh [20]; jset #0x1fff           ; フラグメントオフセット (後続断片は破棄)
+ *   ldxb 4*([14]&0xf); ldh [x+16]    ; UDP 宛先ポート
+ *   jeq #LISTEN_PORT
+ * ============================================================================ */
+static int attach_filter(int fd) {
+    uint32_t group = ntohl(inet_addr(MULTICAST_GROUP));
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 0, 10),
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 23),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 8),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 30),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, group, 0, 6),
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 20),
+        BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, 4, 0),
+        BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 14),
+        BPF_STMT(BPF_LD | BPF_H | BPF_IND, 16),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, LISTEN_PORT, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, 0x40000),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+    struct sock_fprog prog = {
+        .len = sizeof(code) / sizeof(code[0]),
+        .filter = code,
+    };
+
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+}
+
+/* ============================================================================
+ * 関数: tpacket_rx_open
+ * 機能: AF_PACKET ソケット、BPFフィルタ、mmap リングを準備する
+ * ============================================================================ */
+int tpacket_rx_open(tpacket_rx_t *tp, const char *ifname) {
+    struct tpacket_req3 req;
+    struct sockaddr_ll sll;
+    struct ip_mreqn mreq;
+    int version = TPACKET_V3;
+
+    memset(tp, 0, sizeof(*tp));
+    tp->fd = -1;
+    tp->join_fd = -1;
+    tp->map = MAP_FAILED;
+
+    tp->ifindex = if_nametoindex(ifname);
+    if (tp->ifindex == 0) {
+        fprintf(stderr, "[ERROR] Unknown interface: %s\n", ifname);
+        return -1;
+    }
+
+    /* フィルタ設定前のパケットを受けないよう、プロトコル0で作成してから bind */
+    tp->fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if (tp->fd < 0) {
+        perror("[ERROR] Failed to create AF_PACKET socket");
+        return -1;
+    }
+
+    if (attach_filter(tp->fd) < 0) {
+        perror("[ERROR] Failed to attach BPF filter");
+        goto fail;
+    }
+
+    if (setsockopt(tp->fd, SOL_PACKET, PACKET_VERSION,
+                   &version, sizeof(version)) < 0) {
+        perror("[ERROR] Failed to set TPACKET_V3");
+        goto fail;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = TPACKET_BLOCK_SIZE;
+    req.tp_block_nr = TPACKET_BLOCK_NR;
+    req.tp_frame_size = TPACKET_FRAME_SIZE;
+    req.tp_frame_nr = (TPACKET_BLOCK_SIZE / TPACKET_FRAME_SIZE) * TPACKET_BLOCK_NR;
+    req.tp_retire_blk_tov = TPACKET_RETIRE_MS;
+    if (setsockopt(tp->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+        perror("[ERROR] Failed to set up PACKET_RX_RING");
+        goto fail;
+    }
+
+    tp->map_size = (size_t)TPACKET_BLOCK_SIZE * TPACKET_BLOCK_NR;
+    tp->map = mmap(NULL, tp->map_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, tp->fd, 0);
+    if (tp->map == MAP_FAILED) {
+        perror("[ERROR] Failed to mmap packet ring");
+        goto fail;
+    }
+
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_IP);
+    sll.sll_ifindex = tp->ifindex;
+    if (bind(tp->fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+        perror("[ERROR] Failed to bind AF_PACKET socket");
+        goto fail;
+    }
+
+    /* スイッチ/NICへ配送させるため、未bindのUDPソケットでグループに参加する
+     * (ポートにbindしないため、このソケット自体にはパケットは溜まらない) */
+    tp->join_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (tp->join_fd < 0) {
+        perror("[ERROR] Failed to create multicast join socket");
+        goto fail;
+    }
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.imr_multiaddr.s_addr = inet_addr(MULTICAST_GROUP);
+    mreq.imr_ifindex = tp->ifindex;
+    if (setsockopt(tp->join_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+                   &mreq, sizeof(mreq)) < 0) {
+        perror("[ERROR] Failed to join multicast group");
+        goto fail;
+    }
+
+    printf("[INFO] TPACKET_V3 ring on %s: %d blocks x %d KB\n",
+           ifname, TPACKET_BLOCK_NR, TPACKET_BLOCK_SIZE / 1024);
+    printf("[INFO] Joined multicast group: %s\n", MULTICAST_GROUP);
+    return 0;
+
+fail:
+    tpacket_rx_close(tp);
+    return -1;
+}
+
+/* ============================================================================
+ * 関数: release_blocks
+ * 機能: 処理スレッドが参照し終えたブロックを古い順にカーネルへ返却する
+ * ============================================================================ */
+static void release_blocks(receiver_t *rx, tpacket_rx_t *tp) {
+    uint32_t tail = atomic_load_explicit(&rx->ring.tail, memory_order_acquire);
+    struct tpacket_block_desc *bd;
+
+    while (tp->pending > 0 &&
+           (int32_t)(tail - tp->block_end[tp->release_idx]) >= 0) {
+        bd = block_desc(tp, tp->release_idx);
+        __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL,
+                         __ATOMIC_RELEASE);
+        tp->release_idx = (tp->release_idx + 1) % TPACKET_BLOCK_NR;
+        tp->pending--;
+    }
+}
+
+/* ============================================================================
+ * 関数: parse_packet
+ * 機能: フレームから送信元とUDPペイロードを取り出してスロットへ設定する
+ * 戻り値: 1 = ELSGWパケット, 0 = 対象外
+ * ============================================================================ */
+static int parse_packet(struct tpacket3_hdr *hdr, rx_slot_t *slot) {
+    const struct sockaddr_ll *sll;
+    const struct iphdr *ip;
+    const struct udphdr *udp;
+    const unsigned char *net = (const unsigned char *)hdr + hdr->tp_net;
+    size_t avail = hdr->tp_snaplen - (hdr->tp_net - hdr->tp_mac);
+    size_t ihl, udp_len;
+
+    sll = (const struct sockaddr_ll *)((const unsigned char *)hdr +
+                                       TPACKET_ALIGN(sizeof(*hdr)));
+    if (sll->sll_pkttype == PACKET_OUTGOING || avail < sizeof(*ip)) {
+        return 0;
+    }
+
+    ip = (const struct iphdr *)net;
+    ihl = ip->ihl * 4;
+    if (avail < ihl + sizeof(*udp)) {
+        return 0;
+    }
+    udp = (const struct udphdr *)(net + ihl);
+    udp_len = ntohs(udp->len);
+    if (udp_len < sizeof(*udp)) {
+        return 0;
+    }
+
+    slot->payload = (const unsigned char *)udp + sizeof(*udp);
+    slot->len = udp_len - sizeof(*udp);
+    if (slot->len > avail - ihl - sizeof(*udp)) {
+        slot->len = avail - ihl - sizeof(*udp);
+    }
+    /* UDPソケット受信時と同じく BUFFER_SIZE を上限とする */
+    if (slot->len > BUFFER_SIZE) {
+        slot->len = BUFFER_SIZE;
+    }
+    slot->sender.sin_family = AF_INET;
+    slot->sender.sin_addr.s_addr = ip->saddr;
+    slot->sender.sin_port = udp->source;
+    slot->dest.sin_family = AF_INET;
+    slot->dest.sin_addr.s_addr = ip->daddr;
+    slot->dest.sin_port = udp->dest;
+    slot->rx_time.tv_sec = hdr->tp_sec;
+    slot->rx_time.tv_nsec = hdr->tp_nsec;
+    slot->ifindex = sll->sll_ifindex;
+    return 1;
+}
+
+/* ============================================================================
+ * 関数: walk_block
+ * 機能: 完了ブロック内の全パケットを受信リングへ公開する (コピーなし)
+ *       リング満杯の場合はドロップ数を計上する
+ * ============================================================================ */
+static void walk_block(receiver_t *rx, struct tpacket_block_desc *bd) {
+    struct tpacket3_hdr *hdr;
+    uint32_t remaining = bd->hdr.bh1.num_pkts;
+    uint32_t start, avail, filled;
+    unsigned long received = 0;
+
+    hdr = (struct tpacket3_hdr *)((unsigned char *)bd +
+                                  bd->hdr.bh1.offset_to_first_pkt);
+
+    while (remaining > 0) {
+        avail = spsc_ring_reserve(&rx->ring, remaining, &start);
+        filled = 0;
+
+        if (avail == 0) {
+            /* リング満杯: 残りは処理せず破棄 */
+            atomic_fetch_add_explicit(&rx->ring_drops, remaining,
+                                      memory_order_relaxed);
+            received += remaining;
+            break;
+        }
+
+        while (avail > 0 && remaining > 0) {
+            if (parse_packet(hdr, &rx->slots[start + filled])) {
+                filled++;
+                avail--;
+                received++;
+            }
+            remaining--;
+            hdr = (struct tpacket3_hdr *)((unsigned char *)hdr + hdr->tp_next_offset);
+        }
+        spsc_ring_publish(&rx->ring, filled);
+    }
+
+    atomic_fetch_add_explicit(&rx->rx_packets, received, memory_order_relaxed);
+}
+
+/* ============================================================================
+ * 関数: tpacket_rx_update_stats
+ * 機能: PACKET_STATISTICS を取得して積算し、rx->kernel_drops へ反映する
+ *       (カーネル側のカウンタは getsockopt のたびにリセットされる)
+ * ============================================================================ */
+void tpacket_rx_update_stats(receiver_t *rx, tpacket_rx_t *tp) {
+    struct tpacket_stats_v3 stats;
+    socklen_t len = sizeof(stats);
+
+    if (getsockopt(tp->fd, SOL_PACKET, PACKET_STATISTICS, &stats, &len) < 0) {
+        return;
+    }
+    tp->stat_packets += stats.tp_packets;
+    tp->stat_drops += stats.tp_drops;
+    tp->stat_freezes += stats.tp_freeze_q_cnt;
+    atomic_store_explicit(&rx->kernel_drops, tp->stat_drops, memory_order_relaxed);
+}
+
+/* ============================================================================
+ * 関数: poll_stats
+ * 機能: 取得周期に達していればカーネル統計を更新する
+ * ============================================================================ */
+static void poll_stats(receiver_t *rx, tpacket_rx_t *tp) {
+    struct timespec ts;
+    long long now;
+
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    now = (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    if (now >= tp->next_stats_ns) {
+        tpacket_rx_update_stats(rx, tp);
+        tp->next_stats_ns = now + TPACKET_STATS_MS * 1000000LL;
+    }
+}
+
+/* ============================================================================
+ * 関数: tpacket_rx_loop
+ * 機能: 受信スレッド本体。完了ブロックを順に読み、リングへ公開する
+ * ============================================================================ */
+void tpacket_rx_loop(receiver_t *rx, tpacket_rx_t *tp) {
+    struct tpacket_block_desc *bd;
+    struct pollfd pfd;
+    uint32_t status;
+
+    pfd.fd = tp->fd;
+    pfd.events = POLLIN | POLLERR;
+
+    while (g_running) {
+        release_blocks(rx, tp);
+        poll_stats(rx, tp);
+
+        /* 全ブロックが処理スレッドの参照待ちなら返却を待つ */
+        bd = block_desc(tp, tp->walk_idx);
+        status = __atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE);
+        if (tp->pending == TPACKET_BLOCK_NR || !(status & TP_STATUS_USER)) {
+            pfd.revents = 0;
+            if (poll(&pfd, 1, tp->pending > 0 ? RELEASE_POLL_MS : POLL_TIMEOUT_MS) < 0 &&
+                errno != EINTR) {
+                perror("[ERROR] poll failed");
+            }
+            continue;
+        }
+
+        walk_block(rx, bd);
+        tp->block_end[tp->walk_idx] =
+            atomic_load_explicit(&rx->ring.head, memory_order_relaxed);
+        tp->walk_idx = (tp->walk_idx + 1) % TPACKET_BLOCK_NR;
+        tp->pending++;
+    }
+}
+
+/* ============================================================================
+ * 関数: tpacket_rx_close
+ * 機能: カーネル側の統計 (積算値) を表示し、リングとソケットを解放する
+ *       (最新値は呼び出し前に tpacket_rx_update_stats で取り込んでおく)
+ * ============================================================================ */
+void tpacket_rx_close(tpacket_rx_t *tp) {
+    if (tp->fd >= 0 && tp->map != MAP_FAILED) {
+        printf("[INFO] AF_PACKET: packets=%lu, kernel drops=%lu, queue freezes=%lu\n",
+               tp->stat_packets, tp->stat_drops, tp->stat_freezes);
+    }
+    if (tp->map != MAP_FAILED) {
+        munmap(tp->map, tp->map_size);
+        tp->map = MAP_FAILED;
+    }
+    if (tp->join_fd >= 0) {
+        close(tp->join_fd);
+        tp->join_fd = -1;
+    }
+    if (tp->fd >= 0) {
+        close(tp->fd);
+        tp->fd = -1;
+    }
+}
@@ -0,0 +1,78 @@
+/*
+ * ============================================================================
+ * tpacket_rx.h - AF_PACKET TPACKET_V3 Capture Backend
+ * ============================================================================
+ * 機能:
+ *   - 指定インターフェースの AF_PACKET ソケットに TPACKET_V3 の mmap リングを
+ *     設定し、カーネル内BPFで ELSGW (MULTICAST_GROUP:LISTEN_PORT) のみを受信
+ *   - 完了ブロック内のパケットをコピーせず、そのまま受信リングへ公開する
+ *   - ブロックは処理スレッドが中の全パケットを処理し終えてからカーネルへ返却
+ * ============================================================================
+ */
+
+#ifndef TPACKET_RX_H
+#define TPACKET_RX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "elsgw_receiver.h"
+
+/* ============================================================================
+ * 動作設定
+ * ============================================================================ */
+#define TPACKET_BLOCK_SIZE  (1 << 18)   /* ブロックサイズ (256KB) */
+#define TPACKET_BLOCK_NR    16          /* ブロック数 */
+#define TPACKET_FRAME_SIZE  2048        /* フレームサイズ (V3では目安値) */
+#define TPACKET_RETIRE_MS   1           /* 未満杯ブロックの引き渡し時間 (ミリ秒) */
+#define TPACKET_STATS_MS    1000        /* カーネル統計の取得周期 (ミリ秒) */
+
+/* ============================================================================
+ * AF_PACKET 受信状態
+ * ============================================================================ */
+typedef struct {
+    int            fd;                  /* AF_PACKET ソケット */
+    int            join_fd;             /* マルチキャスト参加 (IGMP) 用ソケット */
+    int            ifindex;             /* 受信インターフェース番号 */
+    unsigned char *map;                 /* mmap したブロック領域 */
+    size_t         map_size;            /* mmap サイズ */
+    uint32_t       block_end[TPACKET_BLOCK_NR];
+                                        /* 各ブロックの公開終了位置 (リングhead) */
+    uint32_t       walk_idx;            /* 次に読むブロック */
+    uint32_t       release_idx;         /* 次に返却するブロック */
+    uint32_t       pending;             /* 読み終えて未返却のブロック数 */
+    long long      next_stats_ns;       /* 次にカーネル統計を取得する時刻 */
+    /* カーネル統計の積算値 (カーネル側は取得ごとにリセットされる) */
+    unsigned long  stat_packets;        /* 受信数 */
+    unsigned long  stat_drops;          /* リング満杯による破棄数 */
+    unsigned long  stat_freezes;        /* キュー凍結回数 */
+} tpacket_rx_t;
+
+/* ============================================================================
+ * 関数: tpacket_rx_open
+ * 機能: AF_PACKET ソケット、BPFフィルタ、mmap リングを準備する
+ * 引数:
+ *   ifname - 受信インターフェース名 (例: "eth0")
+ * 戻り値: 0 = 成功, -1 = 失敗
+ * ============================================================================ */
+int tpacket_rx_open(tpacket_rx_t *tp, const char *ifname);
+
+/* ============================================================================
+ * 関数: tpacket_rx_loop
+ * 機能: 受信スレッド本体 (g_running が 0 になるまで戻らない)
+ * ============================================================================ */
+void tpacket_rx_loop(receiver_t *rx, tpacket_rx_t *tp);
+
+/* ============================================================================
+ * 関数: tpacket_rx_update_stats
+ * 機能: PACKET_STATISTICS を取得して積算し、rx->kernel_drops へ反映する
+ * ============================================================================ */
+void tpacket_rx_update_stats(receiver_t *rx, tpacket_rx_t *tp);
+
+/* ============================================================================
+ * 関数: tpacket_rx_close
+ * 機能: カーネル側の統計 (積算値) を表示し、リングとソケットを解放する
+ * ============================================================================ */
+void tpacket_rx_close(tpacket_rx_t *tp);
+
+#endif /* TPACKET_RX_H */
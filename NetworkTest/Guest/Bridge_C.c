@@ -5,20 +5,112 @@
  * 機能:
  *   - ABOS2からの往路接続を受信 (Server機能: 192.168.100.1:8000)
  *   - ABOS2へ応答を返信 (Client機能: 192.168.200.2:8000へ接続)
+ *   - 往路の1接続で改行区切りの複数メッセージを受信
+ *     (改行なしで切断する従来のクライアントは、切断時に1メッセージとして扱う)
+ *   - 復路接続を維持して再利用 (メッセージごとの接続・TIME_WAIT をなくす)
+ *     切断を検出したら送信待ちの応答を保持したまま再接続する
+ *   - 復路の配送: 応答は宛先ごとの上限付き送信キューに入れ、
+ *     再接続はタイマホイール (timer_wheel.h) で指数バックオフ + ジッタの
+ *     間隔で行い、接続できたら溜まった応答をまとめて送る。
+ *     キューの深さ・保持期限・ドロップポリシーはオプションで指定し、
+ *     -S で配送状態を定期的に表示する。破棄した応答は ABOS2 へ通知しない
+ *     (溢れたキューと同じ復路では通知も届かないため。Client_C は応答待ちの
+ *      タイムアウトで失われた要求として数える)
+ *   - epoll による単一スレッドのイベントループで全接続を処理する
+ *     受け入れ・受信・復路接続はすべて非ブロッキングの状態遷移で進め、
+ *     ABOS2 の復路が遅い・つながらない場合も他の往路接続は止まらない
+ *     (応答は復路ごとの送信キューに溜め、溢れた応答は破棄する)
+ *   - 長さヘッダと相関IDを持つフレーム形式 (frame_protocol.h) に対応
+ *     最初のバイトで往路接続ごとに形式を判定し、フレーム形式の要求には
+ *     同じ相関IDのフレームで応答する。分割受信・まとめ受信を再組み立てし、
+ *     1接続で複数の要求を続けて送る (パイプライン) ことができる
+ *   - ワーカーモード (-w): CPUごとに固定したワーカースレッドを起動し、
+ *     各ワーカーが SO_REUSEPORT の待ち受けソケット・epoll・復路接続・
+ *     送信キュー・タイマを個別に持つ (往路接続はカーネルがワーカーに
+ *     振り分け、メッセージ処理の経路ではスレッド間で何も共有しない)。
+ *     終了時 (Ctrl+C) にワーカーごとと全体の処理メッセージ数/秒を表示する
+ *   - パススルーモード (-P): フレーム形式の要求は、応答ヘッダ (フレーム
+ *     ヘッダ + 応答文) を送ったあと、要求本体を往路ソケットから pipe 経由で
+ *     復路ソケットへ splice() で中継する (ユーザ空間へのコピーなし)。
+ *     往路接続ごとに専用の復路接続を使い、送信キューには入れない
+ *     (復路が切断された場合は往路接続も閉じる)。大きなメッセージ向け。
+ *     終了時の集計に要求本体のバイト数と1バイトあたりのCPU時間を表示する
+ *   - 段階ごとの計測 (-T): 受け入れ -> 最初の受信、受信 -> 応答の
+ *     キュー投入、復路の接続、キュー投入 -> 送信完了 の所要時間と
+ *     処理数のカウンタをワーカーごとに共有メモリ (stage_probe.h) へ記録する。
+ *     実行中に StageStat で表示する
+ *   - 非同期ログ (async_log.h): 受信・送信・接続のログは書式IDと引数を
+ *     スレッドごとのリングに書くのみで、整形と出力はバックグラウンドの
+ *     スレッドがまとめて行う (ワーカーは write() で止まらない)。
+ *     -l でバイナリのまま出力し、LogDecode で後から表示する。
+ *     レベル・流量制限は環境変数 ABOS_LOG_LEVEL / ABOS_LOG_RATE で指定する
+ *   - UDP 転送 (-u): TCP に加えて、要求・応答を UDP データグラム1個ずつで
+ *     受け付ける (udp_transport.h)。復路の接続・受け入れがなく、小さな
+ *     メッセージの往復を短くする。要求は recvmmsg() でまとめて受信し、
+ *     応答は sendmmsg() でまとめて送る。重複した要求は処理せず、ACK が
+ *     届くまで保持した応答を送り直す (セッションはワーカーごとに
+ *     UDP_SESSIONS 個まで)
+ *   - 低遅延プロファイル (-F): 往路の待ち受け・復路の接続に TCP Fast Open、
+ *     TCP_NODELAY・TCP_QUICKACK (受信ごと)・SO_BUSY_POLL・固定の送受信
+ *     バッファを設定する (socket_profile.h, Client_C -F と同じ設定)。
+ *     Fast Open は応答ごとの接続 (-o) のみで使い、最初の応答を SYN に載せる
+ *     (3ウェイハンドシェイクの往復がなくなる)。維持する復路の接続と
+ *     中継 (-P) の接続は使わない。両側で net.ipv4.tcp_fastopen = 3 が必要
  *
  * 通信経路:
  *   [往路] ABOS2 (192.168.100.2) -> ABOS1 (192.168.100.1:8000)
  *   [復路] ABOS1 (192.168.200.1) -> ABOS2 (192.168.200.2:8000)
+ *   (-u: 同じアドレス・ポートの UDP。ACK は 192.168.200.2 から応答の送信元へ)
+ *
+ * 使い方:
+ *   ./Bridge_C [-o] [-P] [-u] [-F] [-q] [-T] [-l ファイル] [-w ワーカー数] [-Q 応答数]
+ *              [-A 保持期限ms] [-D new|old] [-S 秒]
+ *     -o  従来動作: 応答ごとに復路接続を作成して切断する
+ *     -P  フレーム形式の要求本体を splice() で復路へ中継する
+ *     -u  UDP の要求も受け付ける (Client_C -u, TCP と同時に使える)
+ *     -F  低遅延のソケット設定 (TCP Fast Open ほか, socket_profile.h)
+ *     -q  メッセージごとの表示を省略する (多数接続時)
+ *     -T  段階ごとの所要時間を共有メモリに記録する (StageStat で表示)
+ *     -l  ログをバイナリ形式でファイルに出力する (LogDecode で表示)
+ *     -w  ワーカースレッド数 (既定: 1, ワーカー i は CPU i に固定し、
+ *         送信キュー・復路接続はワーカーごとに持つ)
+ *     -Q  送信キューに入れる応答数の上限 (既定: 65536,
+ *         -o では未送信の復路接続数の上限)
+ *     -A  送信キューでの保持期限 (ミリ秒, 既定: 30000, 0 = 無期限)
+ *     -D  キューが一杯の場合に破棄する応答 (new = 新しい応答 (既定),
+ *         old = 未送信の最も古い応答)
+ *     -S  配送状態の表示間隔 (秒, 既定: 0 = 表示しない, ワーカーごと)
+ *
+ * ビルド:
+ *   gcc -O2 -Wall -pthread -o Bridge_C Bridge_C.c
  * ============================================================================
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
 #include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/eventfd.h>
+
+#include "frame_protocol.h"
+#include "timer_wheel.h"
+#include "stage_probe.h"
+#include "async_log.h"
+#include "udp_transport.h"
+#include "socket_profile.h"
 
 /* ============================================================================
  * ネットワーク設定
@@ -35,17 +127,272 @@
 /* ============================================================================
  * 動作設定
  * ============================================================================ */
-#define RETRY_DELAY             1       /* 接続リトライ間隔 (秒) */
+#define RETRY_DELAY             1       /* 待ち受け開始のリトライ間隔 (秒) */
+#define RETRY_BASE_MS           100     /* 復路の再接続間隔の初期値 (ms) */
+#define RETRY_MAX_MS            10000   /* 復路の再接続間隔の上限 (ms) */
 #define BUFFER_SIZE             1024    /* バッファサイズ */
-#define MAX_PENDING             5       /* 待ち受けキューの最大数 */
+#define MAX_PENDING             SOMAXCONN   /* 待ち受けキューの最大数 */
+#define MAX_EVENTS              256     /* epoll_wait 1回で取り出すイベント数 */
+#define INBOUND_READ_ROUNDS     16      /* 1イベントで1接続から読む最大回数 */
+#define RETURN_QUEUE_SIZE       (64 * 1024 * 1024)  /* 維持する復路の送信キュー (バイト) */
+#define DELIVERY_QUEUE_DEPTH    65536   /* 送信キューの応答数の上限 (既定) */
+#define DELIVERY_MAX_AGE_MS     30000   /* 送信キューでの保持期限 (既定, ms) */
+#define WORKER_MAX              64      /* ワーカースレッド数の上限 */
+#define RELAY_PIPE_SIZE         (1024 * 1024)   /* パススルーの pipe 容量 (バイト) */
+#define RELAY_ROUNDS            64      /* 1イベントで1接続の splice を行う最大回数 */
+#define KEEPALIVE_IDLE          5       /* キープアライブ開始までの無通信時間 (秒) */
+#define KEEPALIVE_INTERVAL      1       /* キープアライブ間隔 (秒) */
+#define KEEPALIVE_COUNT         3       /* 切断と判定するまでの無応答回数 */
+#define UDP_SESSIONS            16      /* ワーカーごとに保持する UDP のセッション数 */
+#define UDP_BATCH               64      /* recvmmsg / sendmmsg 1回のデータグラム数 */
+#define UDP_SOCKET_BUFFER       (4 * 1024 * 1024)   /* UDP ソケットの送受信バッファ */
 #define TRUE                    1
 
+/* ============================================================================
+ * 段階ごとの計測 (-T) の段階・カウンタ番号 (stage_names / counter_names の順)
+ * ============================================================================ */
+enum {
+    STAGE_ACCEPT,                       /* 受け入れ -> 最初の受信 */
+    STAGE_RESPONSE,                     /* 受信 -> 応答をキューへ投入 */
+    STAGE_CONNECT,                      /* 復路の接続開始 -> 接続完了 */
+    STAGE_DELIVER,                      /* キューへ投入 -> 送信完了 */
+};
+enum {
+    COUNTER_MESSAGES,
+    COUNTER_DELIVERED,
+    COUNTER_DROPPED,
+    COUNTER_CONNECTS,
+};
+
+static const char *const stage_names[] = {
+    "accept->first_byte", "read->queued", "return_connect", "queued->sent",
+};
+static const char *const counter_names[] = {
+    "messages", "delivered", "dropped", "connects",
+};
+
+/* ============================================================================
+ * epoll に登録する対象の種別 (各構造体の先頭メンバ)
+ * ============================================================================ */
+typedef enum {
+    EV_LISTENER,                        /* 往路の待ち受けソケット */
+    EV_INBOUND,                         /* 往路接続 */
+    EV_RETURN,                          /* 復路接続 */
+    EV_RELAY,                           /* パススルーの復路接続 */
+    EV_UDP_REQUEST,                     /* UDP の往路 (要求) ソケット */
+    EV_UDP_ACK,                         /* UDP の復路 (応答の送信・ACK の受信) ソケット */
+    EV_STOP,                            /* 終了通知 (eventfd) */
+} ev_kind_t;
+
+/* ============================================================================
+ * 往路接続のメッセージ形式 (最初に受信したバイトで判定する)
+ * ============================================================================ */
+typedef enum {
+    WIRE_UNKNOWN,                       /* 未受信 */
+    WIRE_TEXT,                          /* 改行区切りのテキスト (従来形式) */
+    WIRE_FRAMED,                        /* フレーム形式 */
+    WIRE_RELAY,                         /* フレーム形式 (パススルー) */
+} wire_mode_t;
+
+struct relay;
+
+/* ============================================================================
+ * 往路接続の管理情報
+ * ============================================================================ */
+typedef struct {
+    ev_kind_t      kind;                /* EV_INBOUND */
+    int            fd;                  /* ソケット (-1 = 閉じた) */
+    wire_mode_t    mode;
+    uint32_t       events;              /* epoll に登録中のイベント (パススルー時) */
+    frame_buffer_t in;                  /* 受信バッファ (未完成の行・フレーム) */
+    struct relay  *relay;               /* パススルーの中継 (WIRE_RELAY 時) */
+    long long      accepted_ns;         /* 受け入れた時刻 (-T 時, ns) */
+} inbound_conn_t;
+
+/* ============================================================================
+ * パススルーの中継 (往路接続1個に専用の復路接続と pipe を持つ)
+ *   応答ヘッダ head を送り終えてから、要求本体 remaining バイトを
+ *   往路ソケット -> pipe -> 復路ソケット の順に splice() で移す
+ * ============================================================================ */
+typedef struct relay {
+    ev_kind_t       kind;               /* EV_RELAY */
+    int             fd;                 /* 復路ソケット (-1 = 閉じた) */
+    int             connected;          /* 1 = 接続済み */
+    uint32_t        events;             /* epoll に登録中のイベント */
+    int             pipe_fd[2];
+    size_t          pipe_size;          /* pipe の容量 */
+    size_t          in_pipe;            /* pipe 内の未送信バイト数 */
+    size_t          remaining;          /* 往路から未読の本体バイト数 */
+    int             active;             /* 1 = フレームの中継中 */
+    size_t          head_off, head_len; /* 応答ヘッダの送信済み位置と長さ */
+    inbound_conn_t *owner;
+    struct relay   *next_closed;        /* 解放待ちのリスト */
+    unsigned char   head[FRAME_HEADER_SIZE + BUFFER_SIZE];
+} relay_t;
+
+/* ============================================================================
+ * 復路接続の状態
+ *   IDLE -> CONNECTING -> CONNECTED -> (切断) -> IDLE / BACKOFF
+ *   接続失敗時は BACKOFF で再接続タイマの満了 (指数バックオフ) を待つ
+ * ============================================================================ */
+typedef enum {
+    RETURN_IDLE,                        /* 未接続 (送信待ちなし) */
+    RETURN_CONNECTING,                  /* 非ブロッキング接続の完了待ち */
+    RETURN_CONNECTED,                   /* 接続済み */
+    RETURN_BACKOFF,                     /* 再接続までの待ち */
+} return_state_t;
+
+/* ============================================================================
+ * 送信キューが一杯の場合のドロップポリシー
+ * ============================================================================ */
+typedef enum {
+    DROP_NEWEST,                        /* 新しい応答を破棄する */
+    DROP_OLDEST,                        /* 未送信の最も古い応答を破棄する */
+} drop_policy_t;
+
+/* ============================================================================
+ * 送信キュー内の応答1個 (バイト列はキューに連続して格納する)
+ * ============================================================================ */
+typedef struct {
+    uint32_t  len;                      /* 応答のバイト数 */
+    long long queued_at;                /* キューに入れた時刻 (ms) */
+    long long queued_ns;                /* キューに入れた時刻 (-T 時, ns) */
+} delivery_msg_t;
+
+/* ============================================================================
+ * 復路接続の管理情報 (宛先ごとの送信キューを持つ)
+ * ============================================================================ */
+typedef struct return_conn {
+    ev_kind_t           kind;           /* EV_RETURN */
+    int                 fd;             /* ソケット (-1 = 未接続) */
+    return_state_t      state;
+    int                 persistent;     /* 1 = 接続を維持して再利用する */
+    uint32_t            events;         /* epoll に登録中のイベント */
+    int                 attempts;       /* 連続した再接続の回数 (バックオフの指数) */
+    long long           down_since;     /* 送信できなくなった時刻 (ms, 0 = 正常) */
+    long long           connect_ns;     /* 接続を開始した時刻 (-T 時, ns) */
+    int                 overflowed;     /* キューが溢れて破棄を表示済み */
+    int                 fastopen;       /* 1 = Fast Open で接続し、確立を未確認 */
+    wheel_timer_t       retry;          /* 再接続タイマ */
+    delivery_msg_t     *msgs;           /* 応答のリング (msg_first から msg_count 個) */
+    size_t              msg_cap, msg_first, msg_count;
+    size_t              msg_start;      /* 先頭の応答 (送信途中の場合あり) の位置 */
+    size_t              head, tail;     /* 送信待ちの範囲 [head, tail) */
+    size_t              capacity;
+    char                queue[];        /* 送信キュー (改行区切り・フレームの応答) */
+} return_conn_t;
+
+/* ============================================================================
+ * UDP で送った応答 (ACK が届くまで、重複した要求に送り直すため保持する)
+ * ============================================================================ */
+typedef struct {
+    uint32_t      seq;                  /* 要求番号 (0 = 空き) */
+    uint16_t      len;                  /* データグラムのバイト数 */
+    uint8_t       acked;                /* 1 = ACK を受信済み */
+    unsigned char data[UDPT_DATAGRAM_MAX];
+} udp_reply_t;
+
+/* ============================================================================
+ * UDP のセッション (クライアントの起動ごと。応答は 要求番号 % UDPT_WINDOW)
+ * ============================================================================ */
+typedef struct {
+    uint32_t      id;                   /* セッションID (0 = 空き) */
+    long long     last_seen;            /* 最後に要求を受信した時刻 (ms) */
+    udpt_window_t window;               /* 受信済みの要求番号 */
+    udp_reply_t   replies[UDPT_WINDOW];
+} udp_session_t;
+
+/* ============================================================================
+ * 起動オプション
+ * ============================================================================ */
+typedef struct {
+    int           persistent;           /* 1 = 復路接続を維持する */
+    int           passthrough;          /* 1 = フレーム本体を splice() で中継 */
+    int           quiet;                /* 1 = メッセージごとの表示を省略 */
+    size_t        queue_depth;          /* 送信キューの応答数の上限 */
+    long long     max_age_ms;           /* 送信キューでの保持期限 (0 = 無期限) */
+    drop_policy_t policy;               /* キューが一杯の場合のドロップポリシー */
+    int           stats_interval;       /* 配送状態の表示間隔 (秒, 0 = なし) */
+    int           workers;              /* ワーカースレッド数 */
+    int           udp;                  /* 1 = UDP の要求・応答も受け付ける */
+    sock_profile_t profile;             /* TCP ソケットの設定 (-F = 低遅延) */
+} bridge_config_t;
+
+/* ============================================================================
+ * ワーカーごとのブリッジの管理情報 (ワーカースレッドのみが参照する)
+ * ============================================================================ */
+typedef struct {
+    int                id;              /* ワーカー番号 */
+    int                cpu;             /* 固定したCPU (-1 = 固定なし) */
+    pthread_t          thread;
+    int                epfd;
+    int                listen_fd;
+    int                spare_fd;        /* fd 枯渇時に接続を断るための予備 */
+    int                persistent;      /* 1 = 復路接続を維持する */
+    int                passthrough;     /* 1 = フレーム本体を splice() で中継 */
+    int                quiet;           /* 1 = メッセージごとの表示を省略 */
+    sock_profile_t     profile;         /* TCP ソケットの設定 */
+    struct sockaddr_in dest;            /* 復路の接続先 (ABOS2) */
+    struct sockaddr_in src;             /* 復路の送信元 (192.168.200.1) */
+    return_conn_t     *shared;          /* 維持する復路接続 (persistent 時) */
+    timer_wheel_t      wheel;           /* 再接続・定期表示のタイマ */
+    wheel_timer_t      stats_timer;
+    long long          now;             /* イベント処理中の時刻 (ms) */
+    size_t             queue_depth;     /* 送信キューの応答数の上限 */
+    long long          max_age_ms;      /* 送信キューでの保持期限 (0 = 無期限) */
+    drop_policy_t      policy;
+    int                stats_interval;  /* 配送状態の表示間隔 (秒, 0 = なし) */
+    unsigned int       seed;            /* 再接続のジッタ用の乱数 */
+    unsigned long      oneshot_pending; /* 未送信の応答ごとの復路接続数 */
+    unsigned long      active;          /* 接続中の往路数 */
+    unsigned long      accepted;        /* 受け入れた往路数 */
+    unsigned long      messages;        /* 受信メッセージ数 */
+    unsigned long      frames;          /* うちフレーム形式の要求数 */
+    unsigned long      dropped;         /* 送信キュー溢れで破棄した応答数 */
+    unsigned long      expired;         /* 保持期限切れで破棄した応答数 */
+    unsigned long      delivered;       /* 送信し終えた応答数 */
+    unsigned long      retries;         /* 再接続タイマの満了回数 */
+    unsigned long      connects;        /* 復路の接続回数 */
+    unsigned long      reuses;          /* 接続済みの復路へ送った応答数 */
+    unsigned long      failures;        /* 復路の接続失敗・切断の回数 */
+    unsigned long      stats_messages;  /* 前回の定期表示時の受信メッセージ数 */
+    long long          stats_at;        /* 前回の定期表示の時刻 (ms) */
+    long long          first_message;   /* 最初・最後にメッセージを受信した時刻 */
+    long long          last_message;
+    unsigned long long bytes;           /* 受信したフレーム本体のバイト数 */
+    long long          cpu_ns;          /* ワーカーが使ったCPU時間 (終了時) */
+    relay_t           *closed;          /* イベント処理後に解放する中継 */
+    stage_slot_t      *probe;           /* 段階ごとの計測 (NULL = -T なし) */
+    long long          read_ns;         /* 処理中のメッセージを受信した時刻 (ns) */
+    int                udp_fd;          /* UDP の往路ソケット (-1 = -u なし) */
+    int                udp_ack_fd;      /* UDP の復路ソケット (192.168.200.1:自動) */
+    udp_session_t     *sessions;        /* UDP のセッション (UDP_SESSIONS 個) */
+    unsigned char    (*udp_rx)[UDPT_DATAGRAM_MAX];  /* 受信バッファ (UDP_BATCH 個) */
+    unsigned long      udp_requests;    /* 処理した UDP の要求数 */
+    unsigned long      udp_duplicates;  /* 重複した要求数 */
+    unsigned long      udp_resent;      /* 重複した要求に送り直した応答数 */
+    unsigned long      udp_acks;        /* 受信した ACK 数 (重複を除く) */
+    unsigned long      udp_sessions;    /* 開始したセッション数 */
+    unsigned long      udp_errors;      /* 不正なデータグラム・送信失敗の数 */
+} bridge_t;
+
+static ev_kind_t listener_kind = EV_LISTENER;
+static ev_kind_t stop_kind = EV_STOP;
+static ev_kind_t udp_request_kind = EV_UDP_REQUEST;
+static ev_kind_t udp_ack_kind = EV_UDP_ACK;
+
+volatile sig_atomic_t g_running = 1;
+stage_shm_t *g_stages = NULL;           /* 段階ごとの計測の共有メモリ (-T) */
+
 /* ============================================================================
  * プログラム情報
  * ============================================================================ */
 const char *RESPONDER_HOST_NAME = "ABOS1";
 const char *RESPONDER_LANGUAGE  = "C";
 
+void return_conn_connect(bridge_t *b, return_conn_t *rc);
+void return_conn_on_retry(wheel_timer_t *t, void *arg);
+
 /* ============================================================================
  * 関数: generate_response
  * 機能: ABOS2へ返信する応答メッセージを生成
@@ -54,208 +401,2096 @@ const char *RESPONDER_LANGUAGE  = "C";
  *   buffer_size     - バッファサイズ
  *   client_message  - ABOS2から受信したメッセージ
  * ============================================================================ */
-void generate_response(char *response_buffer, size_t buffer_size, 
+void generate_response(char *response_buffer, size_t buffer_size,
                        const char *client_message) {
     snprintf(response_buffer, buffer_size,
              "Response from %s written by %s via %s --- Received: %s",
-             RESPONDER_HOST_NAME, RESPONDER_LANGUAGE, 
+             RESPONDER_HOST_NAME, RESPONDER_LANGUAGE,
              RESPONSE_SRC_IP, client_message);
 }
 
 /* ============================================================================
- * 関数: handle_client_connection
- * 機能: ABOS2からの接続を処理し、応答を返送
+ * 関数: now_ms
+ * 機能: 単調増加時刻をミリ秒で取得
+ * ============================================================================ */
+long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* ============================================================================
+ * 関数: raise_fd_limit
+ * 機能: 多数の同時接続に備えてファイルディスクリプタ数の上限を引き上げる
+ * ============================================================================ */
+void raise_fd_limit(void) {
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0) {
+        perror("[WARN] getrlimit failed");
+        return;
+    }
+    if (rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) < 0) {
+            perror("[WARN] Failed to raise RLIMIT_NOFILE");
+            getrlimit(RLIMIT_NOFILE, &rl);
+        }
+    }
+    printf("[INFO] File descriptor limit: %llu\n", (unsigned long long)rl.rlim_cur);
+}
+
+/* ============================================================================
+ * 関数: return_conn_watch
+ * 機能: 復路接続の epoll 登録イベントを変更する (変化がなければ何もしない)
+ * ============================================================================ */
+void return_conn_watch(bridge_t *b, return_conn_t *rc, uint32_t events) {
+    struct epoll_event ev;
+
+    if (rc->events == events) {
+        return;
+    }
+    ev.events = events;
+    ev.data.ptr = rc;
+    if (epoll_ctl(b->epfd, rc->events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD,
+                  rc->fd, &ev) < 0) {
+        perror("[ERROR] epoll_ctl failed for response connection");
+    }
+    rc->events = events;
+}
+
+/* ============================================================================
+ * 関数: return_conn_new
+ * 機能: 復路接続 (宛先ごとの送信キュー) の管理情報を作成する
  * 引数:
- *   client_sock_fd - ABOS2との接続済みソケット
- * 処理フロー:
- *   1. ABOS2からメッセージを受信 (往路)
- *   2. 応答メッセージを生成
- *   3. ABOS2へ接続 (復路)
- *   4. 応答メッセージを送信
+ *   persistent - 1 = 接続を維持して再利用, 0 = 応答ごとに接続 (従来動作)
+ *   capacity   - 送信キューのバイト数
+ *   depth      - 送信キューに入れられる応答数
+ * 戻り値: 管理情報 (NULL = メモリ不足)
  * ============================================================================ */
-void handle_client_connection(int client_sock_fd) {
-    char client_buffer[BUFFER_SIZE];
-    char response_buffer[BUFFER_SIZE];
-    ssize_t bytes_read;
-    int resp_sock = -1;
-    struct sockaddr_in resp_addr;
-    struct sockaddr_in src_addr;
+return_conn_t *return_conn_new(bridge_t *b, int persistent, size_t capacity,
+                               size_t depth) {
+    return_conn_t *rc;
+
+    rc = calloc(1, sizeof(*rc) + capacity);
+    if (rc != NULL) {
+        rc->msgs = calloc(depth, sizeof(*rc->msgs));
+    }
+    if (rc == NULL || rc->msgs == NULL) {
+        perror("[ERROR] Failed to allocate response connection");
+        free(rc);
+        return NULL;
+    }
+    rc->kind = EV_RETURN;
+    rc->fd = -1;
+    rc->state = RETURN_IDLE;
+    rc->persistent = persistent;
+    rc->capacity = capacity;
+    rc->msg_cap = depth;
+    timer_init(&rc->retry, return_conn_on_retry);
+    if (!persistent) {
+        b->oneshot_pending++;
+    }
+    return rc;
+}
+
+/* ============================================================================
+ * 関数: return_conn_free
+ * 機能: 応答ごとの復路接続を閉じて解放する
+ * ============================================================================ */
+void return_conn_free(bridge_t *b, return_conn_t *rc) {
+    timer_cancel(&b->wheel, &rc->retry);
+    if (rc->fd >= 0) {
+        close(rc->fd);
+    }
+    if (!rc->persistent) {
+        b->oneshot_pending--;
+    }
+    free(rc->msgs);
+    free(rc);
+}
+
+/* ============================================================================
+ * 関数: queue_front
+ * 機能: 送信キューの先頭 (最も古い) の応答を参照する
+ * ============================================================================ */
+static inline delivery_msg_t *queue_front(return_conn_t *rc) {
+    return &rc->msgs[rc->msg_first];
+}
+
+/* ============================================================================
+ * 関数: queue_pop
+ * 機能: 送信キューの先頭の応答を取り除く
+ *   未送信の応答を破棄する場合は、送信位置も応答の終端へ進める
+ * ============================================================================ */
+void queue_pop(return_conn_t *rc) {
+    size_t end = rc->msg_start + queue_front(rc)->len;
+
+    if (rc->head < end) {
+        rc->head = end;
+    }
+    rc->msg_start = end;
+    rc->msg_first = (rc->msg_first + 1) % rc->msg_cap;
+    rc->msg_count--;
+    if (rc->msg_count == 0) {
+        rc->msg_first = rc->msg_start = rc->head = rc->tail = 0;
+    }
+}
+
+/* ============================================================================
+ * 関数: queue_expire
+ * 機能: 保持期限 (max_age_ms) を過ぎた未送信の応答を先頭から破棄する
+ *   送信途中の応答は送り切るため破棄しない
+ * ============================================================================ */
+void queue_expire(bridge_t *b, return_conn_t *rc) {
+    if (b->max_age_ms <= 0) {
+        return;
+    }
+    while (rc->msg_count > 0 && rc->head == rc->msg_start &&
+           b->now - queue_front(rc)->queued_at > b->max_age_ms) {
+        queue_pop(rc);
+        b->expired++;
+    }
+}
 
-    /* 往路メッセージの受信 */
-    bytes_read = recv(client_sock_fd, client_buffer, sizeof(client_buffer) - 1, 0);
+/* ============================================================================
+ * 関数: backoff_delay
+ * 機能: 再接続までの待ち時間を求める (指数バックオフ + ジッタ)
+ *   1回目は即座に、以降は RETRY_BASE_MS から2倍ずつ RETRY_MAX_MS まで延ばし、
+ *   同時に切断された多数の接続が一斉に再接続しないよう
+ *   [delay/2, delay] の範囲でばらつかせる (乱数はワーカーごとに持つ)
+ * ============================================================================ */
+long long backoff_delay(bridge_t *b, int attempts) {
+    long long delay;
 
-    if (bytes_read > 0) {
-        client_buffer[bytes_read] = '\0';
-        printf("[RECV] Message from ABOS2 via %s:%d: %s\n", 
-               SERVER_IP_INBOUND, SERVER_PORT_INBOUND, client_buffer);
+    if (attempts == 0) {
+        return 0;
+    }
+    delay = RETRY_BASE_MS;
+    while (--attempts > 0 && delay < RETRY_MAX_MS) {
+        delay *= 2;
+    }
+    if (delay > RETRY_MAX_MS) {
+        delay = RETRY_MAX_MS;
+    }
+    return delay / 2 + rand_r(&b->seed) % (delay / 2 + 1);
+}
 
-        /* 応答メッセージの生成 */
-        generate_response(response_buffer, sizeof(response_buffer), client_buffer);
+/* ============================================================================
+ * 関数: return_conn_retry
+ * 機能: 復路接続を閉じ、バックオフ後に再接続する
+ *   送信途中で切断された応答は、再接続後に先頭から送り直す
+ *   (受信側は切断時に未完成の行・フレームを破棄する)。
+ *   送信待ちがなくなった場合、維持する接続は次の応答まで接続しない。
+ * 引数:
+ *   reason - 失敗の理由 (表示用, NULL = 表示しない)
+ * ============================================================================ */
+void return_conn_retry(bridge_t *b, return_conn_t *rc, const char *reason) {
+    long long delay;
 
-        /* 復路接続先の設定 (ABOS2) */
-        memset(&resp_addr, 0, sizeof(resp_addr));
-        resp_addr.sin_family = AF_INET;
-        resp_addr.sin_port = htons(CLIENT_PORT_OUTBOUND);
+    if (rc->fd >= 0) {
+        close(rc->fd);              /* epoll からも自動で外れる */
+        rc->fd = -1;
+    }
+    rc->events = 0;
+    b->failures++;
+    if (rc->down_since == 0) {
+        rc->down_since = b->now;
+    }
 
-        if (inet_pton(AF_INET, CLIENT_IP_OUTBOUND, &resp_addr.sin_addr) <= 0) {
-            fprintf(stderr, "[ERROR] Invalid address: %s\n", CLIENT_IP_OUTBOUND);
-            close(client_sock_fd);
+    rc->head = rc->msg_start;
+    queue_expire(b, rc);
+    if (rc->msg_count == 0) {
+        if (!rc->persistent) {
+            return_conn_free(b, rc);
             return;
         }
+        rc->state = RETURN_IDLE;
+        rc->attempts = 0;
+        rc->down_since = 0;
+        return;
+    }
 
-        /* 復路接続のリトライループ */
-        while (TRUE) {
-            resp_sock = socket(AF_INET, SOCK_STREAM, 0);
-            if (resp_sock < 0) {
-                perror("[ERROR] Response socket creation failed");
-                break;
-            }
+    delay = backoff_delay(b, rc->attempts++);
+    rc->state = RETURN_BACKOFF;
+    timer_schedule(&b->wheel, &rc->retry, b->now + delay);
+    if (reason != NULL && (rc->persistent || !b->quiet)) {
+        fprintf(stderr, "[WARN] Response connection failed: %s "
+                "(retry %d in %lld ms, %zu responses queued)\n",
+                reason, rc->attempts, delay, rc->msg_count);
+    }
+}
 
-            /* 送信元IPアドレスを明示的にバインド (192.168.200.1) */
-            memset(&src_addr, 0, sizeof(src_addr));
-            src_addr.sin_family = AF_INET;
-            src_addr.sin_port = htons(0); /* OSが自動割り当て */
-            inet_pton(AF_INET, RESPONSE_SRC_IP, &src_addr.sin_addr);
+/* ============================================================================
+ * 関数: return_conn_on_retry
+ * 機能: 再接続タイマの満了時に、期限切れの応答を捨ててから再接続する
+ * ============================================================================ */
+void return_conn_on_retry(wheel_timer_t *t, void *arg) {
+    return_conn_t *rc = (return_conn_t *)((char *)t - offsetof(return_conn_t, retry));
+    bridge_t *b = arg;
 
-            if (bind(resp_sock, (struct sockaddr *)&src_addr, sizeof(src_addr)) < 0) {
-                perror("[ERROR] Failed to bind response source IP");
-                close(resp_sock);
-                resp_sock = -1;
-                break;
-            }
+    b->retries++;
+    queue_expire(b, rc);
+    if (rc->msg_count == 0) {
+        if (!rc->persistent) {
+            return_conn_free(b, rc);
+            return;
+        }
+        rc->state = RETURN_IDLE;
+        rc->attempts = 0;
+        rc->down_since = 0;
+        return;
+    }
+    return_conn_connect(b, rc);
+}
 
-            printf("[INFO] Attempting response connection to ABOS2 at %s:%d\n",
-                   CLIENT_IP_OUTBOUND, CLIENT_PORT_OUTBOUND);
+/* ============================================================================
+ * 関数: return_conn_confirmed
+ * 機能: 復路の接続の確立を受けて接続数・所要時間を記録し、再接続の回数を戻す
+ *   (Fast Open の接続は connect() がすぐに返るため、SYN-ACK を受けた時点で呼ぶ)
+ * ============================================================================ */
+void return_conn_confirmed(bridge_t *b, return_conn_t *rc) {
+    b->connects++;
+    if (b->probe != NULL) {
+        stage_record(b->probe, STAGE_CONNECT, stage_now() - rc->connect_ns);
+    }
+    if (!b->quiet) {
+        ALOG_INFO("[INFO] Response connection established\n");
+    }
+    if (rc->persistent && rc->attempts > 1) {
+        ALOG_INFO("[INFO] Response path restored after %lld ms (%d attempts), "
+                  "flushing %zu queued responses (%zu bytes)\n",
+                  b->now - rc->down_since, rc->attempts, rc->msg_count,
+                  rc->tail - rc->head);
+    }
+    rc->attempts = 0;
+    rc->down_since = 0;
+}
 
-            /* ABOS2への接続試行 */
-            if (connect(resp_sock, (struct sockaddr *)&resp_addr, 
-                       sizeof(resp_addr)) == 0) {
-                printf("[INFO] Response connection established\n");
-                break;
-            }
+/* ============================================================================
+ * 関数: return_conn_sent
+ * 機能: 送信し終えた応答を取り除く (送り直す位置を進める)
+ *   Fast Open の接続は確立を確認するまで取り除かない
+ *   (SYN に載せた応答は、接続を拒否された場合に送り直す)
+ * ============================================================================ */
+void return_conn_sent(bridge_t *b, return_conn_t *rc, long long now_ns) {
+    if (rc->fastopen) {
+        return;
+    }
+    while (rc->msg_count > 0 &&
+           rc->msg_start + queue_front(rc)->len <= rc->head) {
+        stage_record(b->probe, STAGE_DELIVER, now_ns - queue_front(rc)->queued_ns);
+        queue_pop(rc);
+        b->delivered++;
+    }
+}
+
+/* ============================================================================
+ * 関数: return_conn_flush
+ * 機能: 送信キューの応答を送れるだけまとめて送る
+ *   送信バッファが一杯の場合は EPOLLOUT を待つ (ブロックしない)。
+ *   応答ごとの接続は送信し終えたら閉じる。
+ *   Fast Open の接続は確立 (EPOLLOUT) を待ってから送信済みとし、閉じる
+ * ============================================================================ */
+void return_conn_flush(bridge_t *b, return_conn_t *rc) {
+    long long now_ns = b->probe != NULL ? stage_now() : 0;
+    ssize_t sent;
 
-            /* 接続失敗時の処理 */
-            if (errno == ECONNREFUSED || errno == ETIMEDOUT || 
-                errno == ENETUNREACH) {
-                fprintf(stderr, "[WARN] Response connection failed: %s (retrying...)\n",
-                        strerror(errno));
-                close(resp_sock);
-                resp_sock = -1;
-                sleep(RETRY_DELAY);
+    queue_expire(b, rc);
+    while (rc->head < rc->tail) {
+        sent = send(rc->fd, rc->queue + rc->head, rc->tail - rc->head,
+                    MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
                 continue;
-            } else {
-                perror("[ERROR] Critical response connection error");
-                close(resp_sock);
-                resp_sock = -1;
-                break;
             }
-        }
-
-        /* 応答メッセージの送信 */
-        if (resp_sock != -1) {
-            if (send(resp_sock, response_buffer, strlen(response_buffer), 0) < 0) {
-                perror("[ERROR] Response send failed");
-            } else {
-                printf("[SEND] Response sent via %s: %s\n", 
-                       RESPONSE_SRC_IP, response_buffer);
+            /* EINPROGRESS: Fast Open の cookie がなく、SYN のみ送った */
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS) {
+                return_conn_watch(b, rc, EPOLLIN | EPOLLRDHUP | EPOLLOUT);
+                return;
             }
-            close(resp_sock);
+            return_conn_retry(b, rc, strerror(errno));
+            return;
         }
-    } else if (bytes_read == 0) {
-        printf("[INFO] ABOS2 disconnected gracefully\n");
-    } else {
-        perror("[ERROR] Failed to receive data from ABOS2");
+        rc->head += sent;
+        return_conn_sent(b, rc, now_ns);
+    }
+    if (rc->fastopen && rc->msg_count > 0) {
+        switch (sock_profile_connecting(rc->fd, b->profile)) {
+        case 1:
+            return_conn_watch(b, rc, EPOLLIN | EPOLLRDHUP | EPOLLOUT);
+            return;
+        case -1:
+            return_conn_retry(b, rc, "connection refused or reset");
+            return;
+        }
+        rc->fastopen = 0;
+        return_conn_confirmed(b, rc);
+        return_conn_sent(b, rc, now_ns);
     }
 
-    /* 往路ソケットのクローズ */
-    close(client_sock_fd);
+    rc->overflowed = 0;
+    if (!rc->persistent) {
+        return_conn_free(b, rc);
+        return;
+    }
+    return_conn_watch(b, rc, EPOLLIN | EPOLLRDHUP);
 }
 
 /* ============================================================================
- * 関数: main
- * 機能: Server機能を起動し、ABOS2からの接続を待ち受け
+ * 関数: return_conn_established
+ * 機能: 復路接続の完了後にソケットを設定し、溜まっている応答をまとめて送る
  * ============================================================================ */
-int main(int argc, char *argv[]) {
-    int listen_sock = -1;
-    int client_sock_fd = -1;
-    struct sockaddr_in serv_addr;
-    struct sockaddr_in client_addr;
-    socklen_t addrlen;
+void return_conn_established(bridge_t *b, return_conn_t *rc) {
     int opt = 1;
+    int idle = KEEPALIVE_IDLE;
+    int interval = KEEPALIVE_INTERVAL;
+    int count = KEEPALIVE_COUNT;
 
-    printf("============================================================\n");
-    printf("  Bridge Server/Client (ABOS1, C) Starting\n");
-    printf("============================================================\n");
-    
-    /* Server機能の起動とリトライループ */
-    while (TRUE) {
-      listen_sock = socket(AF_INET, SOCK_STREAM, 0);
-      if (listen_sock < 0) {
-        perror("[ERROR] Listen socket creation failed");
-        return 1;
-      }
-      
-      /* ポート再利用設定 */
-      if (setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, 
-                     &opt, sizeof(opt)) < 0) {
-        perror("[WARN] Failed to set SO_REUSEADDR");
-      }
-      
-      /* 待ち受けアドレスの設定 (192.168.100.1:8000) */
-      memset(&serv_addr, 0, sizeof(serv_addr));
-      serv_addr.sin_family = AF_INET;
-      serv_addr.sin_port = htons(SERVER_PORT_INBOUND);
-        
-        if (inet_pton(AF_INET, SERVER_IP_INBOUND, &serv_addr.sin_addr) <= 0) {
-        fprintf(stderr, "[ERROR] Invalid SERVER_IP_INBOUND: %s\n", 
-                SERVER_IP_INBOUND);
-        close(listen_sock);
-        return 1;
+    rc->state = RETURN_CONNECTED;
+    if (!rc->fastopen) {
+        return_conn_confirmed(b, rc);
+    }
+
+    /* 応答は1メッセージずつ即時に送る (Nagle による遅延をなくす) */
+    if (setsockopt(rc->fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt)) < 0) {
+        perror("[WARN] Failed to set TCP_NODELAY");
+    }
+
+    /* 無通信中の ABOS2 側の消失をキープアライブで検出する */
+    if (rc->persistent &&
+        (setsockopt(rc->fd, SOL_SOCKET, SO_KEEPALIVE, &opt, sizeof(opt)) < 0 ||
+         setsockopt(rc->fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle)) < 0 ||
+         setsockopt(rc->fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval)) < 0 ||
+         setsockopt(rc->fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count)) < 0)) {
+        perror("[WARN] Failed to enable TCP keepalive");
+    }
+
+    return_conn_flush(b, rc);
+}
+
+/* ============================================================================
+ * 関数: return_conn_connect
+ * 機能: ABOS2への非ブロッキング接続を開始する
+ *   完了は EPOLLOUT で通知される。失敗時はバックオフ後に再試行する。
+ * ============================================================================ */
+void return_conn_connect(bridge_t *b, return_conn_t *rc) {
+    int opt = 1;
+
+    rc->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (rc->fd < 0) {
+        perror("[ERROR] Response socket creation failed");
+        return_conn_retry(b, rc, NULL);
+        return;
+    }
+    rc->events = 0;
+    if (b->probe != NULL) {
+        rc->connect_ns = stage_now();
+    }
+
+    /* 送信元IPアドレスを明示的にバインド (192.168.200.1)。送信元ポートは
+     * 接続時に選ばせ、応答ごとの接続で TIME_WAIT のポートを再利用できるようにする */
+    setsockopt(rc->fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &opt, sizeof(opt));
+    if (bind(rc->fd, (struct sockaddr *)&b->src, sizeof(b->src)) < 0) {
+        perror("[ERROR] Failed to bind response source IP");
+        return_conn_retry(b, rc, NULL);
+        return;
+    }
+
+    if (!b->quiet) {
+        ALOG_INFO("[INFO] Attempting response connection to ABOS2 at %s:%d\n",
+                  CLIENT_IP_OUTBOUND, CLIENT_PORT_OUTBOUND);
+    }
+
+    /* 応答ごとの接続は Fast Open で接続する (connect はすぐに完了し、
+     * 最初の応答とともに SYN を送る。維持する接続は使わない) */
+    rc->fastopen = b->profile == SOCK_PROFILE_LOWLAT && !rc->persistent &&
+                   rc->head < rc->tail;
+    sock_profile_connect(rc->fd, b->profile, rc->fastopen);
+    if (connect(rc->fd, (struct sockaddr *)&b->dest, sizeof(b->dest)) == 0) {
+        return_conn_watch(b, rc, EPOLLIN | EPOLLRDHUP);
+        return_conn_established(b, rc);
+        return;
+    }
+    if (errno != EINPROGRESS) {
+        return_conn_retry(b, rc, strerror(errno));
+        return;
+    }
+
+    rc->state = RETURN_CONNECTING;
+    return_conn_watch(b, rc, EPOLLOUT);
+}
+
+/* ============================================================================
+ * 関数: return_conn_event
+ * 機能: 復路接続のイベントを処理する
+ *   CONNECTING: 接続結果を確認する
+ *   CONNECTED : ABOS2 は復路へ送信しないため、読み出し可能 = 切断 (FIN/RST)
+ *               とみなす。送信可能になったら送信キューの残りを送る
+ * ============================================================================ */
+void return_conn_event(bridge_t *b, return_conn_t *rc, uint32_t events) {
+    char discard[BUFFER_SIZE];
+    struct sockaddr_in peer;
+    socklen_t len = sizeof(int);
+    int err = 0;
+    ssize_t n;
+
+    if (rc->fd < 0) {
+        return;                         /* 同じ回の先のイベントで閉じた */
+    }
+
+    if (rc->state == RETURN_CONNECTING) {
+        if (getsockopt(rc->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+            err = errno;
+        }
+        if (err != 0) {
+            return_conn_retry(b, rc, strerror(err));
+            return;
+        }
+        /* 閉じた旧ソケットのイベントが残っていた場合は接続完了を待つ */
+        len = sizeof(peer);
+        if (getpeername(rc->fd, (struct sockaddr *)&peer, &len) < 0) {
+            return;
         }
+        return_conn_watch(b, rc, EPOLLIN | EPOLLRDHUP);
+        return_conn_established(b, rc);
+        return;
+    }
 
-        /* バインドとリッスン */
-        if (bind(listen_sock, (struct sockaddr *)&serv_addr, 
-                sizeof(serv_addr)) == 0 &&
-            listen(listen_sock, MAX_PENDING) == 0) {
-            printf("[INFO] Listening on %s:%d\n", 
-                   SERVER_IP_INBOUND, SERVER_PORT_INBOUND);
-            break;
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        /* 想定外の受信データは読み捨てる (0 = 切断) */
+        n = recv(rc->fd, discard, sizeof(discard), MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) ||
+            (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+            if (!b->quiet) {
+                ALOG_INFO("[INFO] Response connection closed by ABOS2, reconnecting\n");
+            }
+            return_conn_retry(b, rc, NULL);
+            return;
         }
+    }
 
-        /* 待ち受け失敗時のリトライ */
-        perror("[WARN] Failed to start server (retrying...)");
-        close(listen_sock);
-        listen_sock = -1;
-        sleep(RETRY_DELAY);
+    if (events & EPOLLOUT) {
+        return_conn_flush(b, rc);
     }
+}
 
-    /* 接続受け入れループ */
-    while (TRUE) {
-        addrlen = sizeof(client_addr);
+/* ============================================================================
+ * 関数: print_delivery_stats
+ * 機能: ワーカーの受信レートと送信キュー・配送の状態を表示する
+ *   (他のワーカーの表示と混ざらないよう1行にまとめて出力する)
+ * ============================================================================ */
+void print_delivery_stats(bridge_t *b) {
+    static const char *state_names[] = {
+        "idle", "connecting", "connected", "backoff",
+    };
+    return_conn_t *rc = b->shared;
+    char line[512];
+    int len;
 
-        /* ABOS2からの接続を待機 */
-        client_sock_fd = accept(listen_sock, (struct sockaddr *)&client_addr, 
-                               &addrlen);
+    len = snprintf(line, sizeof(line), "[STATS] worker %d: %.0f msg/s; ", b->id,
+                   b->now > b->stats_at ? (b->messages - b->stats_messages) * 1000.0 /
+                                          (b->now - b->stats_at) : 0.0);
+    b->stats_messages = b->messages;
+    b->stats_at = b->now;
 
-        if (client_sock_fd < 0) {
-            /* 一時的なエラーは無視して継続 */
-            if (errno != EINTR && errno != EAGAIN) {
-                perror("[ERROR] Accept failed");
-                sleep(RETRY_DELAY);
-            }
-            continue;
+    if (rc != NULL) {
+        len += snprintf(line + len, sizeof(line) - len,
+                        "delivery: %s, queued %zu responses / %zu bytes "
+                        "(oldest %lld ms), attempts %d",
+                        state_names[rc->state], rc->msg_count, rc->tail - rc->msg_start,
+                        rc->msg_count > 0 ? b->now - queue_front(rc)->queued_at : 0LL,
+                        rc->attempts);
+    } else {
+        len += snprintf(line + len, sizeof(line) - len,
+                        "delivery: %lu responses pending", b->oneshot_pending);
+    }
+    ALOG_INFO("%s; delivered %lu, dropped %lu (full) %lu (expired), "
+              "retries %lu, connects %lu, failures %lu\n", line,
+              b->delivered, b->dropped, b->expired, b->retries, b->connects,
+              b->failures);
+}
+
+/* ============================================================================
+ * 関数: on_stats_timer
+ * 機能: 一定間隔で配送状態を表示する
+ * ============================================================================ */
+void on_stats_timer(wheel_timer_t *t, void *arg) {
+    bridge_t *b = arg;
+
+    print_delivery_stats(b);
+    timer_schedule(&b->wheel, t, b->now + b->stats_interval * 1000LL);
+}
+
+/* ============================================================================
+ * 関数: response_conn
+ * 機能: 応答を入れる復路接続を選ぶ
+ *   維持する接続はブリッジで1個を共有し、応答ごとの接続は応答の長さの
+ *   送信キューを持つ接続を新しく作る (未送信の接続数を queue_depth までとする)
+ * 戻り値: 復路接続 (NULL = 応答を破棄)
+ * ============================================================================ */
+return_conn_t *response_conn(bridge_t *b, size_t len) {
+    return_conn_t *rc;
+
+    if (b->persistent) {
+        return b->shared;
+    }
+    rc = b->oneshot_pending < b->queue_depth ? return_conn_new(b, 0, len, 1) : NULL;
+    if (rc == NULL) {
+        b->dropped++;
+    }
+    return rc;
+}
+
+/* ============================================================================
+ * 関数: queue_overflow
+ * 機能: キュー溢れで応答を1個破棄したことを数える
+ *   (表示はキューが空になるまでの最初の1回のみ)
+ * ============================================================================ */
+void queue_overflow(bridge_t *b, return_conn_t *rc) {
+    b->dropped++;
+    if (!rc->overflowed) {
+        fprintf(stderr, "[WARN] Response queue full, dropping %s responses "
+                "until ABOS2 catches up\n",
+                b->policy == DROP_OLDEST ? "oldest" : "new");
+        rc->overflowed = 1;
+    }
+}
+
+/* ============================================================================
+ * 関数: return_conn_append
+ * 機能: 送信キューの末尾に len バイトの応答の領域を確保する
+ *   キュー (バイト数・応答数) が一杯の場合はドロップポリシーに従う
+ *     DROP_NEWEST: 新しい応答を破棄する
+ *     DROP_OLDEST: 未送信の古い応答から破棄して空きを作る
+ *                  (先頭が送信途中の場合は新しい応答を破棄する)
+ *   破棄は ABOS2 へ通知しない (Client_C 側の応答待ちタイムアウトで検出する)
+ * 戻り値: 書き込み先 (NULL = 応答を破棄)
+ * ============================================================================ */
+char *return_conn_append(bridge_t *b, return_conn_t *rc, size_t len) {
+    delivery_msg_t *msg;
+    char *p;
+
+    queue_expire(b, rc);
+    if (len > rc->capacity) {
+        b->dropped++;
+        return NULL;
+    }
+    if (b->policy == DROP_OLDEST) {
+        while (rc->msg_count > 0 && rc->head == rc->msg_start &&
+               (rc->msg_count == rc->msg_cap ||
+                rc->tail - rc->msg_start + len > rc->capacity)) {
+            queue_pop(rc);
+            queue_overflow(b, rc);
         }
+    }
+
+    if (rc->tail + len > rc->capacity && rc->msg_start > 0) {
+        memmove(rc->queue, rc->queue + rc->msg_start, rc->tail - rc->msg_start);
+        rc->head -= rc->msg_start;
+        rc->tail -= rc->msg_start;
+        rc->msg_start = 0;
+    }
+    if (rc->tail + len > rc->capacity || rc->msg_count == rc->msg_cap) {
+        queue_overflow(b, rc);
+        return NULL;
+    }
 
-        printf("[INFO] Connection accepted from ABOS2\n");
+    msg = &rc->msgs[(rc->msg_first + rc->msg_count) % rc->msg_cap];
+    msg->len = (uint32_t)len;
+    msg->queued_at = b->now;
+    if (b->probe != NULL) {
+        msg->queued_ns = stage_now();
+        stage_record(b->probe, STAGE_RESPONSE, msg->queued_ns - b->read_ns);
+    }
+    rc->msg_count++;
+    p = rc->queue + rc->tail;
+    rc->tail += len;
+    return p;
+}
 
-        /* 接続処理 (往路受信と復路送信) */
-        handle_client_connection(client_sock_fd);
+/* ============================================================================
+ * 関数: return_conn_kick
+ * 機能: 送信キューへ追加した応答の送信を進める
+ *   復路が接続済みなら即座に送信し、未接続なら接続を開始する
+ *   (接続中・再接続待ちの間はキューに溜め、接続後にまとめて送る)
+ * ============================================================================ */
+void return_conn_kick(bridge_t *b, return_conn_t *rc) {
+    switch (rc->state) {
+    case RETURN_IDLE:
+        return_conn_connect(b, rc);
+        break;
+    case RETURN_CONNECTED:
+        b->reuses++;
+        if (!(rc->events & EPOLLOUT)) {
+            return_conn_flush(b, rc);
+        }
+        break;
+    default:
+        break;                          /* 接続完了・再接続後に送信する */
     }
+}
 
-    /* クリーンアップ (通常は到達しない) */
-    if (listen_sock != -1) {
-        close(listen_sock);
+/* ============================================================================
+ * 関数: count_message
+ * 機能: 受信メッセージ数と、最初・最後の受信時刻 (処理レートの算出用) を記録する
+ * ============================================================================ */
+static inline void count_message(bridge_t *b) {
+    if (b->messages++ == 0) {
+        b->first_message = b->now;
     }
+    b->last_message = b->now;
+}
 
-    return 0;
-   }
+/* ============================================================================
+ * 関数: handle_message
+ * 機能: 往路メッセージ1個 (テキスト形式) に対する応答を生成し、
+ *       復路の送信キューへ入れる
+ * ============================================================================ */
+void handle_message(bridge_t *b, const char *message) {
+    char response_buffer[BUFFER_SIZE];
+    return_conn_t *rc;
+    size_t len;
+    char *p;
+
+    count_message(b);
+    if (!b->quiet) {
+        ALOG_INFO("[RECV] Message from ABOS2 via %s:%d: %s\n",
+                  SERVER_IP_INBOUND, SERVER_PORT_INBOUND, message);
+    }
+
+    /* 応答メッセージの生成 (末尾に改行を付けて送信する) */
+    generate_response(response_buffer, sizeof(response_buffer) - 1, message);
+    len = strlen(response_buffer);
+    response_buffer[len] = '\n';
+
+    rc = response_conn(b, len + 1);
+    if (rc == NULL) {
+        return;
+    }
+    p = return_conn_append(b, rc, len + 1);
+    if (p == NULL) {
+        return;
+    }
+    memcpy(p, response_buffer, len + 1);
+
+    if (!b->quiet) {
+        response_buffer[len] = '\0';
+        ALOG_INFO("[SEND] Response queued via %s: %s\n", RESPONSE_SRC_IP, response_buffer);
+    }
+    return_conn_kick(b, rc);
+}
+
+/* ============================================================================
+ * 関数: handle_frame
+ * 機能: フレーム形式の要求1個に対する応答フレームを生成し、
+ *       復路の送信キューへ入れる
+ *   応答本体は従来の応答文の後ろに要求本体をそのまま続けたもの
+ *   (FRAME_MAX_PAYLOAD に収まらない分の要求本体は含めない)
+ * ============================================================================ */
+void handle_frame(bridge_t *b, const frame_t *f) {
+    char prefix[BUFFER_SIZE];
+    return_conn_t *rc;
+    size_t prefix_len, echo_len, len;
+    char *p;
+
+    count_message(b);
+    b->frames++;
+    b->bytes += f->length;
+    if (!b->quiet) {
+        ALOG_INFO("[RECV] Frame id=%u from ABOS2 via %s:%d (%u bytes)\n",
+                  f->id, SERVER_IP_INBOUND, SERVER_PORT_INBOUND, f->length);
+    }
+
+    generate_response(prefix, sizeof(prefix), "");
+    prefix_len = strlen(prefix);
+    echo_len = f->length;
+    if (prefix_len + echo_len > FRAME_MAX_PAYLOAD) {
+        echo_len = FRAME_MAX_PAYLOAD - prefix_len;
+    }
+    len = FRAME_HEADER_SIZE + prefix_len + echo_len;
+
+    rc = response_conn(b, len);
+    if (rc == NULL) {
+        return;
+    }
+    p = return_conn_append(b, rc, len);
+    if (p == NULL) {
+        return;
+    }
+    frame_put_header((unsigned char *)p, FRAME_TYPE_RESPONSE, f->id,
+                     (uint32_t)(prefix_len + echo_len));
+    memcpy(p + FRAME_HEADER_SIZE, prefix, prefix_len);
+    memcpy(p + FRAME_HEADER_SIZE + prefix_len, f->payload, echo_len);
+
+    if (!b->quiet) {
+        ALOG_INFO("[SEND] Response frame id=%u queued via %s (%zu bytes)\n",
+                  f->id, RESPONSE_SRC_IP, prefix_len + echo_len);
+    }
+    return_conn_kick(b, rc);
+}
+
+/* ============================================================================
+ * 関数: inbound_close
+ * 機能: 往路接続を閉じて解放する
+ *   パススルーの接続は復路ソケットも閉じ、同じ回に残っている復路側の
+ *   イベントが解放済みの領域を参照しないよう、解放はイベント処理後に行う
+ * ============================================================================ */
+void inbound_close(bridge_t *b, inbound_conn_t *ic) {
+    relay_t *r = ic->relay;
+
+    close(ic->fd);
+    frame_buffer_free(&ic->in);
+    if (r != NULL) {
+        if (r->fd >= 0) {
+            close(r->fd);
+        }
+        close(r->pipe_fd[0]);
+        close(r->pipe_fd[1]);
+        r->fd = -1;
+        ic->fd = -1;
+        r->next_closed = b->closed;
+        b->closed = r;
+    } else {
+        free(ic);
+    }
+    b->active--;
+
+    if (!b->quiet) {
+        ALOG_INFO("[INFO] Connections: %lu active, %lu accepted, %lu messages "
+                  "(%lu frames), %lu dropped; response connection: %lu connects, "
+                  "%lu reuses, %lu failures\n", b->active, b->accepted, b->messages,
+                  b->frames, b->dropped, b->connects, b->reuses, b->failures);
+    }
+}
+
+/* ============================================================================
+ * 関数: inbound_lines
+ * 機能: 受信バッファ内の完全な行 (テキスト形式) を順に処理する
+ *   未完成の行はバッファ先頭へ詰める (溢れる場合は1メッセージとして扱う)
+ * ============================================================================ */
+void inbound_lines(bridge_t *b, inbound_conn_t *ic) {
+    char *buffer = (char *)ic->in.data;
+    char *line, *newline;
+
+    buffer[ic->in.len] = '\0';
+    line = buffer;
+    while ((newline = strchr(line, '\n')) != NULL) {
+        *newline = '\0';
+        if (newline > line && newline[-1] == '\r') {
+            newline[-1] = '\0';
+        }
+        handle_message(b, line);
+        line = newline + 1;
+    }
+
+    frame_buffer_consume(&ic->in, line - buffer);
+    if (ic->in.len == BUFFER_SIZE - 1) {
+        buffer[ic->in.len] = '\0';
+        handle_message(b, buffer);
+        ic->in.len = 0;
+    }
+}
+
+/* ============================================================================
+ * 関数: inbound_frames
+ * 機能: 受信バッファ内の完全なフレームを順に処理する
+ *   1回の受信に含まれる複数の要求 (パイプライン) はまとめて処理し、
+ *   未完成のフレームは次の受信で再組み立てする
+ * 戻り値: 0 = 成功, -1 = 不正なフレーム (接続を閉じる)
+ * ============================================================================ */
+int inbound_frames(bridge_t *b, inbound_conn_t *ic) {
+    size_t off = 0;
+    frame_t f;
+    ssize_t n;
+
+    while ((n = frame_parse(ic->in.data + off, ic->in.len - off, &f)) > 0) {
+        if (f.type == FRAME_TYPE_REQUEST) {
+            handle_frame(b, &f);
+        } else {
+            fprintf(stderr, "[WARN] Ignoring frame type %u from ABOS2\n", f.type);
+        }
+        off += n;
+    }
+    if (n < 0) {
+        fprintf(stderr, "[WARN] Invalid frame from ABOS2, closing connection\n");
+        return -1;
+    }
+    frame_buffer_consume(&ic->in, off);
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: relay_watch
+ * 機能: パススルー接続の epoll 登録イベントを変更する
+ *   待つ側のソケットだけを登録し、相手側が詰まっている間は通知を止める
+ * 引数:
+ *   in_events  - 往路ソケットのイベント (EPOLLIN = 要求の受信待ち, 0 = 停止)
+ *   out_events - 復路ソケットのイベント (EPOLLOUT = 送信可能待ち, 0 = 停止)
+ * ============================================================================ */
+void relay_watch(bridge_t *b, inbound_conn_t *ic, uint32_t in_events,
+                 uint32_t out_events) {
+    relay_t *r = ic->relay;
+    struct epoll_event ev;
+
+    if (ic->events != in_events) {
+        ev.events = in_events;
+        ev.data.ptr = ic;
+        if (epoll_ctl(b->epfd, EPOLL_CTL_MOD, ic->fd, &ev) < 0) {
+            perror("[ERROR] epoll_ctl failed for connection");
+        }
+        ic->events = in_events;
+    }
+    if (r->events != out_events) {
+        ev.events = out_events;
+        ev.data.ptr = r;
+        if (epoll_ctl(b->epfd, EPOLL_CTL_MOD, r->fd, &ev) < 0) {
+            perror("[ERROR] epoll_ctl failed for response connection");
+        }
+        r->events = out_events;
+    }
+}
+
+/* ============================================================================
+ * 関数: relay_open
+ * 機能: フレーム形式の往路接続をパススルーに切り替え、専用の復路接続と
+ *       pipe を準備して ABOS2 への非ブロッキング接続を開始する
+ *   (接続が完了するまで往路からは受信しない)
+ * 戻り値: 0 = 成功, -1 = 失敗 (往路接続を閉じる)
+ * ============================================================================ */
+int relay_open(bridge_t *b, inbound_conn_t *ic) {
+    struct epoll_event ev;
+    relay_t *r;
+    int opt = 1;
+    int size;
+
+    r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+        perror("[ERROR] Failed to allocate relay");
+        return -1;
+    }
+    r->kind = EV_RELAY;
+    r->owner = ic;
+    if (pipe2(r->pipe_fd, O_NONBLOCK | O_CLOEXEC) < 0) {
+        perror("[ERROR] pipe2 failed");
+        free(r);
+        return -1;
+    }
+    ic->relay = r;
+    ic->mode = WIRE_RELAY;
+    ic->events = EPOLLIN | EPOLLRDHUP;
+
+    /* pipe を拡張して1回の splice で移せる量を増やす (失敗時は既定の容量) */
+    fcntl(r->pipe_fd[1], F_SETPIPE_SZ, RELAY_PIPE_SIZE);
+    size = fcntl(r->pipe_fd[1], F_GETPIPE_SZ);
+    r->pipe_size = size > 0 ? (size_t)size : 65536;
+
+    r->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (r->fd < 0) {
+        perror("[ERROR] Response socket creation failed");
+        return -1;
+    }
+    setsockopt(r->fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &opt, sizeof(opt));
+    if (bind(r->fd, (struct sockaddr *)&b->src, sizeof(b->src)) < 0) {
+        perror("[ERROR] Failed to bind response source IP");
+        return -1;
+    }
+    sock_profile_connect(r->fd, b->profile, 0);     /* 往路の接続と同じく維持する */
+    if (connect(r->fd, (struct sockaddr *)&b->dest, sizeof(b->dest)) < 0 &&
+        errno != EINPROGRESS) {
+        fprintf(stderr, "[WARN] Pass-through connection failed: %s\n", strerror(errno));
+        return -1;
+    }
+    ev.events = 0;
+    ev.data.ptr = r;
+    if (epoll_ctl(b->epfd, EPOLL_CTL_ADD, r->fd, &ev) < 0) {
+        perror("[ERROR] epoll_ctl failed for response connection");
+        return -1;
+    }
+    relay_watch(b, ic, 0, EPOLLOUT);
+    if (!b->quiet) {
+        ALOG_INFO("[INFO] Pass-through connection to ABOS2 at %s:%d started\n",
+                  CLIENT_IP_OUTBOUND, CLIENT_PORT_OUTBOUND);
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: relay_header
+ * 機能: 往路から次の要求のフレームヘッダを読み、応答ヘッダを準備する
+ *   応答ヘッダ = 応答フレームのヘッダ (同じ相関ID) + 従来の応答文
+ *   (要求本体は読まずに往路ソケットに残し、splice で中継する)
+ * 戻り値: 1 = 準備完了, 0 = ヘッダの残りを待つ, -1 = 切断・不正 (閉じた)
+ * ============================================================================ */
+int relay_header(bridge_t *b, inbound_conn_t *ic) {
+    relay_t *r = ic->relay;
+    const unsigned char *h;
+    uint32_t id, length;
+    size_t prefix_len;
+    ssize_t n;
+
+    if (frame_buffer_reserve(&ic->in, FRAME_HEADER_SIZE) < 0) {
+        perror("[ERROR] Failed to allocate receive buffer");
+        inbound_close(b, ic);
+        return -1;
+    }
+    n = recv(ic->fd, ic->in.data + ic->in.len, FRAME_HEADER_SIZE - ic->in.len, 0);
+    if (n < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        perror("[ERROR] Failed to receive data from ABOS2");
+        inbound_close(b, ic);
+        return -1;
+    }
+    if (n == 0) {
+        if (ic->in.len > 0) {
+            fprintf(stderr, "[WARN] Discarding incomplete frame (%zu bytes)\n",
+                    ic->in.len);
+        }
+        if (!b->quiet) {
+            ALOG_INFO("[INFO] ABOS2 disconnected gracefully\n");
+        }
+        inbound_close(b, ic);
+        return -1;
+    }
+    ic->in.len += n;
+    if (ic->in.len < FRAME_HEADER_SIZE) {
+        return 0;
+    }
+
+    h = ic->in.data;
+    id = frame_get32(h + 4);
+    length = frame_get32(h + 8);
+    generate_response((char *)r->head + FRAME_HEADER_SIZE, BUFFER_SIZE, "");
+    prefix_len = strlen((char *)r->head + FRAME_HEADER_SIZE);
+    if (h[0] != FRAME_MAGIC || h[1] != FRAME_VERSION || h[2] != FRAME_TYPE_REQUEST ||
+        prefix_len + length > FRAME_MAX_PAYLOAD) {
+        fprintf(stderr, "[WARN] Invalid frame from ABOS2, closing connection\n");
+        inbound_close(b, ic);
+        return -1;
+    }
+    ic->in.len = 0;
+
+    frame_put_header(r->head, FRAME_TYPE_RESPONSE, id, (uint32_t)(prefix_len + length));
+    r->head_len = FRAME_HEADER_SIZE + prefix_len;
+    r->head_off = 0;
+    r->remaining = length;
+    r->active = 1;
+    count_message(b);
+    b->frames++;
+    if (!b->quiet) {
+        ALOG_INFO("[RECV] Frame id=%u from ABOS2 via %s:%d (%u bytes, pass-through)\n",
+                  id, SERVER_IP_INBOUND, SERVER_PORT_INBOUND, length);
+    }
+    return 1;
+}
+
+/* ============================================================================
+ * 関数: relay_pump
+ * 機能: パススルー接続の中継を進める
+ *   1. 応答ヘッダを復路へ送る
+ *   2. 要求本体を往路ソケットから pipe へ splice する
+ *   3. pipe の中身を復路ソケットへ splice する
+ *   4. 本体を送り終えたら次の要求のヘッダを読む
+ *   復路が詰まったら EPOLLOUT を、往路が空なら EPOLLIN を待つ
+ *   (1接続の処理は RELAY_ROUNDS 回までとし、他の接続に順番を渡す)
+ * ============================================================================ */
+void relay_pump(bridge_t *b, inbound_conn_t *ic) {
+    relay_t *r = ic->relay;
+    size_t want;
+    ssize_t n;
+
+    for (int round = 0; round < RELAY_ROUNDS; round++) {
+        /* 1. 応答ヘッダ (本体が続く場合は MSG_MORE で本体とまとめて送る) */
+        if (r->head_off < r->head_len) {
+            n = send(r->fd, r->head + r->head_off, r->head_len - r->head_off,
+                     MSG_NOSIGNAL | (r->remaining > 0 ? MSG_MORE : 0));
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    relay_watch(b, ic, 0, EPOLLOUT);
+                    return;
+                }
+                fprintf(stderr, "[WARN] Pass-through send failed: %s\n", strerror(errno));
+                inbound_close(b, ic);
+                return;
+            }
+            r->head_off += n;
+            continue;
+        }
+
+        /* 2. 往路 -> pipe (pipe の空きの分だけ) */
+        if (r->remaining > 0 && r->in_pipe < r->pipe_size) {
+            want = r->pipe_size - r->in_pipe;
+            if (want > r->remaining) {
+                want = r->remaining;
+            }
+            n = splice(ic->fd, NULL, r->pipe_fd[1], NULL, want,
+                       SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n == 0) {
+                fprintf(stderr, "[WARN] ABOS2 disconnected in the middle of a frame "
+                        "(%zu bytes missing)\n", r->remaining);
+                inbound_close(b, ic);
+                return;
+            }
+            if (n > 0) {
+                r->remaining -= n;
+                r->in_pipe += n;
+                b->bytes += n;
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("[ERROR] splice from ABOS2 failed");
+                inbound_close(b, ic);
+                return;
+            }
+        }
+
+        /* 3. pipe -> 復路 */
+        if (r->in_pipe > 0) {
+            n = splice(r->pipe_fd[0], NULL, r->fd, NULL, r->in_pipe,
+                       SPLICE_F_MOVE | SPLICE_F_NONBLOCK |
+                       (r->remaining > 0 ? SPLICE_F_MORE : 0));
+            if (n > 0) {
+                r->in_pipe -= n;
+                continue;
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                relay_watch(b, ic, 0, EPOLLOUT);
+                return;
+            }
+            fprintf(stderr, "[WARN] Pass-through send failed: %s\n",
+                    n < 0 ? strerror(errno) : "connection closed");
+            inbound_close(b, ic);
+            return;
+        }
+        if (r->remaining > 0) {
+            relay_watch(b, ic, EPOLLIN | EPOLLRDHUP, 0);
+            return;
+        }
+
+        /* 4. 1フレームの中継を完了し、次の要求のヘッダへ */
+        if (r->active) {
+            r->active = 0;
+            b->delivered++;
+            b->last_message = b->now;
+        }
+        n = relay_header(b, ic);
+        if (n < 0) {
+            return;
+        }
+        if (n == 0) {
+            relay_watch(b, ic, EPOLLIN | EPOLLRDHUP, 0);
+            return;
+        }
+    }
+    relay_watch(b, ic, EPOLLIN | EPOLLRDHUP, 0);
+}
+
+/* ============================================================================
+ * 関数: relay_event
+ * 機能: パススルーの復路接続のイベントを処理する
+ *   接続完了を確認してから往路の受信を始め、以降は送信可能になるたびに
+ *   中継を進める (接続できない場合は往路接続を閉じる)
+ * ============================================================================ */
+void relay_event(bridge_t *b, relay_t *r) {
+    socklen_t len = sizeof(int);
+    int opt = 1;
+    int err = 0;
+
+    if (r->fd < 0) {
+        return;                         /* 同じ回の先のイベントで閉じた */
+    }
+    if (!r->connected) {
+        if (getsockopt(r->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+            err = errno;
+        }
+        if (err != 0) {
+            fprintf(stderr, "[WARN] Pass-through connection failed: %s\n",
+                    strerror(err));
+            inbound_close(b, r->owner);
+            return;
+        }
+        r->connected = 1;
+        b->connects++;
+        setsockopt(r->fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        if (!b->quiet) {
+            ALOG_INFO("[INFO] Pass-through connection established\n");
+        }
+    }
+    relay_pump(b, r->owner);
+}
+
+/* ============================================================================
+ * 関数: relay_reap
+ * 機能: イベント処理中に閉じたパススルー接続を解放する
+ * ============================================================================ */
+void relay_reap(bridge_t *b) {
+    relay_t *r;
+
+    while ((r = b->closed) != NULL) {
+        b->closed = r->next_closed;
+        free(r->owner);
+        free(r);
+    }
+}
+
+/* ============================================================================
+ * 関数: inbound_event
+ * 機能: 往路接続から受信したメッセージを処理する
+ * 処理フロー:
+ *   1. ABOS2からメッセージを受信 (往路, 改行区切り・フレームとも複数可)
+ *      最初の受信の先頭バイトで接続の形式を判定する
+ *   2. メッセージごとに応答を生成して復路の送信キューへ入れる
+ *   3. ABOS2が往路を切断したら終了 (改行のない残りは1メッセージとして扱う)
+ *   1接続の読み出しは INBOUND_READ_ROUNDS 回までとし、他の接続に順番を渡す
+ * ============================================================================ */
+void inbound_event(bridge_t *b, inbound_conn_t *ic) {
+    unsigned char first;
+    ssize_t bytes_read;
+
+    if (ic->fd < 0) {
+        return;                         /* 同じ回の先のイベントで閉じた */
+    }
+    if (ic->mode == WIRE_RELAY) {
+        relay_pump(b, ic);
+        return;
+    }
+
+    /* パススルー時は先頭バイトを覗いて形式を判定する (本体を読み出さない) */
+    if (ic->mode == WIRE_UNKNOWN && b->passthrough &&
+        recv(ic->fd, &first, 1, MSG_PEEK) == 1 && first == FRAME_MAGIC) {
+        if (b->probe != NULL) {
+            stage_record(b->probe, STAGE_ACCEPT, stage_now() - ic->accepted_ns);
+        }
+        if (relay_open(b, ic) < 0) {
+            inbound_close(b, ic);
+        }
+        return;
+    }
+
+    for (int round = 0; round < INBOUND_READ_ROUNDS; round++) {
+        /* 往路メッセージの受信 (テキスト形式は従来どおり1行 BUFFER_SIZE - 1 まで) */
+        if (ic->mode == WIRE_FRAMED) {
+            bytes_read = frame_buffer_read(&ic->in, ic->fd);
+        } else if (frame_buffer_reserve(&ic->in, BUFFER_SIZE) < 0) {
+            errno = ENOMEM;
+            bytes_read = -1;
+        } else {
+            bytes_read = recv(ic->fd, ic->in.data + ic->in.len,
+                              BUFFER_SIZE - 1 - ic->in.len, 0);
+            if (bytes_read > 0) {
+                ic->in.len += bytes_read;
+            }
+        }
+        if (b->probe != NULL) {
+            b->read_ns = stage_now();
+        }
+        if (bytes_read > 0) {
+            sock_profile_rearm(ic->fd, b->profile);
+        }
+
+        if (bytes_read < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            perror("[ERROR] Failed to receive data from ABOS2");
+            inbound_close(b, ic);
+            return;
+        }
+        if (bytes_read == 0) {
+            /* 改行なしで切断する従来のクライアントのメッセージ */
+            if (ic->mode == WIRE_TEXT && ic->in.len > 0) {
+                ic->in.data[ic->in.len] = '\0';
+                handle_message(b, (char *)ic->in.data);
+            } else if (ic->mode == WIRE_FRAMED && ic->in.len > 0) {
+                fprintf(stderr, "[WARN] Discarding incomplete frame (%zu bytes)\n",
+                        ic->in.len);
+            }
+            if (!b->quiet) {
+                ALOG_INFO("[INFO] ABOS2 disconnected gracefully\n");
+            }
+            inbound_close(b, ic);
+            return;
+        }
+
+        if (ic->mode == WIRE_UNKNOWN) {
+            ic->mode = ic->in.data[0] == FRAME_MAGIC ? WIRE_FRAMED : WIRE_TEXT;
+            if (b->probe != NULL) {
+                stage_record(b->probe, STAGE_ACCEPT, b->read_ns - ic->accepted_ns);
+            }
+        }
+        if (ic->mode == WIRE_TEXT) {
+            inbound_lines(b, ic);
+        } else if (inbound_frames(b, ic) < 0) {
+            inbound_close(b, ic);
+            return;
+        }
+    }
+}
+
+/* ============================================================================
+ * 関数: accept_connections
+ * 機能: 待ち受けキューの接続をすべて受け入れ、epoll に登録する
+ *   fd が枯渇した場合は予備の fd を使って接続を受け入れてすぐ閉じる
+ *   (待ち受けキューに残したままだと epoll が通知し続けるため)
+ * ============================================================================ */
+void accept_connections(bridge_t *b) {
+    struct epoll_event ev;
+    inbound_conn_t *ic;
+    int opt = 1;
+    int fd;
+
+    while (TRUE) {
+        fd = accept4(b->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            if ((errno == EMFILE || errno == ENFILE) && b->spare_fd >= 0) {
+                fprintf(stderr, "[WARN] Out of file descriptors, "
+                        "rejecting connection\n");
+                close(b->spare_fd);
+                fd = accept(b->listen_fd, NULL, NULL);
+                if (fd >= 0) {
+                    close(fd);
+                }
+                b->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                continue;
+            }
+            perror("[ERROR] Accept failed");
+            return;
+        }
+
+        ic = malloc(sizeof(*ic));
+        if (ic == NULL) {
+            perror("[ERROR] Failed to allocate connection");
+            close(fd);
+            continue;
+        }
+        memset(ic, 0, sizeof(*ic));
+        ic->kind = EV_INBOUND;
+        ic->fd = fd;
+        ic->mode = WIRE_UNKNOWN;
+        if (b->probe != NULL) {
+            ic->accepted_ns = stage_now();
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        sock_profile_accepted(fd, b->profile);
+
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = ic;
+        if (epoll_ctl(b->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            perror("[ERROR] epoll_ctl failed for connection");
+            close(fd);
+            free(ic);
+            continue;
+        }
+        b->active++;
+        b->accepted++;
+        if (!b->quiet) {
+            ALOG_INFO("[INFO] Connection accepted from ABOS2\n");
+        }
+    }
+}
+
+/* ============================================================================
+ * 関数: udp_session
+ * 機能: セッションIDの管理情報を探す
+ *   create = 1 で見つからない場合は、空き (なければ最も長く要求のない
+ *   セッション) を新しいセッションとして使う
+ * 戻り値: セッション (NULL = 見つからない)
+ * ============================================================================ */
+udp_session_t *udp_session(bridge_t *b, uint32_t id, int create) {
+    udp_session_t *s = NULL;
+
+    for (int i = 0; i < UDP_SESSIONS; i++) {
+        if (b->sessions[i].id == id) {
+            return &b->sessions[i];
+        }
+        /* 空きの枠は last_seen = 0 のため最初に選ばれる */
+        if (s == NULL || b->sessions[i].last_seen < s->last_seen) {
+            s = &b->sessions[i];
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+    if (s->id != 0) {
+        ALOG_WARN("[WARN] UDP session %08x evicted (%d sessions in use)\n",
+                  s->id, UDP_SESSIONS);
+    }
+    s->id = id;
+    udpt_window_reset(&s->window);
+    for (int i = 0; i < UDPT_WINDOW; i++) {
+        s->replies[i].seq = 0;
+    }
+    b->udp_sessions++;
+    if (!b->quiet) {
+        ALOG_INFO("[INFO] UDP session %08x started\n", id);
+    }
+    return s;
+}
+
+/* ============================================================================
+ * 関数: udp_request
+ * 機能: UDP の要求1個を処理し、送信する応答を返す
+ *   初めての要求は応答 (従来の応答文 + 要求本体) を作って番号の枠に保持し、
+ *   重複した要求には ACK されていない保持中の応答を返す (処理は1回のみ)
+ * 戻り値: 送信する応答 (NULL = 送信しない)
+ * ============================================================================ */
+udp_reply_t *udp_request(bridge_t *b, const udpt_datagram_t *d) {
+    char prefix[UDPT_RESPONSE_PREFIX];
+    udp_session_t *s;
+    udp_reply_t *r;
+    size_t prefix_len, echo_len;
+
+    s = udp_session(b, d->session, 1);
+    s->last_seen = b->now;
+    r = &s->replies[d->seq % UDPT_WINDOW];
+
+    switch (udpt_window_check(&s->window, d->seq)) {
+    case UDPT_NEW:
+        break;
+    case UDPT_DUPLICATE:
+        b->udp_duplicates++;
+        if (r->seq != d->seq || r->acked) {
+            return NULL;                /* 応答はクライアントに届いている */
+        }
+        b->udp_resent++;
+        return r;
+    default:
+        b->udp_duplicates++;
+        return NULL;
+    }
+
+    count_message(b);
+    b->udp_requests++;
+    if (!b->quiet) {
+        ALOG_INFO("[RECV] Datagram seq=%u from ABOS2 via %s:%d (%u bytes)\n",
+                  d->seq, SERVER_IP_INBOUND, SERVER_PORT_INBOUND, d->length);
+    }
+
+    generate_response(prefix, sizeof(prefix), "");
+    prefix_len = strlen(prefix);
+    echo_len = d->length;
+    if (prefix_len + echo_len > UDPT_MAX_PAYLOAD) {
+        echo_len = UDPT_MAX_PAYLOAD - prefix_len;
+    }
+    udpt_put_header(r->data, UDPT_TYPE_RESPONSE, d->session, d->seq);
+    memcpy(r->data + UDPT_HEADER_SIZE, prefix, prefix_len);
+    memcpy(r->data + UDPT_HEADER_SIZE + prefix_len, d->payload, echo_len);
+    r->seq = d->seq;
+    r->len = (uint16_t)(UDPT_HEADER_SIZE + prefix_len + echo_len);
+    r->acked = 0;
+
+    if (!b->quiet) {
+        ALOG_INFO("[SEND] Response datagram seq=%u sent via %s (%zu bytes)\n",
+                  d->seq, RESPONSE_SRC_IP, prefix_len + echo_len);
+    }
+    return r;
+}
+
+/* ============================================================================
+ * 関数: udp_receive
+ * 機能: UDP ソケットから最大 UDP_BATCH 個のデータグラムを recvmmsg() で受信する
+ * 戻り値: 受信数 (0 = なし, -1 = エラー)
+ * ============================================================================ */
+int udp_receive(bridge_t *b, int fd, struct mmsghdr *msgs, struct iovec *iov) {
+    int n;
+
+    for (int i = 0; i < UDP_BATCH; i++) {
+        iov[i].iov_base = b->udp_rx[i];
+        iov[i].iov_len = UDPT_DATAGRAM_MAX;
+        memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    do {
+        n = recvmmsg(fd, msgs, UDP_BATCH, MSG_DONTWAIT, NULL);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        perror("[ERROR] recvmmsg failed");
+    }
+    return n;
+}
+
+/* ============================================================================
+ * 関数: udp_requests_event
+ * 機能: UDP の要求をまとめて受信・処理し、応答を sendmmsg() でまとめて送る
+ *   ソケットが満杯で送れなかった応答は、クライアントの再送で送り直す
+ * ============================================================================ */
+void udp_requests_event(bridge_t *b) {
+    struct mmsghdr in[UDP_BATCH], out[UDP_BATCH];
+    struct iovec in_iov[UDP_BATCH], out_iov[UDP_BATCH];
+    udpt_datagram_t d;
+    udp_reply_t *r;
+    int n, count, sent, m;
+
+    for (int round = 0; round < INBOUND_READ_ROUNDS; round++) {
+        n = udp_receive(b, b->udp_fd, in, in_iov);
+        if (n <= 0) {
+            return;
+        }
+
+        count = 0;
+        for (int i = 0; i < n; i++) {
+            if ((in[i].msg_hdr.msg_flags & MSG_TRUNC) ||
+                udpt_parse(b->udp_rx[i], in[i].msg_len, &d) < 0 ||
+                d.type != UDPT_TYPE_REQUEST) {
+                b->udp_errors++;
+                continue;
+            }
+            r = udp_request(b, &d);
+            if (r == NULL) {
+                continue;
+            }
+            out_iov[count].iov_base = r->data;
+            out_iov[count].iov_len = r->len;
+            memset(&out[count].msg_hdr, 0, sizeof(out[count].msg_hdr));
+            out[count].msg_hdr.msg_name = &b->dest;
+            out[count].msg_hdr.msg_namelen = sizeof(b->dest);
+            out[count].msg_hdr.msg_iov = &out_iov[count];
+            out[count].msg_hdr.msg_iovlen = 1;
+            count++;
+        }
+
+        for (sent = 0; sent < count; sent += m) {
+            m = sendmmsg(b->udp_ack_fd, out + sent, count - sent, MSG_DONTWAIT);
+            if (m < 0 && errno == EINTR) {
+                m = 0;
+                continue;
+            }
+            if (m <= 0) {
+                b->udp_errors += count - sent;
+                break;
+            }
+        }
+        if (n < UDP_BATCH) {
+            return;
+        }
+    }
+}
+
+/* ============================================================================
+ * 関数: udp_acks_event
+ * 機能: 応答の ACK をまとめて受信し、保持している応答を送信済みにする
+ * ============================================================================ */
+void udp_acks_event(bridge_t *b) {
+    struct mmsghdr in[UDP_BATCH];
+    struct iovec in_iov[UDP_BATCH];
+    udpt_datagram_t d;
+    udp_session_t *s;
+    udp_reply_t *r;
+    int n;
+
+    for (int round = 0; round < INBOUND_READ_ROUNDS; round++) {
+        n = udp_receive(b, b->udp_ack_fd, in, in_iov);
+        if (n <= 0) {
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            if (udpt_parse(b->udp_rx[i], in[i].msg_len, &d) < 0 ||
+                d.type != UDPT_TYPE_ACK) {
+                b->udp_errors++;
+                continue;
+            }
+            s = udp_session(b, d.session, 0);
+            if (s == NULL) {
+                continue;
+            }
+            r = &s->replies[d.seq % UDPT_WINDOW];
+            if (r->seq == d.seq && !r->acked) {
+                r->acked = 1;
+                b->udp_acks++;
+                b->delivered++;
+            }
+        }
+        if (n < UDP_BATCH) {
+            return;
+        }
+    }
+}
+
+/* ============================================================================
+ * 関数: open_udp_sockets
+ * 機能: UDP の往路ソケット (192.168.100.1:8000, SO_REUSEPORT) と復路ソケット
+ *       (192.168.200.1, ポートは自動割り当て) を作成して epoll に登録する
+ *   往路はカーネルが送信元ごとにワーカーへ振り分け、ACK は応答を送った
+ *   ワーカーの復路ソケットに届くため、セッションはワーカー内で完結する
+ * 戻り値: 0 = 成功, -1 = 失敗
+ * ============================================================================ */
+int open_udp_sockets(bridge_t *b) {
+    struct sockaddr_in addr;
+    struct epoll_event ev;
+    int size = UDP_SOCKET_BUFFER;
+    int opt = 1;
+
+    b->sessions = calloc(UDP_SESSIONS, sizeof(*b->sessions));
+    b->udp_rx = malloc(UDP_BATCH * sizeof(*b->udp_rx));
+    if (b->sessions == NULL || b->udp_rx == NULL) {
+        perror("[ERROR] Failed to allocate UDP sessions");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SERVER_PORT_INBOUND);
+    inet_pton(AF_INET, SERVER_IP_INBOUND, &addr.sin_addr);
+
+    b->udp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    b->udp_ack_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (b->udp_fd < 0 || b->udp_ack_fd < 0) {
+        perror("[ERROR] UDP socket creation failed");
+        return -1;
+    }
+    if (setsockopt(b->udp_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("[ERROR] Failed to set SO_REUSEPORT on UDP socket");
+        return -1;
+    }
+    setsockopt(b->udp_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(b->udp_ack_fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+    if (bind(b->udp_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("[ERROR] UDP bind failed");
+        return -1;
+    }
+    if (bind(b->udp_ack_fd, (struct sockaddr *)&b->src, sizeof(b->src)) < 0) {
+        perror("[ERROR] UDP return bind failed");
+        return -1;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = &udp_request_kind;
+    if (epoll_ctl(b->epfd, EPOLL_CTL_ADD, b->udp_fd, &ev) < 0) {
+        perror("[ERROR] epoll_ctl failed for UDP socket");
+        return -1;
+    }
+    ev.data.ptr = &udp_ack_kind;
+    if (epoll_ctl(b->epfd, EPOLL_CTL_ADD, b->udp_ack_fd, &ev) < 0) {
+        perror("[ERROR] epoll_ctl failed for UDP return socket");
+        return -1;
+    }
+    printf("[INFO] Worker %d UDP requests on %s:%d\n",
+           b->id, SERVER_IP_INBOUND, SERVER_PORT_INBOUND);
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: bridge_init
+ * 機能: ワーカーの復路のアドレス・送信キュー・タイマと epoll を準備する
+ * 戻り値: 0 = 成功, -1 = 失敗
+ * ============================================================================ */
+int bridge_init(bridge_t *b, const bridge_config_t *cfg, int id) {
+    memset(b, 0, sizeof(*b));
+    b->id = id;
+    b->cpu = -1;
+    b->listen_fd = -1;
+    b->udp_fd = -1;
+    b->udp_ack_fd = -1;
+    b->persistent = cfg->persistent;
+    b->passthrough = cfg->passthrough;
+    b->quiet = cfg->quiet;
+    b->profile = cfg->profile;
+    b->queue_depth = cfg->queue_depth;
+    b->max_age_ms = cfg->max_age_ms;
+    b->policy = cfg->policy;
+    b->stats_interval = cfg->stats_interval;
+    b->now = now_ms();
+    b->stats_at = b->now;
+    timer_wheel_init(&b->wheel, b->now);
+    b->seed = (unsigned int)(b->now ^ getpid() ^ ((unsigned int)id << 16));
+
+    /* 復路接続先の設定 (ABOS2) */
+    b->dest.sin_family = AF_INET;
+    b->dest.sin_port = htons(CLIENT_PORT_OUTBOUND);
+    if (inet_pton(AF_INET, CLIENT_IP_OUTBOUND, &b->dest.sin_addr) <= 0) {
+        fprintf(stderr, "[ERROR] Invalid address: %s\n", CLIENT_IP_OUTBOUND);
+        return -1;
+    }
+
+    /* 送信元IPアドレス (192.168.200.1, ポートはOSが自動割り当て) */
+    b->src.sin_family = AF_INET;
+    b->src.sin_port = htons(0);
+    if (inet_pton(AF_INET, RESPONSE_SRC_IP, &b->src.sin_addr) <= 0) {
+        fprintf(stderr, "[ERROR] Invalid address: %s\n", RESPONSE_SRC_IP);
+        return -1;
+    }
+
+    if (b->persistent) {
+        b->shared = return_conn_new(b, 1, RETURN_QUEUE_SIZE, b->queue_depth);
+        if (b->shared == NULL) {
+            return -1;
+        }
+    }
+    timer_init(&b->stats_timer, on_stats_timer);
+    if (b->stats_interval > 0) {
+        timer_schedule(&b->wheel, &b->stats_timer, b->now + b->stats_interval * 1000LL);
+    }
+
+    b->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (b->epfd < 0) {
+        perror("[ERROR] epoll_create1 failed");
+        return -1;
+    }
+    b->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: open_listener
+ * 機能: 往路の待ち受けソケットを作成する (待ち受けできるまでリトライ)
+ *   SO_REUSEPORT により、ワーカーごとに同じアドレスで待ち受け、
+ *   新しい接続はカーネルが各ワーカーのソケットに振り分ける
+ * 引数:
+ *   profile - TCP ソケットの設定 (低遅延では Fast Open の要求を受け付ける)
+ * 戻り値: ソケット (-1 = 失敗)
+ * ============================================================================ */
+int open_listener(int id, sock_profile_t profile) {
+    struct sockaddr_in serv_addr;
+    int listen_sock;
+    int opt = 1;
+
+    /* 待ち受けアドレスの設定 (192.168.100.1:8000) */
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(SERVER_PORT_INBOUND);
+    if (inet_pton(AF_INET, SERVER_IP_INBOUND, &serv_addr.sin_addr) <= 0) {
+        fprintf(stderr, "[ERROR] Invalid SERVER_IP_INBOUND: %s\n",
+                SERVER_IP_INBOUND);
+        return -1;
+    }
+
+    /* Server機能の起動とリトライループ */
+    while (g_running) {
+        listen_sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_sock < 0) {
+            perror("[ERROR] Listen socket creation failed");
+            return -1;
+        }
+
+        /* ポート再利用設定 (ワーカー間で同じポートを共有する) */
+        if (setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR,
+                       &opt, sizeof(opt)) < 0) {
+            perror("[WARN] Failed to set SO_REUSEADDR");
+        }
+        if (setsockopt(listen_sock, SOL_SOCKET, SO_REUSEPORT,
+                       &opt, sizeof(opt)) < 0) {
+            perror("[ERROR] Failed to set SO_REUSEPORT");
+            close(listen_sock);
+            return -1;
+        }
+        sock_profile_listener(listen_sock, profile);
+
+        /* バインドとリッスン */
+        if (bind(listen_sock, (struct sockaddr *)&serv_addr,
+                 sizeof(serv_addr)) == 0 &&
+            listen(listen_sock, MAX_PENDING) == 0) {
+            printf("[INFO] Worker %d listening on %s:%d\n",
+                   id, SERVER_IP_INBOUND, SERVER_PORT_INBOUND);
+            return listen_sock;
+        }
+
+        /* 待ち受け失敗時のリトライ */
+        perror("[WARN] Failed to start server (retrying...)");
+        close(listen_sock);
+        sleep(RETRY_DELAY);
+    }
+    return -1;
+}
+
+/* ============================================================================
+ * 関数: worker_main
+ * 機能: ワーカースレッド本体。自分の epoll で往路の受け入れ・受信と
+ *       復路の送信を処理し、終了通知 (eventfd) で抜ける
+ * ============================================================================ */
+void *worker_main(void *arg) {
+    bridge_t *b = (bridge_t *)arg;
+    struct epoll_event events[MAX_EVENTS];
+    struct timespec cpu;
+    char name[16];
+    int running = TRUE;
+    int n;
+
+    snprintf(name, sizeof(name), "worker%d", b->id);
+    b->probe = stage_thread(g_stages, name);
+
+    /* イベントループ */
+    while (running) {
+        n = epoll_wait(b->epfd, events, MAX_EVENTS,
+                       timer_wheel_timeout(&b->wheel, now_ms()));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("[ERROR] epoll_wait failed");
+            break;
+        }
+        b->now = now_ms();
+
+        for (int i = 0; i < n; i++) {
+            switch (*(ev_kind_t *)events[i].data.ptr) {
+            case EV_LISTENER:
+                accept_connections(b);
+                break;
+            case EV_INBOUND:
+                inbound_event(b, events[i].data.ptr);
+                break;
+            case EV_RETURN:
+                return_conn_event(b, events[i].data.ptr, events[i].events);
+                break;
+            case EV_RELAY:
+                relay_event(b, events[i].data.ptr);
+                break;
+            case EV_UDP_REQUEST:
+                udp_requests_event(b);
+                break;
+            case EV_UDP_ACK:
+                udp_acks_event(b);
+                break;
+            case EV_STOP:
+                running = 0;
+                break;
+            }
+        }
+
+        /* 閉じたパススルー接続の解放と、再接続・定期表示のタイマ */
+        relay_reap(b);
+        timer_wheel_advance(&b->wheel, b->now, b);
+
+        /* 処理数を共有メモリへ反映 (-T 時) */
+        if (b->probe != NULL) {
+            stage_set(b->probe, COUNTER_MESSAGES, b->messages);
+            stage_set(b->probe, COUNTER_DELIVERED, b->delivered);
+            stage_set(b->probe, COUNTER_DROPPED, b->dropped + b->expired);
+            stage_set(b->probe, COUNTER_CONNECTS, b->connects);
+        }
+    }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    b->cpu_ns = (long long)cpu.tv_sec * 1000000000LL + cpu.tv_nsec;
+    return NULL;
+}
+
+/* ============================================================================
+ * 関数: worker_start
+ * 機能: ワーカースレッドを起動し、CPU番号 = ワーカー番号 で固定する
+ *   (CPU数を超えるワーカーは固定しない)
+ * 戻り値: 0 = 成功, -1 = 失敗
+ * ============================================================================ */
+int worker_start(bridge_t *b) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_attr_t attr;
+    cpu_set_t set;
+    int err;
+
+    pthread_attr_init(&attr);
+    if (b->id < cpus) {
+        b->cpu = b->id;
+        CPU_ZERO(&set);
+        CPU_SET(b->cpu, &set);
+        pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+    }
+    err = pthread_create(&b->thread, &attr, worker_main, b);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        fprintf(stderr, "[ERROR] Failed to start worker %d: %s\n", b->id, strerror(err));
+        return -1;
+    }
+    if (b->cpu >= 0) {
+        ALOG_INFO("[INFO] Worker %d pinned to CPU%d\n", b->id, b->cpu);
+    } else {
+        ALOG_WARN("[WARN] CPU%d not available, worker %d not pinned\n", b->id, b->id);
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: print_worker_summary
+ * 機能: ワーカーごとと全体の処理メッセージ数・メッセージ/秒を表示する
+ *   (レートは最初から最後のメッセージを受信するまでの時間で求める。
+ *    1ms 未満の場合は 1ms とする)
+ *   フレーム形式の要求があれば、本体のバイト数と1バイトあたりのCPU時間
+ *   (全ワーカーのスレッドCPU時間の合計 / 本体バイト数) も表示する
+ * ============================================================================ */
+void print_worker_summary(bridge_t *bridges, int count) {
+    unsigned long messages = 0, accepted = 0, delivered = 0, dropped = 0;
+    unsigned long long bytes = 0;
+    long long first = 0, last = 0, span, cpu_ns = 0;
+    char cpu[16];
+
+    for (int i = 0; i < count; i++) {
+        bridge_t *b = &bridges[i];
+
+        if (b->cpu >= 0) {
+            snprintf(cpu, sizeof(cpu), "CPU%d", b->cpu);
+        } else {
+            snprintf(cpu, sizeof(cpu), "not pinned");
+        }
+        span = b->last_message - b->first_message;
+        printf("[STATS] worker %d (%s): %lu connections, %lu messages, "
+               "%.0f msg/s, %lu delivered, %lu dropped\n",
+               b->id, cpu, b->accepted, b->messages,
+               b->messages * 1000.0 / (span > 0 ? span : 1),
+               b->delivered, b->dropped + b->expired);
+        if (b->udp_fd >= 0) {
+            printf("[STATS] worker %d udp: %lu requests, %lu duplicates "
+                   "(%lu responses resent), %lu acked, %lu sessions, %lu errors\n",
+                   b->id, b->udp_requests, b->udp_duplicates, b->udp_resent,
+                   b->udp_acks, b->udp_sessions, b->udp_errors);
+        }
+        if (b->messages > 0) {
+            if (messages == 0 || b->first_message < first) {
+                first = b->first_message;
+            }
+            if (b->last_message > last) {
+                last = b->last_message;
+            }
+        }
+        messages += b->messages;
+        accepted += b->accepted;
+        delivered += b->delivered;
+        dropped += b->dropped + b->expired;
+        bytes += b->bytes;
+        cpu_ns += b->cpu_ns;
+    }
+    span = last - first;
+    printf("[STATS] total (%d workers): %lu connections, %lu messages, "
+           "%.0f msg/s, %lu delivered, %lu dropped\n",
+           count, accepted, messages, messages * 1000.0 / (span > 0 ? span : 1),
+           delivered, dropped);
+    if (bytes > 0) {
+        printf("[STATS] frame payload: %.1f MB, CPU %.3f s, %.3f ns CPU/byte\n",
+               bytes / 1e6, cpu_ns / 1e9, (double)cpu_ns / bytes);
+    }
+}
+
+/* ============================================================================
+ * 関数: handle_signal
+ * 機能: 終了シグナルを受けてワーカーを停止させる
+ * ============================================================================ */
+void handle_signal(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+/* ============================================================================
+ * 関数: main
+ * 機能: ワーカーごとに Server機能を起動し、終了シグナルを待つ
+ * ============================================================================ */
+int main(int argc, char *argv[]) {
+    bridge_t *bridges;
+    struct epoll_event ev;
+    struct sigaction sa;
+    sigset_t block_set, orig_set;
+    bridge_config_t cfg = {
+        .persistent = 1,
+        .queue_depth = DELIVERY_QUEUE_DEPTH,
+        .max_age_ms = DELIVERY_MAX_AGE_MS,
+        .policy = DROP_NEWEST,
+        .workers = 1,
+    };
+    uint64_t one = 1;
+    int stop_fd;
+    int started = 0;
+    int probes = 0;
+    const char *log_path = NULL;
+    int c;
+
+    /* コマンドライン引数の解析 */
+    while ((c = getopt(argc, argv, "oPuFqTl:w:Q:A:D:S:h")) != -1) {
+        switch (c) {
+        case 'o':
+            cfg.persistent = 0;
+            break;
+        case 'P':
+            cfg.passthrough = 1;
+            break;
+        case 'u':
+            cfg.udp = 1;
+            break;
+        case 'F':
+            cfg.profile = SOCK_PROFILE_LOWLAT;
+            break;
+        case 'q':
+            cfg.quiet = 1;
+            break;
+        case 'T':
+            probes = 1;
+            break;
+        case 'l':
+            log_path = optarg;
+            break;
+        case 'w':
+            cfg.workers = atoi(optarg);
+            if (cfg.workers <= 0 || cfg.workers > WORKER_MAX) {
+                fprintf(stderr, "[ERROR] Invalid worker count: %s (1-%d)\n",
+                        optarg, WORKER_MAX);
+                return 1;
+            }
+            break;
+        case 'Q':
+            cfg.queue_depth = strtoul(optarg, NULL, 10);
+            if (cfg.queue_depth == 0) {
+                fprintf(stderr, "[ERROR] Invalid queue depth: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'A':
+            cfg.max_age_ms = atoll(optarg);
+            break;
+        case 'D':
+            if (strcmp(optarg, "new") == 0) {
+                cfg.policy = DROP_NEWEST;
+            } else if (strcmp(optarg, "old") == 0) {
+                cfg.policy = DROP_OLDEST;
+            } else {
+                fprintf(stderr, "[ERROR] Invalid drop policy: %s (new|old)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'S':
+            cfg.stats_interval = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-o] [-P] [-u] [-F] [-q] [-T] [-l log_file] [-w workers] "
+                    "[-Q depth] [-A max_age_ms] [-D new|old] [-S stats_sec]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("============================================================\n");
+    printf("  Bridge Server/Client (ABOS1, C) Starting\n");
+    printf("  Workers: %d (SO_REUSEPORT, %ld CPUs online)\n",
+           cfg.workers, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("  Return Path: %s%s\n",
+           cfg.persistent ? "persistent connection" : "connection per response",
+           cfg.passthrough ? ", frames passed through with splice()" : "");
+    printf("  Delivery Queue: %zu responses, max age %lld ms, drop %s\n",
+           cfg.queue_depth, cfg.max_age_ms,
+           cfg.policy == DROP_OLDEST ? "oldest" : "newest");
+    printf("  Socket Profile: %s\n", sock_profile_name(cfg.profile));
+    if (cfg.udp) {
+        printf("  UDP Transport: %s:%d -> %s:%d (ack/retransmit)\n",
+               SERVER_IP_INBOUND, SERVER_PORT_INBOUND,
+               CLIENT_IP_OUTBOUND, CLIENT_PORT_OUTBOUND);
+    }
+    printf("============================================================\n");
+
+    raise_fd_limit();
+    sock_profile_check(cfg.profile);
+    if (probes) {
+        g_stages = stage_shm_create("Bridge_C", stage_names, sizeof(stage_names) / sizeof(stage_names[0]),
+                                    counter_names,
+                                    sizeof(counter_names) / sizeof(counter_names[0]));
+    }
+    bridges = calloc(cfg.workers, sizeof(*bridges));
+    stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (bridges == NULL || stop_fd < 0) {
+        perror("[ERROR] Failed to allocate workers");
+        return 1;
+    }
+
+    /* 終了シグナルの設定 (待ち受けのリトライ中も終了できるよう先に設定) */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    /* ワーカーごとの待ち受けソケットと終了通知を epoll に登録 */
+    for (int i = 0; i < cfg.workers; i++) {
+        bridge_t *b = &bridges[i];
+
+        if (bridge_init(b, &cfg, i) < 0) {
+            return 1;
+        }
+        b->listen_fd = open_listener(i, cfg.profile);
+        if (b->listen_fd < 0) {
+            return 1;
+        }
+        ev.events = EPOLLIN;
+        ev.data.ptr = &listener_kind;
+        if (epoll_ctl(b->epfd, EPOLL_CTL_ADD, b->listen_fd, &ev) < 0) {
+            perror("[ERROR] epoll_ctl failed for listen socket");
+            return 1;
+        }
+        ev.events = EPOLLIN;
+        ev.data.ptr = &stop_kind;
+        if (epoll_ctl(b->epfd, EPOLL_CTL_ADD, stop_fd, &ev) < 0) {
+            perror("[ERROR] epoll_ctl failed for stop event");
+            return 1;
+        }
+        if (cfg.udp && open_udp_sockets(b) < 0) {
+            return 1;
+        }
+    }
+
+    /* ワーカーの起動 (シグナルは main で受けるため遮断して生成) */
+    sigemptyset(&block_set);
+    sigaddset(&block_set, SIGINT);
+    sigaddset(&block_set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block_set, &orig_set);
+    alog_start("Bridge_C", log_path);
+    for (; started < cfg.workers && g_running; started++) {
+        if (worker_start(&bridges[started]) < 0) {
+            g_running = 0;
+            break;
+        }
+    }
+    fflush(stdout);
+    while (g_running) {
+        sigsuspend(&orig_set);
+    }
+    pthread_sigmask(SIG_SETMASK, &orig_set, NULL);
+
+    /* 全ワーカーに終了を通知し、停止を待ってから集計を表示 */
+    ALOG_INFO("\n[INFO] Stopping %d workers\n", started);
+    if (write(stop_fd, &one, sizeof(one)) < 0) {
+        perror("[ERROR] Failed to notify workers");
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(bridges[i].thread, NULL);
+    }
+    alog_stop();
+    print_worker_summary(bridges, started);
+
+    /* クリーンアップ */
+    for (int i = 0; i < cfg.workers; i++) {
+        bridge_t *b = &bridges[i];
+
+        if (b->shared != NULL) {
+            return_conn_free(b, b->shared);
+        }
+        if (b->udp_fd >= 0) {
+            close(b->udp_fd);
+        }
+        if (b->udp_ack_fd >= 0) {
+            close(b->udp_ack_fd);
+        }
+        free(b->sessions);
+        free(b->udp_rx);
+        close(b->listen_fd);
+        close(b->epfd);
+        if (b->spare_fd >= 0) {
+            close(b->spare_fd);
+        }
+    }
+    close(stop_fd);
+    free(bridges);
+    stage_shm_destroy(g_stages);
+    return 0;
+}
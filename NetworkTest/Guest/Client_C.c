@@ -5,20 +5,98 @@
  * 機能:
  *   - ABOS1へメッセージを送信 (Client機能: 192.168.100.1:8000へ接続)
  *   - ABOS1からの応答を受信 (Server機能: 192.168.200.2:8000で待ち受け)
+ *     (待ち受けは起動時に作成して維持し、応答は送信と並行して受け入れる)
+ *   - 送信から応答受信までの往復時間 (RTT) を表示
+ *     (従来モードはメッセージに番号を付け、応答を番号で送信と対応付ける)
+ *   - 接続維持モード (-p): 往路・復路とも1本の接続を維持し、
+ *     改行区切りのメッセージを送受信する (Bridge_C の復路接続維持に対応)
+ *   - 負荷試験モード (-L): 同時接続数・目標レート・要求サイズの分布・試験時間を
+ *     指定して要求を送り、相関IDと送信時刻を埋め込んだ要求の応答から
+ *     RTT のヒストグラム (p50/p99/p99.9/max) とスループットを表示する
+ *     (テキスト形式のため Bridge_C・Bridge_Java を同じ条件で測定できる)
+ *   - フレーム形式モード (-f): 長さヘッダと相関IDを持つフレーム
+ *     (frame_protocol.h) で送受信する。最大 -w 個の要求を応答を待たずに
+ *     続けて送り (パイプライン)、応答は相関IDで要求と対応付ける
+ *     (大きな要求の送信中も復路の応答を読み進める)
+ *     応答のない要求は 5 秒で打ち切り、失われた要求として数える
+ *     終了時に RTT の平均・最大とパーセンタイル・度数分布を表示する
+ *   - UDP 転送モード (-u): 要求・応答を UDP データグラム1個ずつで送受信する
+ *     (udp_transport.h, Bridge_C -u に対応)。往路・復路とも接続しない。
+ *     要求に1から順に番号を付け、応答が届かなければ再送し、受け取った
+ *     応答には ACK を返し、重複した応答は捨てる。ウィンドウ・本体サイズ・
+ *     要求数・表示はフレーム形式モードと同じで、RTT を TCP と比較できる
+ *   - 段階ごとの計測 (-T): 往路の接続・要求の送信・RTT の所要時間と
+ *     送信数・受信数を共有メモリ (stage_probe.h) へ記録する (全モード共通)。
+ *     実行中に StageStat で表示する
+ *   - 非同期ログ (async_log.h): 送信・受信・接続のログは書式IDと引数を
+ *     リングに書くのみで、整形と出力はバックグラウンドのスレッドが行う。
+ *     -l でバイナリのまま出力し、LogDecode で後から表示する (全モード共通)。
+ *     従来・接続維持モードを Ctrl+C で終了した場合、最後の数ミリ秒分の
+ *     ログは出力されないことがある
+ *   - 低遅延プロファイル (-F): 往路の接続・復路の待ち受けに TCP Fast Open、
+ *     TCP_NODELAY・TCP_QUICKACK (受信ごと)・SO_BUSY_POLL・固定の送受信
+ *     バッファを設定する (socket_profile.h, Bridge_C -F と同じ設定, TCP の
+ *     全モード)。メッセージごと・要求ごとの往路接続 (従来モード, -L -o) のみ
+ *     最初の要求を SYN に載せ、3ウェイハンドシェイクの往復をなくす
+ *     (接続の失敗は送信の失敗として表示される。接続を維持するモード
+ *     (-p, -f, -L) は Fast Open を使わない)。両側で net.ipv4.tcp_fastopen = 3 が必要
  *
  * 通信経路:
  *   [往路] ABOS2 (192.168.100.2) -> ABOS1 (192.168.100.1:8000)
  *   [復路] ABOS1 (192.168.200.1) -> ABOS2 (192.168.200.2:8000)
+ *
+ * 使い方:
+ *   ./Client_C [-p] [-i 送信間隔ms] [-F]
+ *   ./Client_C -f|-u [-w 同時要求数] [-s 本体サイズ] [-n 要求数] [-i 送信間隔ms] [-q]
+ *     -p  接続維持モード
+ *     -f  フレーム形式モード (接続維持, Bridge_C のみ対応)
+ *     -u  UDP 転送モード (Bridge_C -u のみ対応)
+ *     -w  応答待ちにできる要求数 (既定: 8, -u では 256 以下)
+ *     -s  要求本体のバイト数 (既定: 従来のメッセージ長, -u では 1272 以下)
+ *     -n  送信する要求数 (既定: 0 = 無制限)
+ *     -i  メッセージ送信サイクル間隔 (ミリ秒, 既定: 1000)
+ *     -q  要求ごとの表示を省略する (負荷試験モードでは毎秒の経過表示)
+ *     -T  段階ごとの所要時間を共有メモリに記録する (全モード, StageStat で表示)
+ *     -l  ログをバイナリ形式でファイルに出力する (全モード, LogDecode で表示)
+ *     -F  低遅延のソケット設定 (TCP Fast Open ほか, -u 以外の全モード)
+ *   ./Client_C -L [-c 同時接続数] [-r 要求数/秒] [-d 秒] [-s サイズ分布] [-o] [-q]
+ *     -L  負荷試験モード
+ *     -c  往路の同時接続数 (既定: 1)
+ *     -r  目標の要求数/秒 (open-loop, 既定: 0 = closed-loop:
+ *         各接続が応答を受けてから次の要求を送る)
+ *     -d  試験時間 (秒, 既定: 10)
+ *     -s  要求1行のバイト数: N / A-B (一様分布) / A,B,C (等確率) (既定: 64)
+ *     -o  要求ごとに往路接続する (Bridge_Java は1接続で1行のみ読むため必要)
+ *
+ * ビルド:
+ *   gcc -O2 -Wall -pthread -o Client_C Client_C.c
  * ============================================================================
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <limits.h>
 #include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#include "frame_protocol.h"
+#include "latency_hist.h"
+#include "stage_probe.h"
+#include "async_log.h"
+#include "udp_transport.h"
+#include "socket_profile.h"
 
 /* ============================================================================
  * ネットワーク設定
@@ -39,14 +117,161 @@
 #define RETRY_DELAY             1       /* 接続リトライ間隔 (秒) */
 #define BUFFER_SIZE             1024    /* バッファサイズ */
 #define MAX_PENDING             5       /* 待ち受けキューの最大数 */
+#define MESSAGE_WINDOW          16      /* 応答待ちにできるメッセージ数 (従来モード) */
+#define RESPONSE_TIMEOUT_MS     5000    /* 応答待ちのタイムアウト (ms, 従来・フレーム形式モード) */
+#define RETURN_CONN_MAX         16      /* 同時に受け入れる復路接続数 (従来モード) */
+#define FRAME_WINDOW            8       /* 応答待ちにできる要求数 (既定) */
+#define FRAME_WINDOW_MAX        4096    /* 応答待ちにできる要求数の上限 */
+#define LOADGEN_CONCURRENCY_MAX 10000   /* 負荷試験の同時接続数の上限 */
+#define LOADGEN_DURATION        10      /* 負荷試験の時間 (既定, 秒) */
+#define LOADGEN_PENDING         (1 << 18)   /* 応答待ちを管理する要求数 (相関ID % この数) */
+#define LOADGEN_TIMEOUT_MS      5000    /* 応答待ちのタイムアウト (ms) */
+#define LOADGEN_TICK_MS         100     /* タイムアウト確認・経過表示の間隔 (ms) */
+#define LOADGEN_OUT_MAX         (256 * 1024)    /* 接続ごとの未送信要求の上限 (バイト) */
+#define LOADGEN_SIZE_MAX        (BUFFER_SIZE - 2)   /* 要求1行の最大長 (Bridge_C の行長) */
+#define LOADGEN_SIZE_LIST_MAX   16      /* 要求サイズの候補数の上限 */
+#define LOADGEN_MAX_EVENTS      256     /* epoll_wait 1回で取り出すイベント数 */
+#define UDP_BATCH               64      /* recvmmsg / sendmmsg 1回のデータグラム数 */
+#define UDP_SOCKET_BUFFER       (4 * 1024 * 1024)   /* UDP ソケットの送受信バッファ */
 #define TRUE                    1
 
+/* ============================================================================
+ * 段階ごとの計測 (-T) の段階・カウンタ番号 (stage_names / counter_names の順)
+ * ============================================================================ */
+enum {
+    STAGE_CONNECT,                      /* 往路の接続開始 -> 接続完了 */
+    STAGE_SEND,                         /* 要求の送信 (send の所要時間) */
+    STAGE_RTT,                          /* 送信 -> 応答の受信 */
+};
+enum {
+    COUNTER_SENT,
+    COUNTER_RECEIVED,
+};
+
+static const char *const stage_names[] = { "connect", "send", "rtt" };
+static const char *const counter_names[] = { "sent", "received" };
+
 /* ============================================================================
  * プログラム情報
  * ============================================================================ */
 const char *CLIENT_HOST_NAME = "ABOS2";
 const char *CLIENT_LANGUAGE  = "C";
 
+/* ============================================================================
+ * 行単位受信バッファ (接続維持モードの復路用)
+ * ============================================================================ */
+typedef struct {
+    char   data[BUFFER_SIZE];
+    size_t len;                         /* 受信済みバイト数 */
+} line_reader_t;
+
+/* ============================================================================
+ * 応答待ちの要求 (フレーム形式モード: 相関ID % ウィンドウ,
+ *                 従来モード: メッセージ番号 % MESSAGE_WINDOW で管理)
+ * ============================================================================ */
+typedef struct {
+    uint32_t        id;                 /* 相関ID (0 = 空き) */
+    struct timespec sent_at;
+} pending_request_t;
+
+/* ============================================================================
+ * 応答待ちの要求 (UDP 転送モード: 要求番号 % ウィンドウで管理)
+ * ============================================================================ */
+typedef struct {
+    uint32_t  seq;                      /* 要求番号 (0 = 空き) */
+    int       retries;                  /* 再送した回数 */
+    long long sent_ns;                  /* 最初に送信した時刻 (RTT の起点) */
+    long long deadline_ns;              /* 次に再送する時刻 */
+} udp_pending_t;
+
+/* ============================================================================
+ * 負荷試験モード (-L)
+ * ============================================================================ */
+/* epoll に登録する対象の種別 (各構造体の先頭メンバ) */
+typedef enum {
+    LG_LISTENER,                        /* 復路の待ち受けソケット */
+    LG_SENDER,                          /* 往路接続 */
+    LG_RETURN,                          /* 復路接続 */
+} lg_kind_t;
+
+/* 要求サイズの分布 (固定長 / 一様分布 / 候補から等確率) */
+typedef struct {
+    int min, max;                       /* 一様分布の範囲 (固定長は min == max) */
+    int list[LOADGEN_SIZE_LIST_MAX];    /* 候補 (count > 0 の場合に使う) */
+    int count;
+} size_dist_t;
+
+/* 負荷試験の条件 */
+typedef struct {
+    int         concurrency;            /* 往路の同時接続数 */
+    double      rate;                   /* 目標の要求数/秒 (0 = closed-loop) */
+    int         duration;               /* 試験時間 (秒) */
+    int         per_request;            /* 1 = 要求ごとに往路接続 (Bridge_Java 用) */
+    size_dist_t sizes;
+    int         quiet;                  /* 1 = 経過表示を省略 */
+} loadgen_config_t;
+
+/* 往路接続 (送信スロット) */
+typedef struct {
+    lg_kind_t      kind;                /* LG_SENDER */
+    int            fd;                  /* -1 = 未接続 */
+    int            connected;
+    uint32_t       events;              /* epoll に登録中のイベント */
+    uint32_t       waiting_id;          /* closed-loop: 応答待ちの相関ID (0 = なし) */
+    long long      waiting_since;       /* 同, 送信時刻 (ns) */
+    long long      connect_ns;          /* 接続を開始した時刻 (-T 時, ns) */
+    int            fastopen;            /* 1 = Fast Open で接続し、確立を未確認 */
+    frame_buffer_t out;                 /* 未送信の要求 */
+} lg_sender_t;
+
+/* 復路接続 */
+typedef struct {
+    lg_kind_t      kind;                /* LG_RETURN */
+    int            fd;
+    frame_buffer_t in;                  /* 受信バッファ (未完成の行) */
+} lg_return_t;
+
+/* 応答待ちの要求 (相関ID % LOADGEN_PENDING で管理) */
+typedef struct {
+    uint32_t id;                        /* 相関ID (0 = 空き) */
+    int      sender;                    /* 送信した接続の番号 */
+} lg_pending_t;
+
+/* 負荷試験の状態 */
+typedef struct {
+    loadgen_config_t   cfg;
+    int                epfd;
+    int                listen_fd;
+    lg_sender_t       *senders;
+    lg_pending_t      *pending;
+    lat_hist_t         hist;            /* 全体の RTT */
+    lat_hist_t         interval_hist;   /* 経過表示の間の RTT */
+    unsigned int       seed;            /* 要求サイズの乱数 */
+    uint32_t           next_id;         /* 次の相関ID */
+    int                next_sender;     /* open-loop の振り分け先 */
+    int                generating;      /* 1 = 要求を生成中, 0 = 応答の待ち合わせ */
+    long long          start, now;      /* 試験開始・現在の時刻 (ns) */
+    unsigned long      issued;          /* open-loop: 生成した要求数 */
+    unsigned long      sent, received, timeouts, unexpected, errors, accepted;
+    unsigned long long bytes;           /* 送信した要求のバイト数 */
+    unsigned long      interval_sent;   /* 前回の経過表示時の送信数 */
+} loadgen_t;
+
+static lg_kind_t lg_listener_kind = LG_LISTENER;
+
+/* 送受信に使うアドレス (main で設定) */
+static struct sockaddr_in serv_addr_out;
+static struct sockaddr_in client_bind_addr;
+static struct sockaddr_in bind_addr_in;
+
+/* 段階ごとの計測 (-T 時のみ。単一スレッドのためスロットは1個) */
+static stage_shm_t *g_stages = NULL;
+static stage_slot_t *g_probe = NULL;
+static char g_stage_path[128];          /* 終了シグナル時に削除するファイル */
+
+/* TCP ソケットの設定 (-F = 低遅延) */
+static sock_profile_t g_profile = SOCK_PROFILE_DEFAULT;
+
 /* ============================================================================
  * 関数: generate_message
  * 機能: ABOS1へ送信するメッセージを生成
@@ -60,183 +285,2006 @@ void generate_message(char *buffer, size_t buffer_size) {
 }
 
 /* ============================================================================
- * 関数: main
- * 機能: ABOS1への定期的なメッセージ送信と応答受信
- * 処理フロー:
- *   1. ABOS1へ接続 (往路)
- *   2. メッセージを送信
- *   3. 接続をクローズ
- *   4. ABOS1からの応答を待ち受け (復路)
- *   5. 応答を受信
- *   6. 指定間隔で繰り返し
+ * 関数: elapsed_ms
+ * 機能: 2つの時刻の差をミリ秒で求める
  * ============================================================================ */
-int main(int argc, char *argv[]) {
-    struct sockaddr_in serv_addr_out;
-    struct sockaddr_in bind_addr_in;
-    struct sockaddr_in client_bind_addr;
-    struct sockaddr_in client_addr_in;
-    char send_buffer[BUFFER_SIZE];
-    char recv_buffer[BUFFER_SIZE];
+double elapsed_ms(const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1e3 +
+           (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/* ============================================================================
+ * 関数: connect_outbound
+ * 機能: ABOS1へ往路接続する (接続できるまでリトライ)
+ * 引数:
+ *   fastopen - 1 = 低遅延プロファイルで Fast Open を使う (メッセージごとの接続)。
+ *              connect はすぐに完了し、SYN は最初の送信とともに送られる
+ *              (接続の失敗は送信の失敗として通知される。確立の記録は
+ *               最初の送信の後に呼び出し側で行う)
+ * 戻り値: 接続済みソケット (失敗時は -1)
+ * ============================================================================ */
+int connect_outbound(int fastopen) {
+    long long started;
+    int client_sock_fd;
     int opt = 1;
 
-    printf("============================================================\n");
-    printf("  Client/Server (ABOS2, C) Starting\n");
-    printf("============================================================\n");
+    /* 往路接続のリトライループ */
+    while (TRUE) {
+        client_sock_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (client_sock_fd < 0) {
+            perror("[ERROR] Socket creation failed");
+            return -1;
+        }
 
-    /* 往路接続先の設定 (ABOS1) */
-    memset(&serv_addr_out, 0, sizeof(serv_addr_out));
-    serv_addr_out.sin_family = AF_INET;
-    serv_addr_out.sin_port = htons(SERVER_PORT_OUTBOUND);
-    
-    if (inet_pton(AF_INET, SERVER_IP_OUTBOUND, &serv_addr_out.sin_addr) <= 0) {
-        perror("[ERROR] Invalid outbound address");
-        return 1;
+        /* 送信元IPアドレスを明示的にバインド (192.168.100.2) */
+        if (bind(client_sock_fd, (struct sockaddr *)&client_bind_addr,
+                sizeof(client_bind_addr)) < 0) {
+            perror("[ERROR] Client bind failed");
+            close(client_sock_fd);
+            sleep(RETRY_DELAY);
+            continue;
+        }
+
+        ALOG_INFO("[INFO] Attempting to connect to ABOS1 at %s:%d\n",
+                  SERVER_IP_OUTBOUND, SERVER_PORT_OUTBOUND);
+        sock_profile_connect(client_sock_fd, g_profile, fastopen);
+
+        /* ABOS1への接続試行 */
+        started = stage_now();
+        if (connect(client_sock_fd, (struct sockaddr *)&serv_addr_out,
+                   sizeof(serv_addr_out)) == 0) {
+            if (!fastopen || g_profile != SOCK_PROFILE_LOWLAT) {
+                stage_record(g_probe, STAGE_CONNECT, stage_now() - started);
+                ALOG_INFO("[INFO] Outbound connection established\n");
+            }
+            break;
+        }
+
+        /* 接続失敗時のリトライ */
+        perror("[WARN] Connection failed (retrying...)");
+        close(client_sock_fd);
+        sleep(RETRY_DELAY);
     }
 
-    /* 復路待ち受けアドレスの設定 (ABOS2) */
-    memset(&bind_addr_in, 0, sizeof(bind_addr_in));
-    bind_addr_in.sin_family = AF_INET;
-    bind_addr_in.sin_port = htons(CLIENT_PORT_INBOUND);
-    
-    if (inet_pton(AF_INET, CLIENT_IP_INBOUND, &bind_addr_in.sin_addr) <= 0) {
-        perror("[ERROR] Invalid inbound bind address");
+    /* メッセージは1個ずつ即時に送る (Nagle による遅延をなくす) */
+    setsockopt(client_sock_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    return client_sock_fd;
+}
+
+/* ============================================================================
+ * 関数: open_listener
+ * 機能: 復路の待ち受けソケットを作成する (作成できるまでリトライ)
+ * 引数:
+ *   backlog - 待ち受けキューの長さ
+ * 戻り値: 待ち受けソケット (失敗時は -1)
+ * ============================================================================ */
+int open_listener(int backlog) {
+    int listen_sock;
+    int opt = 1;
+
+    /* Server機能の起動とリトライループ */
+    while (TRUE) {
+        listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (listen_sock < 0) {
+            perror("[ERROR] Listen socket creation failed");
+            return -1;
+        }
+
+        /* ポート再利用設定 */
+        if (setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR,
+                      &opt, sizeof(opt)) < 0) {
+            perror("[WARN] Failed to set SO_REUSEADDR");
+        }
+        sock_profile_listener(listen_sock, g_profile);
+
+        /* バインドとリッスン */
+        if (bind(listen_sock, (struct sockaddr *)&bind_addr_in,
+                sizeof(bind_addr_in)) == 0 &&
+            listen(listen_sock, backlog) == 0) {
+            ALOG_INFO("[INFO] Listening on %s:%d\n",
+                      CLIENT_IP_INBOUND, CLIENT_PORT_INBOUND);
+            return listen_sock;
+        }
+
+        /* 待ち受け失敗時のリトライ */
+        perror("[WARN] Failed to start inbound server (retrying...)");
+        close(listen_sock);
+        sleep(RETRY_DELAY);
+    }
+}
+
+/* ============================================================================
+ * 関数: send_all
+ * 機能: バッファ全体を送信する (切断時に SIGPIPE を発生させない)
+ * 戻り値: 0 = 成功, -1 = 失敗
+ * ============================================================================ */
+int send_all(int fd, const char *buf, size_t len) {
+    long long started = g_probe != NULL ? stage_now() : 0;
+    ssize_t sent;
+
+    while (len > 0) {
+        sent = send(fd, buf, len, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += sent;
+        len -= sent;
+    }
+    if (g_probe != NULL) {
+        stage_record(g_probe, STAGE_SEND, stage_now() - started);
+        stage_add(g_probe, COUNTER_SENT, 1);
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: connection_alive
+ * 機能: 往路接続が使用可能か確認する (待ちなし)
+ *   ABOS1 は往路へ送信しないため、読み出し可能 = 切断 (FIN/RST) とみなす
+ * 戻り値: 1 = 使用可能, 0 = 切断済み
+ * ============================================================================ */
+int connection_alive(int fd) {
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN | POLLRDHUP;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) <= 0;
+}
+
+/* ============================================================================
+ * 関数: take_line
+ * 機能: 受信済みのデータから改行までの1行を取り出す (改行は含めない)
+ *   改行まで (バッファ満杯・切断後の残りの場合は全体) を1行とする
+ * 引数:
+ *   at_eof - 1 = 切断済み (改行のない残りも1行として取り出す)
+ * 戻り値: 行の長さ + 1 (空行でも1以上), 0 = 1行に満たない
+ * ============================================================================ */
+ssize_t take_line(line_reader_t *reader, char *line, size_t line_size, int at_eof) {
+    char *newline = memchr(reader->data, '\n', reader->len);
+    size_t len;
+
+    if (newline == NULL && reader->len < sizeof(reader->data) &&
+        !(at_eof && reader->len > 0)) {
+        return 0;
+    }
+    len = newline != NULL ? (size_t)(newline - reader->data) : reader->len;
+    if (len >= line_size) {
+        len = line_size - 1;
+    }
+    memcpy(line, reader->data, len);
+    line[len] = '\0';
+    if (len > 0 && line[len - 1] == '\r') {
+        line[len - 1] = '\0';
+    }
+    if (newline != NULL) {
+        len = newline - reader->data + 1;
+    }
+    reader->len -= len;
+    memmove(reader->data, reader->data + len, reader->len);
+    return (ssize_t)strlen(line) + 1;
+}
+
+/* ============================================================================
+ * 関数: read_line
+ * 機能: 改行までの1行を受信する (改行は含めない)
+ * 戻り値: 行の長さ + 1 (空行でも1以上), 0 = 切断, -1 = エラー
+ * ============================================================================ */
+ssize_t read_line(int fd, line_reader_t *reader, char *line, size_t line_size) {
+    ssize_t n;
+
+    while (TRUE) {
+        n = take_line(reader, line, line_size, 0);
+        if (n > 0) {
+            return n;
+        }
+
+        n = recv(fd, reader->data + reader->len, sizeof(reader->data) - reader->len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return n;
+        }
+        sock_profile_rearm(fd, g_profile);
+        reader->len += n;
+    }
+}
+
+/* ============================================================================
+ * 関数: match_response
+ * 機能: 応答1行を送信済みのメッセージと対応付け、RTT を表示する
+ *   応答に含まれるメッセージ番号 (" #番号") で対応付ける。番号がない応答は
+ *   最も古い応答待ちのメッセージへの応答とみなす
+ * ============================================================================ */
+void match_response(const char *line, pending_request_t *pending) {
+    const char *p = strstr(line, " #");
+    pending_request_t *req = NULL;
+    struct timespec received_at;
+    unsigned int id;
+
+    clock_gettime(CLOCK_MONOTONIC, &received_at);
+    if (p != NULL && sscanf(p, " #%u", &id) == 1 && id != 0) {
+        if (pending[id % MESSAGE_WINDOW].id == id) {
+            req = &pending[id % MESSAGE_WINDOW];
+        }
+    } else {
+        for (int i = 0; i < MESSAGE_WINDOW; i++) {
+            if (pending[i].id != 0 && (req == NULL || pending[i].id < req->id)) {
+                req = &pending[i];
+            }
+        }
+    }
+
+    if (req == NULL) {
+        ALOG_WARN("[WARN] Response without a matching message via %s: %s\n",
+                  CLIENT_IP_INBOUND, line);
+        return;
+    }
+    ALOG_INFO("[RECV] Response received via %s: %s (RTT %.3f ms)\n",
+              CLIENT_IP_INBOUND, line, elapsed_ms(&req->sent_at, &received_at));
+    stage_record(g_probe, STAGE_RTT, (long long)(elapsed_ms(&req->sent_at, &received_at) * 1e6));
+    stage_add(g_probe, COUNTER_RECEIVED, 1);
+    req->id = 0;
+}
+
+/* ============================================================================
+ * 関数: run_per_message
+ * 機能: 従来動作。メッセージごとに往路接続し、送信後に切断する
+ *   - 復路の待ち受けは起動時に作成して維持し、応答の接続は送信と並行して
+ *     受け入れる (応答が往路の切断より先に届いても拒否されない)
+ *   - 応答はメッセージ番号で送信と対応付け、最大 MESSAGE_WINDOW 個まで
+ *     応答を待たずに次を送る。応答のない番号は RESPONSE_TIMEOUT_MS で打ち切る
+ *   - 送信は前回の送信から指定間隔後。応答の待ち合わせは poll で行い、
+ *     受信したらすぐ処理する
+ * 処理フロー:
+ *   1. 復路の待ち受けを作成
+ *   2. 送信時刻になり空きがあれば、ABOS1へ接続してメッセージを送信し切断
+ *   3. 次の送信時刻・タイムアウトまで、復路の接続の受け入れと応答の受信
+ *   4. 2 から繰り返し
+ * ============================================================================ */
+int run_per_message(int interval_ms) {
+    static line_reader_t readers[RETURN_CONN_MAX];
+    static pending_request_t pending[MESSAGE_WINDOW];
+    struct pollfd fds[1 + RETURN_CONN_MAX];
+    int return_socks[RETURN_CONN_MAX];
+    struct timespec now, next_send;
+    char send_buffer[BUFFER_SIZE];
+    char recv_buffer[BUFFER_SIZE];
+    unsigned int next_id = 1;
+    int listen_sock;
+    int client_sock_fd;
+    int accept_sock;
+    int wait_ms;
+    long long started;
+    ssize_t n;
+
+    /* 復路の待ち受けは起動時に1回だけ作成する */
+    listen_sock = open_listener(MAX_PENDING);
+    if (listen_sock < 0) {
         return 1;
     }
+    for (int i = 0; i < RETURN_CONN_MAX; i++) {
+        return_socks[i] = -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &next_send);
 
     /* メッセージ送受信ループ */
     while (TRUE) {
-        int client_sock_fd = -1;
-        int listen_sock = -1;
-        int accept_sock = -1;
-        socklen_t addrlen;
+        clock_gettime(CLOCK_MONOTONIC, &now);
 
         /* ====================================================================
          * 往路処理: ABOS1へメッセージを送信
          * ==================================================================== */
-        
-        /* 往路接続のリトライループ */
-        while (TRUE) {
-            client_sock_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (elapsed_ms(&next_send, &now) >= 0 && pending[next_id % MESSAGE_WINDOW].id == 0) {
+            client_sock_fd = connect_outbound(1);
             if (client_sock_fd < 0) {
-                perror("[ERROR] Socket creation failed");
                 return 1;
             }
 
-            /* 送信元IPアドレスを明示的にバインド (192.168.100.2) */
-            memset(&client_bind_addr, 0, sizeof(client_bind_addr));
-            client_bind_addr.sin_family = AF_INET;
-            client_bind_addr.sin_port = 0; /* OSが自動割り当て */
-            inet_pton(AF_INET, CLIENT_IP_OUTBOUND_SRC, &client_bind_addr.sin_addr);
+            /* メッセージの生成と送信 (応答との対応付けにメッセージ番号を付ける) */
+            generate_message(send_buffer, sizeof(send_buffer));
+            n = strlen(send_buffer);
+            snprintf(send_buffer + n, sizeof(send_buffer) - n, " #%u", next_id);
+            clock_gettime(CLOCK_MONOTONIC, &now);
 
-            if (bind(client_sock_fd, (struct sockaddr *)&client_bind_addr, 
-                    sizeof(client_bind_addr)) < 0) {
-                perror("[ERROR] Client bind failed");
-                close(client_sock_fd);
-                client_sock_fd = -1;
+            started = stage_now();
+            if (send_all(client_sock_fd, send_buffer, strlen(send_buffer)) < 0) {
+                /* Fast Open では接続の失敗もここで通知される (接続と同じ間隔で再試行) */
+                perror("[ERROR] Send failed to ABOS1");
                 sleep(RETRY_DELAY);
-                continue;
+            } else {
+                if (g_profile == SOCK_PROFILE_LOWLAT) {
+                    /* Fast Open の最初の送信は SYN-ACK を受けてから返る (ブロッキング) */
+                    stage_record(g_probe, STAGE_CONNECT, stage_now() - started);
+                    ALOG_INFO("[INFO] Outbound connection established\n");
+                }
+                ALOG_INFO("[SEND] Message sent via %s: %s\n",
+                          CLIENT_IP_OUTBOUND_SRC, send_buffer);
+                pending[next_id % MESSAGE_WINDOW].id = next_id;
+                pending[next_id % MESSAGE_WINDOW].sent_at = now;
+                next_id = next_id == UINT32_MAX ? 1 : next_id + 1;
             }
 
-            printf("[INFO] Attempting to connect to ABOS1 at %s:%d\n",
-                   SERVER_IP_OUTBOUND, SERVER_PORT_OUTBOUND);
+            /* 往路接続のクローズ */
+            close(client_sock_fd);
+            ALOG_INFO("[INFO] Outbound connection closed\n");
 
-            /* ABOS1への接続試行 */
-            if (connect(client_sock_fd, (struct sockaddr *)&serv_addr_out, 
-                       sizeof(serv_addr_out)) == 0) {
-                printf("[INFO] Outbound connection established\n");
-                break;
+            next_send = now;
+            next_send.tv_sec += interval_ms / 1000;
+            next_send.tv_nsec += (long)(interval_ms % 1000) * 1000000L;
+            if (next_send.tv_nsec >= 1000000000L) {
+                next_send.tv_sec++;
+                next_send.tv_nsec -= 1000000000L;
             }
-
-            /* 接続失敗時のリトライ */
-            perror("[WARN] Connection failed (retrying...)");
-            close(client_sock_fd);
-            client_sock_fd = -1;
-            sleep(RETRY_DELAY);
         }
 
-        /* メッセージの生成と送信 */
-        generate_message(send_buffer, sizeof(send_buffer));
+        /* 応答のないメッセージの打ち切りと、次に起きる時刻までの待ち時間 */
+        wait_ms = pending[next_id % MESSAGE_WINDOW].id == 0 ?
+                  (int)(-elapsed_ms(&next_send, &now)) + 1 : RESPONSE_TIMEOUT_MS;
+        for (int i = 0; i < MESSAGE_WINDOW; i++) {
+            double age;
 
-        if (send(client_sock_fd, send_buffer, strlen(send_buffer), 0) < 0) {
-            perror("[ERROR] Send failed to ABOS1");
-        } else {
-            printf("[SEND] Message sent via %s: %s\n", 
-                   CLIENT_IP_OUTBOUND_SRC, send_buffer);
+            if (pending[i].id == 0) {
+                continue;
+            }
+            age = elapsed_ms(&pending[i].sent_at, &now);
+            if (age >= RESPONSE_TIMEOUT_MS) {
+                ALOG_WARN("[WARN] No response for message #%u within %d ms\n",
+                          pending[i].id, RESPONSE_TIMEOUT_MS);
+                pending[i].id = 0;
+                wait_ms = 0;
+            } else if (RESPONSE_TIMEOUT_MS - (int)age < wait_ms) {
+                wait_ms = RESPONSE_TIMEOUT_MS - (int)age;
+            }
+        }
+        if (wait_ms < 0) {
+            wait_ms = 0;
         }
-
-        /* 往路接続のクローズ */
-        close(client_sock_fd);
-        printf("[INFO] Outbound connection closed\n");
 
         /* ====================================================================
-         * 復路処理: ABOS1からの応答を受信
+         * 復路処理: 応答の接続の受け入れと応答の受信
          * ==================================================================== */
-        
-        printf("[INFO] Starting inbound server to wait for response\n");
+        fds[0].fd = listen_sock;
+        fds[0].events = POLLIN;
+        for (int i = 0; i < RETURN_CONN_MAX; i++) {
+            fds[1 + i].fd = return_socks[i];    /* -1 は poll が無視する */
+            fds[1 + i].events = POLLIN;
+            fds[1 + i].revents = 0;
+        }
+        if (poll(fds, 1 + RETURN_CONN_MAX, wait_ms) < 0) {
+            if (errno != EINTR) {
+                perror("[ERROR] poll failed");
+                sleep(RETRY_DELAY);
+            }
+            continue;
+        }
 
-        /* Server機能の起動とリトライループ */
-        while (TRUE) {
-            listen_sock = socket(AF_INET, SOCK_STREAM, 0);
-            if (listen_sock < 0) {
-                perror("[ERROR] Listen socket creation failed");
-                return 1;
+        if (fds[0].revents & POLLIN) {
+            accept_sock = accept(listen_sock, NULL, NULL);
+            if (accept_sock < 0) {
+                perror("[ERROR] Accept failed for inbound connection");
+            } else {
+                int slot = 0;
+
+                while (slot < RETURN_CONN_MAX && return_socks[slot] >= 0) {
+                    slot++;
+                }
+                if (slot == RETURN_CONN_MAX) {
+                    ALOG_WARN("[WARN] Too many response connections, closing the new one\n");
+                    close(accept_sock);
+                } else {
+                    ALOG_INFO("[INFO] Response connection accepted from ABOS1\n");
+                    sock_profile_accepted(accept_sock, g_profile);
+                    return_socks[slot] = accept_sock;
+                    readers[slot].len = 0;
+                }
             }
+        }
 
-            /* ポート再利用設定 */
-            if (setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, 
-                          &opt, sizeof(opt)) < 0) {
-                perror("[WARN] Failed to set SO_REUSEADDR");
+        for (int i = 0; i < RETURN_CONN_MAX; i++) {
+            line_reader_t *reader = &readers[i];
+
+            if (fds[1 + i].revents == 0) {
+                continue;
+            }
+            n = recv(return_socks[i], reader->data + reader->len,
+                     sizeof(reader->data) - reader->len, 0);
+            if (n < 0 && errno == EINTR) {
+                continue;
             }
+            if (n > 0) {
+                reader->len += n;
+                sock_profile_rearm(return_socks[i], g_profile);
+            }
+            while (take_line(reader, recv_buffer, sizeof(recv_buffer), n <= 0) > 0) {
+                match_response(recv_buffer, pending);
+            }
+            if (n == 0) {
+                ALOG_INFO("[INFO] ABOS1 closed the response connection\n");
+            } else if (n < 0) {
+                perror("[ERROR] Inbound receive failed");
+            }
+            if (n <= 0) {
+                close(return_socks[i]);
+                return_socks[i] = -1;
+            }
+        }
+    }
 
-            /* バインドとリッスン */
-            if (bind(listen_sock, (struct sockaddr *)&bind_addr_in, 
-                    sizeof(bind_addr_in)) == 0 && 
-                listen(listen_sock, MAX_PENDING) == 0) {
-                printf("[INFO] Listening on %s:%d\n", 
-                       CLIENT_IP_INBOUND, CLIENT_PORT_INBOUND);
-                break;
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: run_persistent
+ * 機能: 接続維持モード。往路接続と復路の待ち受けを維持し、
+ *       改行区切りのメッセージを同じ接続で送受信する
+ *   - 往路が切断されていれば再接続してから送信する
+ *   - 復路は最初の応答時に受け入れた接続を使い続け、切断されたら
+ *     次の接続を受け入れる (応答ごとに接続する相手にも対応)
+ * ============================================================================ */
+int run_persistent(int interval_ms) {
+    static line_reader_t reader;
+    struct sockaddr_in client_addr_in;
+    struct timespec sent_at, received_at;
+    char send_buffer[BUFFER_SIZE];
+    char recv_buffer[BUFFER_SIZE];
+    int listen_sock;
+    int out_sock = -1;
+    int return_sock = -1;
+    socklen_t addrlen;
+    size_t len;
+    ssize_t n;
+
+    /* 復路の待ち受けは起動時に1回だけ作成する */
+    listen_sock = open_listener(MAX_PENDING);
+    if (listen_sock < 0) {
+        return 1;
+    }
+
+    /* メッセージ送受信ループ */
+    while (TRUE) {
+        /* 往路接続の確認と (再) 接続 */
+        if (out_sock >= 0 && !connection_alive(out_sock)) {
+            ALOG_INFO("[INFO] Outbound connection closed by ABOS1, reconnecting\n");
+            close(out_sock);
+            out_sock = -1;
+        }
+        if (out_sock < 0) {
+            out_sock = connect_outbound(0);
+            if (out_sock < 0) {
+                return 1;
             }
+        }
 
-            /* 待ち受け失敗時のリトライ */
-            perror("[WARN] Failed to start inbound server (retrying...)");
-            close(listen_sock);
-            listen_sock = -1;
-            sleep(RETRY_DELAY);
+        /* メッセージの生成と送信 (改行区切り) */
+        generate_message(send_buffer, sizeof(send_buffer) - 1);
+        len = strlen(send_buffer);
+        send_buffer[len] = '\n';
+        clock_gettime(CLOCK_MONOTONIC, &sent_at);
+
+        if (send_all(out_sock, send_buffer, len + 1) < 0) {
+            perror("[WARN] Send failed to ABOS1 (reconnecting...)");
+            close(out_sock);
+            out_sock = -1;
+            continue;
         }
+        send_buffer[len] = '\0';
+        ALOG_INFO("[SEND] Message sent via %s: %s\n", CLIENT_IP_OUTBOUND_SRC, send_buffer);
 
-        /* ABOS1からの接続を受け入れ */
-        addrlen = sizeof(client_addr_in);
-        accept_sock = accept(listen_sock, (struct sockaddr *)&client_addr_in, 
-                           &addrlen);
-        close(listen_sock); /* 接続受け入れ後、待ち受けソケットをクローズ */
+        /* 応答の受信 (復路が切断されていれば次の接続を受け入れる) */
+        while (TRUE) {
+            if (return_sock < 0) {
+                addrlen = sizeof(client_addr_in);
+                return_sock = accept(listen_sock, (struct sockaddr *)&client_addr_in,
+                                     &addrlen);
+                if (return_sock < 0) {
+                    if (errno != EINTR) {
+                        perror("[ERROR] Accept failed for inbound connection");
+                        sleep(RETRY_DELAY);
+                    }
+                    continue;
+                }
+                reader.len = 0;
+                sock_profile_accepted(return_sock, g_profile);
+                ALOG_INFO("[INFO] Response connection accepted from ABOS1\n");
+            }
 
-        if (accept_sock < 0) {
-            perror("[ERROR] Accept failed for inbound connection");
-        } else {
-            printf("[INFO] Response connection accepted from ABOS1\n");
-
-            /* 応答メッセージの受信 */
-            memset(recv_buffer, 0, BUFFER_SIZE);
-            ssize_t bytes_received = recv(accept_sock, recv_buffer, 
-                                         BUFFER_SIZE - 1, 0);
-
-            if (bytes_received > 0) {
-                recv_buffer[bytes_received] = '\0';
-                printf("[RECV] Response received via %s: %s\n", 
-                       CLIENT_IP_INBOUND, recv_buffer);
-            } else if (bytes_received == 0) {
-                printf("[INFO] ABOS1 closed the response connection\n");
+            n = read_line(return_sock, &reader, recv_buffer, sizeof(recv_buffer));
+            if (n > 0) {
+                break;
+            }
+            if (n == 0) {
+                ALOG_INFO("[INFO] ABOS1 closed the response connection\n");
             } else {
                 perror("[ERROR] Inbound receive failed");
             }
-
-            close(accept_sock);
+            close(return_sock);
+            return_sock = -1;
         }
+        clock_gettime(CLOCK_MONOTONIC, &received_at);
+        ALOG_INFO("[RECV] Response received via %s: %s (RTT %.3f ms)\n",
+                  CLIENT_IP_INBOUND, recv_buffer, elapsed_ms(&sent_at, &received_at));
+        stage_record(g_probe, STAGE_RTT, (long long)(elapsed_ms(&sent_at, &received_at) * 1e6));
+        stage_add(g_probe, COUNTER_RECEIVED, 1);
 
         /* 次のサイクルまで待機 */
-        printf("[INFO] Waiting %d seconds before next cycle\n", MESSAGE_INTERVAL);
-        sleep(MESSAGE_INTERVAL);
+        usleep((useconds_t)interval_ms * 1000);
+    }
+
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: receive_responses
+ * 機能: 復路の受け入れ・受信を1回行う (フレーム形式モード)
+ *   復路が未接続なら待ち受けソケットで受け入れ、接続済みなら受信バッファへ
+ *   読む。切断・エラー時は復路を閉じて次の接続を待つ
+ * 引数:
+ *   timeout - 待ち時間 (ミリ秒, -1 = 無期限)
+ * 戻り値: 受信バイト数 (0 = 受信なし)
+ * ============================================================================ */
+ssize_t receive_responses(int listen_sock, int *return_sock, frame_buffer_t *rx,
+                          int timeout, int quiet) {
+    struct pollfd pfd;
+    ssize_t n;
+
+    pfd.fd = *return_sock >= 0 ? *return_sock : listen_sock;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, timeout) <= 0) {
+        return 0;
+    }
+
+    if (*return_sock < 0) {
+        *return_sock = accept(listen_sock, NULL, NULL);
+        if (*return_sock < 0) {
+            if (errno != EINTR) {
+                perror("[ERROR] Accept failed for inbound connection");
+            }
+            return 0;
+        }
+        rx->len = 0;
+        sock_profile_accepted(*return_sock, g_profile);
+        if (!quiet) {
+            ALOG_INFO("[INFO] Response connection accepted from ABOS1\n");
+        }
+        return 0;
+    }
+
+    n = frame_buffer_read(rx, *return_sock);
+    if (n <= 0) {
+        if (n < 0 && errno == EINTR) {
+            return 0;
+        }
+        if (n == 0) {
+            ALOG_INFO("[INFO] ABOS1 closed the response connection\n");
+        } else {
+            perror("[ERROR] Inbound receive failed");
+        }
+        close(*return_sock);
+        *return_sock = -1;
+        return 0;
+    }
+    sock_profile_rearm(*return_sock, g_profile);
+    return n;
+}
+
+/* ============================================================================
+ * 関数: send_request
+ * 機能: 要求を送信する (フレーム形式モード)
+ *   送信バッファが一杯の間は復路の応答を受信バッファへ読み進める
+ *   (Bridge_C -P のように要求本体を受信しながら応答を返す相手に対し、
+ *    双方の送信が詰まって止まらないようにする)
+ * 戻り値: 0 = 成功, -1 = 失敗
+ * ============================================================================ */
+int send_request(int out_sock, const char *buf, size_t len, int listen_sock,
+                 int *return_sock, frame_buffer_t *rx, int quiet) {
+    struct pollfd pfd[2];
+    ssize_t sent;
+
+    while (len > 0) {
+        sent = send(out_sock, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent > 0) {
+            buf += sent;
+            len -= sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            return -1;
+        }
+
+        pfd[0].fd = out_sock;
+        pfd[0].events = POLLOUT;
+        pfd[1].fd = *return_sock >= 0 ? *return_sock : listen_sock;
+        pfd[1].events = POLLIN;
+        pfd[0].revents = pfd[1].revents = 0;
+        if (poll(pfd, 2, -1) < 0 && errno != EINTR) {
+            return -1;
+        }
+        if (pfd[1].revents != 0) {
+            receive_responses(listen_sock, return_sock, rx, 0, quiet);
+        }
     }
-    
     return 0;
 }
+
+/* ============================================================================
+ * 関数: run_framed
+ * 機能: フレーム形式モード。往路接続と復路の待ち受けを維持し、
+ *       最大 window 個の要求をパイプラインで送信する
+ *   - 要求には1から順に相関IDを付け、応答は相関IDで要求と対応付ける
+ *   - 応答本体の末尾が要求本体と一致することを確認する
+ *   - 往路が切断された場合、応答待ちの要求は失われたものとして数える
+ *   - 応答のない要求は RESPONSE_TIMEOUT_MS で打ち切り、失われたものとして数える
+ *     (Bridge_C の配信キューが溢れた・古すぎた応答は届かない)
+ * 引数:
+ *   interval_ms  - 要求の送信間隔 (0 = ウィンドウが空けば即座に送信)
+ *   window       - 応答待ちにできる要求数
+ *   payload_size - 要求本体のバイト数
+ *   count        - 送信する要求数 (0 = 無制限)
+ *   quiet        - 1 = 要求ごとの表示を省略
+ * ============================================================================ */
+int run_framed(int interval_ms, int window, size_t payload_size,
+               unsigned long count, int quiet) {
+    static frame_buffer_t rx;
+    static lat_hist_t hist;
+    pending_request_t *pending;
+    unsigned char *request;
+    char message[BUFFER_SIZE];
+    struct timespec start, now, next_send;
+    unsigned long sent = 0, received = 0, lost = 0, mismatched = 0;
+    double rtt, rtt_sum = 0, rtt_max = 0;
+    uint32_t next_id = 1, oldest_id = 1;
+    int listen_sock, out_sock = -1, return_sock = -1;
+    int inflight = 0;
+    int timeout;
+    size_t msg_len, off;
+    ssize_t n;
+    frame_t f;
+
+    pending = calloc(window, sizeof(*pending));
+    request = malloc(FRAME_HEADER_SIZE + payload_size);
+    if (pending == NULL || request == NULL) {
+        perror("[ERROR] malloc failed");
+        return 1;
+    }
+
+    /* 要求本体: 従来のメッセージを繰り返して payload_size バイトにする */
+    generate_message(message, sizeof(message));
+    msg_len = strlen(message);
+    for (off = 0; off < payload_size; off++) {
+        request[FRAME_HEADER_SIZE + off] = off % (msg_len + 1) == msg_len ?
+                                           ' ' : message[off % (msg_len + 1)];
+    }
+
+    listen_sock = open_listener(MAX_PENDING);
+    if (listen_sock < 0) {
+        return 1;
+    }
+
+    lat_hist_init(&hist);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    next_send = start;
+
+    while (count == 0 || sent < count || inflight > 0) {
+        /* 往路接続の確認と (再) 接続 */
+        if (out_sock >= 0 && !connection_alive(out_sock)) {
+            ALOG_INFO("[INFO] Outbound connection closed by ABOS1, reconnecting\n");
+            close(out_sock);
+            out_sock = -1;
+        }
+        if (out_sock < 0) {
+            if (inflight > 0) {
+                fprintf(stderr, "[WARN] %d in-flight requests lost\n", inflight);
+                lost += inflight;
+                inflight = 0;
+                memset(pending, 0, window * sizeof(*pending));
+            }
+            out_sock = connect_outbound(0);
+            if (out_sock < 0) {
+                return 1;
+            }
+        }
+
+        /* 応答のない要求の打ち切り。送信時刻は相関ID順なので、応答待ちで
+         * 最も古い要求の期限が最も近い (応答済みの要求は読み飛ばす) */
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        timeout = -1;
+        while (oldest_id != next_id) {
+            pending_request_t *slot = &pending[oldest_id % window];
+
+            if (slot->id == oldest_id) {
+                double age = elapsed_ms(&slot->sent_at, &now);
+
+                if (age < RESPONSE_TIMEOUT_MS) {
+                    if (timeout < 0) {
+                        timeout = RESPONSE_TIMEOUT_MS - (int)age;
+                    }
+                    break;
+                }
+                ALOG_WARN("[WARN] No response for request id=%u within %d ms\n",
+                          oldest_id, RESPONSE_TIMEOUT_MS);
+                slot->id = 0;
+                lost++;
+                inflight--;
+                timeout = 0;            /* 終了条件を確認し直す */
+            }
+            oldest_id = oldest_id == UINT32_MAX ? 1 : oldest_id + 1;
+        }
+
+        /* ウィンドウが空いていて送信時刻に達していれば要求を送信 */
+        if (inflight < window && (count == 0 || sent < count)) {
+            int send_wait = (int)elapsed_ms(&now, &next_send);
+
+            if (timeout < 0 || send_wait < timeout) {
+                timeout = send_wait < 0 ? 0 : send_wait;
+            }
+            if (send_wait <= 0) {
+                pending_request_t *slot = &pending[next_id % window];
+
+                if (slot->id != 0) {
+                    /* 同じ枠の古い要求の応答が来ていない (失われた) */
+                    lost++;
+                    inflight--;
+                }
+                frame_put_header(request, FRAME_TYPE_REQUEST, next_id,
+                                 (uint32_t)payload_size);
+                slot->id = next_id;
+                slot->sent_at = now;
+                if (send_request(out_sock, (char *)request,
+                                 FRAME_HEADER_SIZE + payload_size, listen_sock,
+                                 &return_sock, &rx, quiet) < 0) {
+                    perror("[WARN] Send failed to ABOS1 (reconnecting...)");
+                    slot->id = 0;
+                    close(out_sock);
+                    out_sock = -1;
+                    continue;
+                }
+                if (g_probe != NULL) {
+                    stage_record(g_probe, STAGE_SEND, stage_now() -
+                                 ((long long)now.tv_sec * 1000000000LL + now.tv_nsec));
+                    stage_add(g_probe, COUNTER_SENT, 1);
+                }
+                if (!quiet) {
+                    ALOG_INFO("[SEND] Request id=%u sent via %s (%zu bytes)\n",
+                              next_id, CLIENT_IP_OUTBOUND_SRC, payload_size);
+                }
+                next_id = next_id == UINT32_MAX ? 1 : next_id + 1;
+                sent++;
+                inflight++;
+                next_send.tv_sec += interval_ms / 1000;
+                next_send.tv_nsec += (long)(interval_ms % 1000) * 1000000;
+                if (next_send.tv_nsec >= 1000000000) {
+                    next_send.tv_sec++;
+                    next_send.tv_nsec -= 1000000000;
+                }
+                if (elapsed_ms(&next_send, &now) > 0) {
+                    next_send = now;    /* 遅れた分は詰めて送らない */
+                }
+                continue;
+            }
+        }
+
+        /* 復路の受け入れ・受信を待つ (送信中に受信済みの応答があれば先に処理) */
+        if (frame_parse(rx.data, rx.len, &f) == 0 &&
+            receive_responses(listen_sock, &return_sock, &rx, timeout, quiet) <= 0) {
+            continue;
+        }
+
+        /* 受信済みの完全な応答フレームを順に処理 */
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        off = 0;
+        while ((n = frame_parse(rx.data + off, rx.len - off, &f)) > 0) {
+            pending_request_t *slot = &pending[f.id % window];
+
+            off += n;
+            if (f.type != FRAME_TYPE_RESPONSE || slot->id != f.id) {
+                fprintf(stderr, "[WARN] Unexpected response id=%u\n", f.id);
+                continue;
+            }
+            if (f.length < payload_size ||
+                memcmp(f.payload + f.length - payload_size,
+                       request + FRAME_HEADER_SIZE, payload_size) != 0) {
+                mismatched++;
+            }
+            rtt = elapsed_ms(&slot->sent_at, &now);
+            lat_hist_record(&hist, (uint64_t)(rtt * 1e6));
+            stage_record(g_probe, STAGE_RTT, (long long)(rtt * 1e6));
+            stage_add(g_probe, COUNTER_RECEIVED, 1);
+            rtt_sum += rtt;
+            if (rtt > rtt_max) {
+                rtt_max = rtt;
+            }
+            slot->id = 0;
+            inflight--;
+            received++;
+            if (!quiet) {
+                ALOG_INFO("[RECV] Response id=%u received via %s (%u bytes, RTT %.3f ms)\n",
+                          f.id, CLIENT_IP_INBOUND, f.length, rtt);
+            }
+        }
+        if (n < 0) {
+            fprintf(stderr, "[ERROR] Invalid frame from ABOS1, closing response connection\n");
+            close(return_sock);
+            return_sock = -1;
+            continue;
+        }
+        frame_buffer_consume(&rx, off);
+    }
+
+    /* 要求ごとのログを出し切ってから集計を表示 */
+    alog_stop();
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    printf("[INFO] Requests: %lu sent, %lu received, %lu lost, %lu payload mismatches\n",
+           sent, received, lost, mismatched);
+    if (received > 0) {
+        double secs = elapsed_ms(&start, &now) / 1e3;
+        printf("[INFO] %.1f requests/s, %.2f MB/s, RTT avg %.3f ms, max %.3f ms\n",
+               received / secs, received * (double)payload_size / secs / 1e6,
+               rtt_sum / received, rtt_max);
+        lat_hist_print(&hist, "RTT");
+    }
+
+    if (out_sock >= 0) {
+        close(out_sock);
+    }
+    if (return_sock >= 0) {
+        close(return_sock);
+    }
+    close(listen_sock);
+    frame_buffer_free(&rx);
+    free(request);
+    free(pending);
+    return mismatched == 0 && lost == 0 ? 0 : 1;
+}
+
+/* ============================================================================
+ * 関数: now_ns
+ * 機能: 単調増加時刻をナノ秒で取得
+ * ============================================================================ */
+long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* ============================================================================
+ * 関数: raise_fd_limit
+ * 機能: 多数の同時接続に備えてファイルディスクリプタ数の上限を引き上げる
+ * ============================================================================ */
+void raise_fd_limit(void) {
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0) {
+        perror("[WARN] getrlimit failed");
+        return;
+    }
+    if (rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) < 0) {
+            perror("[WARN] Failed to raise RLIMIT_NOFILE");
+        }
+    }
+}
+
+/* ============================================================================
+ * 関数: parse_size_dist
+ * 機能: 要求サイズの分布を解析する
+ *   "N" = 固定長, "A-B" = A 以上 B 以下の一様分布, "A,B,C" = 候補から等確率
+ *   (相関IDと送信時刻を含む先頭部分より短いサイズは先頭部分の長さになる)
+ * 戻り値: 0 = 成功, -1 = 不正
+ * ============================================================================ */
+int parse_size_dist(const char *arg, size_dist_t *d) {
+    const char *p = arg;
+    char *end;
+    long v;
+
+    memset(d, 0, sizeof(*d));
+    if (strchr(arg, ',') != NULL) {
+        while (*p != '\0') {
+            v = strtol(p, &end, 10);
+            if (end == p || v < 1 || v > LOADGEN_SIZE_MAX ||
+                d->count == LOADGEN_SIZE_LIST_MAX) {
+                return -1;
+            }
+            d->list[d->count++] = (int)v;
+            p = *end == ',' ? end + 1 : end;
+            if (*end != ',' && *end != '\0') {
+                return -1;
+            }
+        }
+        return d->count > 0 ? 0 : -1;
+    }
+    if (sscanf(arg, "%d-%d", &d->min, &d->max) == 2) {
+        return d->min >= 1 && d->min <= d->max &&
+               d->max <= LOADGEN_SIZE_MAX ? 0 : -1;
+    }
+    v = strtol(arg, &end, 10);
+    d->min = d->max = (int)v;
+    return *end == '\0' && v >= 1 && v <= LOADGEN_SIZE_MAX ? 0 : -1;
+}
+
+/* ============================================================================
+ * 関数: lg_size
+ * 機能: 分布に従って次の要求のサイズを選ぶ
+ * ============================================================================ */
+int lg_size(loadgen_t *lg) {
+    size_dist_t *d = &lg->cfg.sizes;
+
+    if (d->count > 0) {
+        return d->list[rand_r(&lg->seed) % d->count];
+    }
+    return d->min + rand_r(&lg->seed) % (d->max - d->min + 1);
+}
+
+/* ============================================================================
+ * 関数: lg_watch
+ * 機能: 往路接続の epoll 登録イベントを変更する
+ * ============================================================================ */
+void lg_watch(loadgen_t *lg, lg_sender_t *s, uint32_t events) {
+    struct epoll_event ev;
+
+    if (s->events == events) {
+        return;
+    }
+    ev.events = events;
+    ev.data.ptr = s;
+    if (epoll_ctl(lg->epfd, EPOLL_CTL_MOD, s->fd, &ev) < 0) {
+        perror("[ERROR] epoll_ctl failed for outbound connection");
+    }
+    s->events = events;
+}
+
+/* ============================================================================
+ * 関数: lg_close
+ * 機能: 往路接続を閉じる (未送信の要求は破棄し、応答なしとして数える)
+ * ============================================================================ */
+void lg_close(lg_sender_t *s) {
+    if (s->fd >= 0) {
+        close(s->fd);
+    }
+    s->fd = -1;
+    s->connected = 0;
+    s->events = 0;
+    s->out.len = 0;
+}
+
+/* ============================================================================
+ * 関数: lg_connect
+ * 機能: ABOS1への非ブロッキング接続を開始する (完了は EPOLLOUT で通知)
+ *   送信元ポートは接続時に選ばせ、要求ごとに接続する場合も
+ *   TIME_WAIT のポートを避けて割り当てられるようにする
+ * 戻り値: 0 = 成功, -1 = 失敗
+ * ============================================================================ */
+int lg_connect(loadgen_t *lg, lg_sender_t *s) {
+    struct epoll_event ev;
+    int opt = 1;
+
+    s->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (s->fd < 0) {
+        perror("[ERROR] Socket creation failed");
+        lg->errors++;
+        return -1;
+    }
+    setsockopt(s->fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &opt, sizeof(opt));
+    setsockopt(s->fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    /* 要求ごとの接続のみ Fast Open を使う (要求は送信待ちに入れてある) */
+    s->fastopen = g_profile == SOCK_PROFILE_LOWLAT && lg->cfg.per_request;
+    sock_profile_connect(s->fd, g_profile, s->fastopen);
+    s->connect_ns = lg->now;
+    if (bind(s->fd, (struct sockaddr *)&client_bind_addr, sizeof(client_bind_addr)) < 0 ||
+        (connect(s->fd, (struct sockaddr *)&serv_addr_out, sizeof(serv_addr_out)) < 0 &&
+         errno != EINPROGRESS)) {
+        if (lg->errors++ == 0) {
+            perror("[WARN] Connection to ABOS1 failed");
+        }
+        lg_close(s);
+        return -1;
+    }
+    s->events = EPOLLOUT;
+    ev.events = s->events;
+    ev.data.ptr = s;
+    if (epoll_ctl(lg->epfd, EPOLL_CTL_ADD, s->fd, &ev) < 0) {
+        perror("[ERROR] epoll_ctl failed for outbound connection");
+        lg_close(s);
+        return -1;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: lg_flush
+ * 機能: 往路接続の未送信の要求を送る
+ *   送信バッファが一杯なら EPOLLOUT を待つ。要求ごとの接続は送り終えたら閉じる
+ * ============================================================================ */
+void lg_flush(loadgen_t *lg, lg_sender_t *s) {
+    long long started;
+    ssize_t n;
+
+    while (s->out.len > 0) {
+        started = g_probe != NULL ? stage_now() : 0;
+        n = send(s->fd, s->out.data, s->out.len, MSG_NOSIGNAL);
+        if (g_probe != NULL && n > 0) {
+            stage_record(g_probe, STAGE_SEND, stage_now() - started);
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS) {
+                lg_watch(lg, s, EPOLLOUT | EPOLLRDHUP);
+                return;
+            }
+            lg->errors++;
+            lg_close(s);
+            return;
+        }
+        frame_buffer_consume(&s->out, n);
+    }
+    if (lg->cfg.per_request) {
+        /* Fast Open の接続は SYN-ACK を受けてから閉じる (先に閉じると中止される) */
+        switch (sock_profile_connecting(s->fd, g_profile)) {
+        case 1:
+            lg_watch(lg, s, EPOLLOUT | EPOLLRDHUP);
+            return;
+        case -1:
+            lg->errors++;
+            break;
+        default:
+            if (g_probe != NULL && s->fastopen) {
+                stage_record(g_probe, STAGE_CONNECT, now_ns() - s->connect_ns);
+            }
+            break;
+        }
+        lg_close(s);
+        return;
+    }
+    /* ABOS1 は往路へ送信しないため、切断の検出のみ待つ */
+    lg_watch(lg, s, EPOLLRDHUP);
+}
+
+/* ============================================================================
+ * 関数: lg_send
+ * 機能: 相関IDと送信時刻を埋め込んだ要求1行を作り、往路接続で送る
+ *   要求: "Hello from ABOS2 written by C #<相関ID> @<送信時刻ns> xxx..."
+ *   (ブリッジは受信した行を応答に含めて返すため、応答から両方を取り出せる。
+ *    行の先頭側に置き、応答が切り詰められても残るようにする)
+ * 引数:
+ *   sent_at - 要求の送信時刻 (open-loop では予定時刻。遅れて送った分も
+ *             遅延に含め、送信側の詰まりで遅延が小さく見えないようにする)
+ * ============================================================================ */
+void lg_send(loadgen_t *lg, int index, long long sent_at) {
+    lg_sender_t *s = &lg->senders[index];
+    lg_pending_t *p;
+    char line[BUFFER_SIZE];
+    int size = lg_size(lg);
+    int len;
+
+    if (lg->next_id == 0) {
+        lg->next_id = 1;
+    }
+    generate_message(line, sizeof(line));
+    len = (int)strlen(line);
+    len += snprintf(line + len, sizeof(line) - len, " #%u @%lld ", lg->next_id, sent_at);
+    if (len < size) {
+        memset(line + len, 'x', size - len);
+        len = size;
+    }
+    line[len++] = '\n';
+
+    if (frame_buffer_reserve(&s->out, s->out.len + len) < 0) {
+        lg->errors++;
+        return;
+    }
+    memcpy(s->out.data + s->out.len, line, len);
+    s->out.len += len;
+
+    p = &lg->pending[lg->next_id % LOADGEN_PENDING];
+    if (p->id != 0) {
+        lg->timeouts++;                 /* 一周しても応答のない要求 */
+    }
+    p->id = lg->next_id;
+    p->sender = index;
+    if (lg->cfg.rate == 0) {
+        s->waiting_id = lg->next_id;
+        s->waiting_since = sent_at;
+    }
+    lg->next_id++;
+    lg->sent++;
+    stage_add(g_probe, COUNTER_SENT, 1);
+    lg->bytes += len;
+
+    if (s->fd < 0) {
+        lg_connect(lg, s);
+    } else if (s->connected && !(s->events & EPOLLOUT)) {
+        lg_flush(lg, s);
+    }
+}
+
+/* ============================================================================
+ * 関数: lg_sender_ready
+ * 機能: 往路接続が次の要求を送れるか確認する
+ *   closed-loop: 応答待ちの要求がない (要求ごとの接続は前の接続を閉じた後)
+ *   open-loop  : 未送信の要求が上限未満 (要求ごとの接続は使用中でない)
+ * ============================================================================ */
+int lg_sender_ready(loadgen_t *lg, lg_sender_t *s) {
+    if (lg->cfg.rate == 0 && s->waiting_id != 0) {
+        return 0;
+    }
+    if (lg->cfg.per_request) {
+        return s->fd < 0;
+    }
+    return s->out.len < LOADGEN_OUT_MAX;
+}
+
+/* ============================================================================
+ * 関数: lg_generate
+ * 機能: 送るべき要求を送る
+ *   open-loop  : 開始からの経過時間 × 目標レートに達するまで、送信可能な
+ *                接続へ順番に振り分ける (空きがなければ次の機会に送る)
+ *   closed-loop: 応答待ちのない接続がすぐ次の要求を送る
+ * ============================================================================ */
+void lg_generate(loadgen_t *lg) {
+    long long due;
+    int tried;
+
+    if (!lg->generating) {
+        return;
+    }
+    if (lg->cfg.rate == 0) {
+        for (int i = 0; i < lg->cfg.concurrency; i++) {
+            if (lg_sender_ready(lg, &lg->senders[i])) {
+                lg_send(lg, i, now_ns());
+            }
+        }
+        return;
+    }
+
+    while (TRUE) {
+        due = lg->start + (long long)(lg->issued * 1e9 / lg->cfg.rate);
+        if (due > lg->now) {
+            return;
+        }
+        for (tried = 0; tried < lg->cfg.concurrency; tried++) {
+            lg->next_sender = (lg->next_sender + 1) % lg->cfg.concurrency;
+            if (lg_sender_ready(lg, &lg->senders[lg->next_sender])) {
+                break;
+            }
+        }
+        if (tried == lg->cfg.concurrency) {
+            return;                     /* 空きの接続がない (次の機会に送る) */
+        }
+        lg_send(lg, lg->next_sender, due);
+        lg->issued++;
+    }
+}
+
+/* ============================================================================
+ * 関数: lg_sender_event
+ * 機能: 往路接続のイベントを処理する (接続完了の確認・送信の再開・切断)
+ * ============================================================================ */
+void lg_sender_event(loadgen_t *lg, lg_sender_t *s, uint32_t events) {
+    socklen_t len = sizeof(int);
+    int err = 0;
+
+    if (s->fd < 0) {
+        return;
+    }
+    if (!s->connected) {
+        if (getsockopt(s->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+            err = errno;
+        }
+        if (err != 0) {
+            if (lg->errors++ == 0) {
+                fprintf(stderr, "[WARN] Connection to ABOS1 failed: %s\n", strerror(err));
+            }
+            lg_close(s);
+            return;
+        }
+        s->connected = 1;
+        if (g_probe != NULL && !s->fastopen) {
+            stage_record(g_probe, STAGE_CONNECT, now_ns() - s->connect_ns);
+        }
+        lg_flush(lg, s);
+        return;
+    }
+    if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        lg_close(s);                    /* 次の要求の送信時に再接続する */
+        return;
+    }
+    if (events & EPOLLOUT) {
+        lg_flush(lg, s);
+    }
+}
+
+/* ============================================================================
+ * 関数: lg_response
+ * 機能: 応答1行から相関IDと送信時刻を取り出し、RTT を記録する
+ *   closed-loop では、応答を待っていた接続から次の要求を送る
+ * ============================================================================ */
+void lg_response(loadgen_t *lg, const char *line) {
+    const char *p = strstr(line, " #");
+    lg_pending_t *pending;
+    lg_sender_t *s;
+    unsigned int id;
+    long long sent_at;
+
+    if (p == NULL || sscanf(p, " #%u @%lld", &id, &sent_at) != 2 || id == 0) {
+        lg->unexpected++;
+        return;
+    }
+    pending = &lg->pending[id % LOADGEN_PENDING];
+    if (pending->id != id) {
+        lg->unexpected++;               /* 重複・タイムアウト後の応答 */
+        return;
+    }
+    pending->id = 0;
+    lg->received++;
+    lg->now = now_ns();                 /* 同じ受信で続く応答・次の要求の時刻 */
+    lat_hist_record(&lg->hist, (uint64_t)(lg->now - sent_at));
+    lat_hist_record(&lg->interval_hist, (uint64_t)(lg->now - sent_at));
+    stage_record(g_probe, STAGE_RTT, lg->now - sent_at);
+    stage_add(g_probe, COUNTER_RECEIVED, 1);
+
+    s = &lg->senders[pending->sender];
+    if (s->waiting_id == id) {
+        s->waiting_id = 0;
+        if (lg->generating && lg_sender_ready(lg, s)) {
+            lg_send(lg, pending->sender, lg->now);
+        }
+    }
+}
+
+/* ============================================================================
+ * 関数: lg_return_event
+ * 機能: 復路接続から受信した応答の行を順に処理する
+ *   (Bridge_C は1接続で複数行、Bridge_Java は応答ごとに接続して1行を送る)
+ * ============================================================================ */
+void lg_return_event(loadgen_t *lg, lg_return_t *r) {
+    char *line, *newline;
+    ssize_t n;
+
+    while (TRUE) {
+        n = frame_buffer_read(&r->in, r->fd);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (n <= 0) {
+            close(r->fd);               /* epoll からも自動で外れる */
+            frame_buffer_free(&r->in);
+            free(r);
+            return;
+        }
+        sock_profile_rearm(r->fd, g_profile);
+
+        line = (char *)r->in.data;
+        while ((newline = memchr(line, '\n', r->in.len - (line - (char *)r->in.data)))
+               != NULL) {
+            *newline = '\0';
+            lg_response(lg, line);
+            line = newline + 1;
+        }
+        frame_buffer_consume(&r->in, line - (char *)r->in.data);
+    }
+}
+
+/* ============================================================================
+ * 関数: lg_accept
+ * 機能: 復路の接続をすべて受け入れ、epoll に登録する
+ * ============================================================================ */
+void lg_accept(loadgen_t *lg) {
+    struct epoll_event ev;
+    lg_return_t *r;
+    int fd;
+
+    while ((fd = accept4(lg->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        r = calloc(1, sizeof(*r));
+        if (r == NULL) {
+            close(fd);
+            continue;
+        }
+        r->kind = LG_RETURN;
+        r->fd = fd;
+        sock_profile_accepted(fd, g_profile);
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = r;
+        if (epoll_ctl(lg->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            perror("[ERROR] epoll_ctl failed for inbound connection");
+            close(fd);
+            free(r);
+            continue;
+        }
+        lg->accepted++;
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR &&
+        errno != ECONNABORTED) {
+        perror("[ERROR] Accept failed for inbound connection");
+    }
+}
+
+/* ============================================================================
+ * 関数: lg_tick
+ * 機能: 定期処理。応答のない要求をタイムアウトとし (closed-loop では
+ *       その接続から次の要求を送る)、1秒ごとに経過を表示する
+ * ============================================================================ */
+void lg_tick(loadgen_t *lg, long long *next_report) {
+    lg_sender_t *s;
+    lg_pending_t *p;
+
+    for (int i = 0; i < lg->cfg.concurrency; i++) {
+        s = &lg->senders[i];
+        if (s->waiting_id != 0 &&
+            lg->now - s->waiting_since > LOADGEN_TIMEOUT_MS * 1000000LL) {
+            p = &lg->pending[s->waiting_id % LOADGEN_PENDING];
+            if (p->id == s->waiting_id) {
+                p->id = 0;
+                lg->timeouts++;
+            }
+            s->waiting_id = 0;
+            if (lg->cfg.per_request) {
+                lg_close(s);
+            }
+        }
+    }
+    lg_generate(lg);
+
+    if (lg->now >= *next_report) {
+        if (!lg->cfg.quiet && lg->generating) {
+            ALOG_INFO("[STATS] %3lld s: %lu requests/s sent, RTT p50 %.3f ms, "
+                      "p99 %.3f ms, max %.3f ms, %lu in flight\n",
+                      (lg->now - lg->start) / 1000000000LL, lg->sent - lg->interval_sent,
+                      lat_hist_percentile(&lg->interval_hist, 50) / 1e6,
+                      lat_hist_percentile(&lg->interval_hist, 99) / 1e6,
+                      lg->interval_hist.count > 0 ? lg->interval_hist.max / 1e6 : 0.0,
+                      lg->sent - lg->received - lg->timeouts);
+        }
+        lg->interval_sent = lg->sent;
+        lat_hist_init(&lg->interval_hist);
+        *next_report += 1000000000LL;
+    }
+}
+
+/* ============================================================================
+ * 関数: run_loadgen
+ * 機能: 負荷試験モード。同時接続数・目標レート・要求サイズの分布・試験時間を
+ *       指定して要求を送り、RTT のヒストグラムとスループットを表示する
+ *   - closed-loop (-r なし): 各接続が応答を受けてから次の要求を送る
+ *   - open-loop (-r): 応答を待たず目標レートで送る
+ *   - 往路・復路とも epoll の単一スレッドで処理し、復路は複数の接続を
+ *     同時に受け入れる (Bridge_C は接続を維持、Bridge_Java は応答ごとに接続)
+ *   試験時間の経過後、応答待ちの要求をタイムアウトまで待ってから集計する
+ * ============================================================================ */
+int run_loadgen(const loadgen_config_t *cfg) {
+    static loadgen_t lg;
+    struct epoll_event events[LOADGEN_MAX_EVENTS];
+    struct epoll_event ev;
+    long long end, next_tick, next_report, wait_ns;
+    unsigned long lost;
+    double secs;
+    int n;
+
+    memset(&lg, 0, sizeof(lg));
+    lg.cfg = *cfg;
+    lg.seed = (unsigned int)(now_ns() ^ getpid());
+    lat_hist_init(&lg.hist);
+    lat_hist_init(&lg.interval_hist);
+    lg.senders = calloc(cfg->concurrency, sizeof(*lg.senders));
+    lg.pending = calloc(LOADGEN_PENDING, sizeof(*lg.pending));
+    if (lg.senders == NULL || lg.pending == NULL) {
+        perror("[ERROR] malloc failed");
+        return 1;
+    }
+    for (int i = 0; i < cfg->concurrency; i++) {
+        lg.senders[i].kind = LG_SENDER;
+        lg.senders[i].fd = -1;
+    }
+
+    raise_fd_limit();
+    lg.epfd = epoll_create1(EPOLL_CLOEXEC);
+    lg.listen_fd = open_listener(SOMAXCONN);
+    if (lg.epfd < 0 || lg.listen_fd < 0) {
+        return 1;
+    }
+    fcntl(lg.listen_fd, F_SETFL, fcntl(lg.listen_fd, F_GETFL) | O_NONBLOCK);
+    ev.events = EPOLLIN;
+    ev.data.ptr = &lg_listener_kind;
+    if (epoll_ctl(lg.epfd, EPOLL_CTL_ADD, lg.listen_fd, &ev) < 0) {
+        perror("[ERROR] epoll_ctl failed for listen socket");
+        return 1;
+    }
+
+    lg.start = lg.now = now_ns();
+    end = lg.start + cfg->duration * 1000000000LL;
+    next_tick = lg.start + LOADGEN_TICK_MS * 1000000LL;
+    next_report = lg.start + 1000000000LL;
+    lg.generating = 1;
+    lg_generate(&lg);
+
+    /* 試験時間の経過後は、応答待ちがなくなるかタイムアウトまで待つ */
+    while (lg.generating ||
+           (lg.sent > lg.received + lg.timeouts &&
+            lg.now < end + LOADGEN_TIMEOUT_MS * 1000000LL)) {
+        wait_ns = next_tick - lg.now;
+        if (lg.generating && cfg->rate > 0) {
+            long long due = lg.start + (long long)(lg.issued * 1e9 / cfg->rate);
+            if (due - lg.now < wait_ns) {
+                wait_ns = due - lg.now;
+            }
+        }
+        /* 待ち時間は ms 単位のため、open-loop の送信は最大 1 ms まとめて行われる
+         * (送信時刻は予定時刻なので、その遅れも RTT に含まれる) */
+        n = epoll_wait(lg.epfd, events, LOADGEN_MAX_EVENTS,
+                       wait_ns > 0 ? (int)((wait_ns + 999999) / 1000000) : 0);
+        if (n < 0 && errno != EINTR) {
+            perror("[ERROR] epoll_wait failed");
+            break;
+        }
+        lg.now = now_ns();
+
+        for (int i = 0; i < n; i++) {
+            switch (*(lg_kind_t *)events[i].data.ptr) {
+            case LG_LISTENER:
+                lg_accept(&lg);
+                break;
+            case LG_SENDER:
+                lg_sender_event(&lg, events[i].data.ptr, events[i].events);
+                break;
+            case LG_RETURN:
+                lg_return_event(&lg, events[i].data.ptr);
+                break;
+            }
+        }
+
+        if (lg.generating && lg.now >= end) {
+            lg.generating = 0;
+        }
+        lg_generate(&lg);
+        if (lg.now >= next_tick) {
+            lg_tick(&lg, &next_report);
+            next_tick = lg.now + LOADGEN_TICK_MS * 1000000LL;
+        }
+    }
+
+    /* 結果の表示 (経過表示のログを出し切ってから) */
+    alog_stop();
+    secs = cfg->duration;
+    lost = lg.sent - lg.received - lg.timeouts;
+    printf("============================================================\n");
+    printf("  Load Test Result: %s, %d connections (%s), %d s\n",
+           cfg->rate > 0 ? "open-loop" : "closed-loop", cfg->concurrency,
+           cfg->per_request ? "connection per request" : "persistent", cfg->duration);
+    printf("============================================================\n");
+    printf("[INFO] Requests: %lu sent, %lu received, %lu timed out, %lu lost, "
+           "%lu unexpected responses\n",
+           lg.sent, lg.received, lg.timeouts, lost, lg.unexpected);
+    printf("[INFO] Connections: %lu response connections accepted, %lu connect/send errors\n",
+           lg.accepted, lg.errors);
+    printf("[INFO] Throughput: %.1f requests/s sent, %.1f responses/s, %.3f MB/s requests",
+           lg.sent / secs, lg.received / secs, lg.bytes / secs / 1e6);
+    if (cfg->rate > 0) {
+        printf(" (target %.1f requests/s)", cfg->rate);
+    }
+    printf("\n");
+    lat_hist_print(&lg.hist, "RTT");
+
+    for (int i = 0; i < cfg->concurrency; i++) {
+        lg_close(&lg.senders[i]);
+        frame_buffer_free(&lg.senders[i].out);
+    }
+    close(lg.listen_fd);
+    close(lg.epfd);
+    free(lg.senders);
+    free(lg.pending);
+    return lost == 0 && lg.timeouts == 0 ? 0 : 1;
+}
+
+/* ============================================================================
+ * 関数: open_udp_socket
+ * 機能: UDP ソケットを作成してアドレスにバインドする (非ブロッキング)
+ * 戻り値: ソケット (失敗時は -1)
+ * ============================================================================ */
+int open_udp_socket(const struct sockaddr_in *addr) {
+    int size = UDP_SOCKET_BUFFER;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("[ERROR] UDP socket creation failed");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    if (bind(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0) {
+        perror("[ERROR] UDP bind failed");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* ============================================================================
+ * 関数: run_udp
+ * 機能: UDP 転送モード。要求・応答を UDP データグラム1個ずつで送受信し、
+ *       最大 window 個の要求を応答を待たずに送信する (udp_transport.h)
+ *   - 要求には1から順に番号を付け、応答は番号で要求と対応付ける
+ *     (応答待ちの要求の番号は、常に次の番号から UDPT_WINDOW 個以内)
+ *   - 応答が届かない要求は、間隔を倍々に延ばして UDPT_MAX_RETRIES 回まで
+ *     再送する (RTT は最初の送信から測る)。超えたら失われたものとして数える
+ *   - 受信した応答すべて (重複を含む) に、応答の送信元へ ACK を返す
+ *   - 応答本体の末尾が要求本体と一致することを確認する
+ * 引数:
+ *   interval_ms  - 要求の送信間隔 (0 = ウィンドウが空けば即座に送信)
+ *   window       - 応答待ちにできる要求数 (UDPT_WINDOW 以下)
+ *   payload_size - 要求本体のバイト数 (UDPT_REQUEST_MAX 以下)
+ *   count        - 送信する要求数 (0 = 無制限)
+ *   quiet        - 1 = 要求ごとの表示を省略
+ * ============================================================================ */
+int run_udp(int interval_ms, int window, size_t payload_size,
+            unsigned long count, int quiet) {
+    static unsigned char rx[UDP_BATCH][UDPT_DATAGRAM_MAX];
+    static lat_hist_t hist;
+    struct mmsghdr in[UDP_BATCH], acks[UDP_BATCH];
+    struct iovec in_iov[UDP_BATCH], ack_iov[UDP_BATCH];
+    struct sockaddr_in from[UDP_BATCH];
+    unsigned char ack[UDP_BATCH][UDPT_HEADER_SIZE];
+    unsigned char request[UDPT_DATAGRAM_MAX];
+    char message[BUFFER_SIZE];
+    udp_pending_t *pending, *p;
+    udpt_datagram_t d;
+    struct pollfd pfd;
+    unsigned long sent = 0, received = 0, lost = 0, mismatched = 0;
+    unsigned long retransmits = 0, duplicates = 0, acked = 0;
+    long long start, now, wake, next_send, next_check = LLONG_MAX;
+    uint32_t session, next_seq = 1;
+    int req_sock, rsp_sock;
+    int inflight = 0;
+    int n, nacks;
+    size_t msg_len, off;
+
+    /* 応答待ちの枠は UDPT_WINDOW 個 (window より多く持ち、再送中の要求が
+     * あっても後続の要求を送れるようにする) */
+    pending = calloc(UDPT_WINDOW, sizeof(*pending));
+    if (pending == NULL) {
+        perror("[ERROR] malloc failed");
+        return 1;
+    }
+
+    /* 要求本体: 従来のメッセージを繰り返して payload_size バイトにする */
+    generate_message(message, sizeof(message));
+    msg_len = strlen(message);
+    for (off = 0; off < payload_size; off++) {
+        request[UDPT_HEADER_SIZE + off] = off % (msg_len + 1) == msg_len ?
+                                          ' ' : message[off % (msg_len + 1)];
+    }
+
+    /* 往路: 192.168.100.2 (ポート自動) から送信, 復路: 192.168.200.2:8000 で受信 */
+    req_sock = open_udp_socket(&client_bind_addr);
+    rsp_sock = open_udp_socket(&bind_addr_in);
+    if (req_sock < 0 || rsp_sock < 0) {
+        return 1;
+    }
+
+    /* セッションIDは起動ごとに変える (ブリッジが要求番号の空間を区別する) */
+    start = now_ns();
+    session = (uint32_t)(start ^ ((long long)getpid() << 16));
+    if (session == 0) {
+        session = 1;
+    }
+    ALOG_INFO("[INFO] UDP session %08x: %s -> %s:%d, responses on %s:%d\n", session,
+              CLIENT_IP_OUTBOUND_SRC, SERVER_IP_OUTBOUND, SERVER_PORT_OUTBOUND,
+              CLIENT_IP_INBOUND, CLIENT_PORT_INBOUND);
+
+    for (int i = 0; i < UDP_BATCH; i++) {
+        ack_iov[i].iov_base = ack[i];
+        ack_iov[i].iov_len = UDPT_HEADER_SIZE;
+    }
+    lat_hist_init(&hist);
+    next_send = start;
+
+    while (count == 0 || sent < count || inflight > 0) {
+        now = now_ns();
+
+        /* 再送時刻に達した要求を再送 (上限を超えたら失われたものとする) */
+        if (now >= next_check) {
+            next_check = LLONG_MAX;
+            for (int i = 0; i < UDPT_WINDOW; i++) {
+                p = &pending[i];
+                if (p->seq == 0) {
+                    continue;
+                }
+                if (now >= p->deadline_ns) {
+                    if (p->retries >= UDPT_MAX_RETRIES) {
+                        ALOG_WARN("[WARN] Request seq=%u lost after %d retransmits\n",
+                                  p->seq, p->retries);
+                        p->seq = 0;
+                        lost++;
+                        inflight--;
+                        continue;
+                    }
+                    p->retries++;
+                    udpt_put_header(request, UDPT_TYPE_REQUEST, session, p->seq);
+                    sendto(req_sock, request, UDPT_HEADER_SIZE + payload_size, 0,
+                           (struct sockaddr *)&serv_addr_out, sizeof(serv_addr_out));
+                    retransmits++;
+                    p->deadline_ns = now + udpt_rto(p->retries) * 1000000LL;
+                }
+                if (p->deadline_ns < next_check) {
+                    next_check = p->deadline_ns;
+                }
+            }
+        }
+
+        /* ウィンドウ (同じ番号の枠) が空いていて送信時刻に達していれば送信 */
+        wake = next_check;
+        if (inflight < window && (count == 0 || sent < count) &&
+            pending[next_seq % UDPT_WINDOW].seq == 0) {
+            if (now >= next_send) {
+                p = &pending[next_seq % UDPT_WINDOW];
+                udpt_put_header(request, UDPT_TYPE_REQUEST, session, next_seq);
+                /* 送れなかった場合 (ソケットが満杯) も再送で送り直す */
+                sendto(req_sock, request, UDPT_HEADER_SIZE + payload_size, 0,
+                       (struct sockaddr *)&serv_addr_out, sizeof(serv_addr_out));
+                if (g_probe != NULL) {
+                    stage_record(g_probe, STAGE_SEND, now_ns() - now);
+                    stage_add(g_probe, COUNTER_SENT, 1);
+                }
+                if (!quiet) {
+                    ALOG_INFO("[SEND] Request seq=%u sent via %s (%zu bytes)\n",
+                              next_seq, CLIENT_IP_OUTBOUND_SRC, payload_size);
+                }
+                p->seq = next_seq;
+                p->retries = 0;
+                p->sent_ns = now;
+                p->deadline_ns = now + udpt_rto(0) * 1000000LL;
+                if (p->deadline_ns < next_check) {
+                    next_check = p->deadline_ns;
+                }
+                next_seq++;
+                sent++;
+                inflight++;
+                next_send += interval_ms * 1000000LL;
+                if (next_send < now) {
+                    next_send = now;    /* 遅れた分は詰めて送らない */
+                }
+                continue;
+            }
+            if (next_send < wake) {
+                wake = next_send;
+            }
+        }
+
+        /* 次の送信・再送の時刻まで応答を待つ */
+        pfd.fd = rsp_sock;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, wake == LLONG_MAX ? -1 :
+                 (int)((wake - now + 999999) / 1000000)) <= 0) {
+            continue;
+        }
+
+        /* 応答をまとめて受信し、すべてに ACK を返す */
+        for (int i = 0; i < UDP_BATCH; i++) {
+            in_iov[i].iov_base = rx[i];
+            in_iov[i].iov_len = UDPT_DATAGRAM_MAX;
+            memset(&in[i].msg_hdr, 0, sizeof(in[i].msg_hdr));
+            in[i].msg_hdr.msg_name = &from[i];
+            in[i].msg_hdr.msg_namelen = sizeof(from[i]);
+            in[i].msg_hdr.msg_iov = &in_iov[i];
+            in[i].msg_hdr.msg_iovlen = 1;
+        }
+        n = recvmmsg(rsp_sock, in, UDP_BATCH, MSG_DONTWAIT, NULL);
+        if (n <= 0) {
+            continue;
+        }
+        now = now_ns();
+        nacks = 0;
+        for (int i = 0; i < n; i++) {
+            if (udpt_parse(rx[i], in[i].msg_len, &d) < 0 ||
+                d.type != UDPT_TYPE_RESPONSE || d.session != session) {
+                fprintf(stderr, "[WARN] Unexpected datagram from ABOS1 (%u bytes)\n",
+                        in[i].msg_len);
+                continue;
+            }
+            udpt_put_header(ack[nacks], UDPT_TYPE_ACK, session, d.seq);
+            memset(&acks[nacks].msg_hdr, 0, sizeof(acks[nacks].msg_hdr));
+            acks[nacks].msg_hdr.msg_name = &from[i];
+            acks[nacks].msg_hdr.msg_namelen = sizeof(from[i]);
+            acks[nacks].msg_hdr.msg_iov = &ack_iov[nacks];
+            acks[nacks].msg_hdr.msg_iovlen = 1;
+            nacks++;
+
+            p = &pending[d.seq % UDPT_WINDOW];
+            if (p->seq != d.seq) {
+                duplicates++;           /* 再送した要求への応答など */
+                continue;
+            }
+            if (d.length < payload_size ||
+                memcmp(d.payload + d.length - payload_size,
+                       request + UDPT_HEADER_SIZE, payload_size) != 0) {
+                mismatched++;
+            }
+            lat_hist_record(&hist, (uint64_t)(now - p->sent_ns));
+            stage_record(g_probe, STAGE_RTT, now - p->sent_ns);
+            stage_add(g_probe, COUNTER_RECEIVED, 1);
+            p->seq = 0;
+            inflight--;
+            received++;
+            if (!quiet) {
+                ALOG_INFO("[RECV] Response seq=%u received via %s (%u bytes, RTT %.3f ms)\n",
+                          d.seq, CLIENT_IP_INBOUND, d.length, (now - p->sent_ns) / 1e6);
+            }
+        }
+        if (nacks > 0) {
+            n = sendmmsg(rsp_sock, acks, nacks, MSG_DONTWAIT);
+            if (n > 0) {
+                acked += n;
+            }
+        }
+    }
+
+    /* 要求ごとのログを出し切ってから集計を表示 */
+    alog_stop();
+    now = now_ns();
+    printf("[INFO] Requests: %lu sent, %lu received, %lu lost, %lu payload mismatches\n",
+           sent, received, lost, mismatched);
+    if (received > 0) {
+        double secs = (now - start) / 1e9;
+        printf("[INFO] %.1f requests/s, %.2f MB/s, RTT avg %.3f ms, max %.3f ms\n",
+               received / secs, received * (double)payload_size / secs / 1e6,
+               hist.sum / hist.count / 1e6, hist.max / 1e6);
+        lat_hist_print(&hist, "RTT");
+    }
+    printf("[INFO] UDP: %lu retransmits, %lu duplicate responses, %lu acks sent\n",
+           retransmits, duplicates, acked);
+
+    close(req_sock);
+    close(rsp_sock);
+    free(pending);
+    return mismatched == 0 && lost == 0 ? 0 : 1;
+}
+
+/* ============================================================================
+ * 関数: remove_stage_probes
+ * 機能: 終了時に段階ごとの計測の共有メモリを削除する (atexit)
+ * ============================================================================ */
+void remove_stage_probes(void) {
+    stage_shm_destroy(g_stages);
+    g_stages = NULL;
+    g_probe = NULL;
+}
+
+/* ============================================================================
+ * 関数: handle_signal
+ * 機能: 終了シグナルで共有メモリのファイルを削除し、既定の動作で終了する
+ *   (シグナルハンドラ内で安全な unlink / signal / raise のみ使う)
+ * ============================================================================ */
+void handle_signal(int sig) {
+    unlink(g_stage_path);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/* ============================================================================
+ * 関数: main
+ * 機能: ABOS1への定期的なメッセージ送信と応答受信
+ * ============================================================================ */
+int main(int argc, char *argv[]) {
+    int persistent = 0;
+    int framed = 0;
+    int udp = 0;
+    int loadgen = 0;
+    loadgen_config_t lg_cfg = { 1, 0, LOADGEN_DURATION, 0, { 0 }, 0 };
+    const char *size_arg = NULL;
+    int window = FRAME_WINDOW;
+    long payload_size = -1;
+    unsigned long count = 0;
+    int quiet = 0;
+    int probes = 0;
+    const char *log_path = NULL;
+    int interval_ms = MESSAGE_INTERVAL * 1000;
+    char message[BUFFER_SIZE];
+    int ret;
+    int c;
+
+    /* コマンドライン引数の解析 */
+    while ((c = getopt(argc, argv, "pfuLc:r:d:ow:s:n:qTl:i:Fh")) != -1) {
+        switch (c) {
+        case 'p':
+            persistent = 1;
+            break;
+        case 'f':
+            framed = 1;
+            break;
+        case 'u':
+            udp = 1;
+            break;
+        case 'L':
+            loadgen = 1;
+            break;
+        case 'c':
+            lg_cfg.concurrency = atoi(optarg);
+            if (lg_cfg.concurrency <= 0 || lg_cfg.concurrency > LOADGEN_CONCURRENCY_MAX) {
+                fprintf(stderr, "[ERROR] Invalid concurrency: %s (1-%d)\n",
+                        optarg, LOADGEN_CONCURRENCY_MAX);
+                return 1;
+            }
+            break;
+        case 'r':
+            lg_cfg.rate = atof(optarg);
+            if (lg_cfg.rate < 0) {
+                fprintf(stderr, "[ERROR] Invalid rate: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'd':
+            lg_cfg.duration = atoi(optarg);
+            if (lg_cfg.duration <= 0) {
+                fprintf(stderr, "[ERROR] Invalid duration: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'o':
+            lg_cfg.per_request = 1;
+            break;
+        case 'w':
+            window = atoi(optarg);
+            if (window <= 0 || window > FRAME_WINDOW_MAX) {
+                fprintf(stderr, "[ERROR] Invalid window: %s (1-%d)\n",
+                        optarg, FRAME_WINDOW_MAX);
+                return 1;
+            }
+            break;
+        case 's':
+            size_arg = optarg;
+            payload_size = atol(optarg);
+            if (strpbrk(optarg, ",-") == NULL &&
+                (payload_size < 0 || payload_size > FRAME_MAX_PAYLOAD - BUFFER_SIZE)) {
+                fprintf(stderr, "[ERROR] Invalid payload size: %s (0-%d)\n",
+                        optarg, FRAME_MAX_PAYLOAD - BUFFER_SIZE);
+                return 1;
+            }
+            break;
+        case 'n':
+            count = strtoul(optarg, NULL, 10);
+            break;
+        case 'q':
+            quiet = 1;
+            lg_cfg.quiet = 1;
+            break;
+        case 'T':
+            probes = 1;
+            break;
+        case 'l':
+            log_path = optarg;
+            break;
+        case 'F':
+            g_profile = SOCK_PROFILE_LOWLAT;
+            break;
+        case 'i':
+            interval_ms = atoi(optarg);
+            if (interval_ms < 0) {
+                fprintf(stderr, "[ERROR] Invalid interval: %s\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-p] [-F] [-T] [-l log_file] [-i interval_ms]\n"
+                    "       %s -f [-w window] [-s payload_size] [-n count] "
+                    "[-i interval_ms] [-q] [-F] [-T] [-l log_file]\n"
+                    "       %s -u [-w window] [-s payload_size] [-n count] "
+                    "[-i interval_ms] [-q] [-T] [-l log_file]\n"
+                    "       %s -L [-c concurrency] [-r rate] [-d seconds] [-s sizes] [-o] [-q] "
+                    "[-F] [-T] [-l log_file]\n",
+                    argv[0], argv[0], argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+    printf("============================================================\n");
+    printf("  Client/Server (ABOS2, C) Starting\n");
+    printf("  Mode: %s\n", loadgen ? "load test" :
+                          udp ? "UDP datagrams (ack/retransmit)" :
+                          framed ? "framed requests (pipelined)" :
+                          persistent ? "persistent connections" : "connection per message");
+    if (!udp || loadgen) {
+        printf("  Socket Profile: %s\n", sock_profile_name(g_profile));
+    }
+    printf("============================================================\n");
+    if (!udp || loadgen) {
+        sock_profile_check(g_profile);
+    }
+
+    /* 往路接続先の設定 (ABOS1) */
+    memset(&serv_addr_out, 0, sizeof(serv_addr_out));
+    serv_addr_out.sin_family = AF_INET;
+    serv_addr_out.sin_port = htons(SERVER_PORT_OUTBOUND);
+
+    if (inet_pton(AF_INET, SERVER_IP_OUTBOUND, &serv_addr_out.sin_addr) <= 0) {
+        perror("[ERROR] Invalid outbound address");
+        return 1;
+    }
+
+    /* 往路の送信元アドレス (192.168.100.2, ポートはOSが自動割り当て) */
+    memset(&client_bind_addr, 0, sizeof(client_bind_addr));
+    client_bind_addr.sin_family = AF_INET;
+    client_bind_addr.sin_port = 0;
+    inet_pton(AF_INET, CLIENT_IP_OUTBOUND_SRC, &client_bind_addr.sin_addr);
+
+    /* 復路待ち受けアドレスの設定 (ABOS2) */
+    memset(&bind_addr_in, 0, sizeof(bind_addr_in));
+    bind_addr_in.sin_family = AF_INET;
+    bind_addr_in.sin_port = htons(CLIENT_PORT_INBOUND);
+
+    if (inet_pton(AF_INET, CLIENT_IP_INBOUND, &bind_addr_in.sin_addr) <= 0) {
+        perror("[ERROR] Invalid inbound bind address");
+        return 1;
+    }
+
+    /* 段階ごとの計測 (-T)。従来・接続維持モードは Ctrl+C で終了するため、
+     * 終了シグナルでも共有メモリのファイルを削除する */
+    if (probes) {
+        g_stages = stage_shm_create("Client_C", stage_names,
+                                    sizeof(stage_names) / sizeof(stage_names[0]),
+                                    counter_names,
+                                    sizeof(counter_names) / sizeof(counter_names[0]));
+        g_probe = stage_thread(g_stages, "main");
+        if (g_stages != NULL) {
+            stage_shm_path(g_stage_path, sizeof(g_stage_path), "Client_C", getpid());
+            atexit(remove_stage_probes);
+            signal(SIGINT, handle_signal);
+            signal(SIGTERM, handle_signal);
+        }
+    }
+
+    if (loadgen) {
+        if (parse_size_dist(size_arg != NULL ? size_arg : "64", &lg_cfg.sizes) < 0) {
+            fprintf(stderr, "[ERROR] Invalid sizes: %s (N, A-B or A,B,... within 1-%d)\n",
+                    size_arg, LOADGEN_SIZE_MAX);
+            return 1;
+        }
+    } else if (size_arg != NULL && strpbrk(size_arg, ",-") != NULL) {
+        fprintf(stderr, "[ERROR] Size distribution requires -L: %s\n", size_arg);
+        return 1;
+    }
+    if (udp && !loadgen) {
+        if (window > UDPT_WINDOW) {
+            fprintf(stderr, "[ERROR] Invalid window for UDP: %d (1-%d)\n",
+                    window, UDPT_WINDOW);
+            return 1;
+        }
+        if (payload_size > UDPT_REQUEST_MAX) {
+            fprintf(stderr, "[ERROR] Invalid payload size for UDP: %ld (0-%d)\n",
+                    payload_size, UDPT_REQUEST_MAX);
+            return 1;
+        }
+    }
+
+    /* 送受信のログはバックグラウンドで出力する (-l: バイナリ形式でファイルへ) */
+    alog_start("Client_C", log_path);
+    if (!loadgen && (framed || udp) && payload_size < 0) {
+        generate_message(message, sizeof(message));
+        payload_size = (long)strlen(message);
+    }
+    if (loadgen) {
+        ret = run_loadgen(&lg_cfg);
+    } else if (udp) {
+        ret = run_udp(interval_ms, window, (size_t)payload_size, count, quiet);
+    } else if (framed) {
+        ret = run_framed(interval_ms, window, (size_t)payload_size, count, quiet);
+    } else if (persistent) {
+        ret = run_persistent(interval_ms);
+    } else {
+        ret = run_per_message(interval_ms);
+    }
+    alog_stop();
+    return ret;
+}
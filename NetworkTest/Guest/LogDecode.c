@@ -0,0 +1,266 @@
+/*
+ * ============================================================================
+ * LogDecode.c - Binary Log Decoder
+ * ============================================================================
+ * 機能:
+ *   - Bridge_C / Client_C / ElsgwReceiver を -l で起動した場合のバイナリログ
+ *     (async_log.h) を、実行時のテキスト出力と同じ形式で表示する
+ *   - 記録ごとの時刻 (-t)、時刻順への並べ替え (-s, スレッドをまたいだ順序)、
+ *     レベルによる絞り込み (-l) を行う
+ *   - 強制終了などで途中までのファイルは、読めた記録まで表示する
+ *
+ * 使い方:
+ *   ./LogDecode [-t] [-s] [-l error|warn|info|debug] ファイル...
+ *     -t  各記録の先頭に時刻 (時:分:秒.マイクロ秒) を付ける
+ *     -s  時刻順に並べ替えて表示する (ファイル全体を読み込む)
+ *     -l  表示するレベル (既定: debug = すべて)
+ *
+ * ビルド:
+ *   gcc -O2 -Wall -pthread -o LogDecode LogDecode.c ../../EvalEnv/hex_dump.c
+ *   (ElsgwReceiver の ALOG_DUMP の整形に EvalEnv/hex_dump.h・hex_dump.c を使うため、
+ *    他の Guest のプログラムと異なり EvalEnv のソースが必要。このディレクトリで実行する)
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../../EvalEnv/hex_dump.h"      /* ElsgwReceiver の ALOG_DUMP の整形 */
+#include "async_log.h"
+
+/* ============================================================================
+ * 呼び出し箇所の定義 (ファイル内の ALOG_SITE_DEF の記録から作る)
+ * ============================================================================ */
+typedef struct {
+    const char *fmt;                    /* NULL = 未定義 */
+    int         level;
+    int         dump;
+} site_def_t;
+
+/* ============================================================================
+ * 表示オプション
+ * ============================================================================ */
+typedef struct {
+    int show_time;                      /* 1 = 時刻を付ける */
+    int sort;                           /* 1 = 時刻順に並べ替える */
+    int level;                          /* 表示するレベル (これ以下) */
+} decode_options_t;
+
+/* ============================================================================
+ * 関数: print_time
+ * 機能: 記録の時刻 (CLOCK_REALTIME, ns) を地方時で表示する
+ * ============================================================================ */
+void print_time(int64_t ns) {
+    time_t sec = (time_t)(ns / 1000000000LL);
+    struct tm tm;
+    char buf[32];
+
+    localtime_r(&sec, &tm);
+    strftime(buf, sizeof(buf), "%H:%M:%S", &tm);
+    printf("%s.%06lld ", buf, (long long)(ns % 1000000000LL) / 1000);
+}
+
+/* ============================================================================
+ * 関数: compare_time
+ * 機能: 記録を時刻順に並べる (同時刻はファイル内の順)
+ * ============================================================================ */
+int compare_time(const void *a, const void *b) {
+    const alog_rec_t *ra = *(const alog_rec_t *const *)a;
+    const alog_rec_t *rb = *(const alog_rec_t *const *)b;
+
+    if (ra->time_ns != rb->time_ns) {
+        return ra->time_ns < rb->time_ns ? -1 : 1;
+    }
+    return ra < rb ? -1 : ra > rb;
+}
+
+/* ============================================================================
+ * 関数: print_record
+ * 機能: 記録1件を書式に従って表示する
+ * 戻り値: 0 = 成功, -1 = 記録が壊れている
+ * ============================================================================ */
+int print_record(const alog_rec_t *rec, const site_def_t *sites,
+                 const decode_options_t *opt) {
+    const site_def_t *def = &sites[rec->site];
+
+    if (def->level > opt->level) {
+        return 0;
+    }
+    if (opt->show_time) {
+        print_time(rec->time_ns);
+    }
+    return alog_format(stdout, def->fmt, def->dump, (const unsigned char *)(rec + 1),
+                       rec->size - sizeof(*rec));
+}
+
+/* ============================================================================
+ * 関数: decode_file
+ * 機能: バイナリログ1個を表示する
+ *   呼び出し箇所の定義は、その箇所の最初の記録より前に書かれている
+ * 戻り値: 0 = 成功, -1 = 読めない・形式が違う・壊れた記録がある
+ * ============================================================================ */
+int decode_file(const char *path, const decode_options_t *opt) {
+    static site_def_t sites[ALOG_SITE_MAX + 1];
+    const alog_file_header_t *hdr;
+    const alog_rec_t **records = NULL;
+    const unsigned char *data, *p, *end;
+    size_t count = 0, capacity = 0;
+    unsigned long bad = 0;
+    struct stat st;
+    int ret = 0;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(*hdr)) {
+        fprintf(stderr, "[ERROR] %s: not a binary log\n", path);
+        close(fd);
+        return -1;
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("[ERROR] mmap failed");
+        return -1;
+    }
+    hdr = (const alog_file_header_t *)data;
+    if (memcmp(hdr->magic, ALOG_FILE_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != ALOG_FILE_VERSION) {
+        fprintf(stderr, "[ERROR] %s: not a binary log (or unsupported version)\n", path);
+        munmap((void *)data, st.st_size);
+        return -1;
+    }
+    fprintf(stderr, "[INFO] %s: %.32s (pid %d)\n", path, hdr->program, hdr->pid);
+
+    memset(sites, 0, sizeof(sites));
+    p = data + sizeof(*hdr);
+    end = data + st.st_size;
+    while (p + sizeof(alog_rec_t) <= end) {
+        const alog_rec_t *rec = (const alog_rec_t *)p;
+
+        if (rec->size < sizeof(*rec) || rec->size % 8 != 0 || p + rec->size > end) {
+            fprintf(stderr, "[WARN] %s: truncated record at offset %zu\n",
+                    path, (size_t)(p - data));
+            ret = -1;
+            break;
+        }
+        p += rec->size;
+
+        /* 呼び出し箇所の定義: 番号, レベル | ダンプ << 8, 書式 */
+        if (rec->site == ALOG_SITE_DEF) {
+            const uint32_t *info = (const uint32_t *)(rec + 1);
+
+            if (rec->size < sizeof(*rec) + 9 || info[0] == 0 || info[0] > ALOG_SITE_MAX ||
+                memchr(info + 2, '\0', rec->size - sizeof(*rec) - 8) == NULL) {
+                bad++;
+                continue;
+            }
+            sites[info[0]].fmt = (const char *)(info + 2);
+            sites[info[0]].level = (int)(info[1] & 0xff);
+            sites[info[0]].dump = (int)(info[1] >> 8) & 1;
+            continue;
+        }
+        if (rec->site == ALOG_SITE_PAD || rec->site > ALOG_SITE_MAX ||
+            sites[rec->site].fmt == NULL) {
+            bad++;
+            continue;
+        }
+
+        if (!opt->sort) {
+            if (print_record(rec, sites, opt) < 0) {
+                bad++;
+            }
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity == 0 ? 65536 : capacity * 2;
+            records = realloc(records, capacity * sizeof(*records));
+            if (records == NULL) {
+                perror("[ERROR] malloc failed");
+                munmap((void *)data, st.st_size);
+                return -1;
+            }
+        }
+        records[count++] = rec;
+    }
+
+    if (opt->sort) {
+        qsort(records, count, sizeof(*records), compare_time);
+        for (size_t i = 0; i < count; i++) {
+            if (print_record(records[i], sites, opt) < 0) {
+                bad++;
+            }
+        }
+        free(records);
+    }
+    fflush(stdout);
+    if (bad > 0) {
+        fprintf(stderr, "[WARN] %s: %lu malformed records skipped\n", path, bad);
+        ret = -1;
+    }
+    munmap((void *)data, st.st_size);
+    return ret;
+}
+
+/* ============================================================================
+ * 関数: main
+ * 機能: 指定されたバイナリログを順に表示する
+ * ============================================================================ */
+int main(int argc, char *argv[]) {
+    decode_options_t opt = { 0, 0, ALOG_LEVEL_DEBUG };
+    int ret = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "tsl:h")) != -1) {
+        switch (c) {
+        case 't':
+            opt.show_time = 1;
+            break;
+        case 's':
+            opt.sort = 1;
+            break;
+        case 'l':
+            if (strcmp(optarg, "error") == 0) {
+                opt.level = ALOG_LEVEL_ERROR;
+            } else if (strcmp(optarg, "warn") == 0) {
+                opt.level = ALOG_LEVEL_WARN;
+            } else if (strcmp(optarg, "info") == 0) {
+                opt.level = ALOG_LEVEL_INFO;
+            } else if (strcmp(optarg, "debug") == 0) {
+                opt.level = ALOG_LEVEL_DEBUG;
+            } else {
+                fprintf(stderr, "[ERROR] Invalid level: %s (error|warn|info|debug)\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-t] [-s] [-l error|warn|info|debug] file...\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-t] [-s] [-l error|warn|info|debug] file...\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = optind; i < argc; i++) {
+        if (decode_file(argv[i], &opt) < 0) {
+            ret = 1;
+        }
+    }
+    return ret;
+}
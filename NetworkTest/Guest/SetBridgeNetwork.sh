@@ -8,7 +8,14 @@
 #   eth2: 10.0.2.x/24     (QEMU User Mode自動設定)
 ################################################################################
 
-# NICのクリーンアップ
+# SetNetwork (gcc -O2 -Wall -o SetNetwork SetNetwork.c) があれば、
+# rtnetlink で一括設定し、リンクの IFF_RUNNING を待って終了する (sleep なし)
+SET_NETWORK="$(dirname "$0")/SetNetwork"
+if [ -x "$SET_NETWORK" ]; then
+    exec "$SET_NETWORK" bridge
+fi
+
+# NICのクリーンアップ (以下は SetNetwork がない場合)
 for dev in eth0 eth1 eth2; do
     ip link set dev $dev down 2>/dev/null
     ip addr flush dev $dev 2>/dev/null
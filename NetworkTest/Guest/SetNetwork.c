@@ -0,0 +1,605 @@
+/*
+ * ============================================================================
+ * SetNetwork.c - ABOS Network Configuration (rtnetlink)
+ * ============================================================================
+ * 機能:
+ *   - SetBridgeNetwork.sh / SetClientNetwork.sh と同じアドレス・経路を
+ *     rtnetlink で設定する。要求は1回の送信にまとめ、ACK をまとめて受ける
+ *       後片付け : main 表の IPv4 経路と eth0/eth1/eth2 の IPv4 アドレスを削除
+ *       設定     : リンク up、アドレス追加、サブネットの経路追加
+ *   - sleep で待たず、カーネルが全インターフェースの IFF_RUNNING (キャリアあり)
+ *     を通知した時点で終了する (RTNLGRP_LINK の通知を受ける)
+ *   - リンクは down にしない (既に up のリンクはキャリアの再検出を待たずに済み、
+ *     eth2 の外部通信も切れない)。そのため IPv6 のアドレスは残す
+ *
+ * 使い方:
+ *   ./SetNetwork [-t 待ち時間ms] [-n] bridge|client
+ *     bridge  ABOS1: eth0=192.168.100.1/24, eth1=192.168.200.1/24, eth2=up
+ *     client  ABOS2: eth0=192.168.100.2/24, eth1=192.168.200.2/24, eth2=up
+ *     -t  IFF_RUNNING を待つ上限 (ミリ秒, 既定: 5000 = 従来のスクリプトの sleep)
+ *     -n  IFF_RUNNING を待たない
+ *   終了コード: 0 = 完了, 1 = 設定に失敗, 2 = 待ち時間内に RUNNING にならない
+ *   (要 CAP_NET_ADMIN)
+ *
+ * ビルド:
+ *   gcc -O2 -Wall -o SetNetwork SetNetwork.c
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+/* ============================================================================
+ * 設定
+ * ============================================================================ */
+#define DEFAULT_WAIT_MS     5000                /* IFF_RUNNING を待つ上限 */
+#define ACK_TIMEOUT_MS      2000                /* 要求の ACK を待つ上限 */
+#define NL_BATCH_SIZE       65536               /* 一括送信のバッファ */
+#define NL_BATCH_MAX        512                 /* 一括送信の要求数の上限 */
+#define NL_RECV_SIZE        32768               /* 受信バッファ */
+#define NL_RCVBUF           (1024 * 1024)       /* ソケットの受信バッファ (ACK・通知) */
+#define IF_COUNT            3
+
+/* ============================================================================
+ * インターフェースの構成 (SetBridgeNetwork.sh / SetClientNetwork.sh と同じ)
+ * ============================================================================ */
+typedef struct {
+    const char *name;
+    const char *subnet;                 /* 先頭3オクテット (NULL = up のみ) */
+    int         prefix;
+} if_layout_t;
+
+static const if_layout_t layout[IF_COUNT] = {
+    { "eth0", "192.168.100", 24 },      /* 100.x網 (Client -> Bridge) */
+    { "eth1", "192.168.200", 24 },      /* 200.x網 (Bridge -> Client) */
+    { "eth2", NULL,          0  },      /* 外部通信 (QEMU User Mode自動設定) */
+};
+
+typedef struct {
+    const if_layout_t *layout;
+    int            ifindex;             /* 0 = 見つからない */
+    struct in_addr addr;
+    struct in_addr network;
+    int            running;             /* 最後に通知された IFF_RUNNING */
+} if_state_t;
+
+/* ============================================================================
+ * rtnetlink の状態 (一括送信する要求と ACK の集計)
+ * ============================================================================ */
+typedef struct {
+    int           fd;
+    uint32_t      seq;                  /* 最後に使ったシーケンス番号 */
+    unsigned char buf[NL_BATCH_SIZE];   /* 一括送信する要求 */
+    size_t        len;
+    uint32_t      first_seq;            /* 一括送信の最初の要求の番号 (送信時に付ける) */
+    int           count;                /* 一括送信の要求数 */
+    int           acks;                 /* ACK を待つ要求数 */
+    int           acked;                /* 受けた ACK の数 */
+    int           failed;               /* 失敗した要求の数 */
+    int           ignore[NL_BATCH_MAX]; /* 無視するエラー (0 = なし) */
+    char          what[NL_BATCH_MAX][48]; /* 要求の説明 (エラー表示用) */
+    uint32_t      dump_seq;             /* 実行中のダンプ要求の番号 */
+    int           dump_done;
+    int           resync;               /* 通知が溢れた (リンクの状態を取り直す) */
+    if_state_t    ifs[IF_COUNT];
+} nl_ctx_t;
+
+static nl_ctx_t ctx;
+
+/* ============================================================================
+ * 関数: now_ms
+ * 機能: 単調増加の現在時刻をミリ秒で取得する
+ * ============================================================================ */
+static double now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* ============================================================================
+ * 関数: find_if
+ * 機能: インターフェース番号から構成対象のインターフェースを求める
+ * ============================================================================ */
+static if_state_t *find_if(nl_ctx_t *c, int ifindex) {
+    for (int i = 0; i < IF_COUNT; i++) {
+        if (c->ifs[i].ifindex != 0 && c->ifs[i].ifindex == ifindex) {
+            return &c->ifs[i];
+        }
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * 関数: nl_add
+ * 機能: 一括送信のバッファに要求を1個追加する
+ * 引数:
+ *   body, len - 要求の本体 (ifinfomsg などと属性)
+ *   ignore    - 成功とみなすエラー (0 = なし)
+ * 戻り値: 追加した要求 (NULL = バッファが一杯)
+ * ============================================================================ */
+static struct nlmsghdr *nl_add(nl_ctx_t *c, int type, int flags, const void *body,
+                               size_t len, int ignore, const char *fmt, ...) {
+    struct nlmsghdr *nlh;
+    va_list ap;
+
+    if (c->count >= NL_BATCH_MAX || c->len + NLMSG_SPACE(len) > sizeof(c->buf)) {
+        fprintf(stderr, "[ERROR] Too many netlink requests\n");
+        return NULL;
+    }
+    nlh = (struct nlmsghdr *)(c->buf + c->len);
+    memset(nlh, 0, NLMSG_SPACE(len));
+    nlh->nlmsg_len = NLMSG_LENGTH(len);
+    nlh->nlmsg_type = type;
+    nlh->nlmsg_flags = NLM_F_REQUEST | flags;
+    memcpy(NLMSG_DATA(nlh), body, len);
+    c->len += NLMSG_ALIGN(nlh->nlmsg_len);
+
+    c->ignore[c->count] = ignore;
+    va_start(ap, fmt);
+    vsnprintf(c->what[c->count], sizeof(c->what[0]), fmt, ap);
+    va_end(ap);
+    c->count++;
+    if (flags & NLM_F_ACK) {
+        c->acks++;
+    }
+    return nlh;
+}
+
+/* ============================================================================
+ * 関数: nl_attr
+ * 機能: 最後に追加した要求に属性を追加する
+ * ============================================================================ */
+static int nl_attr(nl_ctx_t *c, struct nlmsghdr *nlh, int type, const void *data, size_t len) {
+    struct rtattr *rta;
+
+    if (c->len + RTA_SPACE(len) > sizeof(c->buf)) {
+        fprintf(stderr, "[ERROR] Too many netlink requests\n");
+        return -1;
+    }
+    rta = (struct rtattr *)(c->buf + c->len);
+    rta->rta_type = type;
+    rta->rta_len = RTA_LENGTH(len);
+    memcpy(RTA_DATA(rta), data, len);
+    nlh->nlmsg_len = NLMSG_ALIGN(nlh->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+    c->len = (unsigned char *)nlh - c->buf + NLMSG_ALIGN(nlh->nlmsg_len);
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: collect_address
+ * 機能: ダンプしたアドレスが構成対象のインターフェースのものなら削除要求を追加する
+ *   (ダンプの内容をそのまま RTM_DELADDR として送る)
+ * ============================================================================ */
+static void collect_address(nl_ctx_t *c, const struct nlmsghdr *nlh) {
+    const struct ifaddrmsg *ifa = NLMSG_DATA(nlh);
+    const if_state_t *s = find_if(c, ifa->ifa_index);
+
+    if (s != NULL && ifa->ifa_family == AF_INET &&
+        nl_add(c, RTM_DELADDR, NLM_F_ACK, ifa, nlh->nlmsg_len - NLMSG_HDRLEN,
+               EADDRNOTAVAIL, "delete address on %s", s->layout->name) == NULL) {
+        c->failed++;
+    }
+}
+
+/* ============================================================================
+ * 関数: collect_route
+ * 機能: ダンプした経路が main 表のものなら削除要求を追加する
+ *   (ip route flush table main と同じ)
+ * ============================================================================ */
+static void collect_route(nl_ctx_t *c, const struct nlmsghdr *nlh) {
+    const struct rtmsg *rtm = NLMSG_DATA(nlh);
+    int len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*rtm));
+    uint32_t table = rtm->rtm_table;
+    char dst[INET_ADDRSTRLEN] = "default";
+
+    for (const struct rtattr *rta = RTM_RTA(rtm); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == RTA_TABLE) {
+            table = *(const uint32_t *)RTA_DATA(rta);
+        } else if (rta->rta_type == RTA_DST) {
+            inet_ntop(AF_INET, RTA_DATA(rta), dst, sizeof(dst));
+        }
+    }
+    if (rtm->rtm_family == AF_INET && table == RT_TABLE_MAIN &&
+        nl_add(c, RTM_DELROUTE, NLM_F_ACK, rtm, nlh->nlmsg_len - NLMSG_HDRLEN,
+               ESRCH, "delete route %s/%d", dst, rtm->rtm_dst_len) == NULL) {
+        c->failed++;
+    }
+}
+
+/* ============================================================================
+ * 関数: nl_handle
+ * 機能: 受信したメッセージ1個を処理する (ACK・ダンプ・リンクの状態)
+ * ============================================================================ */
+static void nl_handle(nl_ctx_t *c, const struct nlmsghdr *nlh) {
+    if (nlh->nlmsg_type == RTM_NEWLINK) {
+        const struct ifinfomsg *ifi = NLMSG_DATA(nlh);
+        if_state_t *s = find_if(c, ifi->ifi_index);
+
+        if (s != NULL) {
+            s->running = (ifi->ifi_flags & IFF_RUNNING) != 0;
+        }
+        return;
+    }
+
+    if (c->dump_seq != 0 && nlh->nlmsg_seq == c->dump_seq) {
+        if (nlh->nlmsg_type == NLMSG_DONE) {
+            c->dump_done = 1;
+        } else if (nlh->nlmsg_type == NLMSG_ERROR) {
+            const struct nlmsgerr *err = NLMSG_DATA(nlh);
+
+            fprintf(stderr, "[ERROR] Netlink dump failed: %s\n", strerror(-err->error));
+            c->dump_done = -1;
+        } else if (nlh->nlmsg_type == RTM_NEWADDR) {
+            collect_address(c, nlh);
+        } else if (nlh->nlmsg_type == RTM_NEWROUTE) {
+            collect_route(c, nlh);
+        }
+        return;
+    }
+
+    if (nlh->nlmsg_type == NLMSG_ERROR && c->count > 0 &&
+        nlh->nlmsg_seq - c->first_seq < (uint32_t)c->count) {
+        const struct nlmsgerr *err = NLMSG_DATA(nlh);
+        int index = nlh->nlmsg_seq - c->first_seq;
+
+        c->acked++;
+        if (err->error != 0 && -err->error != c->ignore[index]) {
+            fprintf(stderr, "[ERROR] Failed to %s: %s\n", c->what[index], strerror(-err->error));
+            c->failed++;
+        }
+    }
+}
+
+/* ============================================================================
+ * 関数: nl_receive
+ * 機能: 受信を待ち、届いたメッセージをすべて処理する
+ * 戻り値: 1 = 処理した, 0 = 時間切れ, -1 = エラー
+ * ============================================================================ */
+static int nl_receive(nl_ctx_t *c, int timeout_ms) {
+    static unsigned char buf[NL_RECV_SIZE];
+    struct pollfd pfd = { .fd = c->fd, .events = POLLIN };
+    ssize_t n;
+    int ready;
+
+    ready = poll(&pfd, 1, timeout_ms);
+    if (ready <= 0) {
+        if (ready < 0) {
+            perror("[ERROR] poll failed");
+        }
+        return ready;
+    }
+    n = recv(c->fd, buf, sizeof(buf), 0);
+    if (n < 0) {
+        if (errno == ENOBUFS) {
+            c->resync = 1;              /* 通知が溢れた (ACK・応答は失われない) */
+            return 1;
+        }
+        perror("[ERROR] Netlink recv failed");
+        return -1;
+    }
+    for (struct nlmsghdr *nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, (size_t)n);
+         nlh = NLMSG_NEXT(nlh, n)) {
+        nl_handle(c, nlh);
+    }
+    return 1;
+}
+
+/* ============================================================================
+ * 関数: nl_dump
+ * 機能: IPv4 のアドレスまたは経路をダンプし、削除要求を一括送信のバッファに追加する
+ * ============================================================================ */
+static int nl_dump(nl_ctx_t *c, int type) {
+    struct {
+        struct nlmsghdr nlh;
+        union {
+            struct ifaddrmsg ifa;
+            struct rtmsg     rtm;
+        };
+    } req;
+    size_t len = type == RTM_GETADDR ? sizeof(req.ifa) : sizeof(req.rtm);
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len = NLMSG_LENGTH(len);
+    req.nlh.nlmsg_type = type;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = ++c->seq;
+    req.ifa.ifa_family = AF_INET;       /* ifa_family と rtm_family は同じ位置 */
+
+    c->dump_seq = req.nlh.nlmsg_seq;
+    c->dump_done = 0;
+    if (send(c->fd, &req, req.nlh.nlmsg_len, 0) < 0) {
+        perror("[ERROR] Netlink send failed");
+        return -1;
+    }
+    while (c->dump_done == 0) {
+        if (nl_receive(c, ACK_TIMEOUT_MS) <= 0) {
+            fprintf(stderr, "[ERROR] Netlink dump did not complete\n");
+            return -1;
+        }
+    }
+    c->dump_seq = 0;
+    return c->dump_done > 0 ? 0 : -1;
+}
+
+/* ============================================================================
+ * 関数: nl_flush
+ * 機能: 一括送信のバッファを1回で送り、すべての ACK を待つ
+ * 戻り値: 0 = 全要求が成功, -1 = 失敗あり
+ * ============================================================================ */
+static int nl_flush(nl_ctx_t *c) {
+    int result = 0;
+    size_t len = c->len;
+
+    /* 番号は送信時に連番で付ける (ダンプ中に追加した要求も ACK と対応させる) */
+    c->first_seq = c->seq + 1;
+    for (struct nlmsghdr *nlh = (struct nlmsghdr *)c->buf; NLMSG_OK(nlh, len);
+         nlh = NLMSG_NEXT(nlh, len)) {
+        nlh->nlmsg_seq = ++c->seq;
+    }
+    if (c->len > 0 && send(c->fd, c->buf, c->len, 0) < 0) {
+        perror("[ERROR] Netlink send failed");
+        result = -1;
+    }
+    while (result == 0 && c->acked < c->acks) {
+        if (nl_receive(c, ACK_TIMEOUT_MS) <= 0) {
+            fprintf(stderr, "[ERROR] %d of %d netlink requests not acknowledged\n",
+                    c->acks - c->acked, c->acks);
+            result = -1;
+        }
+    }
+    if (c->failed > 0) {
+        result = -1;
+    }
+    c->len = 0;
+    c->count = 0;
+    c->acks = 0;
+    c->acked = 0;
+    c->failed = 0;
+    return result;
+}
+
+/* ============================================================================
+ * 関数: add_requests
+ * 機能: リンク up・アドレス追加・経路追加の要求を一括送信のバッファに追加する
+ *   (経路はアドレス追加でカーネルが作るため、通常は EEXIST になる。
+ *    スクリプトの ip route add と同じ)
+ * ============================================================================ */
+static int add_requests(nl_ctx_t *c) {
+    struct nlmsghdr *nlh;
+
+    for (int i = 0; i < IF_COUNT; i++) {
+        const if_state_t *s = &c->ifs[i];
+        struct ifinfomsg ifi = {
+            .ifi_family = AF_UNSPEC,
+            .ifi_index = s->ifindex,
+            .ifi_flags = IFF_UP,
+            .ifi_change = IFF_UP,
+        };
+
+        if (s->ifindex != 0 &&
+            nl_add(c, RTM_NEWLINK, NLM_F_ACK, &ifi, sizeof(ifi), 0,
+                   "set %s up", s->layout->name) == NULL) {
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < IF_COUNT; i++) {
+        const if_state_t *s = &c->ifs[i];
+        struct ifaddrmsg ifa = {
+            .ifa_family = AF_INET,
+            .ifa_prefixlen = s->layout->prefix,
+            .ifa_scope = RT_SCOPE_UNIVERSE,
+            .ifa_index = s->ifindex,
+        };
+
+        if (s->ifindex == 0 || s->layout->subnet == NULL) {
+            continue;
+        }
+        nlh = nl_add(c, RTM_NEWADDR, NLM_F_ACK | NLM_F_CREATE | NLM_F_EXCL, &ifa, sizeof(ifa),
+                     0, "add address to %s", s->layout->name);
+        if (nlh == NULL || nl_attr(c, nlh, IFA_LOCAL, &s->addr, sizeof(s->addr)) < 0 ||
+            nl_attr(c, nlh, IFA_ADDRESS, &s->addr, sizeof(s->addr)) < 0) {
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < IF_COUNT; i++) {
+        const if_state_t *s = &c->ifs[i];
+        struct rtmsg rtm = {
+            .rtm_family = AF_INET,
+            .rtm_dst_len = s->layout->prefix,
+            .rtm_table = RT_TABLE_MAIN,
+            .rtm_protocol = RTPROT_BOOT,
+            .rtm_scope = RT_SCOPE_LINK,
+            .rtm_type = RTN_UNICAST,
+        };
+        uint32_t oif = s->ifindex;
+
+        if (s->ifindex == 0 || s->layout->subnet == NULL) {
+            continue;
+        }
+        nlh = nl_add(c, RTM_NEWROUTE, NLM_F_ACK | NLM_F_CREATE | NLM_F_EXCL, &rtm, sizeof(rtm),
+                     EEXIST, "add route via %s", s->layout->name);
+        if (nlh == NULL || nl_attr(c, nlh, RTA_DST, &s->network, sizeof(s->network)) < 0 ||
+            nl_attr(c, nlh, RTA_OIF, &oif, sizeof(oif)) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: query_links
+ * 機能: 構成対象のリンクの現在の状態を要求する (応答は nl_handle で反映)
+ * ============================================================================ */
+static int query_links(nl_ctx_t *c) {
+    for (int i = 0; i < IF_COUNT; i++) {
+        struct ifinfomsg ifi = { .ifi_family = AF_UNSPEC, .ifi_index = c->ifs[i].ifindex };
+
+        if (ifi.ifi_index != 0 &&
+            nl_add(c, RTM_GETLINK, 0, &ifi, sizeof(ifi), 0, "get %s", c->ifs[i].layout->name) == NULL) {
+            return -1;
+        }
+    }
+    return nl_flush(c);
+}
+
+/* ============================================================================
+ * 関数: all_running
+ * 機能: 構成対象のリンクがすべて IFF_RUNNING か確認する
+ * ============================================================================ */
+static int all_running(const nl_ctx_t *c) {
+    for (int i = 0; i < IF_COUNT; i++) {
+        if (c->ifs[i].ifindex != 0 && !c->ifs[i].running) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* ============================================================================
+ * 関数: main
+ * 機能: 既存のアドレス・経路を削除し、構成を1回の送信で設定してリンクを待つ
+ * ============================================================================ */
+int main(int argc, char *argv[]) {
+    struct sockaddr_nl local = { .nl_family = AF_NETLINK, .nl_groups = RTMGRP_LINK };
+    int rcvbuf = NL_RCVBUF;
+    int wait_ms = DEFAULT_WAIT_MS;
+    int no_wait = 0;
+    const char *label;
+    int host;
+    double start, configured, elapsed;
+    int c;
+
+    while ((c = getopt(argc, argv, "t:nh")) != -1) {
+        switch (c) {
+        case 't':
+            wait_ms = atoi(optarg);
+            if (wait_ms <= 0) {
+                fprintf(stderr, "[ERROR] Invalid wait time: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'n':
+            no_wait = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-t wait_ms] [-n] bridge|client\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-t wait_ms] [-n] bridge|client\n", argv[0]);
+        return 1;
+    }
+    if (strcmp(argv[optind], "bridge") == 0) {
+        label = "ABOS1";
+        host = 1;
+    } else if (strcmp(argv[optind], "client") == 0) {
+        label = "ABOS2";
+        host = 2;
+    } else {
+        fprintf(stderr, "[ERROR] Unknown role: %s (bridge or client)\n", argv[optind]);
+        return 1;
+    }
+
+    /* インターフェース番号とアドレス (eth2 は無くても続ける) */
+    for (int i = 0; i < IF_COUNT; i++) {
+        if_state_t *s = &ctx.ifs[i];
+        char text[INET_ADDRSTRLEN + 8];
+
+        s->layout = &layout[i];
+        s->ifindex = if_nametoindex(layout[i].name);
+        if (s->ifindex == 0) {
+            if (layout[i].subnet != NULL) {
+                fprintf(stderr, "[ERROR] Interface %s not found\n", layout[i].name);
+                return 1;
+            }
+            fprintf(stderr, "[WARN] Interface %s not found, skipped\n", layout[i].name);
+            continue;
+        }
+        if (layout[i].subnet != NULL) {
+            snprintf(text, sizeof(text), "%s.%d", layout[i].subnet, host);
+            inet_pton(AF_INET, text, &s->addr);
+            snprintf(text, sizeof(text), "%s.0", layout[i].subnet);
+            inet_pton(AF_INET, text, &s->network);
+        }
+    }
+
+    /* リンクの通知は設定の前から受ける (取りこぼさない) */
+    ctx.fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (ctx.fd < 0) {
+        perror("[ERROR] Netlink socket creation failed");
+        return 1;
+    }
+    setsockopt(ctx.fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (bind(ctx.fd, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        perror("[ERROR] Netlink bind failed");
+        close(ctx.fd);
+        return 1;
+    }
+
+    start = now_ms();
+    if (nl_dump(&ctx, RTM_GETROUTE) < 0 || nl_dump(&ctx, RTM_GETADDR) < 0 ||
+        add_requests(&ctx) < 0) {
+        close(ctx.fd);
+        return 1;
+    }
+    printf("[INFO] Sending %d netlink requests in one batch\n", ctx.count);
+    if (nl_flush(&ctx) < 0) {
+        close(ctx.fd);
+        return 1;
+    }
+    configured = now_ms();
+    printf("[INFO] Addresses and routes configured in %.1f ms\n", configured - start);
+
+    if (!no_wait) {
+        if (query_links(&ctx) < 0) {
+            close(ctx.fd);
+            return 1;
+        }
+        while (!all_running(&ctx)) {
+            int remain = (int)(configured + wait_ms - now_ms());
+
+            if (remain <= 0 || nl_receive(&ctx, remain) <= 0) {
+                break;
+            }
+            if (ctx.resync) {
+                ctx.resync = 0;
+                if (query_links(&ctx) < 0) {
+                    break;
+                }
+            }
+        }
+        elapsed = now_ms() - start;
+        if (!all_running(&ctx)) {
+            for (int i = 0; i < IF_COUNT; i++) {
+                if (ctx.ifs[i].ifindex != 0 && !ctx.ifs[i].running) {
+                    fprintf(stderr, "[WARN] %s has no carrier after %.0f ms\n",
+                            layout[i].name, elapsed);
+                }
+            }
+            close(ctx.fd);
+            return 2;
+        }
+        printf("[INFO] All links running after %.1f ms\n", elapsed);
+    }
+    close(ctx.fd);
+
+    printf("%s: eth0=%s.%d/24, eth1=%s.%d/24, eth2=auto\n", label,
+           layout[0].subnet, host, layout[1].subnet, host);
+    return 0;
+}
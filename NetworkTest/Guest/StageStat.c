@@ -0,0 +1,407 @@
+/*
+ * ============================================================================
+ * StageStat.c - Stage Probe Viewer
+ * ============================================================================
+ * 機能:
+ *   - Bridge_C / Client_C / ElsgwReceiver を -T で起動した場合の共有メモリ
+ *     (stage_probe.h) を読み出し、段階ごとの所要時間とカウンタを表示する
+ *   - 対象のプロセスには何も要求しない (読み出しのみ, ロックなし)
+ *   - 定期表示では前回からの差分で件数/秒と p50/p99/p99.9 を求める
+ *   - 終了したプロセスの残した共有メモリの削除 (-c)
+ *
+ * 使い方:
+ *   ./StageStat                       共有メモリの一覧
+ *   ./StageStat [-i 間隔ms] [-n 回数] [-1] 対象
+ *   ./StageStat -c                    終了したプロセスの共有メモリを削除
+ *     対象 プログラム名 (例: Bridge_C)・pid・ファイルのパス
+ *          (省略時は実行中のものが1個だけならそれを使う)
+ *     -i   表示間隔 (ミリ秒, 既定: 1000)
+ *     -n   表示回数 (既定: 0 = 対象の終了まで)
+ *     -1   起動からの累計を1回表示して終了する
+ *
+ * ビルド:
+ *   gcc -O2 -Wall -o StageStat StageStat.c
+ * ============================================================================
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "stage_probe.h"
+
+/* ============================================================================
+ * 表示設定
+ * ============================================================================ */
+#define DEFAULT_INTERVAL_MS     1000    /* 表示間隔 (既定, ms) */
+
+/* ============================================================================
+ * 1スロット分の読み出し結果
+ * ============================================================================ */
+typedef struct {
+    int          in_use;                /* 0 = 初期化中 (表示しない) */
+    uint64_t     counters[STAGE_COUNTER_MAX];
+    stage_hist_t stages[STAGE_MAX];
+} slot_snapshot_t;
+
+volatile sig_atomic_t g_running = 1;
+
+/* ============================================================================
+ * 関数: handle_signal
+ * 機能: SIGINT/SIGTERM で表示ループを終了する
+ * ============================================================================ */
+void handle_signal(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+/* ============================================================================
+ * 関数: process_alive
+ * 機能: 共有メモリを作成したプロセスが実行中か確認する
+ * ============================================================================ */
+int process_alive(int pid) {
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+/* ============================================================================
+ * 関数: open_segment
+ * 機能: 共有メモリを読み出し専用で開き、形式を確認する
+ * 戻り値: 共有メモリ (NULL = 開けない・形式が違う)
+ * ============================================================================ */
+const stage_shm_t *open_segment(const char *path) {
+    const stage_shm_t *shm;
+    struct stat st;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size != sizeof(stage_shm_t)) {
+        close(fd);
+        return NULL;
+    }
+    shm = mmap(NULL, sizeof(stage_shm_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        return NULL;
+    }
+    if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != STAGE_MAGIC ||
+        shm->version != STAGE_VERSION) {
+        munmap((void *)shm, sizeof(stage_shm_t));
+        return NULL;
+    }
+    return shm;
+}
+
+/* ============================================================================
+ * 関数: list_segments
+ * 機能: 共有メモリを一覧表示する。target が指定されれば一致するもののパスを返す
+ * 引数:
+ *   target - プログラム名または pid (NULL = 一覧のみ)
+ *   clean  - 1 = 終了したプロセスの共有メモリを削除する
+ *   found  - 一致した (target なしの場合は実行中の) パスの格納先
+ * 戻り値: 一致した数
+ * ============================================================================ */
+int list_segments(const char *target, int clean, char *found, size_t found_size) {
+    const stage_shm_t *shm;
+    struct dirent *de;
+    char path[512];
+    int matches = 0;
+    int alive;
+    DIR *dir;
+
+    dir = opendir(STAGE_SHM_DIR);
+    if (dir == NULL) {
+        perror("[ERROR] Failed to open " STAGE_SHM_DIR);
+        return 0;
+    }
+    while ((de = readdir(dir)) != NULL) {
+        if (strncmp(de->d_name, STAGE_SHM_PREFIX, strlen(STAGE_SHM_PREFIX)) != 0) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", STAGE_SHM_DIR, de->d_name);
+        shm = open_segment(path);
+        if (shm == NULL) {
+            continue;
+        }
+        alive = process_alive(shm->pid);
+
+        if (clean) {
+            if (!alive) {
+                printf("[INFO] Removing %s (pid %d exited)\n", path, shm->pid);
+                unlink(path);
+            }
+        } else if (target == NULL) {
+            printf("  %-10s pid %-7d %2u threads  %-8s %s\n", shm->program, shm->pid,
+                   shm->thread_count, alive ? "running" : "exited", path);
+            if (alive) {
+                snprintf(found, found_size, "%s", path);
+                matches++;
+            }
+        } else if (strcmp(shm->program, target) == 0 || atoi(target) == shm->pid) {
+            snprintf(found, found_size, "%s", path);
+            matches++;
+        }
+        munmap((void *)shm, sizeof(stage_shm_t));
+    }
+    closedir(dir);
+    return matches;
+}
+
+/* ============================================================================
+ * 関数: read_slot
+ * 機能: スロットの値を1個ずつ読み出す (書き込み中のスロットも読める)
+ *   初期化中のスロット (in_use が 0) は読まない
+ * ============================================================================ */
+void read_slot(const stage_slot_t *slot, slot_snapshot_t *snap) {
+    snap->in_use = __atomic_load_n(&slot->in_use, __ATOMIC_ACQUIRE) != 0;
+    if (!snap->in_use) {
+        return;
+    }
+    for (int i = 0; i < STAGE_COUNTER_MAX; i++) {
+        snap->counters[i] = __atomic_load_n(&slot->counters[i], __ATOMIC_RELAXED);
+    }
+    for (int s = 0; s < STAGE_MAX; s++) {
+        const stage_hist_t *h = &slot->stages[s];
+
+        snap->stages[s].count = __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+        snap->stages[s].sum_ns = __atomic_load_n(&h->sum_ns, __ATOMIC_RELAXED);
+        snap->stages[s].max_ns = __atomic_load_n(&h->max_ns, __ATOMIC_RELAXED);
+        for (int b = 0; b < STAGE_HIST_BUCKETS; b++) {
+            snap->stages[s].buckets[b] = __atomic_load_n(&h->buckets[b], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/* ============================================================================
+ * 関数: hist_percentile
+ * 機能: ヒストグラムのパーセンタイル値を求める (該当バケットの上限, 最大値を超えない, ns)
+ * ============================================================================ */
+uint64_t hist_percentile(const stage_hist_t *h, uint64_t count, double p) {
+    uint64_t rank = (uint64_t)(p / 100.0 * (double)count + 0.5);
+    uint64_t seen = 0;
+
+    if (count == 0) {
+        return 0;
+    }
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (int b = 0; b < STAGE_HIST_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen >= rank) {
+            return stage_hist_upper(b) < h->max_ns ? stage_hist_upper(b) : h->max_ns;
+        }
+    }
+    return h->max_ns;
+}
+
+/* ============================================================================
+ * 関数: print_snapshot
+ * 機能: 全スロットの段階・カウンタを表示する
+ *   prev があれば前回からの差分 (件数/秒・パーセンタイル)、なければ累計
+ * ============================================================================ */
+void print_snapshot(const stage_shm_t *shm, const slot_snapshot_t *cur,
+                    const slot_snapshot_t *prev, double secs, int threads) {
+    stage_hist_t d;
+    uint64_t count;
+
+    printf("%-10s %-22s %12s %10s %10s %10s %10s %10s %10s\n", "thread", "stage",
+           "count", prev != NULL ? "/s" : "", "avg us", "p50 us", "p99 us",
+           "p99.9 us", "max us");
+    for (int t = 0; t < threads; t++) {
+        if (!cur[t].in_use) {
+            continue;
+        }
+        for (uint32_t s = 0; s < shm->stage_count; s++) {
+            const stage_hist_t *c = &cur[t].stages[s];
+
+            /* 差分のヒストグラム (累計表示では全体) */
+            d.count = c->count - (prev != NULL ? prev[t].stages[s].count : 0);
+            d.sum_ns = c->sum_ns - (prev != NULL ? prev[t].stages[s].sum_ns : 0);
+            for (int b = 0; b < STAGE_HIST_BUCKETS; b++) {
+                d.buckets[b] = c->buckets[b] -
+                               (prev != NULL ? prev[t].stages[s].buckets[b] : 0);
+            }
+            d.max_ns = c->max_ns;
+            count = 0;
+            for (int b = 0; b < STAGE_HIST_BUCKETS; b++) {
+                count += d.buckets[b];
+            }
+            if (c->count == 0) {
+                continue;
+            }
+
+            printf("%-10s %-22s %12llu ", shm->slots[t].name, shm->stage_names[s],
+                   (unsigned long long)c->count);
+            if (prev != NULL) {
+                printf("%10.0f ", d.count / secs);
+            } else {
+                printf("%10s ", "");
+            }
+            if (count == 0) {
+                printf("%10s %10s %10s %10s %10.1f\n", "-", "-", "-", "-", c->max_ns / 1e3);
+                continue;
+            }
+            printf("%10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                   d.count > 0 ? d.sum_ns / 1e3 / d.count : 0.0,
+                   hist_percentile(&d, count, 50) / 1e3,
+                   hist_percentile(&d, count, 99) / 1e3,
+                   hist_percentile(&d, count, 99.9) / 1e3, c->max_ns / 1e3);
+        }
+    }
+
+    if (shm->counter_count == 0) {
+        return;
+    }
+    printf("%-10s %-22s %12s %10s\n", "thread", "counter", "value", prev != NULL ? "/s" : "");
+    for (int t = 0; t < threads; t++) {
+        if (!cur[t].in_use) {
+            continue;
+        }
+        for (uint32_t i = 0; i < shm->counter_count; i++) {
+            printf("%-10s %-22s %12llu ", shm->slots[t].name, shm->counter_names[i],
+                   (unsigned long long)cur[t].counters[i]);
+            if (prev != NULL) {
+                printf("%10.0f", (cur[t].counters[i] - prev[t].counters[i]) / secs);
+            }
+            printf("\n");
+        }
+    }
+}
+
+/* ============================================================================
+ * 関数: main
+ * 機能: 対象の共有メモリを開き、定期的に (または1回) 表示する
+ * ============================================================================ */
+int main(int argc, char *argv[]) {
+    static slot_snapshot_t snaps[2][STAGE_THREAD_MAX];
+    const stage_shm_t *shm;
+    const char *target = NULL;
+    char path[512] = "";
+    int interval_ms = DEFAULT_INTERVAL_MS;
+    unsigned long limit = 0;
+    int once = 0;
+    int clean = 0;
+    int threads;
+    int cur = 0;
+    long long last, now;
+    int c;
+
+    while ((c = getopt(argc, argv, "i:n:1ch")) != -1) {
+        switch (c) {
+        case 'i':
+            interval_ms = atoi(optarg);
+            if (interval_ms <= 0) {
+                fprintf(stderr, "[ERROR] Invalid interval: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'n':
+            limit = strtoul(optarg, NULL, 10);
+            break;
+        case '1':
+            once = 1;
+            break;
+        case 'c':
+            clean = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-i interval_ms] [-n count] [-1] [program|pid|path]\n"
+                    "       %s -c\n", argv[0], argv[0]);
+            return 1;
+        }
+    }
+    if (optind < argc) {
+        target = argv[optind];
+    }
+
+    if (clean) {
+        list_segments(NULL, 1, path, sizeof(path));
+        return 0;
+    }
+
+    /* 対象の決定 (パス, プログラム名・pid, 実行中の1個) */
+    if (target != NULL && strchr(target, '/') != NULL) {
+        snprintf(path, sizeof(path), "%s", target);
+    } else if (target != NULL) {
+        if (list_segments(target, 0, path, sizeof(path)) == 0) {
+            fprintf(stderr, "[ERROR] No stage probes found for %s\n", target);
+            return 1;
+        }
+    } else {
+        printf("[INFO] Stage probe segments in %s:\n", STAGE_SHM_DIR);
+        if (list_segments(NULL, 0, path, sizeof(path)) != 1) {
+            return 0;                   /* 一覧のみ (対象を指定する) */
+        }
+    }
+
+    shm = open_segment(path);
+    if (shm == NULL) {
+        fprintf(stderr, "[ERROR] Failed to open stage probes: %s\n", path);
+        return 1;
+    }
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    threads = (int)__atomic_load_n(&shm->thread_count, __ATOMIC_ACQUIRE);
+    threads = threads < STAGE_THREAD_MAX ? threads : STAGE_THREAD_MAX;
+    for (int t = 0; t < threads; t++) {
+        read_slot(&shm->slots[t], &snaps[cur][t]);
+    }
+    last = stage_now();
+
+    if (once) {
+        printf("============================================================\n");
+        printf("  %s (pid %d): totals over %.1f s\n", shm->program, shm->pid,
+               (last - shm->started_ns) / 1e9);
+        printf("============================================================\n");
+        print_snapshot(shm, snaps[cur], NULL, 0, threads);
+        return 0;
+    }
+
+    for (unsigned long n = 0; g_running && (limit == 0 || n < limit); n++) {
+        usleep((useconds_t)interval_ms * 1000);
+        if (!g_running) {
+            break;
+        }
+        now = stage_now();
+
+        /* 後から登録・初期化されたスロットは今回から表示する */
+        c = (int)__atomic_load_n(&shm->thread_count, __ATOMIC_ACQUIRE);
+        c = c < STAGE_THREAD_MAX ? c : STAGE_THREAD_MAX;
+        for (int t = 0; t < c; t++) {
+            read_slot(&shm->slots[t], &snaps[!cur][t]);
+            if (t >= threads || !snaps[cur][t].in_use) {
+                snaps[cur][t] = snaps[!cur][t];
+            }
+        }
+        threads = c;
+        cur = !cur;
+
+        printf("[STATS] %s (pid %d), %.1f s\n", shm->program, shm->pid,
+               (now - shm->started_ns) / 1e9);
+        print_snapshot(shm, snaps[cur], snaps[!cur], (now - last) / 1e9, threads);
+        printf("\n");
+        fflush(stdout);
+        last = now;
+
+        if (!process_alive(shm->pid)) {
+            printf("[INFO] %s (pid %d) exited\n", shm->program, shm->pid);
+            break;
+        }
+    }
+
+    munmap((void *)shm, sizeof(stage_shm_t));
+    return 0;
+}
@@ -0,0 +1,929 @@
+/*
+ * ============================================================================
+ * async_log.h - Asynchronous Binary Logger (Deferred Formatting)
+ * ============================================================================
+ * 機能:
+ *   - ログ1件の記録は「書式ID + 引数の生の値」をスレッドごとのリングへ
+ *     書き込むのみ (書式の整形・コンソールへの出力は呼び出し側で行わない)
+ *   - バックグラウンドスレッドがリングから取り出し、まとめて出力する
+ *       テキスト出力 (既定): 整形して標準出力へ write() でまとめて書く
+ *       バイナリ出力       : 整形せずにファイルへ書き、LogDecode で後から表示する
+ *   - ログレベル (ERROR/WARN/INFO/DEBUG) による抑止 (比較1回のみ)
+ *   - 呼び出し箇所ごとの流量制限 (1秒あたりの件数、超えた分は件数のみ報告)
+ *   - リングが一杯の場合は待たずに破棄し、件数を報告する
+ *   - 16進ダンプ付きのログ (ALOG_DUMP): データのコピーのみ記録し、
+ *     ダンプの整形 (EvalEnv/hex_dump.c の hex_dump_format) はバックグラウンドで行う
+ *     (ALOG_DUMP を使うプログラムは async_log.h より前に hex_dump.h を
+ *      include し、hex_dump.c をリンクする)
+ *
+ * 使い方:
+ *   alog_start("Bridge_C", NULL);           // NULL = 標準出力へテキスト出力
+ *   alog_start("Bridge_C", "bridge.alog");  // バイナリ出力 (LogDecode で表示)
+ *   ALOG_INFO("[RECV] Message from %s: %s\n", ip, message);
+ *   ALOG_DUMP(ALOG_LEVEL_INFO, data, len, "[RECV] Size: %zu bytes\n", len);
+ *   alog_stop();                            // 残りを出力して終了
+ *   (alog_start 前・alog_stop 後の ALOG_* は printf と同じく即時に出力する)
+ *
+ * 環境変数 (alog_start で読む):
+ *   ABOS_LOG_LEVEL  出力するレベル (error / warn / info (既定) / debug)
+ *   ABOS_LOG_RATE   呼び出し箇所ごとの1秒あたりの上限 (既定: 0 = 制限なし)
+ *
+ * 引数の型:
+ *   書式の変換指定 (%d %ld %llu %zu %f %c %p %s %.*s 等) から型を決め、
+ *   数値は8バイト、文字列は長さ + 内容 (ALOG_STR_MAX まで) をコピーする。
+ *   %n・%m とワイド文字には対応しない。書式は printf と同じく検査される。
+ *
+ * 注意:
+ *   出力はバックグラウンドで ALOG_FLUSH_MS ごとに行うため、シグナル等で
+ *   強制終了した場合は最後の ALOG_FLUSH_MS 程度のログが失われる。
+ *   スレッドをまたいだ出力順は記録順と一致しない (スレッド内の順序は保つ。
+ *   バイナリ出力は時刻を持つため、LogDecode -s で時刻順に並べ替えられる)。
+ * ============================================================================
+ */
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/* ============================================================================
+ * ログ設定
+ * ============================================================================ */
+#define ALOG_RING_SIZE          (1 << 20)       /* スレッドごとのリング (バイト, 2のべき乗) */
+#define ALOG_THREAD_MAX         128             /* ログを書くスレッド数の上限 */
+#define ALOG_SITE_MAX           1024            /* 呼び出し箇所の数の上限 */
+#define ALOG_ARG_MAX            16              /* 1件の引数の数の上限 */
+#define ALOG_STR_MAX            1024            /* 文字列引数1個の最大長 (超えた分は切り捨て) */
+#define ALOG_DUMP_MAX           (16 * 1024)     /* ダンプするデータの最大長 */
+#define ALOG_FLUSH_MS           5               /* バックグラウンドの出力間隔 (ms) */
+#define ALOG_OUT_SIZE           (256 * 1024)    /* まとめて書き込む出力バッファ */
+#define ALOG_OUT_FLUSH          (ALOG_OUT_SIZE / 2) /* 途中で書き込む量 (1件の整形結果より大きく) */
+#define ALOG_FILE_MAGIC         "ABOSLOG1"      /* バイナリ出力のファイル先頭 */
+#define ALOG_FILE_VERSION       1
+
+/* ログレベル (小さいほど重要) */
+#define ALOG_LEVEL_ERROR        0
+#define ALOG_LEVEL_WARN         1
+#define ALOG_LEVEL_INFO         2
+#define ALOG_LEVEL_DEBUG        3
+
+/* 記録の種別 (alog_rec_t.site。1 以上 ALOG_SITE_MAX 以下は呼び出し箇所の番号) */
+#define ALOG_SITE_PAD           0               /* リング末尾の詰め物 */
+#define ALOG_SITE_DEF           0xffffffffu     /* 呼び出し箇所の定義 (バイナリ出力) */
+
+/* 引数の型 */
+enum {
+    ALOG_T_INT,                         /* int 以下の整数 (%d %c %hd, 幅の '*' 等) */
+    ALOG_T_PREC,                        /* 精度の '*' (int, 直後の %.*s の長さにも使う) */
+    ALOG_T_LONG,                        /* long (%ld) */
+    ALOG_T_LLONG,                       /* long long (%lld), intmax_t (%jd) */
+    ALOG_T_SIZE,                        /* size_t (%zu), ptrdiff_t (%td) */
+    ALOG_T_DOUBLE,                      /* double (%f %e %g %a) */
+    ALOG_T_LDOUBLE,                     /* long double (%Lf, double に変換して記録) */
+    ALOG_T_PTR,                         /* ポインタ (%p) */
+    ALOG_T_STR,                         /* 文字列 (%s, 内容をコピー) */
+};
+
+/* ============================================================================
+ * 記録1件の先頭 (リング・バイナリ出力で共通。全体を8バイト境界に揃える)
+ *   後ろに引数 (数値: 8バイト, 文字列: 長さ4バイト + 内容 + 詰め物) が続き、
+ *   ダンプ付きの場合は最後にダンプするデータ (長さ + 内容) が続く
+ * ============================================================================ */
+typedef struct {
+    uint32_t site;                      /* 呼び出し箇所の番号 (ALOG_SITE_*) */
+    uint32_t size;                      /* 記録全体のバイト数 */
+    int64_t  time_ns;                   /* 記録した時刻 (CLOCK_REALTIME, ns) */
+} alog_rec_t;
+
+/* バイナリ出力のファイル先頭 */
+typedef struct {
+    char     magic[8];                  /* ALOG_FILE_MAGIC */
+    uint32_t version;
+    int32_t  pid;
+    char     program[32];
+    int64_t  started_ns;                /* 出力開始時刻 (CLOCK_REALTIME, ns) */
+} alog_file_header_t;
+
+/* ============================================================================
+ * 呼び出し箇所 (ALOG マクロごとの static 変数。初回の記録時に番号を振る)
+ * ============================================================================ */
+typedef struct {
+    uint32_t    id;                     /* 番号 (0 = 未登録) */
+    int         level;
+    int         dump;                   /* 1 = 最後にダンプするデータを持つ */
+    const char *fmt;
+    int         nargs;
+    uint8_t     types[ALOG_ARG_MAX];
+    int64_t     rate_window;            /* 流量制限の区間 (秒) */
+    uint32_t    rate_count;             /* 区間内の件数 */
+    uint32_t    suppressed;             /* 流量制限で破棄した件数 (未報告分) */
+} alog_site_t;
+
+/* ============================================================================
+ * スレッドごとのリング (書き込みはそのスレッド、読み出しはバックグラウンド)
+ *   head / tail は通算のバイト位置 (リング内の位置は & (ALOG_RING_SIZE - 1))
+ * ============================================================================ */
+typedef struct {
+    uint64_t tail __attribute__((aligned(64)));    /* 書き込み位置 */
+    uint64_t dropped;                   /* リングが一杯で破棄した件数 */
+    uint64_t head __attribute__((aligned(64)));    /* 読み出し位置 */
+    uint64_t reported;                  /* 報告済みの破棄件数 */
+    unsigned char data[ALOG_RING_SIZE] __attribute__((aligned(64)));
+} alog_ring_t;
+
+/* ============================================================================
+ * ロガー全体
+ * ============================================================================ */
+typedef struct {
+    int              level;             /* 出力するレベル (これ以下) */
+    uint32_t         rate_limit;        /* 呼び出し箇所ごとの1秒あたりの上限 (0 = なし) */
+    int              running;           /* 1 = バックグラウンドで出力中 */
+    int              stopping;
+    int              fd;                /* 出力先 */
+    int              binary;            /* 1 = バイナリ出力 */
+    pthread_t        thread;
+    pthread_mutex_t  lock;              /* 呼び出し箇所・リングの登録 */
+    alog_site_t     *sites[ALOG_SITE_MAX + 1];
+    uint32_t         site_count;
+    uint32_t         sites_written;     /* バイナリ出力で定義を書いた番号 */
+    alog_ring_t     *rings[ALOG_THREAD_MAX];
+    uint32_t         ring_count;
+    char            *out;               /* 出力バッファ */
+    size_t           out_len;
+} alog_t;
+
+static alog_t g_alog = {
+    .level = ALOG_LEVEL_INFO,
+    .fd = STDOUT_FILENO,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+static __thread alog_ring_t *g_alog_ring;
+
+/* ============================================================================
+ * マクロ: ALOG / ALOG_DUMP
+ * 機能: ログを1件記録する (レベルが出力対象外なら比較1回のみ)
+ *   ALOG_DUMP は書式を整形した後ろに data の16進ダンプを続ける
+ * ============================================================================ */
+#define ALOG(lvl, ...) do {                                                  \
+        static alog_site_t alog_site_ = { .level = (lvl) };                  \
+        if ((lvl) <= g_alog.level) {                                         \
+            alog_write(&alog_site_, __VA_ARGS__);                            \
+        }                                                                    \
+    } while (0)
+
+#ifdef HEX_DUMP_H
+#define ALOG_DUMP(lvl, data, len, ...) do {                                  \
+        static alog_site_t alog_site_ = { .level = (lvl), .dump = 1 };       \
+        if ((lvl) <= g_alog.level) {                                         \
+            alog_write_dump(&alog_site_, (data), (len), __VA_ARGS__);        \
+        }                                                                    \
+    } while (0)
+#endif
+
+#define ALOG_ERROR(...)         ALOG(ALOG_LEVEL_ERROR, __VA_ARGS__)
+#define ALOG_WARN(...)          ALOG(ALOG_LEVEL_WARN, __VA_ARGS__)
+#define ALOG_INFO(...)          ALOG(ALOG_LEVEL_INFO, __VA_ARGS__)
+#define ALOG_DEBUG(...)         ALOG(ALOG_LEVEL_DEBUG, __VA_ARGS__)
+
+/* ============================================================================
+ * 関数: alog_now
+ * 機能: 現在時刻をナノ秒で取得する (CLOCK_REALTIME, vDSO のためシステムコールなし)
+ * ============================================================================ */
+static inline int64_t alog_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* ============================================================================
+ * 関数: alog_align
+ * 機能: バイト数を8バイト境界に切り上げる
+ * ============================================================================ */
+static inline size_t alog_align(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+/* ============================================================================
+ * 関数: alog_spec
+ * 機能: 書式の変換指定1個 ('%' の位置から) を解析する
+ * 引数:
+ *   p     - '%' の位置
+ *   stars - '*' (幅・精度を引数で指定) の格納先 (bit0 = 幅, bit1 = 精度)
+ *   type  - 引数の型 (ALOG_T_*) の格納先 (-1 = 引数なし ("%%"))
+ * 戻り値: 変換指定の長さ (0 = 対応していない変換指定)
+ * ============================================================================ */
+static inline size_t alog_spec(const char *p, int *stars, int *type) {
+    const char *s = p + 1;
+    int longs = 0, size = 0, ldouble = 0;
+
+    *stars = 0;
+    *type = -1;
+    if (*s == '%') {
+        return 2;
+    }
+    while (*s != '\0' && strchr("-+ #0'", *s) != NULL) {
+        s++;
+    }
+    if (*s == '*') {
+        *stars |= 1;
+        s++;
+    }
+    while (*s >= '0' && *s <= '9') {
+        s++;
+    }
+    if (*s == '.') {
+        s++;
+        if (*s == '*') {
+            *stars |= 2;
+            s++;
+        }
+        while (*s >= '0' && *s <= '9') {
+            s++;
+        }
+    }
+    while (*s != '\0' && strchr("hlLqjzt", *s) != NULL) {
+        if (*s == 'l' || *s == 'q' || *s == 'j') {
+            longs += *s == 'l' ? 1 : 2;
+        } else if (*s == 'z' || *s == 't') {
+            size = 1;
+        } else if (*s == 'L') {
+            ldouble = 1;
+        }
+        s++;
+    }
+    switch (*s) {
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+        *type = size ? ALOG_T_SIZE : longs >= 2 ? ALOG_T_LLONG :
+                longs == 1 ? ALOG_T_LONG : ALOG_T_INT;
+        break;
+    case 'c':
+        *type = longs == 0 ? ALOG_T_INT : -1;
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        *type = ldouble ? ALOG_T_LDOUBLE : ALOG_T_DOUBLE;
+        break;
+    case 'p':
+        *type = ALOG_T_PTR;
+        break;
+    case 's':
+        *type = longs == 0 ? ALOG_T_STR : -1;
+        break;
+    default:
+        break;
+    }
+    if (*type < 0) {
+        return 0;                       /* %n %m %ls 等 */
+    }
+    return (size_t)(s - p) + 1;
+}
+
+/* ============================================================================
+ * 関数: alog_parse
+ * 機能: 書式から引数の型の並びを求める ('*' の幅・精度は int)
+ * 戻り値: 引数の数 (-1 = 対応していない書式)
+ * ============================================================================ */
+static inline int alog_parse(const char *fmt, uint8_t *types, int max) {
+    int n = 0, stars, type;
+    size_t len;
+
+    for (const char *p = fmt; *p != '\0'; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        len = alog_spec(p, &stars, &type);
+        if (len == 0 || n + 3 > max) {
+            return -1;
+        }
+        if (stars & 1) {
+            types[n++] = ALOG_T_INT;
+        }
+        if (stars & 2) {
+            types[n++] = ALOG_T_PREC;
+        }
+        if (type >= 0) {
+            types[n++] = (uint8_t)type;
+        }
+        p += len - 1;
+    }
+    return n;
+}
+
+/* ============================================================================
+ * 関数: alog_register
+ * 機能: 呼び出し箇所に番号を振り、書式を解析する (箇所ごとに初回のみ)
+ * 戻り値: 0 = 成功, -1 = 対応していない書式・登録数の上限
+ * ============================================================================ */
+static inline int alog_register(alog_site_t *site, const char *fmt) {
+    int ret = 0;
+
+    pthread_mutex_lock(&g_alog.lock);
+    if (site->id == 0) {
+        site->fmt = fmt;
+        site->nargs = alog_parse(fmt, site->types, ALOG_ARG_MAX);
+        if (site->nargs < 0 || g_alog.site_count >= ALOG_SITE_MAX) {
+            ret = -1;
+        } else {
+            g_alog.sites[g_alog.site_count + 1] = site;
+            __atomic_store_n(&site->id, g_alog.site_count + 1, __ATOMIC_RELEASE);
+            __atomic_store_n(&g_alog.site_count, g_alog.site_count + 1, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&g_alog.lock);
+    return ret;
+}
+
+/* ============================================================================
+ * 関数: alog_thread_ring
+ * 機能: 呼び出したスレッドのリングを返す (初回はリングを確保して登録する)
+ * 戻り値: リング (NULL = 確保失敗・スレッド数の上限)
+ * ============================================================================ */
+static inline alog_ring_t *alog_thread_ring(void) {
+    alog_ring_t *ring = g_alog_ring;
+
+    if (ring != NULL) {
+        return ring;
+    }
+    pthread_mutex_lock(&g_alog.lock);
+    if (g_alog.ring_count < ALOG_THREAD_MAX &&
+        posix_memalign((void **)&ring, 64, sizeof(*ring)) == 0) {
+        memset(ring, 0, offsetof(alog_ring_t, data));
+        g_alog.rings[g_alog.ring_count] = ring;
+        __atomic_store_n(&g_alog.ring_count, g_alog.ring_count + 1, __ATOMIC_RELEASE);
+    } else {
+        ring = NULL;
+    }
+    pthread_mutex_unlock(&g_alog.lock);
+    g_alog_ring = ring;
+    return ring;
+}
+
+/* ============================================================================
+ * 関数: alog_rate_limited
+ * 機能: 呼び出し箇所の流量制限を確認する (複数スレッドの競合は概算で許す)
+ * 戻り値: 1 = 破棄する
+ * ============================================================================ */
+static inline int alog_rate_limited(alog_site_t *site, int64_t now) {
+    int64_t window = now / 1000000000LL;
+
+    if (__atomic_load_n(&site->rate_window, __ATOMIC_RELAXED) != window) {
+        __atomic_store_n(&site->rate_window, window, __ATOMIC_RELAXED);
+        __atomic_store_n(&site->rate_count, 0, __ATOMIC_RELAXED);
+    }
+    if (__atomic_add_fetch(&site->rate_count, 1, __ATOMIC_RELAXED) > g_alog.rate_limit) {
+        __atomic_add_fetch(&site->suppressed, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: alog_record
+ * 機能: 引数をリングへ書き込む (ALOG / ALOG_DUMP の本体)
+ *   1回目の走査で大きさを求め、空きがあれば2回目の走査で書き込んで公開する
+ *   リングの末尾に収まらない記録は先頭から書く (末尾は詰め物にする)
+ * ============================================================================ */
+static inline void alog_record(alog_site_t *site, const void *dump, size_t dump_len,
+                               va_list ap) {
+    const char *str[ALOG_ARG_MAX];
+    uint32_t str_len[ALOG_ARG_MAX];
+    int64_t prec = -1;
+    alog_ring_t *ring;
+    alog_rec_t *rec;
+    unsigned char *p;
+    uint64_t tail, head, pos, pad;
+    size_t size = sizeof(alog_rec_t);
+    int64_t now;
+    va_list aq;
+
+    now = alog_now();
+    if (g_alog.rate_limit > 0 && alog_rate_limited(site, now)) {
+        return;
+    }
+    ring = alog_thread_ring();
+    if (ring == NULL) {
+        return;
+    }
+
+    /* 大きさ (文字列は長さを求めて保存しておく) */
+    va_copy(aq, ap);
+    for (int i = 0; i < site->nargs; i++) {
+        switch (site->types[i]) {
+        case ALOG_T_PREC:
+            prec = va_arg(aq, int);     /* 直後が %.*s の場合の長さ */
+            size += 8;
+            continue;
+        case ALOG_T_INT:    (void)va_arg(aq, int);           size += 8; break;
+        case ALOG_T_LONG:   (void)va_arg(aq, long);          size += 8; break;
+        case ALOG_T_LLONG:  (void)va_arg(aq, long long);     size += 8; break;
+        case ALOG_T_SIZE:   (void)va_arg(aq, size_t);        size += 8; break;
+        case ALOG_T_DOUBLE: (void)va_arg(aq, double);        size += 8; break;
+        case ALOG_T_LDOUBLE: (void)va_arg(aq, long double);  size += 8; break;
+        case ALOG_T_PTR:    (void)va_arg(aq, void *);        size += 8; break;
+        case ALOG_T_STR:
+            str[i] = va_arg(aq, const char *);
+            if (str[i] == NULL) {
+                str[i] = "(null)";
+            }
+            str_len[i] = (uint32_t)strnlen(str[i], prec >= 0 && prec < ALOG_STR_MAX ?
+                                           (size_t)prec : ALOG_STR_MAX);
+            size += alog_align(4 + str_len[i]);
+            break;
+        }
+        prec = -1;
+    }
+    va_end(aq);
+    if (site->dump) {
+        dump_len = dump_len < ALOG_DUMP_MAX ? dump_len : ALOG_DUMP_MAX;
+        size += alog_align(4 + dump_len);
+    }
+
+    /* 空きの確認 (末尾に収まらない場合は詰め物の分も必要) */
+    tail = ring->tail;
+    head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    pos = tail & (ALOG_RING_SIZE - 1);
+    pad = ALOG_RING_SIZE - pos < size ? ALOG_RING_SIZE - pos : 0;
+    if (tail + pad + size - head > ALOG_RING_SIZE) {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+    if (pad >= sizeof(alog_rec_t)) {
+        rec = (alog_rec_t *)(ring->data + pos);
+        rec->site = ALOG_SITE_PAD;
+        rec->size = (uint32_t)pad;
+    }
+    tail += pad;
+
+    /* 書き込み */
+    rec = (alog_rec_t *)(ring->data + (tail & (ALOG_RING_SIZE - 1)));
+    rec->site = site->id;
+    rec->size = (uint32_t)size;
+    rec->time_ns = now;
+    p = (unsigned char *)(rec + 1);
+    for (int i = 0; i < site->nargs; i++) {
+        union { int64_t i; uint64_t u; double d; const void *ptr; } v = { 0 };
+
+        switch (site->types[i]) {
+        case ALOG_T_INT:
+        case ALOG_T_PREC:    v.i = va_arg(ap, int);                  break;
+        case ALOG_T_LONG:    v.i = va_arg(ap, long);                 break;
+        case ALOG_T_LLONG:   v.i = va_arg(ap, long long);            break;
+        case ALOG_T_SIZE:    v.u = va_arg(ap, size_t);               break;
+        case ALOG_T_DOUBLE:  v.d = va_arg(ap, double);               break;
+        case ALOG_T_LDOUBLE: v.d = (double)va_arg(ap, long double);  break;
+        case ALOG_T_PTR:     v.ptr = va_arg(ap, void *);             break;
+        case ALOG_T_STR:
+            (void)va_arg(ap, const char *);
+            memcpy(p, &str_len[i], 4);
+            memcpy(p + 4, str[i], str_len[i]);
+            p += alog_align(4 + str_len[i]);
+            continue;
+        }
+        memcpy(p, &v, 8);
+        p += 8;
+    }
+    if (site->dump) {
+        uint32_t n = (uint32_t)dump_len;
+
+        memcpy(p, &n, 4);
+        memcpy(p + 4, dump, n);
+    }
+    __atomic_store_n(&ring->tail, tail + size, __ATOMIC_RELEASE);
+}
+
+#ifdef HEX_DUMP_H
+/* ============================================================================
+ * 関数: alog_hex_dump
+ * 機能: データの16進ダンプと ASCII 表示を hex_dump_format() で整形し、
+ *       fwrite() 1回で書く (ログスレッド、または開始前・終了後の即時出力)
+ * 引数:
+ *   buf - 整形先 (HEX_DUMP_MAX_SIZE(len) バイト以上, 呼び出し側が用意する)
+ * ============================================================================ */
+static inline void alog_hex_dump(FILE *out, char *buf, const unsigned char *data,
+                                 size_t len) {
+    fwrite(buf, 1, hex_dump_format(buf, data, len), out);
+}
+#endif
+
+/* ============================================================================
+ * 関数: alog_write / alog_write_dump
+ * 機能: ログを1件記録する (ALOG / ALOG_DUMP マクロから呼ぶ)
+ *   バックグラウンドの出力を開始していない場合は標準出力へ即時に書く
+ * ============================================================================ */
+static inline __attribute__((format(printf, 2, 3)))
+void alog_write(alog_site_t *site, const char *fmt, ...) {
+    va_list ap;
+
+    va_start(ap, fmt);
+    if (!__atomic_load_n(&g_alog.running, __ATOMIC_ACQUIRE)) {
+        vprintf(fmt, ap);
+    } else if (__atomic_load_n(&site->id, __ATOMIC_ACQUIRE) != 0 ||
+               alog_register(site, fmt) == 0) {
+        alog_record(site, NULL, 0, ap);
+    }
+    va_end(ap);
+}
+
+#ifdef HEX_DUMP_H
+static inline __attribute__((format(printf, 4, 5)))
+void alog_write_dump(alog_site_t *site, const void *data, size_t len, const char *fmt, ...) {
+    va_list ap;
+
+    va_start(ap, fmt);
+    if (!__atomic_load_n(&g_alog.running, __ATOMIC_ACQUIRE)) {
+        /* 即時出力は複数スレッドから同時に呼ばれうるため、呼び出しごとに確保する */
+        char *buf;
+
+        len = len < ALOG_DUMP_MAX ? len : ALOG_DUMP_MAX;
+        buf = malloc(HEX_DUMP_MAX_SIZE(len));
+        vprintf(fmt, ap);
+        if (buf != NULL) {
+            alog_hex_dump(stdout, buf, data, len);
+            free(buf);
+        }
+    } else if (__atomic_load_n(&site->id, __ATOMIC_ACQUIRE) != 0 ||
+               alog_register(site, fmt) == 0) {
+        alog_record(site, data, len, ap);
+    }
+    va_end(ap);
+}
+#endif
+
+/* ============================================================================
+ * 関数: alog_format
+ * 機能: 記録1件を書式に従って整形し、out へ書く (バックグラウンド・LogDecode 共通)
+ *   変換指定ごとに記録した値を取り出して snprintf で整形する
+ *   整形用の静的バッファを使うため、呼び出すのは1スレッドのみとする
+ *   (ログスレッド、または LogDecode)
+ * 引数:
+ *   fmt  - 呼び出し箇所の書式
+ *   dump - 1 = 最後のダンプするデータを16進ダンプで続ける
+ *   args - 記録の引数部分, len - そのバイト数
+ * 戻り値: 0 = 成功, -1 = 記録が壊れている
+ * ============================================================================ */
+static inline int alog_format(FILE *out, const char *fmt, int dump,
+                              const unsigned char *args, size_t len) {
+    static char str[ALOG_STR_MAX + 1];
+#ifdef HEX_DUMP_H
+    static char dump_buf[HEX_DUMP_MAX_SIZE(ALOG_DUMP_MAX)];
+#endif
+    const unsigned char *end = args + len;
+    char spec[64];
+    int star[2];
+    int stars, type, nstar;
+    size_t n;
+    uint32_t slen;
+
+    for (const char *p = fmt; *p != '\0'; p++) {
+        if (*p != '%') {
+            fputc(*p, out);
+            continue;
+        }
+        n = alog_spec(p, &stars, &type);
+        if (n == 0 || n >= sizeof(spec)) {
+            return -1;
+        }
+        if (type < 0) {
+            fputc('%', out);
+            p++;
+            continue;
+        }
+        memcpy(spec, p, n);
+        spec[n] = '\0';
+        p += n - 1;
+
+        for (nstar = 0; nstar < (stars & 1) + (stars >> 1); nstar++) {
+            int64_t v;
+
+            if (args + 8 > end) {
+                return -1;
+            }
+            memcpy(&v, args, 8);
+            star[nstar] = (int)v;
+            args += 8;
+        }
+
+#define ALOG_PRINT(value) do {                                                   \
+            if (nstar == 0) fprintf(out, spec, value);                         \
+            else if (nstar == 1) fprintf(out, spec, star[0], value);           \
+            else fprintf(out, spec, star[0], star[1], value);                  \
+        } while (0)
+
+        if (type == ALOG_T_STR) {
+            if (args + 4 > end) {
+                return -1;
+            }
+            memcpy(&slen, args, 4);
+            if (slen > ALOG_STR_MAX || args + alog_align(4 + slen) > end) {
+                return -1;
+            }
+            memcpy(str, args + 4, slen);
+            str[slen] = '\0';
+            args += alog_align(4 + slen);
+            ALOG_PRINT(str);
+            continue;
+        }
+
+        union { int64_t i; uint64_t u; double d; void *ptr; } v;
+        char conv = spec[n - 1];
+        int is_unsigned = strchr("uxXo", conv) != NULL;
+
+        if (args + 8 > end) {
+            return -1;
+        }
+        memcpy(&v, args, 8);
+        args += 8;
+        switch (type) {
+        case ALOG_T_INT:
+            if (is_unsigned) ALOG_PRINT((unsigned int)v.i);
+            else ALOG_PRINT((int)v.i);
+            break;
+        case ALOG_T_LONG:
+            if (is_unsigned) ALOG_PRINT((unsigned long)v.i);
+            else ALOG_PRINT((long)v.i);
+            break;
+        case ALOG_T_LLONG:
+            if (is_unsigned) ALOG_PRINT((unsigned long long)v.i);
+            else ALOG_PRINT((long long)v.i);
+            break;
+        case ALOG_T_SIZE:
+            if (is_unsigned) ALOG_PRINT((size_t)v.u);
+            else ALOG_PRINT((ssize_t)v.i);
+            break;
+        case ALOG_T_DOUBLE:
+            ALOG_PRINT(v.d);
+            break;
+        case ALOG_T_LDOUBLE:
+            ALOG_PRINT((long double)v.d);
+            break;
+        case ALOG_T_PTR:
+            ALOG_PRINT(v.ptr);
+            break;
+        }
+#undef ALOG_PRINT
+    }
+
+    if (dump) {
+#ifdef HEX_DUMP_H
+        if (args + 4 > end) {
+            return -1;
+        }
+        memcpy(&slen, args, 4);
+        if (args + 4 + slen > end || slen > ALOG_DUMP_MAX) {
+            return -1;
+        }
+        alog_hex_dump(out, dump_buf, args + 4, slen);
+#else
+        return -1;                      /* ダンプの整形には hex_dump.h が必要 */
+#endif
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: alog_out_flush
+ * 機能: 出力バッファの内容を出力先へまとめて書く
+ * ============================================================================ */
+static inline void alog_out_flush(FILE *out) {
+    size_t off = 0;
+    ssize_t n;
+
+    fflush(out);
+    g_alog.out_len = (size_t)ftell(out);
+    while (off < g_alog.out_len) {
+        n = write(g_alog.fd, g_alog.out + off, g_alog.out_len - off);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;                      /* 出力先の障害はログを捨てて続ける */
+        }
+        off += n;
+    }
+    rewind(out);
+    g_alog.out_len = 0;
+}
+
+/* ============================================================================
+ * 関数: alog_emit
+ * 機能: 記録1件を出力バッファへ書く
+ *   テキスト出力は整形し、バイナリ出力は記録をそのままコピーする
+ *   (初めて出てきた呼び出し箇所は、その前に定義を書く)
+ * ============================================================================ */
+static inline void alog_emit(FILE *out, const alog_rec_t *rec) {
+    alog_site_t *site;
+
+    if (rec->site == ALOG_SITE_PAD || rec->site > ALOG_SITE_MAX) {
+        return;
+    }
+    site = g_alog.sites[rec->site];
+    if (!g_alog.binary) {
+        alog_format(out, site->fmt, site->dump, (const unsigned char *)(rec + 1),
+                    rec->size - sizeof(*rec));
+        return;
+    }
+
+    while (g_alog.sites_written < rec->site) {
+        alog_site_t *def = g_alog.sites[++g_alog.sites_written];
+        size_t fmt_len = strlen(def->fmt) + 1;
+        alog_rec_t hdr = {
+            .site = ALOG_SITE_DEF,
+            .size = (uint32_t)(sizeof(hdr) + alog_align(8 + fmt_len)),
+        };
+        uint32_t info[2] = { def->id, (uint32_t)(def->level | (def->dump << 8)) };
+        static const char zero[8];
+
+        fwrite(&hdr, sizeof(hdr), 1, out);
+        fwrite(info, sizeof(info), 1, out);
+        fwrite(def->fmt, fmt_len, 1, out);
+        fwrite(zero, alog_align(8 + fmt_len) - 8 - fmt_len, 1, out);
+    }
+    fwrite(rec, rec->size, 1, out);
+}
+
+/* ============================================================================
+ * 関数: alog_drain
+ * 機能: 全スレッドのリングから記録を取り出して出力する
+ *   破棄・流量制限の件数があれば、それもログとして報告する
+ *   (報告はこのスレッドのリングへ書くため、次の呼び出しで出力される)
+ * 戻り値: 取り出した記録数 + 報告した件数 (0 = 出力するものが残っていない)
+ * ============================================================================ */
+static inline unsigned long alog_drain(FILE *out) {
+    uint32_t rings = __atomic_load_n(&g_alog.ring_count, __ATOMIC_ACQUIRE);
+    uint32_t sites = __atomic_load_n(&g_alog.site_count, __ATOMIC_ACQUIRE);
+    unsigned long count = 0;
+    uint64_t dropped;
+    uint32_t suppressed;
+
+    for (uint32_t r = 0; r < rings; r++) {
+        alog_ring_t *ring = g_alog.rings[r];
+        uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        uint64_t head = ring->head;
+
+        while (head < tail) {
+            uint64_t pos = head & (ALOG_RING_SIZE - 1);
+            const alog_rec_t *rec;
+
+            if (ALOG_RING_SIZE - pos < sizeof(alog_rec_t)) {
+                head += ALOG_RING_SIZE - pos;   /* 記録の先頭が収まらない末尾 */
+                continue;
+            }
+            rec = (const alog_rec_t *)(ring->data + pos);
+            alog_emit(out, rec);
+            head += rec->size;
+            count++;
+            if (ftell(out) >= ALOG_OUT_FLUSH) {
+                __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+                alog_out_flush(out);
+            }
+        }
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+
+        dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+        if (dropped != ring->reported) {
+            ALOG_WARN("[WARN] Log buffer full: %llu messages dropped\n",
+                      (unsigned long long)(dropped - ring->reported));
+            ring->reported = dropped;
+            count++;
+        }
+    }
+    for (uint32_t i = 1; i <= sites; i++) {
+        suppressed = __atomic_exchange_n(&g_alog.sites[i]->suppressed, 0, __ATOMIC_RELAXED);
+        if (suppressed > 0) {
+            ALOG_WARN("[WARN] Log rate limit: %u messages suppressed (%.40s)\n",
+                      suppressed, g_alog.sites[i]->fmt);
+            count++;
+        }
+    }
+    return count;
+}
+
+/* ============================================================================
+ * 関数: alog_main
+ * 機能: バックグラウンドスレッド本体。ALOG_FLUSH_MS ごとにリングを取り出し、
+ *       出力バッファにまとめて書き込む
+ *   出力バッファは fmemopen で FILE として扱い、整形に fprintf を使う。
+ *   終了時は報告のログも含めて取り出し終えるまで繰り返す
+ * ============================================================================ */
+static inline void *alog_main(void *arg) {
+    struct timespec wait = { 0, ALOG_FLUSH_MS * 1000000L };
+    FILE *out = (FILE *)arg;
+    unsigned long count;
+    int stopping;
+
+    while (1) {
+        stopping = __atomic_load_n(&g_alog.stopping, __ATOMIC_ACQUIRE);
+        count = alog_drain(out);
+        if (ftell(out) > 0) {
+            alog_out_flush(out);
+        }
+        if (stopping && count == 0) {
+            break;
+        }
+        if (!stopping) {
+            nanosleep(&wait, NULL);
+        }
+    }
+    fclose(out);
+    free(g_alog.out);
+    g_alog.out = NULL;
+    return NULL;
+}
+
+/* ============================================================================
+ * 関数: alog_start
+ * 機能: バックグラウンドの出力を開始する
+ * 引数:
+ *   program - プログラム名 (バイナリ出力のファイル先頭に記録する)
+ *   path    - バイナリ出力のファイル (NULL = 標準出力へテキスト出力)
+ * 戻り値: 0 = 成功, -1 = 失敗 (ログは即時出力のまま)
+ * ============================================================================ */
+static inline int alog_start(const char *program, const char *path) {
+    const char *level = getenv("ABOS_LOG_LEVEL");
+    const char *rate = getenv("ABOS_LOG_RATE");
+    FILE *out;
+
+    if (level != NULL) {
+        g_alog.level = strcasecmp(level, "error") == 0 ? ALOG_LEVEL_ERROR :
+                       strcasecmp(level, "warn") == 0 ? ALOG_LEVEL_WARN :
+                       strcasecmp(level, "debug") == 0 ? ALOG_LEVEL_DEBUG :
+                       ALOG_LEVEL_INFO;
+    }
+    if (rate != NULL) {
+        g_alog.rate_limit = (uint32_t)strtoul(rate, NULL, 10);
+    }
+
+    g_alog.out = malloc(ALOG_OUT_SIZE);
+    out = g_alog.out != NULL ? fmemopen(g_alog.out, ALOG_OUT_SIZE, "w") : NULL;
+    if (out == NULL) {
+        perror("[WARN] Failed to allocate log buffer");
+        free(g_alog.out);
+        return -1;
+    }
+
+    if (path != NULL) {
+        alog_file_header_t hdr;
+
+        g_alog.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (g_alog.fd < 0) {
+            perror("[WARN] Failed to open log file");
+            fclose(out);
+            g_alog.fd = STDOUT_FILENO;
+            return -1;
+        }
+        g_alog.binary = 1;
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, ALOG_FILE_MAGIC, sizeof(hdr.magic));
+        hdr.version = ALOG_FILE_VERSION;
+        hdr.pid = getpid();
+        snprintf(hdr.program, sizeof(hdr.program), "%s", program);
+        hdr.started_ns = alog_now();
+        if (write(g_alog.fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+            perror("[WARN] Failed to write log file");
+        }
+        printf("[INFO] Binary log: %s (decode with LogDecode)\n", path);
+    }
+
+    /* これまでの printf の出力をログより前に出す */
+    fflush(stdout);
+    __atomic_store_n(&g_alog.running, 1, __ATOMIC_RELEASE);
+    if (pthread_create(&g_alog.thread, NULL, alog_main, out) != 0) {
+        fprintf(stderr, "[WARN] Failed to start log thread\n");
+        __atomic_store_n(&g_alog.running, 0, __ATOMIC_RELEASE);
+        fclose(out);
+        return -1;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: alog_stop
+ * 機能: 残りのログを出力してバックグラウンドの出力を終了する
+ *   (以降の ALOG_* は即時出力。ログを書くスレッドの終了後に呼ぶこと)
+ * ============================================================================ */
+static inline void alog_stop(void) {
+    if (!__atomic_load_n(&g_alog.running, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    __atomic_store_n(&g_alog.stopping, 1, __ATOMIC_RELEASE);
+    pthread_join(g_alog.thread, NULL);
+    __atomic_store_n(&g_alog.running, 0, __ATOMIC_RELEASE);
+    if (g_alog.binary) {
+        close(g_alog.fd);
+        g_alog.fd = STDOUT_FILENO;
+        g_alog.binary = 0;
+    }
+}
+
+#endif /* ASYNC_LOG_H */
@@ -0,0 +1,200 @@
+/*
+ * ============================================================================
+ * frame_protocol.h - Bridge/Client Framed Wire Protocol
+ * ============================================================================
+ * 機能:
+ *   - 長さヘッダと相関ID (correlation ID) を持つフレーム形式の定義
+ *   - フレームヘッダの書き込み・解析
+ *   - ストリーム受信の再組み立てバッファ (分割受信・複数フレームの
+ *     まとめ受信に対応し、大きなフレームに合わせて拡張する)
+ *
+ * フレーム形式 (ビッグエンディアン):
+ *   +0  u8   magic     (FRAME_MAGIC, 改行区切りのテキストの先頭にはならない)
+ *   +1  u8   version   (FRAME_VERSION)
+ *   +2  u8   type      (FRAME_TYPE_REQUEST / FRAME_TYPE_RESPONSE)
+ *   +3  u8   flags     (予約, 0)
+ *   +4  u32  id        (相関ID: 応答には要求と同じ値を入れる)
+ *   +8  u32  length    (本体長, ヘッダを含まない)
+ *   +12 本体 (length バイト)
+ *
+ * 往路の最初のバイトが FRAME_MAGIC ならフレーム形式、それ以外は従来の
+ * 改行区切りテキストとして扱う (Java 版との互換のため)。
+ * ============================================================================
+ */
+
+#ifndef FRAME_PROTOCOL_H
+#define FRAME_PROTOCOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+/* ============================================================================
+ * フレーム設定
+ * ============================================================================ */
+#define FRAME_MAGIC             0xA5
+#define FRAME_VERSION           1
+#define FRAME_HEADER_SIZE       12
+#define FRAME_MAX_PAYLOAD       (32 * 1024 * 1024)  /* 本体長の上限 (バイト) */
+#define FRAME_READ_MIN          4096                /* 1回の受信で確保する空き */
+
+enum {
+    FRAME_TYPE_REQUEST  = 1,
+    FRAME_TYPE_RESPONSE = 2,
+};
+
+/* ============================================================================
+ * 解析済みフレーム (受信バッファを直接指す)
+ * ============================================================================ */
+typedef struct {
+    uint8_t              type;
+    uint8_t              flags;
+    uint32_t             id;            /* 相関ID */
+    uint32_t             length;        /* 本体長 */
+    const unsigned char *payload;
+} frame_t;
+
+/* ============================================================================
+ * 再組み立てバッファ
+ * ============================================================================ */
+typedef struct {
+    unsigned char *data;
+    size_t         len;                 /* 受信済みバイト数 */
+    size_t         cap;
+} frame_buffer_t;
+
+/* ============================================================================
+ * 関数: frame_put_header
+ * 機能: フレームヘッダを書き込む
+ * ============================================================================ */
+static inline void frame_put_header(unsigned char *p, uint8_t type,
+                                    uint32_t id, uint32_t length) {
+    p[0] = FRAME_MAGIC;
+    p[1] = FRAME_VERSION;
+    p[2] = type;
+    p[3] = 0;
+    p[4] = id >> 24;
+    p[5] = id >> 16;
+    p[6] = id >> 8;
+    p[7] = id;
+    p[8] = length >> 24;
+    p[9] = length >> 16;
+    p[10] = length >> 8;
+    p[11] = length;
+}
+
+/* ============================================================================
+ * 関数: frame_get32
+ * 機能: ビッグエンディアンの u32 を読み出す
+ * ============================================================================ */
+static inline uint32_t frame_get32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* ============================================================================
+ * 関数: frame_parse
+ * 機能: 先頭のフレームを解析する
+ * 引数:
+ *   p     - 受信データの先頭 (フレーム境界)
+ *   avail - 受信済みバイト数
+ *   f     - 解析結果の格納先 (戻り値 > 0 の場合のみ有効)
+ * 戻り値: フレーム全体の長さ, 0 = 未完成 (追加の受信が必要), -1 = 不正
+ * ============================================================================ */
+static inline ssize_t frame_parse(const unsigned char *p, size_t avail, frame_t *f) {
+    uint32_t length;
+
+    if (avail < FRAME_HEADER_SIZE) {
+        return avail > 0 && p[0] != FRAME_MAGIC ? -1 : 0;
+    }
+    length = frame_get32(p + 8);
+    if (p[0] != FRAME_MAGIC || p[1] != FRAME_VERSION || length > FRAME_MAX_PAYLOAD) {
+        return -1;
+    }
+    if (avail < FRAME_HEADER_SIZE + (size_t)length) {
+        return 0;
+    }
+    f->type = p[2];
+    f->flags = p[3];
+    f->id = frame_get32(p + 4);
+    f->length = length;
+    f->payload = p + FRAME_HEADER_SIZE;
+    return FRAME_HEADER_SIZE + (ssize_t)length;
+}
+
+/* ============================================================================
+ * 関数: frame_buffer_reserve
+ * 機能: 受信バッファの容量を need バイト以上に拡張する
+ * 戻り値: 0 = 成功, -1 = メモリ不足
+ * ============================================================================ */
+static inline int frame_buffer_reserve(frame_buffer_t *b, size_t need) {
+    size_t cap = b->cap != 0 ? b->cap : need;
+    unsigned char *data;
+
+    if (need <= b->cap) {
+        return 0;
+    }
+    while (cap < need) {
+        cap *= 2;
+    }
+    data = realloc(b->data, cap);
+    if (data == NULL) {
+        return -1;
+    }
+    b->data = data;
+    b->cap = cap;
+    return 0;
+}
+
+/* ============================================================================
+ * 関数: frame_buffer_read
+ * 機能: ソケットから受信してバッファ末尾に追加する
+ *   先頭に未完成のフレームがあれば、その全体が入る容量を確保してから読む
+ * 戻り値: 受信バイト数, 0 = 切断, -1 = エラー (errno を参照)
+ * ============================================================================ */
+static inline ssize_t frame_buffer_read(frame_buffer_t *b, int fd) {
+    size_t need = b->len + FRAME_READ_MIN;
+    ssize_t n;
+
+    if (b->len >= FRAME_HEADER_SIZE && b->data[0] == FRAME_MAGIC &&
+        frame_get32(b->data + 8) <= FRAME_MAX_PAYLOAD &&
+        FRAME_HEADER_SIZE + (size_t)frame_get32(b->data + 8) > need) {
+        need = FRAME_HEADER_SIZE + (size_t)frame_get32(b->data + 8);
+    }
+    if (frame_buffer_reserve(b, need) < 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    n = recv(fd, b->data + b->len, b->cap - b->len, 0);
+    if (n > 0) {
+        b->len += n;
+    }
+    return n;
+}
+
+/* ============================================================================
+ * 関数: frame_buffer_consume
+ * 機能: 処理済みの先頭 n バイトを取り除く (未完成の残りを先頭へ詰める)
+ * ============================================================================ */
+static inline void frame_buffer_consume(frame_buffer_t *b, size_t n) {
+    b->len -= n;
+    if (b->len > 0 && n > 0) {
+        memmove(b->data, b->data + n, b->len);
+    }
+}
+
+/* ============================================================================
+ * 関数: frame_buffer_free
+ * 機能: 受信バッファを解放する
+ * ============================================================================ */
+static inline void frame_buffer_free(frame_buffer_t *b) {
+    free(b->data);
+    b->data = NULL;
+    b->len = b->cap = 0;
+}
+
+#endif /* FRAME_PROTOCOL_H */
@@ -0,0 +1,221 @@
+/*
+ * ============================================================================
+ * latency_hist.h - Log-Linear Latency Histogram
+ * ============================================================================
+ * 機能:
+ *   - 遅延 (ナノ秒) を対数・線形の2段階のバケットに記録する
+ *     (2のべき乗の区間を LAT_HIST_SUB 個に等分。相対誤差 約 1/LAT_HIST_SUB)
+ *   - 記録は O(1) でメモリ確保なし。パーセンタイル・最小・最大・平均を求める
+ *   - 結果を p50/p90/p99/p99.9/max と、2のべき乗ごとの度数分布で表示する
+ *
+ * 使い方:
+ *   lat_hist_t h;
+ *   lat_hist_init(&h);
+ *   lat_hist_record(&h, rtt_ns);
+ *   lat_hist_print(&h, "RTT");
+ * ============================================================================
+ */
+
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* ============================================================================
+ * ヒストグラム設定
+ * ============================================================================ */
+#define LAT_HIST_SUB_BITS       5                       /* 区間内の分割 (2^5 = 32) */
+#define LAT_HIST_SUB            (1 << LAT_HIST_SUB_BITS)
+#define LAT_HIST_BUCKETS        ((64 - LAT_HIST_SUB_BITS + 1) * LAT_HIST_SUB)
+#define LAT_HIST_BAR_WIDTH      40                      /* 度数分布の棒の最大幅 */
+
+/* ============================================================================
+ * ヒストグラム
+ * ============================================================================ */
+typedef struct {
+    uint64_t count;                     /* 記録数 */
+    uint64_t min, max;                  /* 最小・最大 (ns) */
+    double   sum;                       /* 合計 (平均の算出用, ns) */
+    uint64_t buckets[LAT_HIST_BUCKETS];
+} lat_hist_t;
+
+/* ============================================================================
+ * 関数: lat_hist_init
+ * 機能: ヒストグラムを空にする
+ * ============================================================================ */
+static inline void lat_hist_init(lat_hist_t *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+/* ============================================================================
+ * 関数: lat_hist_index_bits
+ * 機能: 区間内の分割を sub_bits ビットとして、値を記録するバケット番号を求める
+ *   2^sub_bits 未満はそのまま、それ以上は上位ビットの位置 (区間) と
+ *   続く sub_bits ビット (区間内の位置) から求める
+ *   (stage_probe.h も分割を変えて使う)
+ * ============================================================================ */
+static inline int lat_hist_index_bits(uint64_t v, int sub_bits) {
+    int shift;
+
+    if (v < (1ULL << sub_bits)) {
+        return (int)v;
+    }
+    shift = 63 - __builtin_clzll(v) - sub_bits;
+    return ((shift + 1) << sub_bits) + (int)((v >> shift) - (1ULL << sub_bits));
+}
+
+/* ============================================================================
+ * 関数: lat_hist_upper_bits
+ * 機能: 区間内の分割を sub_bits ビットとして、バケットに入る値の上限
+ *       (次のバケットの下限 - 1) を求める
+ * ============================================================================ */
+static inline uint64_t lat_hist_upper_bits(int index, int sub_bits) {
+    uint64_t sub = 1ULL << sub_bits;
+    int shift;
+
+    if ((uint64_t)index < sub) {
+        return (uint64_t)index;
+    }
+    shift = (index >> sub_bits) - 1;
+    return ((((uint64_t)index & (sub - 1)) + sub + 1) << shift) - 1;
+}
+
+/* ============================================================================
+ * 関数: lat_hist_index / lat_hist_upper
+ * 機能: このヒストグラム (LAT_HIST_SUB_BITS) のバケット番号・上限を求める
+ * ============================================================================ */
+static inline int lat_hist_index(uint64_t v) {
+    return lat_hist_index_bits(v, LAT_HIST_SUB_BITS);
+}
+
+static inline uint64_t lat_hist_upper(int index) {
+    return lat_hist_upper_bits(index, LAT_HIST_SUB_BITS);
+}
+
+/* ============================================================================
+ * 関数: lat_hist_record
+ * 機能: 値 (ns) を1個記録する
+ * ============================================================================ */
+static inline void lat_hist_record(lat_hist_t *h, uint64_t v) {
+    h->buckets[lat_hist_index(v)]++;
+    h->count++;
+    h->sum += (double)v;
+    if (v < h->min) {
+        h->min = v;
+    }
+    if (v > h->max) {
+        h->max = v;
+    }
+}
+
+/* ============================================================================
+ * 関数: lat_hist_merge
+ * 機能: src の記録を dst に加える (スレッドごとの集計をまとめる場合など)
+ * ============================================================================ */
+static inline void lat_hist_merge(lat_hist_t *dst, const lat_hist_t *src) {
+    for (int i = 0; i < LAT_HIST_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+/* ============================================================================
+ * 関数: lat_hist_percentile
+ * 機能: パーセンタイル値を求める (該当バケットの上限, 最大値を超えない)
+ * 引数:
+ *   p - パーセント (0 - 100)
+ * 戻り値: 値 (ns, 記録なしの場合は 0)
+ * ============================================================================ */
+static inline uint64_t lat_hist_percentile(const lat_hist_t *h, double p) {
+    uint64_t rank, seen = 0;
+    uint64_t v;
+
+    if (h->count == 0) {
+        return 0;
+    }
+    rank = (uint64_t)(p / 100.0 * (double)h->count + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (int i = 0; i < LAT_HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            v = lat_hist_upper(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+/* ============================================================================
+ * 関数: lat_hist_print
+ * 機能: パーセンタイルと2のべき乗ごとの度数分布 (ミリ秒) を表示する
+ * 引数:
+ *   name - 表示する項目名 (例: "RTT")
+ * ============================================================================ */
+static inline void lat_hist_print(const lat_hist_t *h, const char *name) {
+    uint64_t range[64] = {0};
+    uint64_t peak = 0, cum = 0;
+    int first = -1, last = -1;
+    int bar;
+
+    if (h->count == 0) {
+        printf("[INFO] %s: no samples\n", name);
+        return;
+    }
+    printf("[INFO] %s (ms): min %.3f, avg %.3f, p50 %.3f, p90 %.3f, p99 %.3f, "
+           "p99.9 %.3f, max %.3f\n", name, h->min / 1e6, h->sum / h->count / 1e6,
+           lat_hist_percentile(h, 50) / 1e6, lat_hist_percentile(h, 90) / 1e6,
+           lat_hist_percentile(h, 99) / 1e6, lat_hist_percentile(h, 99.9) / 1e6,
+           h->max / 1e6);
+
+    /* 2のべき乗の区間 [2^k, 2^(k+1)) ns ごとにまとめる */
+    for (int i = 0; i < LAT_HIST_BUCKETS; i++) {
+        int k;
+
+        if (h->buckets[i] == 0) {
+            continue;
+        }
+        k = 63 - __builtin_clzll(lat_hist_upper(i) | 1);
+        range[k] += h->buckets[i];
+        if (first < 0 || k < first) {
+            first = k;
+        }
+        if (k > last) {
+            last = k;
+        }
+    }
+    for (int k = first; k <= last; k++) {
+        if (range[k] > peak) {
+            peak = range[k];
+        }
+    }
+    printf("  %12s %12s %10s %8s\n", "from (ms)", "to (ms)", "count", "cum %");
+    peak = peak > 0 ? peak : 1;
+    for (int k = first; k <= last; k++) {
+        char bars[LAT_HIST_BAR_WIDTH + 1];
+
+        cum += range[k];
+        bar = (int)(range[k] * LAT_HIST_BAR_WIDTH / peak);
+        if (bar == 0 && range[k] > 0) {
+            bar = 1;
+        }
+        memset(bars, '#', bar);
+        bars[bar] = '\0';
+        printf("  %12.4f %12.4f %10llu %7.3f%% %s\n",
+               k == 0 ? 0.0 : (double)(1ULL << k) / 1e6, (double)(2ULL << k) / 1e6,
+               (unsigned long long)range[k], cum * 100.0 / h->count, bars);
+    }
+}
+
+#endif /* LATENCY_HIST_H */
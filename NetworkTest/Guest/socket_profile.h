@@ -0,0 +1,221 @@
+/*
+ * ============================================================================
+ * socket_profile.h - Bridge/Client TCP Socket Profile
+ * ============================================================================
+ * 機能:
+ *   - Bridge_C・Client_C の TCP ソケットに同じ設定をまとめて行う
+ *     (-F で低遅延プロファイルを選ぶ。既定は従来どおりの設定)
+ *   - 低遅延プロファイル (SOCK_PROFILE_LOWLAT)
+ *       TCP Fast Open : 待ち受けに TCP_FASTOPEN、接続側に TCP_FASTOPEN_CONNECT
+ *                       を設定し、接続直後の最初の送信データを SYN に載せる
+ *                       (2回目以降の接続。最初の接続で cookie を得る)
+ *       TCP_NODELAY   : 送信を Nagle で遅らせない
+ *       TCP_QUICKACK  : 受信のたびに設定し直し、遅延 ACK をしない
+ *                       (カーネルが解除するため1回では続かない)
+ *       SO_BUSY_POLL  : 受信待ちで SOCK_PROFILE_BUSY_POLL_US の間
+ *                       デバイスのキューをポーリングする (要 CAP_NET_ADMIN。
+ *                       epoll で待つ場合は net.core.busy_poll も設定する)
+ *       SO_SNDBUF / SO_RCVBUF : SOCK_PROFILE_BUFFER に固定する
+ *                       (小さなメッセージの往復で自動調整の拡大を待たない。
+ *                        待ち受けに設定すると受け入れた接続に引き継がれる)
+ *
+ * TCP Fast Open の注意:
+ *   - 両側で sysctl net.ipv4.tcp_fastopen = 3 (接続側・待ち受け側の両方) が
+ *     必要 (netns ごとの設定)。有効でなければ通常の3ウェイハンドシェイクになる
+ *   - TCP_FASTOPEN_CONNECT は connect() をすぐに返し、SYN を最初の send() まで
+ *     遅らせる (sendto(MSG_FASTOPEN) と同じ動作を connect -> send の順のまま
+ *     使える)。接続の失敗は send() 以降で通知される。
+ *     接続後すぐに送信して閉じる接続にのみ使う (Bridge_C -o の復路、
+ *     Client_C の従来モード・-L -o の往路。維持する接続は使わない)
+ *   - connect() は SYN を送る前に返るため、接続数・接続の所要時間は
+ *     確立を確認した時点 (sock_profile_connecting() が 0) で記録する
+ *   - 非ブロッキングソケットで cookie がない場合、最初の send() は
+ *     EINPROGRESS を返し、データは送られない (接続完了後に送り直す)
+ *   - 非ブロッキングソケットは SYN-ACK を受ける前に閉じると接続が中止される。
+ *     送信後すぐに閉じる場合は sock_profile_connecting() で確立を待つ
+ * ============================================================================
+ */
+
+#ifndef SOCKET_PROFILE_H
+#define SOCKET_PROFILE_H
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#ifndef TCP_FASTOPEN_CONNECT
+#define TCP_FASTOPEN_CONNECT    30      /* Linux 4.11 以降 (古い glibc 向け) */
+#endif
+
+/* ============================================================================
+ * プロファイル設定
+ * ============================================================================ */
+#define SOCK_PROFILE_TFO_QLEN       1024            /* 待ち受けの TFO 要求の保留数 */
+#define SOCK_PROFILE_BUSY_POLL_US   50              /* 受信待ちのポーリング時間 (us) */
+#define SOCK_PROFILE_BUFFER         (256 * 1024)    /* 送受信バッファ (バイト) */
+#define SOCK_PROFILE_TFO_SYSCTL     "/proc/sys/net/ipv4/tcp_fastopen"
+
+typedef enum {
+    SOCK_PROFILE_DEFAULT,               /* 従来の設定 */
+    SOCK_PROFILE_LOWLAT,                /* 低遅延 (-F) */
+} sock_profile_t;
+
+/* 設定に失敗したオプション (警告は各1回のみ) */
+enum {
+    SOCK_WARN_FASTOPEN      = 1 << 0,
+    SOCK_WARN_BUSY_POLL     = 1 << 1,
+    SOCK_WARN_BUFFER        = 1 << 2,
+};
+
+static int sock_profile_warned;
+
+/* ============================================================================
+ * 関数: sock_profile_name
+ * 機能: プロファイルの表示名を返す
+ * ============================================================================ */
+static inline const char *sock_profile_name(sock_profile_t profile) {
+    return profile == SOCK_PROFILE_LOWLAT ?
+           "low latency (TCP Fast Open, NODELAY, QUICKACK, busy poll)" : "default";
+}
+
+/* ============================================================================
+ * 関数: sock_profile_warn
+ * 機能: 設定の失敗をオプションごとに1回だけ表示する (スレッド間で共有)
+ * ============================================================================ */
+static inline void sock_profile_warn(int bit, const char *what) {
+    int err = errno;
+
+    if (!(__atomic_fetch_or(&sock_profile_warned, bit, __ATOMIC_RELAXED) & bit)) {
+        fprintf(stderr, "[WARN] Failed to set %s: %s\n", what, strerror(err));
+    }
+}
+
+/* ============================================================================
+ * 関数: sock_profile_check
+ * 機能: 低遅延プロファイルで TCP Fast Open が使えるか sysctl を確認する
+ * ============================================================================ */
+static inline void sock_profile_check(sock_profile_t profile) {
+    FILE *fp;
+    int value = 0;
+
+    if (profile != SOCK_PROFILE_LOWLAT) {
+        return;
+    }
+    fp = fopen(SOCK_PROFILE_TFO_SYSCTL, "r");
+    if (fp == NULL || fscanf(fp, "%d", &value) != 1) {
+        value = 0;
+    }
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    if ((value & 3) != 3) {
+        fprintf(stderr, "[WARN] net.ipv4.tcp_fastopen = %d (needs 3); "
+                "connections fall back to the full handshake\n", value);
+    }
+}
+
+/* ============================================================================
+ * 関数: sock_profile_common
+ * 機能: 待ち受け・接続の両方に行う設定 (バッファ・ポーリング)
+ * ============================================================================ */
+static inline void sock_profile_common(int fd) {
+    int size = SOCK_PROFILE_BUFFER;
+    int usec = SOCK_PROFILE_BUSY_POLL_US;
+
+    if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0) {
+        sock_profile_warn(SOCK_WARN_BUFFER, "SO_SNDBUF/SO_RCVBUF");
+    }
+    if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) < 0) {
+        sock_profile_warn(SOCK_WARN_BUSY_POLL, "SO_BUSY_POLL (needs CAP_NET_ADMIN)");
+    }
+}
+
+/* ============================================================================
+ * 関数: sock_profile_listener
+ * 機能: 待ち受けソケットを設定する (bind・listen の前に呼ぶ)
+ * ============================================================================ */
+static inline void sock_profile_listener(int fd, sock_profile_t profile) {
+    int qlen = SOCK_PROFILE_TFO_QLEN;
+
+    if (profile != SOCK_PROFILE_LOWLAT) {
+        return;
+    }
+    sock_profile_common(fd);
+    if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen)) < 0) {
+        sock_profile_warn(SOCK_WARN_FASTOPEN, "TCP_FASTOPEN");
+    }
+}
+
+/* ============================================================================
+ * 関数: sock_profile_connect
+ * 機能: 接続するソケットを設定する (connect の前に呼ぶ)
+ * 引数:
+ *   data_follows - 1 = connect 直後に送信する (TCP Fast Open を使う)
+ * ============================================================================ */
+static inline void sock_profile_connect(int fd, sock_profile_t profile, int data_follows) {
+    int opt = 1;
+
+    if (profile != SOCK_PROFILE_LOWLAT) {
+        return;
+    }
+    sock_profile_common(fd);
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    if (data_follows &&
+        setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &opt, sizeof(opt)) < 0) {
+        sock_profile_warn(SOCK_WARN_FASTOPEN, "TCP_FASTOPEN_CONNECT");
+    }
+}
+
+/* ============================================================================
+ * 関数: sock_profile_accepted
+ * 機能: 受け入れた接続を設定する
+ *   (バッファ・ポーリングは待ち受けソケットから引き継がれる)
+ * ============================================================================ */
+static inline void sock_profile_accepted(int fd, sock_profile_t profile) {
+    int opt = 1;
+
+    if (profile != SOCK_PROFILE_LOWLAT) {
+        return;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &opt, sizeof(opt));
+}
+
+/* ============================================================================
+ * 関数: sock_profile_connecting
+ * 機能: Fast Open で送信した接続が SYN-ACK を待っているか確認する
+ *   (この状態で閉じると接続は中止され、SYN に載せたデータは届かない)
+ * 戻り値: 1 = 接続中, 0 = 確立済み (既定のプロファイルでは常に 0),
+ *         -1 = 接続できなかった (理由は SO_ERROR)
+ * ============================================================================ */
+static inline int sock_profile_connecting(int fd, sock_profile_t profile) {
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+
+    if (profile != SOCK_PROFILE_LOWLAT ||
+        getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) < 0) {
+        return 0;
+    }
+    if (info.tcpi_state == TCP_SYN_SENT) {
+        return 1;
+    }
+    return info.tcpi_state == TCP_CLOSE ? -1 : 0;
+}
+
+/* ============================================================================
+ * 関数: sock_profile_rearm
+ * 機能: 受信のあとに TCP_QUICKACK を設定し直す
+ * ============================================================================ */
+static inline void sock_profile_rearm(int fd, sock_profile_t profile) {
+    int opt = 1;
+
+    if (profile == SOCK_PROFILE_LOWLAT) {
+        setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &opt, sizeof(opt));
+    }
+}
+
+#endif /* SOCKET_PROFILE_H */
@@ -0,0 +1,281 @@
+/*
+ * ============================================================================
+ * stage_probe.h - Per-Stage Timing Probes in Shared Memory
+ * ============================================================================
+ * 機能:
+ *   - 処理の段階 (受け入れ・受信・応答生成・接続・送信完了など) ごとの
+ *     所要時間 (ns) をスレッドごとのヒストグラムに記録する
+ *   - 記録先は /dev/shm/abos_stage.<プログラム>.<pid> の共有メモリで、
+ *     StageStat が実行中のプロセスから読み出して表示する
+ *   - 記録はスレッドごとのスロットへの通常のストアのみ (ロック・
+ *     システムコールなし)。時刻は vDSO の clock_gettime() で取得する
+ *   - 段階名・カウンタ名は共有メモリに書き込み、読み出し側は名前で表示する
+ *
+ * 使い方:
+ *   static const char *stages[] = { "read->response", "queued->sent" };
+ *   stage_shm_t *shm = stage_shm_create("Bridge_C", stages, 2, NULL, 0);
+ *   stage_slot_t *slot = stage_thread(shm, "worker0");  // スレッドごとに1回
+ *   long long t0 = stage_now();
+ *   ...
+ *   stage_record(slot, 0, stage_now() - t0);
+ *   stage_shm_destroy(shm);                              // 終了時
+ *   (shm・slot が NULL の場合、記録は何もしない)
+ *
+ * 整合性:
+ *   各スロットの書き込みはそのスレッドのみが行い、読み出し側は各値を
+ *   個別に読む。記録中の値を読んだ場合、件数と合計などが1件分ずれることがある。
+ *   スロットは初期化してから in_use・thread_count を公開する。読み出し側は
+ *   thread_count までのスロットのうち in_use のものだけを読む
+ *   (複数スレッドが同時に登録した場合、先の番号が初期化中のことがある)
+ * ============================================================================
+ */
+
+#ifndef STAGE_PROBE_H
+#define STAGE_PROBE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "latency_hist.h"
+
+/* ============================================================================
+ * 共有メモリ設定
+ * ============================================================================ */
+#define STAGE_SHM_DIR           "/dev/shm"
+#define STAGE_SHM_PREFIX        "abos_stage."   /* ファイル名: 接頭辞<プログラム>.<pid> */
+#define STAGE_MAGIC             0x53544731      /* "STG1" */
+#define STAGE_VERSION           2
+#define STAGE_MAX               8               /* 段階数の上限 */
+#define STAGE_COUNTER_MAX       8               /* カウンタ数の上限 */
+#define STAGE_THREAD_MAX        64              /* スロット (スレッド) 数の上限 */
+#define STAGE_NAME_LEN          24
+#define STAGE_SUB_BITS          2               /* 2のべき乗の区間内の分割 (2^2 = 4) */
+#define STAGE_SUB               (1 << STAGE_SUB_BITS)
+#define STAGE_HIST_MAX_BITS     41              /* 記録できる最大値 2^41 ns (約36分) */
+#define STAGE_HIST_BUCKETS      ((STAGE_HIST_MAX_BITS - STAGE_SUB_BITS + 1) * STAGE_SUB)
+
+/* ============================================================================
+ * 段階ごとの記録 (ヒストグラムは latency_hist.h と同じ対数・線形の区切り)
+ * ============================================================================ */
+typedef struct {
+    uint64_t count;                     /* 記録数 */
+    uint64_t sum_ns;                    /* 合計 (ns) */
+    uint64_t max_ns;                    /* 最大 (ns) */
+    uint64_t buckets[STAGE_HIST_BUCKETS];
+} stage_hist_t;
+
+/* ============================================================================
+ * スレッドごとのスロット (キャッシュラインを共有しないよう整列)
+ * ============================================================================ */
+typedef struct {
+    uint32_t     in_use;                /* 1 = 初期化済み (読み出してよい) */
+    int32_t      tid;                   /* スレッドID (gettid) */
+    char         name[16];              /* スレッド名 */
+    uint64_t     counters[STAGE_COUNTER_MAX];
+    stage_hist_t stages[STAGE_MAX];
+} __attribute__((aligned(64))) stage_slot_t;
+
+/* ============================================================================
+ * 共有メモリ全体
+ * ============================================================================ */
+typedef struct {
+    uint32_t     magic;                 /* 初期化完了後に STAGE_MAGIC を書く */
+    uint32_t     version;
+    int32_t      pid;
+    uint32_t     stage_count;
+    uint32_t     counter_count;
+    uint32_t     thread_count;          /* 公開済みのスロット番号の上限 */
+    uint32_t     slot_alloc;            /* 確保済みのスロット数 (登録側のみ使用) */
+    int64_t      started_ns;            /* 作成時刻 (CLOCK_MONOTONIC, ns) */
+    char         program[32];
+    char         stage_names[STAGE_MAX][STAGE_NAME_LEN];
+    char         counter_names[STAGE_COUNTER_MAX][STAGE_NAME_LEN];
+    stage_slot_t slots[STAGE_THREAD_MAX];
+} stage_shm_t;
+
+/* ============================================================================
+ * 関数: stage_now
+ * 機能: 単調増加時刻をナノ秒で取得する (vDSO のためシステムコールなし)
+ * ============================================================================ */
+static inline long long stage_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* ============================================================================
+ * 関数: stage_hist_index / stage_hist_upper
+ * 機能: バケット番号・バケットに入る値の上限を求める (latency_hist.h と同じ
+ *       計算を STAGE_SUB_BITS で行う。上限を超える値は最後のバケット)
+ * ============================================================================ */
+static inline int stage_hist_index(uint64_t v) {
+    if (v >> STAGE_HIST_MAX_BITS) {
+        return STAGE_HIST_BUCKETS - 1;
+    }
+    return lat_hist_index_bits(v, STAGE_SUB_BITS);
+}
+
+static inline uint64_t stage_hist_upper(int index) {
+    return lat_hist_upper_bits(index, STAGE_SUB_BITS);
+}
+
+/* ============================================================================
+ * 関数: stage_record
+ * 機能: 段階の所要時間 (ns) を1件記録する
+ *   スロットの書き込みは所有スレッドのみのため、ロックや不可分な加算は
+ *   使わず、読み出し側が途中の値を読まないよう各値を1回のストアで更新する
+ * ============================================================================ */
+static inline void stage_record(stage_slot_t *slot, int stage, long long ns) {
+    stage_hist_t *h;
+    uint64_t v = ns > 0 ? (uint64_t)ns : 0;
+    int i = stage_hist_index(v);
+
+    if (slot == NULL) {
+        return;
+    }
+    h = &slot->stages[stage];
+    __atomic_store_n(&h->buckets[i], h->buckets[i] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->sum_ns, h->sum_ns + v, __ATOMIC_RELAXED);
+    if (v > h->max_ns) {
+        __atomic_store_n(&h->max_ns, v, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&h->count, h->count + 1, __ATOMIC_RELAXED);
+}
+
+/* ============================================================================
+ * 関数: stage_add / stage_set
+ * 機能: カウンタに加算する / カウンタの値を設定する
+ * ============================================================================ */
+static inline void stage_add(stage_slot_t *slot, int counter, uint64_t n) {
+    if (slot != NULL) {
+        __atomic_store_n(&slot->counters[counter], slot->counters[counter] + n,
+                         __ATOMIC_RELAXED);
+    }
+}
+
+static inline void stage_set(stage_slot_t *slot, int counter, uint64_t value) {
+    if (slot != NULL) {
+        __atomic_store_n(&slot->counters[counter], value, __ATOMIC_RELAXED);
+    }
+}
+
+/* ============================================================================
+ * 関数: stage_shm_path
+ * 機能: 共有メモリのファイル名を作る
+ * ============================================================================ */
+static inline void stage_shm_path(char *path, size_t size, const char *program, int pid) {
+    snprintf(path, size, "%s/%s%s.%d", STAGE_SHM_DIR, STAGE_SHM_PREFIX, program, pid);
+}
+
+/* ============================================================================
+ * 関数: stage_shm_create
+ * 機能: 共有メモリを作成し、段階名・カウンタ名を書き込む
+ * 引数:
+ *   program  - プログラム名 (ファイル名と表示に使う)
+ *   stages   - 段階名の配列 (stage_count 個, STAGE_MAX まで)
+ *   counters - カウンタ名の配列 (counter_count 個, NULL 可)
+ * 戻り値: 共有メモリ (NULL = 作成失敗, 記録なしで動作を続ける)
+ * ============================================================================ */
+static inline stage_shm_t *stage_shm_create(const char *program,
+                                            const char *const *stages, int stage_count,
+                                            const char *const *counters, int counter_count) {
+    char path[128];
+    stage_shm_t *shm;
+    int fd;
+
+    if (stage_count > STAGE_MAX || counter_count > STAGE_COUNTER_MAX) {
+        fprintf(stderr, "[WARN] Too many stages or counters for %s\n", program);
+        return NULL;
+    }
+    stage_shm_path(path, sizeof(path), program, getpid());
+    unlink(path);                       /* 同じ pid の古いファイル */
+    fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(stage_shm_t)) < 0) {
+        perror("[WARN] Failed to create stage probe segment");
+        if (fd >= 0) {
+            close(fd);
+            unlink(path);
+        }
+        return NULL;
+    }
+    shm = mmap(NULL, sizeof(stage_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        perror("[WARN] Failed to map stage probe segment");
+        unlink(path);
+        return NULL;
+    }
+
+    /* ftruncate した領域は 0 で埋まっている */
+    shm->version = STAGE_VERSION;
+    shm->pid = getpid();
+    shm->stage_count = stage_count;
+    shm->counter_count = counter_count;
+    shm->started_ns = stage_now();
+    snprintf(shm->program, sizeof(shm->program), "%s", program);
+    for (int i = 0; i < stage_count; i++) {
+        snprintf(shm->stage_names[i], STAGE_NAME_LEN, "%s", stages[i]);
+    }
+    for (int i = 0; i < counter_count; i++) {
+        snprintf(shm->counter_names[i], STAGE_NAME_LEN, "%s", counters[i]);
+    }
+    __atomic_store_n(&shm->magic, STAGE_MAGIC, __ATOMIC_RELEASE);
+
+    printf("[INFO] Stage probes: %s\n", path);
+    return shm;
+}
+
+/* ============================================================================
+ * 関数: stage_thread
+ * 機能: 呼び出したスレッドのスロットを確保する
+ * 戻り値: スロット (NULL = shm が NULL またはスロット不足, 記録しない)
+ * ============================================================================ */
+static inline stage_slot_t *stage_thread(stage_shm_t *shm, const char *name) {
+    stage_slot_t *slot;
+    uint32_t index, count;
+
+    if (shm == NULL) {
+        return NULL;
+    }
+    index = __atomic_fetch_add(&shm->slot_alloc, 1, __ATOMIC_RELAXED);
+    if (index >= STAGE_THREAD_MAX) {
+        fprintf(stderr, "[WARN] No stage probe slot left for %s\n", name);
+        return NULL;
+    }
+    slot = &shm->slots[index];
+    slot->tid = (int32_t)syscall(SYS_gettid);
+    snprintf(slot->name, sizeof(slot->name), "%s", name);
+    __atomic_store_n(&slot->in_use, 1, __ATOMIC_RELEASE);
+
+    /* 初期化後に thread_count を index + 1 以上へ進めて公開する */
+    count = __atomic_load_n(&shm->thread_count, __ATOMIC_RELAXED);
+    while (count < index + 1 &&
+           !__atomic_compare_exchange_n(&shm->thread_count, &count, index + 1, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    return slot;
+}
+
+/* ============================================================================
+ * 関数: stage_shm_destroy
+ * 機能: 共有メモリを解除して削除する
+ * ============================================================================ */
+static inline void stage_shm_destroy(stage_shm_t *shm) {
+    char path[128];
+
+    if (shm == NULL) {
+        return;
+    }
+    stage_shm_path(path, sizeof(path), shm->program, shm->pid);
+    unlink(path);
+    munmap(shm, sizeof(stage_shm_t));
+}
+
+#endif /* STAGE_PROBE_H */
@@ -0,0 +1,172 @@
+/*
+ * ============================================================================
+ * timer_wheel.h - Hashed Timer Wheel
+ * ============================================================================
+ * 機能:
+ *   - TIMER_WHEEL_TICK_MS 刻みのスロットを持つタイマホイール
+ *     (登録・解除は O(1)。一周より先の時刻は同じスロットで周回を待つ)
+ *   - タイマは利用側の構造体に埋め込み、満了時にコールバックを呼ぶ
+ *   - イベントループの epoll_wait の待ち時間を次のタイマから求める
+ *
+ * 使い方:
+ *   timer_wheel_init(&w, now);
+ *   timer_init(&t, on_expire);
+ *   timer_schedule(&w, &t, now + 500);
+ *   epoll_wait(..., timer_wheel_timeout(&w, now));
+ *   timer_wheel_advance(&w, now, arg);      // 満了したタイマの fn(t, arg)
+ * ============================================================================
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+
+/* ============================================================================
+ * タイマホイール設定
+ * ============================================================================ */
+#define TIMER_WHEEL_TICK_MS     10      /* 1スロットの時間 (ms) */
+#define TIMER_WHEEL_SLOTS       512     /* スロット数 (一周 5.12 秒) */
+
+/* ============================================================================
+ * タイマ (利用側の構造体に埋め込む)
+ * ============================================================================ */
+typedef struct wheel_timer {
+    struct wheel_timer *prev, *next;    /* スロットの双方向リスト (NULL = 未登録) */
+    long long           expires;        /* 満了する tick */
+    void              (*fn)(struct wheel_timer *t, void *arg);
+} wheel_timer_t;
+
+/* ============================================================================
+ * タイマホイール
+ * ============================================================================ */
+typedef struct {
+    wheel_timer_t slots[TIMER_WHEEL_SLOTS];     /* 各スロットのリストの先頭 */
+    long long     current;              /* 処理済みの tick */
+    unsigned long count;                /* 登録中のタイマ数 */
+} timer_wheel_t;
+
+/* ============================================================================
+ * 関数: timer_wheel_init
+ * 機能: タイマホイールを初期化する
+ * ============================================================================ */
+static inline void timer_wheel_init(timer_wheel_t *w, long long now_ms) {
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        w->slots[i].prev = w->slots[i].next = &w->slots[i];
+    }
+    w->current = now_ms / TIMER_WHEEL_TICK_MS;
+    w->count = 0;
+}
+
+/* ============================================================================
+ * 関数: timer_init
+ * 機能: タイマを未登録の状態にし、満了時のコールバックを設定する
+ * ============================================================================ */
+static inline void timer_init(wheel_timer_t *t,
+                              void (*fn)(wheel_timer_t *t, void *arg)) {
+    t->prev = t->next = NULL;
+    t->expires = 0;
+    t->fn = fn;
+}
+
+/* ============================================================================
+ * 関数: timer_pending
+ * 機能: タイマが登録中か確認する
+ * ============================================================================ */
+static inline int timer_pending(const wheel_timer_t *t) {
+    return t->next != NULL;
+}
+
+/* ============================================================================
+ * 関数: timer_cancel
+ * 機能: タイマの登録を解除する (未登録なら何もしない)
+ * ============================================================================ */
+static inline void timer_cancel(timer_wheel_t *w, wheel_timer_t *t) {
+    if (t->next == NULL) {
+        return;
+    }
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->prev = t->next = NULL;
+    w->count--;
+}
+
+/* ============================================================================
+ * 関数: timer_schedule
+ * 機能: タイマを expires_ms (単調増加時刻) に満了するよう登録する
+ *   登録中のタイマは解除してから登録し直す。過去の時刻は次の tick で満了する
+ * ============================================================================ */
+static inline void timer_schedule(timer_wheel_t *w, wheel_timer_t *t,
+                                  long long expires_ms) {
+    long long tick = (expires_ms + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+    wheel_timer_t *slot;
+
+    timer_cancel(w, t);
+    if (tick <= w->current) {
+        tick = w->current + 1;
+    }
+    t->expires = tick;
+
+    /* スロットの先頭へ追加 (満了処理中のスロットでも今回は走査されない) */
+    slot = &w->slots[tick % TIMER_WHEEL_SLOTS];
+    t->prev = slot;
+    t->next = slot->next;
+    slot->next->prev = t;
+    slot->next = t;
+    w->count++;
+}
+
+/* ============================================================================
+ * 関数: timer_wheel_advance
+ * 機能: 現在時刻までのスロットを進め、満了したタイマのコールバックを呼ぶ
+ *   コールバック内で同じタイマを登録し直してもよい
+ * ============================================================================ */
+static inline void timer_wheel_advance(timer_wheel_t *w, long long now_ms, void *arg) {
+    long long target = now_ms / TIMER_WHEEL_TICK_MS;
+    long long from = w->current;
+    long long steps = target - from;
+    wheel_timer_t *slot, *t, *next;
+
+    if (steps <= 0) {
+        return;
+    }
+    if (steps > TIMER_WHEEL_SLOTS) {
+        steps = TIMER_WHEEL_SLOTS;      /* 一周以上遅れた場合は全スロットを1回 */
+    }
+    w->current = target;
+
+    for (long long i = 1; i <= steps && w->count > 0; i++) {
+        slot = &w->slots[(from + i) % TIMER_WHEEL_SLOTS];
+        for (t = slot->next; t != slot; t = next) {
+            next = t->next;
+            if (t->expires <= target) {
+                timer_cancel(w, t);
+                t->fn(t, arg);
+            }
+        }
+    }
+}
+
+/* ============================================================================
+ * 関数: timer_wheel_timeout
+ * 機能: 次にタイマが登録されているスロットまでの時間を求める
+ *   (そのスロットのタイマが次の周回の場合は早めに戻るだけで問題ない)
+ * 戻り値: 待ち時間 (ms, epoll_wait に渡す。-1 = タイマなし)
+ * ============================================================================ */
+static inline int timer_wheel_timeout(const timer_wheel_t *w, long long now_ms) {
+    long long wait;
+
+    if (w->count == 0) {
+        return -1;
+    }
+    for (long long i = 1; i <= TIMER_WHEEL_SLOTS; i++) {
+        const wheel_timer_t *slot = &w->slots[(w->current + i) % TIMER_WHEEL_SLOTS];
+        if (slot->next != slot) {
+            wait = (w->current + i) * TIMER_WHEEL_TICK_MS - now_ms;
+            return wait > 0 ? (int)wait : 0;
+        }
+    }
+    return 0;
+}
+
+#endif /* TIMER_WHEEL_H */
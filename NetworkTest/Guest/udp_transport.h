@@ -0,0 +1,181 @@
+/*
+ * ============================================================================
+ * udp_transport.h - Bridge/Client UDP Datagram Transport
+ * ============================================================================
+ * 機能:
+ *   - 小さな要求・応答を UDP データグラム1個ずつで運ぶ形式の定義
+ *     (TCP の復路接続・受け入れを使わない。Bridge_C -u / Client_C -u)
+ *   - データグラムヘッダの書き込み・解析
+ *   - 番号の重複検出 (直近 UDPT_WINDOW 個の受信済みビットマップ)
+ *   - 再送間隔 (初期値から倍々に延ばし、上限で止める)
+ *
+ * 再送と確認応答:
+ *   - クライアントは応答を受け取るまで要求を再送する (応答が要求の確認応答)
+ *   - ブリッジは応答を確認応答 (ACK) が届くまで番号ごとに保持し、
+ *     重複した要求 (応答が失われた・遅れた) には保持した応答を送り直す
+ *     (要求の処理は1回のみ)
+ *   - クライアントは受け取った応答すべて (重複を含む) に ACK を返し、
+ *     重複した応答は捨てる
+ *   - 応答待ちの要求は UDPT_WINDOW 個まで (番号の差が UDPT_WINDOW 以上の
+ *     古い要求は、重複として扱う)
+ *
+ * データグラム形式 (ビッグエンディアン):
+ *   +0  u8   magic     (UDPT_MAGIC)
+ *   +1  u8   version   (UDPT_VERSION)
+ *   +2  u8   type      (UDPT_TYPE_REQUEST / RESPONSE / ACK)
+ *   +3  u8   flags     (予約, 0)
+ *   +4  u32  session   (クライアントの起動ごとの 0 以外の値。番号の空間を区別する)
+ *   +8  u32  seq       (要求番号: 1から順に付け、応答・ACK は要求と同じ値)
+ *   +12 本体 (データグラムの残り全部, ACK は本体なし)
+ * ============================================================================
+ */
+
+#ifndef UDP_TRANSPORT_H
+#define UDP_TRANSPORT_H
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* ============================================================================
+ * 転送設定
+ * ============================================================================ */
+#define UDPT_MAGIC              0xA6
+#define UDPT_VERSION            1
+#define UDPT_HEADER_SIZE        12
+#define UDPT_MAX_PAYLOAD        1400    /* 本体長の上限 (MTU 1500 で分割されない) */
+#define UDPT_DATAGRAM_MAX       (UDPT_HEADER_SIZE + UDPT_MAX_PAYLOAD)
+#define UDPT_RESPONSE_PREFIX    128     /* 応答文に使う分 (要求本体の上限を決める) */
+#define UDPT_REQUEST_MAX        (UDPT_MAX_PAYLOAD - UDPT_RESPONSE_PREFIX)
+#define UDPT_WINDOW             256     /* 重複検出・応答待ちの範囲 (64の倍数) */
+#define UDPT_RTO_INITIAL_MS     20      /* 最初の再送までの時間 (ms) */
+#define UDPT_RTO_MAX_MS         1000    /* 再送間隔の上限 (ms) */
+#define UDPT_MAX_RETRIES        8       /* 再送回数の上限 (超えたら失われたとする) */
+
+enum {
+    UDPT_TYPE_REQUEST  = 1,
+    UDPT_TYPE_RESPONSE = 2,
+    UDPT_TYPE_ACK      = 3,
+};
+
+/* udpt_window_check の結果 */
+enum {
+    UDPT_NEW,                           /* 初めて受信した番号 */
+    UDPT_DUPLICATE,                     /* 受信済みの番号 */
+    UDPT_STALE,                         /* 範囲より古い番号 (受信済みかわからない) */
+};
+
+/* ============================================================================
+ * 解析済みデータグラム (受信バッファを直接指す)
+ * ============================================================================ */
+typedef struct {
+    uint8_t              type;
+    uint32_t             session;
+    uint32_t             seq;
+    uint32_t             length;        /* 本体長 */
+    const unsigned char *payload;
+} udpt_datagram_t;
+
+/* ============================================================================
+ * 重複検出の範囲 (番号 top から UDPT_WINDOW 個前までの受信済みビット)
+ * ============================================================================ */
+typedef struct {
+    uint32_t top;                       /* 受信した最大の番号 (0 = 未受信) */
+    uint64_t bits[UDPT_WINDOW / 64];    /* 番号 % UDPT_WINDOW の位置が受信済み */
+} udpt_window_t;
+
+/* ============================================================================
+ * 関数: udpt_put_header
+ * 機能: データグラムのヘッダを書き込む
+ * ============================================================================ */
+static inline void udpt_put_header(unsigned char *p, uint8_t type,
+                                   uint32_t session, uint32_t seq) {
+    p[0] = UDPT_MAGIC;
+    p[1] = UDPT_VERSION;
+    p[2] = type;
+    p[3] = 0;
+    p[4] = session >> 24;
+    p[5] = session >> 16;
+    p[6] = session >> 8;
+    p[7] = session;
+    p[8] = seq >> 24;
+    p[9] = seq >> 16;
+    p[10] = seq >> 8;
+    p[11] = seq;
+}
+
+/* ============================================================================
+ * 関数: udpt_parse
+ * 機能: 受信したデータグラム1個を解析する
+ * 戻り値: 0 = 成功, -1 = 不正 (短い・形式が違う・セッションか番号が 0)
+ * ============================================================================ */
+static inline int udpt_parse(const unsigned char *p, size_t len, udpt_datagram_t *d) {
+    if (len < UDPT_HEADER_SIZE || len > UDPT_DATAGRAM_MAX ||
+        p[0] != UDPT_MAGIC || p[1] != UDPT_VERSION) {
+        return -1;
+    }
+    d->type = p[2];
+    d->session = ((uint32_t)p[4] << 24) | ((uint32_t)p[5] << 16) |
+                 ((uint32_t)p[6] << 8) | p[7];
+    d->seq = ((uint32_t)p[8] << 24) | ((uint32_t)p[9] << 16) |
+             ((uint32_t)p[10] << 8) | p[11];
+    d->length = (uint32_t)(len - UDPT_HEADER_SIZE);
+    d->payload = p + UDPT_HEADER_SIZE;
+    return d->session != 0 && d->seq != 0 ? 0 : -1;
+}
+
+/* ============================================================================
+ * 関数: udpt_window_reset
+ * 機能: 重複検出の範囲を空にする (新しいセッション)
+ * ============================================================================ */
+static inline void udpt_window_reset(udpt_window_t *w) {
+    memset(w, 0, sizeof(*w));
+}
+
+/* ============================================================================
+ * 関数: udpt_window_check
+ * 機能: 番号が受信済みか確認し、初めての番号なら受信済みにする
+ *   番号は1から順に増える (32ビットの周回は扱わない)
+ * 戻り値: UDPT_NEW / UDPT_DUPLICATE / UDPT_STALE
+ * ============================================================================ */
+static inline int udpt_window_check(udpt_window_t *w, uint32_t seq) {
+    uint32_t bit = seq % UDPT_WINDOW;
+    uint64_t mask = 1ULL << (bit % 64);
+
+    if (seq > w->top) {
+        /* 範囲を進め、新たに範囲に入る番号 (top+1 .. seq) の位置を空ける */
+        if (seq - w->top >= UDPT_WINDOW) {
+            memset(w->bits, 0, sizeof(w->bits));
+        } else {
+            for (uint32_t s = w->top + 1; s != seq; s++) {
+                w->bits[(s % UDPT_WINDOW) / 64] &= ~(1ULL << (s % 64));
+            }
+        }
+        w->top = seq;
+        w->bits[bit / 64] |= mask;
+        return UDPT_NEW;
+    }
+    if (w->top - seq >= UDPT_WINDOW) {
+        return UDPT_STALE;
+    }
+    if (w->bits[bit / 64] & mask) {
+        return UDPT_DUPLICATE;
+    }
+    w->bits[bit / 64] |= mask;
+    return UDPT_NEW;
+}
+
+/* ============================================================================
+ * 関数: udpt_rto
+ * 機能: retries 回目の再送までの時間 (ms) を求める
+ * ============================================================================ */
+static inline long long udpt_rto(int retries) {
+    long long rto = UDPT_RTO_INITIAL_MS;
+
+    while (retries-- > 0 && rto < UDPT_RTO_MAX_MS) {
+        rto *= 2;
+    }
+    return rto < UDPT_RTO_MAX_MS ? rto : UDPT_RTO_MAX_MS;
+}
+
+#endif /* UDP_TRANSPORT_H */
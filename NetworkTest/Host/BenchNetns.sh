@@ -0,0 +1,539 @@
+#!/bin/bash
+################################################################################
+# BenchNetns.sh - Network Namespace Benchmark Harness
+################################################################################
+# QEMU を使わずに ABOS1/ABOS2 の2系統ネットワークを netns と veth で再現し、
+# ブリッジ・クライアントを起動して性能シナリオを実行する (要 root)
+#   netns abos1     : eth0 192.168.100.1/24,   eth1 192.168.200.1/24 (ABOS1)
+#   netns abos2     : eth0 192.168.100.2/24,   eth1 192.168.200.2/24 (ABOS2)
+#   netns elsgw     : eth0 192.168.100.100/24  (ELSGW 再送用, Host 相当)
+#   netns abos-hub  : br100, br200 (各 netns の veth の相手側を接続)
+#
+# シナリオ (run で指定, 省略時は実行できるもの全て):
+#   c-permsg     Bridge_C    + Client_C         メッセージごとに接続 (従来動作)
+#   c-persistent Bridge_C    + Client_C -p      接続維持
+#   c-framed     Bridge_C    + Client_C -f      フレーム形式 (パイプライン)
+#   c-udp        Bridge_C -u + Client_C -u      UDP 転送 (c-framed と同じ条件)
+#   c-closed     Bridge_C    + Client_C -L      closed-loop 負荷試験
+#   c-open       Bridge_C    + Client_C -L -r   open-loop 負荷試験
+#   c-oneshot    Bridge_C -o + Client_C -L -o   要求・応答ごとに接続 (1接続ずつ closed-loop)
+#   c-oneshot-fo c-oneshot の両側に -F  低遅延プロファイル (TCP Fast Open ほか)
+#   java-closed  Bridge_Java + Client_C -L -o   closed-loop 負荷試験 (要 java)
+#   java-client  Bridge_C    + Client_Java      応答数のみ (要 java)
+#   elsgw        ElsgwReplay -> ElsgwReceiver   マルチキャスト受信 (要 ELSGW_PCAP)
+#
+# 結果: $RESULT_DIR/<日時>/
+#   summary.csv  シナリオごとの送信数・受信数・欠損・スループット・RTT
+#   env.txt      実行条件 (ビルドしたコミット, カーネル, CPU, パラメータ)
+#   <シナリオ>.log, <シナリオ>-bridge.log  各プログラムの出力
+#
+# Usage: ./BenchNetns.sh {up|down|ls|build|run [シナリオ...]|compare 結果1 結果2}
+#   run は毎回ビルドし直してから実行する (古いバイナリを計測しない)
+#   環境変数 (既定値):
+#     DURATION=10       各シナリオの時間 (秒)
+#     CONCURRENCY=16    負荷試験の同時接続数
+#     RATE=20000        open-loop の目標の要求数/秒
+#     SIZES=64          負荷試験の要求サイズ (Client_C -s の書式)
+#     FRAMED_COUNT=200000  c-framed / c-udp の要求数
+#     NETEM=            veth に加える netem の設定 (例: "delay 1ms")
+#     ELSGW_PCAP=       elsgw シナリオで再送する pcap (ElsgwReceiver -w の出力)
+#     ELSGW_REPLAY_OPTS=-m  ElsgwReplay の再送速度 (-m = 最大速度, "-s 1" = 保存時の間隔)
+#     BUILD_DIR=/tmp/abos_bench/build  ビルド先
+#     RESULT_DIR=./bench_results       結果の保存先
+################################################################################
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+REPO_DIR="$(cd "$SCRIPT_DIR/../.." && pwd)"
+GUEST_DIR="$REPO_DIR/NetworkTest/Guest"
+EVAL_DIR="$REPO_DIR/EvalEnv"
+
+NS_ABOS1="abos1"
+NS_ABOS2="abos2"
+NS_ELSGW="elsgw"
+NS_HUB="abos-hub"
+
+DURATION="${DURATION:-10}"
+CONCURRENCY="${CONCURRENCY:-16}"
+RATE="${RATE:-20000}"
+SIZES="${SIZES:-64}"
+FRAMED_COUNT="${FRAMED_COUNT:-200000}"
+NETEM="${NETEM:-}"
+ELSGW_PCAP="${ELSGW_PCAP:-}"
+ELSGW_REPLAY_OPTS="${ELSGW_REPLAY_OPTS:--m}"
+BUILD_DIR="${BUILD_DIR:-/tmp/abos_bench/build}"
+RESULT_DIR="${RESULT_DIR:-./bench_results}"
+
+ALL_SCENARIOS="c-permsg c-persistent c-framed c-udp c-closed c-open c-oneshot c-oneshot-fo"
+ALL_SCENARIOS="$ALL_SCENARIOS java-closed java-client elsgw"
+CSV_HEADER="scenario,sent,received,lost,throughput_per_s,p50_ms,p99_ms,p999_ms,max_ms"
+
+# root 以外は sudo で実行する
+if [ "$(id -u)" -eq 0 ]; then
+    SUDO=""
+else
+    SUDO="sudo"
+fi
+
+ns() {
+    local name=$1
+    shift
+    $SUDO ip netns exec "$name" "$@"
+}
+
+################################################################################
+# ネットワーク
+################################################################################
+
+# veth を1本作成し、片側を netns に入れて IP を設定、もう片側をブリッジへ接続
+#   add_link <netns> <netns内の名前> <IP/長さ> <ブリッジ> <hub側の名前>
+add_link() {
+    local name=$1 dev=$2 addr=$3 br=$4 peer=$5
+
+    $SUDO ip link add "$peer" netns $NS_HUB type veth peer name "$dev" netns "$name"
+    ns $NS_HUB ip link set dev "$peer" master "$br" up
+    ns "$name" ip address add "$addr" dev "$dev"
+    ns "$name" ip link set dev "$dev" up
+    if [ -n "$NETEM" ]; then
+        ns $NS_HUB tc qdisc add dev "$peer" root netem $NETEM
+    fi
+}
+
+create_network() {
+    echo "Creating namespaces: $NS_ABOS1, $NS_ABOS2, $NS_ELSGW, $NS_HUB"
+
+    for name in $NS_HUB $NS_ABOS1 $NS_ABOS2 $NS_ELSGW; do
+        $SUDO ip netns add $name || return 1
+        ns $name ip link set dev lo up
+    done
+
+    # TCP Fast Open を接続側・待ち受け側とも有効にする (-F のシナリオ用)。
+    # 接続ごとのシナリオで TIME_WAIT のポートを再利用し、ポートの枯渇を防ぐ
+    for name in $NS_ABOS1 $NS_ABOS2; do
+        ns $name sysctl -qw net.ipv4.tcp_fastopen=3 net.ipv4.tcp_tw_reuse=1
+    done
+
+    # ブリッジ作成 (hub の netns 内, ホストのネットワークには触れない)
+    for br in br100 br200; do
+        ns $NS_HUB ip link add name $br type bridge
+        ns $NS_HUB ip link set dev $br up
+    done
+
+    add_link $NS_ABOS1 eth0 192.168.100.1/24   br100 a1-eth0
+    add_link $NS_ABOS1 eth1 192.168.200.1/24   br200 a1-eth1
+    add_link $NS_ABOS2 eth0 192.168.100.2/24   br100 a2-eth0
+    add_link $NS_ABOS2 eth1 192.168.200.2/24   br200 a2-eth1
+    add_link $NS_ELSGW eth0 192.168.100.100/24 br100 gw-eth0
+
+    # マルチキャスト (ELSGW) は 100.x 網へ送受信する
+    ns $NS_ABOS1 ip route add 224.0.0.0/4 dev eth0
+    ns $NS_ELSGW ip route add 224.0.0.0/4 dev eth0
+
+    echo "Network setup complete${NETEM:+ (netem: $NETEM)}"
+}
+
+cleanup_network() {
+    echo "Cleaning up namespaces: $NS_ABOS1, $NS_ABOS2, $NS_ELSGW, $NS_HUB"
+
+    # netns の削除で中の veth・ブリッジも削除される
+    for name in $NS_ABOS1 $NS_ABOS2 $NS_ELSGW $NS_HUB; do
+        $SUDO ip netns pids $name 2>/dev/null | xargs -r $SUDO kill 2>/dev/null
+        $SUDO ip netns delete $name 2>/dev/null
+    done
+
+    echo "Network cleanup complete"
+}
+
+show_status() {
+    echo "=== Namespace Status ==="
+    for name in $NS_ABOS1 $NS_ABOS2 $NS_ELSGW; do
+        if $SUDO ip netns list | grep -qw "^$name"; then
+            echo "Namespace: $name"
+            ns $name ip -brief address show | grep -v "^lo" | sed 's/^/  /'
+        fi
+    done
+    echo
+    echo "=== Bridge Status ==="
+    for br in br100 br200; do
+        if ns $NS_HUB ip link show $br &>/dev/null; then
+            echo "Bridge: $br"
+            ns $NS_HUB ip -brief link show master $br | sed 's/^/  /'
+        fi
+    done
+}
+
+################################################################################
+# ビルド (各プログラムの「ビルド:」のコマンドと同じ)
+#   ビルドしたソースのコミットを $BUILD_DIR/commit.txt に記録する
+#   (未コミットの変更がある場合は差分のハッシュを付ける)
+################################################################################
+source_commit() {
+    local commit dirty
+
+    commit=$(git -C "$REPO_DIR" describe --always --dirty 2>/dev/null) || commit="unknown"
+    dirty=$(git -C "$REPO_DIR" diff HEAD 2>/dev/null | sha1sum)
+    case "$commit" in
+        *-dirty) echo "$commit (diff ${dirty:0:12})" ;;
+        *)       echo "$commit" ;;
+    esac
+}
+
+build_programs() {
+    local commit
+
+    mkdir -p "$BUILD_DIR" || return 1
+    commit=$(source_commit)
+    echo "Building $commit into $BUILD_DIR"
+    rm -f "$BUILD_DIR/commit.txt"
+
+    gcc -O2 -Wall -pthread -o "$BUILD_DIR/Bridge_C" "$GUEST_DIR/Bridge_C.c" || return 1
+    gcc -O2 -Wall -pthread -o "$BUILD_DIR/Client_C" "$GUEST_DIR/Client_C.c" || return 1
+    gcc -O2 -Wall -o "$BUILD_DIR/StageStat" "$GUEST_DIR/StageStat.c" || return 1
+    gcc -O2 -Wall -pthread -o "$BUILD_DIR/LogDecode" "$GUEST_DIR/LogDecode.c" \
+        "$EVAL_DIR/hex_dump.c" || return 1
+    (cd "$EVAL_DIR" &&
+     gcc -O2 -Wall -pthread -o "$BUILD_DIR/ElsgwReceiver" ElsgwReceiver.c hex_dump.c \
+         tpacket_rx.c pcap_writer.c elsgw_stats.c epoll_rx.c elsgw_decoder.c \
+         elsgw_relay.c elsgw_shm.c elsgw_arb.c &&
+     gcc -O2 -Wall -o "$BUILD_DIR/ElsgwReplay" ElsgwReplay.c) || return 1
+
+    # Java 版はリポジトリの .java から作り直す (javac がなければ .class を使う)
+    if command -v javac &>/dev/null; then
+        javac -d "$BUILD_DIR" "$GUEST_DIR/Bridge_Java.java" "$GUEST_DIR/Client_Java.java" ||
+            return 1
+    else
+        cp "$GUEST_DIR"/Bridge_Java.class "$GUEST_DIR"/Client_Java.class "$BUILD_DIR"/
+    fi
+
+    echo "$commit" > "$BUILD_DIR/commit.txt"
+    echo "Build complete"
+}
+
+################################################################################
+# プロセス制御
+################################################################################
+
+# ブリッジ (ABOS1) を起動し、192.168.100.1:8000 で待ち受けるまで待つ
+#   start_bridge <ログ> <コマンド...>
+start_bridge() {
+    local log=$1
+    shift
+
+    # 関数経由ではなく直接起動し、$! をブリッジ本体 (SIGINT の送り先) にする
+    $SUDO ip netns exec $NS_ABOS1 stdbuf -oL "$@" > "$log" 2>&1 &
+    BRIDGE_PID=$!
+    for _ in $(seq 50); do
+        if ns $NS_ABOS1 ss -Hltn "sport = :8000" | grep -q .; then
+            return 0
+        fi
+        sleep 0.1
+    done
+    echo "[ERROR] Bridge did not start listening (see $log)"
+    stop_bridge
+    return 1
+}
+
+stop_bridge() {
+    if [ -n "$BRIDGE_PID" ]; then
+        $SUDO kill -INT "$BRIDGE_PID" 2>/dev/null
+        wait "$BRIDGE_PID" 2>/dev/null
+        BRIDGE_PID=""
+    fi
+}
+
+# 時間を区切って ABOS2 側のプログラムを実行する (SIGINT で停止)
+#   run_client <秒> <ログ> <netns> <コマンド...>
+run_client() {
+    local secs=$1 log=$2 name=$3
+    shift 3
+
+    timeout -s INT -k 5 "$secs" $SUDO ip netns exec "$name" stdbuf -oL "$@" > "$log" 2>&1
+}
+
+################################################################################
+# 結果の集計 (summary.csv の1行を出力)
+################################################################################
+
+# Client_C -L の結果
+parse_loadgen() {
+    local scenario=$1 log=$2
+
+    awk -v s="$scenario" -F'[ ,:]+' '
+        /^\[INFO\] Requests:/   { sent = $3; recv = $5; lost = $7 + $10 }
+        /^\[INFO\] Throughput:/ { tput = $3 }
+        /^\[INFO\] RTT \(ms\):/ { p50 = $9; p99 = $13; p999 = $15; max = $17 }
+        END {
+            if (sent == "") { print s ",,,,,,,,"; exit }
+            print s "," sent "," recv "," lost "," tput "," p50 "," p99 "," p999 "," max
+        }' "$log"
+}
+
+# Client_C の行ごとの "[RECV] ... (RTT x ms)" から集計 (従来・接続維持モード)
+parse_rtt_lines() {
+    local scenario=$1 log=$2 secs=$3
+    local sent
+
+    sent=$(grep -c '^\[SEND\]' "$log")
+    grep -o '(RTT [0-9.]* ms)$' "$log" | awk '{ print $2 }' | sort -n |
+    awk -v s="$scenario" -v sent="$sent" -v secs="$secs" '
+        { v[NR] = $1 }
+        function pct(p,  i) { i = int(p / 100 * NR + 0.5); return v[i < 1 ? 1 : i] }
+        END {
+            if (NR == 0) { print s "," sent ",0," sent ",0,,,,"; exit }
+            printf "%s,%d,%d,%d,%.1f,%s,%s,%s,%s\n", s, sent, NR, sent - NR,
+                   NR / secs, pct(50), pct(99), pct(99.9), v[NR]
+        }'
+}
+
+# Client_C -f / -u の結果
+parse_framed() {
+    local scenario=$1 log=$2
+
+    awk -v s="$scenario" -F'[ ,:]+' '
+        /^\[INFO\] Requests:/ { sent = $3; recv = $5; lost = $7 }
+        /requests\/s, .* RTT avg/ { tput = $2; max = $(NF - 1) }
+        /^\[INFO\] RTT \(ms\):/ { p50 = $9; p99 = $13; p999 = $15; max = $17 }
+        END {
+            if (sent == "") { print s ",,,,,,,,"; exit }
+            print s "," sent "," recv "," lost "," tput "," p50 "," p99 "," p999 "," max
+        }' "$log"
+}
+
+# Client_Java の応答数 (RTT の表示はない)
+parse_java_client() {
+    local scenario=$1 log=$2 secs=$3
+    local sent recv
+
+    sent=$(grep -c '^\[SEND\]' "$log")
+    recv=$(grep -c '^\[RECV\]' "$log")
+    printf "%s,%d,%d,%d,%.1f,,,,\n" "$scenario" "$sent" "$recv" $((sent - recv)) \
+           "$(echo "$recv $secs" | awk '{ print $1 / $2 }')"
+}
+
+# ElsgwReceiver -j のスナップショットと ElsgwReplay の結果
+#   受信数は最後のスナップショット、RTT の代わりに処理遅延 (最も多く記録した
+#   周期の latency_ns)、スループットは再送時間あたりの受信数
+parse_elsgw() {
+    local scenario=$1 json=$2 log=$3
+    local sent secs
+
+    sent=$(sed -n 's/.*Sent \([0-9]*\) packets.* in \([0-9.]*\) s.*/\1/p' "$log")
+    secs=$(sed -n 's/.*Sent \([0-9]*\) packets.* in \([0-9.]*\) s.*/\2/p' "$log")
+    awk -v s="$scenario" -v sent="$sent" -v secs="$secs" '
+        function field(line, name,  r) {
+            if (match(line, "\"" name "\":[0-9.]+")) {
+                r = substr(line, RSTART, RLENGTH); sub(/.*:/, "", r); return r + 0
+            }
+            return 0
+        }
+        function lat(name,  r) {
+            r = busy
+            sub(/.*"latency_ns":/, "", r)
+            return sprintf("%.3f", field(r, name) / 1e6)
+        }
+        {
+            recv = field($0, "rx_packets")
+            r = $0; sub(/.*"latency_ns":/, "", r)
+            if (field(r, "count") >= most) { most = field(r, "count"); busy = $0 }
+        }
+        END {
+            printf "%s,%s,%d,%s,%s,%s,%s,%s,%s\n", s, sent, recv,
+                   (sent != "" ? sent - recv : ""),
+                   (secs > 0 ? sprintf("%.1f", recv / secs) : ""),
+                   lat("p50"), lat("p99"), lat("p999"), lat("max")
+        }' "$json"
+}
+
+################################################################################
+# シナリオ
+################################################################################
+
+# シナリオを1個実行し、summary.csv へ1行追加する
+run_scenario() {
+    local scenario=$1 out=$2
+    local log="$out/$scenario.log"
+    local blog="$out/$scenario-bridge.log"
+    local row=""
+
+    case "$scenario" in
+        java-*)
+            if ! command -v java &>/dev/null; then
+                echo "[WARN] Skipping $scenario: java not found"
+                return 0
+            fi
+            ;;
+        elsgw)
+            if [ -z "$ELSGW_PCAP" ]; then
+                echo "[WARN] Skipping $scenario: ELSGW_PCAP not set"
+                return 0
+            fi
+            ;;
+    esac
+    echo "[INFO] Running $scenario (${DURATION} s)"
+
+    case "$scenario" in
+        c-permsg)
+            start_bridge "$blog" "$BUILD_DIR/Bridge_C" -q || return 1
+            run_client "$DURATION" "$log" $NS_ABOS2 "$BUILD_DIR/Client_C" -i 0
+            row=$(parse_rtt_lines "$scenario" "$log" "$DURATION")
+            ;;
+        c-persistent)
+            start_bridge "$blog" "$BUILD_DIR/Bridge_C" -q || return 1
+            run_client "$DURATION" "$log" $NS_ABOS2 "$BUILD_DIR/Client_C" -p -i 0
+            row=$(parse_rtt_lines "$scenario" "$log" "$DURATION")
+            ;;
+        c-framed)
+            start_bridge "$blog" "$BUILD_DIR/Bridge_C" -q || return 1
+            run_client $((DURATION * 6)) "$log" $NS_ABOS2 "$BUILD_DIR/Client_C" \
+                -f -w 64 -n "$FRAMED_COUNT" -i 0 -q
+            row=$(parse_framed "$scenario" "$log")
+            ;;
+        c-udp)
+            start_bridge "$blog" "$BUILD_DIR/Bridge_C" -q -u || return 1
+            run_client $((DURATION * 6)) "$log" $NS_ABOS2 "$BUILD_DIR/Client_C" \
+                -u -w 64 -n "$FRAMED_COUNT" -i 0 -q
+            row=$(parse_framed "$scenario" "$log")
+            ;;
+        c-closed)
+            start_bridge "$blog" "$BUILD_DIR/Bridge_C" -q || return 1
+            run_client $((DURATION + 30)) "$log" $NS_ABOS2 "$BUILD_DIR/Client_C" \
+                -L -c "$CONCURRENCY" -d "$DURATION" -s "$SIZES" -q
+            row=$(parse_loadgen "$scenario" "$log")
+            ;;
+        c-open)
+            start_bridge "$blog" "$BUILD_DIR/Bridge_C" -q || return 1
+            run_client $((DURATION + 30)) "$log" $NS_ABOS2 "$BUILD_DIR/Client_C" \
+                -L -c "$CONCURRENCY" -r "$RATE" -d "$DURATION" -s "$SIZES" -q
+            row=$(parse_loadgen "$scenario" "$log")
+            ;;
+        c-oneshot|c-oneshot-fo)
+            local profile=""
+
+            [ "$scenario" = "c-oneshot-fo" ] && profile="-F"
+            start_bridge "$blog" "$BUILD_DIR/Bridge_C" -q -o $profile || return 1
+            run_client $((DURATION + 30)) "$log" $NS_ABOS2 "$BUILD_DIR/Client_C" \
+                -L -o -c 1 -d "$DURATION" -s "$SIZES" -q $profile
+            row=$(parse_loadgen "$scenario" "$log")
+            ;;
+        java-closed)
+            # Bridge_Java は1接続で1行のみ読み、要求を順に処理するため1接続で送る
+            start_bridge "$blog" java -cp "$BUILD_DIR" Bridge_Java || return 1
+            run_client $((DURATION + 30)) "$log" $NS_ABOS2 "$BUILD_DIR/Client_C" \
+                -L -o -c 1 -d "$DURATION" -s "$SIZES" -q
+            row=$(parse_loadgen "$scenario" "$log")
+            ;;
+        java-client)
+            start_bridge "$blog" "$BUILD_DIR/Bridge_C" -q || return 1
+            run_client "$DURATION" "$log" $NS_ABOS2 java -cp "$BUILD_DIR" Client_Java
+            row=$(parse_java_client "$scenario" "$log" "$DURATION")
+            ;;
+        elsgw)
+            local json="$out/$scenario-stats.json"
+
+            $SUDO ip netns exec $NS_ABOS1 "$BUILD_DIR/ElsgwReceiver" -q -j "$json" \
+                > "$blog" 2>&1 &
+            BRIDGE_PID=$!
+            sleep 1
+            run_client $((DURATION * 6)) "$log" $NS_ELSGW "$BUILD_DIR/ElsgwReplay" \
+                $ELSGW_REPLAY_OPTS "$ELSGW_PCAP"
+            sleep 2                 # 残りの処理と最後の統計出力を待つ
+            stop_bridge
+            row=$(parse_elsgw "$scenario" "$json" "$log")
+            ;;
+        *)
+            echo "[ERROR] Unknown scenario: $scenario"
+            return 1
+            ;;
+    esac
+    stop_bridge
+
+    echo "$row" >> "$out/summary.csv"
+    echo "  $CSV_HEADER"
+    echo "  $row"
+}
+
+run_benchmark() {
+    local scenarios="${*:-$ALL_SCENARIOS}"
+    local out
+
+    if ! $SUDO ip netns list | grep -qw "^$NS_ABOS2"; then
+        create_network || return 1
+    fi
+    build_programs || return 1
+
+    out="$RESULT_DIR/$(date +%Y%m%d-%H%M%S)"
+    mkdir -p "$out" || return 1
+    {
+        echo "commit:      $(cat "$BUILD_DIR/commit.txt")"
+        echo "date:        $(date -Iseconds)"
+        echo "kernel:      $(uname -r)"
+        echo "cpu:         $(grep -m1 'model name' /proc/cpuinfo | sed 's/.*: //') x $(nproc)"
+        echo "duration:    $DURATION"
+        echo "concurrency: $CONCURRENCY"
+        echo "rate:        $RATE"
+        echo "sizes:       $SIZES"
+        echo "netem:       ${NETEM:-none}"
+        echo "elsgw:       ${ELSGW_PCAP:-none} $ELSGW_REPLAY_OPTS"
+        echo "scenarios:   $scenarios"
+    } > "$out/env.txt"
+    echo "$CSV_HEADER" > "$out/summary.csv"
+
+    for scenario in $scenarios; do
+        run_scenario "$scenario" "$out"
+    done
+
+    echo "Results: $out/summary.csv"
+}
+
+# 2回の結果を比較し、スループットと p99 の変化を表示する
+#   compare <結果1> <結果2> (結果のディレクトリまたは summary.csv)
+compare_results() {
+    local a=$1 b=$2
+
+    [ -d "$a" ] && a="$a/summary.csv"
+    [ -d "$b" ] && b="$b/summary.csv"
+    if [ ! -f "$a" ] || [ ! -f "$b" ]; then
+        echo "Usage: $0 compare <result1> <result2>"
+        return 1
+    fi
+
+    awk -F, '
+        function delta(x, y) {
+            return (x == "" || y == "" || x + 0 == 0) ? "-" : sprintf("%+.1f%%", (y - x) * 100 / x)
+        }
+        FNR == 1 { next }
+        NR == FNR { tput[$1] = $5; p99[$1] = $7; lost[$1] = $4; next }
+        ($1 in tput) {
+            printf "%-13s %12s -> %-12s %8s   %9s -> %-9s %8s   lost %s -> %s\n",
+                   $1, tput[$1], $5, delta(tput[$1], $5), p99[$1], $7,
+                   delta(p99[$1], $7), lost[$1], $4
+        }' "$a" "$b" |
+    { printf "%-13s %29s %8s   %23s %8s\n" scenario "throughput (/s)" "" "p99 (ms)" ""; cat; }
+}
+
+# メイン処理
+case "${1:-}" in
+    up)
+        create_network
+        ;;
+    down)
+        cleanup_network
+        ;;
+    ls)
+        show_status
+        ;;
+    build)
+        build_programs
+        ;;
+    run)
+        shift
+        run_benchmark "$@"
+        ;;
+    compare)
+        compare_results "$2" "$3"
+        ;;
+    *)
+        echo "Usage: $0 {up|down|ls|build|run [scenario...]|compare result1 result2}"
+        echo "Scenarios: $ALL_SCENARIOS"
+        exit 1
+        ;;
+esac